@@ -14,6 +14,32 @@
 #include <eos_anticheatclient.h>
 
 FAntiCheatClient::FAntiCheatClient()
+	: ProtectedMessageChannel(
+		[this](uint32_t DataLengthBytes, uint32_t& OutBufferSizeBytes)
+		{
+			EOS_AntiCheatClient_GetProtectMessageOutputLengthOptions Options = {};
+			Options.ApiVersion = EOS_ANTICHEATCLIENT_GETPROTECTMESSAGEOUTPUTLENGTH_API_LATEST;
+			Options.DataLengthBytes = DataLengthBytes;
+			return EOS_AntiCheatClient_GetProtectMessageOutputLength(AntiCheatClientHandle, &Options, &OutBufferSizeBytes) == EOS_EResult::EOS_Success;
+		},
+		[this](void* /*ClientHandle*/, const void* Data, uint32_t DataLengthBytes, void* OutBuffer, uint32_t OutBufferSizeBytes, uint32_t& OutBytesWritten)
+		{
+			EOS_AntiCheatClient_ProtectMessageOptions Options = {};
+			Options.ApiVersion = EOS_ANTICHEATCLIENT_PROTECTMESSAGE_API_LATEST;
+			Options.DataLengthBytes = DataLengthBytes;
+			Options.Data = Data;
+			Options.OutBufferSizeBytes = OutBufferSizeBytes;
+			return EOS_AntiCheatClient_ProtectMessage(AntiCheatClientHandle, &Options, OutBuffer, &OutBytesWritten) == EOS_EResult::EOS_Success;
+		},
+		[this](void* /*ClientHandle*/, const void* Data, uint32_t DataLengthBytes, void* OutBuffer, uint32_t OutBufferSizeBytes, uint32_t& OutBytesWritten)
+		{
+			EOS_AntiCheatClient_UnprotectMessageOptions Options = {};
+			Options.ApiVersion = EOS_ANTICHEATCLIENT_UNPROTECTMESSAGE_API_LATEST;
+			Options.DataLengthBytes = DataLengthBytes;
+			Options.Data = Data;
+			Options.OutBufferSizeBytes = OutBufferSizeBytes;
+			return EOS_AntiCheatClient_UnprotectMessage(AntiCheatClientHandle, &Options, OutBuffer, &OutBytesWritten) == EOS_EResult::EOS_Success;
+		})
 {
 	FGame::Get().GetAntiCheatNetworkTransport()->SetOnNewMessageCallback([this](const void* Data, uint32_t Length)
 	{
@@ -25,6 +51,24 @@ FAntiCheatClient::FAntiCheatClient()
 		FGameEvent Event(EGameEventType::AntiCheatKicked);
 		FGame::Get().OnGameEvent(Event);
 	});
+	FGame::Get().GetAntiCheatNetworkTransport()->SetOnConnectionStateChangedCallback([](FTCPClient::EConnectionState State)
+	{
+		if (State == FTCPClient::EConnectionState::Connected)
+		{
+			FDebugLog::Log(L"Connected to anti-cheat server");
+		}
+		else if (State == FTCPClient::EConnectionState::Failed)
+		{
+			// Without the server the session cannot be protected, leave the game the same way as when kicked
+			FDebugLog::LogError(L"ConnectToAntiCheatServer Error");
+			FGameEvent Event(EGameEventType::AntiCheatKicked);
+			FGame::Get().OnGameEvent(Event);
+		}
+	});
+	StatusPoller.Subscribe([](const FAntiCheatStatusPoller::FViolationEvent& Event)
+	{
+		FDebugLog::Log(L"EOS_AntiCheatClient_PollStatus: ViolationType=%d, Message=%ls", Event.Type, FStringUtils::Widen(Event.Message.data()).c_str());
+	});
 }
 
 FAntiCheatClient::~FAntiCheatClient()
@@ -40,15 +84,14 @@ void FAntiCheatClient::Init()
 		FDebugLog::LogWarning(L"Can't get a handle to the Anti-Cheat Client Interface. Please, start the game via Anti-Cheat bootstrapper.");
 		return;
 	}
+
+	StatusPoller.Start(AntiCheatClientHandle);
 }
 
 bool FAntiCheatClient::Start(const std::string& Host, int Port, const FProductUserId& LocalUserId, const std::string& EOSConnectIdTokenJWT)
 {
-	if (!ConnectToAntiCheatServer(Host, Port))
-	{
-		FDebugLog::LogError(L"ConnectToAntiCheatServer Error");
-		return false;
-	}
+	// Completes in the background, messages sent before that are queued until the connection is up
+	ConnectToAntiCheatServer(Host, Port);
 
 	if (!AddNotifyMessageToServerCallback())
 	{
@@ -57,7 +100,7 @@ bool FAntiCheatClient::Start(const std::string& Host, int Port, const FProductUs
 		return false;
 	}
 
-	if (!BeginSession(LocalUserId))
+	if (!BeginSession(LocalUserId, EOS_EAntiCheatClientMode::EOS_ACCM_ClientServer))
 	{
 		RemoveNotifyMessageToServerCallback();
 		DisconnectFromAntiCheatServer();
@@ -73,12 +116,20 @@ bool FAntiCheatClient::Start(const std::string& Host, int Port, const FProductUs
 
 void FAntiCheatClient::Stop()
 {
+	StopPeerMode();
+
 	if (bConnected)
 	{
+		// Protect what the game queued before the session ends
+		SendProtectedMessages();
+
 		RemoveNotifyMessageToServerCallback();
 		EndSession();
 		DisconnectFromAntiCheatServer();
 		bConnected = false;
+
+		FGame::Get().GetAntiCheatNetworkTransport()->LogCompressionStats();
+		ProtectedMessageChannel.LogStats(L"Protected game messages");
 	}
 }
 
@@ -91,28 +142,156 @@ void FAntiCheatClient::EndSession()
 
 void FAntiCheatClient::PollStatus()
 {
-	EOS_AntiCheatClient_PollStatusOptions Options = {};
-	Options.ApiVersion = EOS_ANTICHEATCLIENT_POLLSTATUS_API_LATEST;
-	Options.OutMessageLength = 256;
+	if (!StatusPoller.PollNow())
+	{
+		FDebugLog::Log(L"EOS_AntiCheatClient_PollStatus: No violations found.");
+	}
+}
 
-	EOS_EAntiCheatClientViolationType Type = {};
-	std::array<char, 256> Message = {};
+void FAntiCheatClient::Update()
+{
+	StatusPoller.Update();
+	SendProtectedMessages();
 
-	const EOS_EResult Result = EOS_AntiCheatClient_PollStatus(AntiCheatClientHandle, &Options, &Type, &Message[0]);
+	if (bPeerMode)
+	{
+		// Messages the anti-cheat client queued for a peer since the last frame go out as one packet per peer
+		PeerTransport.Receive();
+		PeerTransport.Flush();
+	}
+}
 
-	if (Result == EOS_EResult::EOS_NotFound)
+void FAntiCheatClient::SetSendProtectedMessageCallback(FProtectedMessageChannel::FSendFunction Callback)
+{
+	SendProtectedMessageCallback = std::move(Callback);
+}
+
+void FAntiCheatClient::SendProtectedMessages()
+{
+	// NetProtect needs a client-server session, game traffic of peer mode is not protected
+	if (bConnected && SendProtectedMessageCallback)
 	{
-		FDebugLog::Log(L"EOS_AntiCheatClient_PollStatus: No violations found.");
+		ProtectedMessageChannel.ProtectQueuedMessages(SendProtectedMessageCallback);
 	}
 	else
 	{
-		FDebugLog::Log(L"EOS_AntiCheatClient_PollStatus: ViolationType=%d, Message=%ls", Type,  FStringUtils::Widen(Message.data()).c_str());
+		ProtectedMessageChannel.DiscardQueuedMessages();
+	}
+}
+
+bool FAntiCheatClient::StartPeerMode(const FProductUserId& LocalUserId)
+{
+	if (bConnected || bPeerMode)
+	{
+		FDebugLog::LogError(L"StartPeerMode: A session is already running");
+		return false;
+	}
+
+	if (!AddNotifyPeerCallbacks())
+	{
+		RemoveNotifyPeerCallbacks();
+		FDebugLog::LogError(L"AddNotifyPeerCallbacks Error");
+		return false;
+	}
+
+	if (!BeginSession(LocalUserId, EOS_EAntiCheatClientMode::EOS_ACCM_PeerToPeer))
+	{
+		RemoveNotifyPeerCallbacks();
+		FDebugLog::LogError(L"BeginSession Error");
+		return false;
+	}
+
+	PeerTransport.Init(EOS_Platform_GetP2PInterface(FPlatform::GetPlatformHandle()), LocalUserId);
+	PeerTransport.SetOnMessageReceivedCallback([this](EOS_ProductUserId PeerUserId, const void* Data, uint32_t Length)
+	{
+		EOS_AntiCheatClient_ReceiveMessageFromPeerOptions Options = {};
+		Options.ApiVersion = EOS_ANTICHEATCLIENT_RECEIVEMESSAGEFROMPEER_API_LATEST;
+		Options.PeerHandle = PeerUserId;
+		Options.DataLengthBytes = Length;
+		Options.Data = Data;
+
+		const EOS_EResult Result = EOS_AntiCheatClient_ReceiveMessageFromPeer(AntiCheatClientHandle, &Options);
+		if (Result != EOS_EResult::EOS_Success)
+		{
+			FDebugLog::LogError(L"EOS_AntiCheatClient_ReceiveMessageFromPeer Error: %ls", FStringUtils::Widen(EOS_EResult_ToString(Result)).c_str());
+		}
+	});
+
+	// Players that connect to us become peers. Their platform is not known here, anti-cheat works it out on its own.
+	PeerTransport.SetOnPeerConnectionRequestCallback([this](EOS_ProductUserId PeerUserId)
+	{
+		FDebugLog::Log(L"Anti-cheat peer connection request from %ls", FStringUtils::Widen(FAccountHelpers::ProductUserIDToString(PeerUserId)).c_str());
+		RegisterPeer(FProductUserId(PeerUserId), EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Unknown);
+	});
+	PeerTransport.SetOnPeerConnectionClosedCallback([this](EOS_ProductUserId PeerUserId)
+	{
+		FDebugLog::Log(L"Anti-cheat peer %ls disconnected", FStringUtils::Widen(FAccountHelpers::ProductUserIDToString(PeerUserId)).c_str());
+		UnregisterPeerHandle(PeerUserId);
+	});
+	bPeerMode = true;
+
+	return true;
+}
+
+void FAntiCheatClient::StopPeerMode()
+{
+	if (bPeerMode)
+	{
+		for (EOS_ProductUserId PeerUserId : PeerTransport.GetPeers())
+		{
+			UnregisterPeerHandle(PeerUserId);
+		}
+		EndSession();
+		RemoveNotifyPeerCallbacks();
+
+		const FAntiCheatPeerTransport::FStats& Stats = PeerTransport.GetStats();
+		FDebugLog::Log(L"Anti-cheat peer messages: %llu sent in %llu packets, %llu received in %llu packets",
+			static_cast<unsigned long long>(Stats.MessagesSent), static_cast<unsigned long long>(Stats.PacketsSent),
+			static_cast<unsigned long long>(Stats.MessagesReceived), static_cast<unsigned long long>(Stats.PacketsReceived));
+		PeerTransport.Shutdown();
+		bPeerMode = false;
+	}
+}
+
+bool FAntiCheatClient::RegisterPeer(const FProductUserId& PeerUserId, EOS_EAntiCheatCommonClientPlatform ClientPlatform)
+{
+	if (!bPeerMode)
+	{
+		return false;
+	}
+
+	// The product user id is unique within the session, so it doubles as the peer handle
+	EOS_AntiCheatClient_RegisterPeerOptions Options = {};
+	Options.ApiVersion = EOS_ANTICHEATCLIENT_REGISTERPEER_API_LATEST;
+	Options.PeerHandle = PeerUserId.AccountId;
+	Options.ClientType = EOS_EAntiCheatCommonClientType::EOS_ACCCT_ProtectedClient;
+	Options.ClientPlatform = ClientPlatform;
+	Options.AuthenticationTimeout = EOS_ANTICHEATCLIENT_REGISTERPEER_MIN_AUTHENTICATIONTIMEOUT;
+	Options.PeerProductUserId = PeerUserId;
+
+	const EOS_EResult Result = EOS_AntiCheatClient_RegisterPeer(AntiCheatClientHandle, &Options);
+	if (Result != EOS_EResult::EOS_Success)
+	{
+		FDebugLog::LogError(L"EOS_AntiCheatClient_RegisterPeer Error: %ls", FStringUtils::Widen(EOS_EResult_ToString(Result)).c_str());
+		return false;
+	}
+
+	PeerTransport.AddPeer(PeerUserId.AccountId);
+	return true;
+}
+
+void FAntiCheatClient::UnregisterPeer(const FProductUserId& PeerUserId)
+{
+	if (bPeerMode)
+	{
+		UnregisterPeerHandle(PeerUserId.AccountId);
 	}
 }
 
 void FAntiCheatClient::OnShutdown()
 {
 	Stop();
+	StatusPoller.Stop();
 }
 
 void FAntiCheatClient::OnMessageFromServerReceived(const void* Data, uint32_t DataLengthBytes) const
@@ -140,22 +319,21 @@ void FAntiCheatClient::RemoveNotifyMessageToServerCallback()
 	EOS_AntiCheatClient_RemoveNotifyMessageToServer(AntiCheatClientHandle, NotificationId);
 }
 
-bool FAntiCheatClient::BeginSession(const FProductUserId& LocalUserId)
+bool FAntiCheatClient::BeginSession(const FProductUserId& LocalUserId, EOS_EAntiCheatClientMode Mode)
 {
 	EOS_AntiCheatClient_BeginSessionOptions Options = {};
 	Options.ApiVersion = EOS_ANTICHEATCLIENT_BEGINSESSION_API_LATEST;
 	Options.LocalUserId = LocalUserId;
-	Options.Mode = EOS_EAntiCheatClientMode::EOS_ACCM_ClientServer;
+	Options.Mode = Mode;
 
 	const EOS_EResult Result = EOS_AntiCheatClient_BeginSession(AntiCheatClientHandle, &Options);
 
 	return Result == EOS_EResult::EOS_Success;
 }
 
-bool FAntiCheatClient::ConnectToAntiCheatServer(const std::string& Host, int Port)
+void FAntiCheatClient::ConnectToAntiCheatServer(const std::string& Host, int Port)
 {
-	const bool bIsConnected = FGame::Get().GetAntiCheatNetworkTransport()->Connect(Host.c_str(), Port);
-	return bIsConnected;
+	FGame::Get().GetAntiCheatNetworkTransport()->Connect(Host.c_str(), static_cast<uint16_t>(Port));
 }
 
 void FAntiCheatClient::DisconnectFromAntiCheatServer()
@@ -178,3 +356,77 @@ void FAntiCheatClient::OnMessageToServerCallback(const EOS_AntiCheatClient_OnMes
 {
 	FGame::Get().GetAntiCheatNetworkTransport()->Send(Message);
 }
+
+bool FAntiCheatClient::AddNotifyPeerCallbacks()
+{
+	EOS_AntiCheatClient_AddNotifyMessageToPeerOptions MessageOptions = {};
+	MessageOptions.ApiVersion = EOS_ANTICHEATCLIENT_ADDNOTIFYMESSAGETOPEER_API_LATEST;
+	MessageToPeerNotificationId = EOS_AntiCheatClient_AddNotifyMessageToPeer(AntiCheatClientHandle, &MessageOptions, nullptr, OnMessageToPeerCallback);
+
+	EOS_AntiCheatClient_AddNotifyPeerActionRequiredOptions ActionOptions = {};
+	ActionOptions.ApiVersion = EOS_ANTICHEATCLIENT_ADDNOTIFYPEERACTIONREQUIRED_API_LATEST;
+	PeerActionRequiredNotificationId = EOS_AntiCheatClient_AddNotifyPeerActionRequired(AntiCheatClientHandle, &ActionOptions, nullptr, OnPeerActionRequiredCallback);
+
+	EOS_AntiCheatClient_AddNotifyPeerAuthStatusChangedOptions AuthStatusOptions = {};
+	AuthStatusOptions.ApiVersion = EOS_ANTICHEATCLIENT_ADDNOTIFYPEERAUTHSTATUSCHANGED_API_LATEST;
+	PeerAuthStatusChangedNotificationId = EOS_AntiCheatClient_AddNotifyPeerAuthStatusChanged(AntiCheatClientHandle, &AuthStatusOptions, nullptr, OnPeerAuthStatusChangedCallback);
+
+	return MessageToPeerNotificationId != EOS_INVALID_NOTIFICATIONID
+		&& PeerActionRequiredNotificationId != EOS_INVALID_NOTIFICATIONID
+		&& PeerAuthStatusChangedNotificationId != EOS_INVALID_NOTIFICATIONID;
+}
+
+void FAntiCheatClient::RemoveNotifyPeerCallbacks()
+{
+	if (MessageToPeerNotificationId != EOS_INVALID_NOTIFICATIONID)
+	{
+		EOS_AntiCheatClient_RemoveNotifyMessageToPeer(AntiCheatClientHandle, MessageToPeerNotificationId);
+		MessageToPeerNotificationId = EOS_INVALID_NOTIFICATIONID;
+	}
+	if (PeerActionRequiredNotificationId != EOS_INVALID_NOTIFICATIONID)
+	{
+		EOS_AntiCheatClient_RemoveNotifyPeerActionRequired(AntiCheatClientHandle, PeerActionRequiredNotificationId);
+		PeerActionRequiredNotificationId = EOS_INVALID_NOTIFICATIONID;
+	}
+	if (PeerAuthStatusChangedNotificationId != EOS_INVALID_NOTIFICATIONID)
+	{
+		EOS_AntiCheatClient_RemoveNotifyPeerAuthStatusChanged(AntiCheatClientHandle, PeerAuthStatusChangedNotificationId);
+		PeerAuthStatusChangedNotificationId = EOS_INVALID_NOTIFICATIONID;
+	}
+}
+
+void FAntiCheatClient::UnregisterPeerHandle(EOS_ProductUserId PeerUserId)
+{
+	EOS_AntiCheatClient_UnregisterPeerOptions Options = {};
+	Options.ApiVersion = EOS_ANTICHEATCLIENT_UNREGISTERPEER_API_LATEST;
+	Options.PeerHandle = PeerUserId;
+	EOS_AntiCheatClient_UnregisterPeer(AntiCheatClientHandle, &Options);
+
+	PeerTransport.RemovePeer(PeerUserId);
+}
+
+void FAntiCheatClient::OnMessageToPeerCallback(const EOS_AntiCheatCommon_OnMessageToClientCallbackInfo* Message)
+{
+	FGame::Get().GetAntiCheatClient()->PeerTransport.Send(static_cast<EOS_ProductUserId>(Message->ClientHandle), Message->MessageData, Message->MessageDataSizeBytes);
+}
+
+void FAntiCheatClient::OnPeerActionRequiredCallback(const EOS_AntiCheatCommon_OnClientActionRequiredCallbackInfo* Data)
+{
+	FDebugLog::Log(L"OnPeerActionRequired: ClientAction=%d, ClientActionReasonCode=%d, ClientActionReasonDetails=%ls", Data->ClientAction, Data->ActionReasonCode, FStringUtils::Widen(Data->ActionReasonDetailsString).c_str());
+
+	if (Data->ClientHandle == EOS_ANTICHEATCLIENT_PEER_SELF)
+	{
+		// This player cannot take part in the session, leave it the same way as when kicked by the server
+		FGameEvent Event(EGameEventType::AntiCheatKicked);
+		FGame::Get().OnGameEvent(Event);
+	}
+	else if (Data->ClientAction == EOS_EAntiCheatCommonClientAction::EOS_ACCCA_RemovePlayer)
+	{
+		FGame::Get().GetAntiCheatClient()->UnregisterPeerHandle(static_cast<EOS_ProductUserId>(Data->ClientHandle));
+	}
+}
+
+void FAntiCheatClient::OnPeerAuthStatusChangedCallback(const EOS_AntiCheatCommon_OnClientAuthStatusChangedCallbackInfo* Data)
+{
+	FDebugLog::Log(L"OnPeerAuthStatusChanged: ClientAuthStatus=%d", Data->ClientAuthStatus);
+}
@@ -2,6 +2,10 @@
 
 #pragma once
 
+#include "AntiCheatPeerTransport.h"
+#include "AntiCheatStatusPoller.h"
+#include "ProtectedMessageChannel.h"
+
 #include <eos_anticheatclient_types.h>
 
 class FGameEvent;
@@ -34,24 +38,73 @@ public:
 	bool Start(const std::string& Host, int Port, const FProductUserId& LocalUserId, const std::string& EOSConnectIdTokenJWT);
 	void Stop();
 
+	/** Polls for violations right away, independent of the status poller's schedule */
 	void PollStatus();
 
+	/**
+	 * Peer-to-peer mode, for listen servers: anti-cheat messages are exchanged with the other players over EOS P2P
+	 * instead of through the anti-cheat server. Every other player in the session has to be registered as a peer.
+	 */
+	bool StartPeerMode(const FProductUserId& LocalUserId);
+	void StopPeerMode();
+	bool IsInPeerMode() const { return bPeerMode; }
+
+	bool RegisterPeer(const FProductUserId& PeerUserId, EOS_EAntiCheatCommonClientPlatform ClientPlatform);
+	void UnregisterPeer(const FProductUserId& PeerUserId);
+
+	const FAntiCheatPeerTransport& GetPeerTransport() const { return PeerTransport; }
+
+	/** Polls the status and, in peer mode, exchanges the frame's peer messages. Call once per frame. */
+	void Update();
+
+	/** Lets UI and game code subscribe to violations */
+	FAntiCheatStatusPoller& GetStatusPoller() { return StatusPoller; }
+
+	/**
+	 * Encrypts game traffic to and decrypts game traffic from the game server with NetProtect, the client handle is
+	 * ignored. Game code queues its outgoing messages on the channel, Update protects them in one batch per frame.
+	 */
+	FProtectedMessageChannel& GetProtectedMessageChannel() { return ProtectedMessageChannel; }
+
+	/** Receives the protected game messages, to send them to the game server over the game's own connection */
+	void SetSendProtectedMessageCallback(FProtectedMessageChannel::FSendFunction Callback);
+
 private:
 	bool AddNotifyMessageToServerCallback();
 	void RemoveNotifyMessageToServerCallback();
-	bool BeginSession(const FProductUserId& LocalUserId);
+	bool BeginSession(const FProductUserId& LocalUserId, EOS_EAntiCheatClientMode Mode);
 	void EndSession();
 
-	bool ConnectToAntiCheatServer(const std::string& Host, int Port);
+	void ConnectToAntiCheatServer(const std::string& Host, int Port);
 	void SendRegistrationInfoToAntiCheatServer(const FProductUserId& LocalUserId, const std::string& EOSConnectIdTokenJWT);
 	void DisconnectFromAntiCheatServer();
 
 	void OnMessageFromServerReceived(const void* Data, uint32_t DataLengthBytes) const;
 	static void EOS_CALL OnMessageToServerCallback(const EOS_AntiCheatClient_OnMessageToServerCallbackInfo* Message);
 
+	bool AddNotifyPeerCallbacks();
+	void RemoveNotifyPeerCallbacks();
+	void UnregisterPeerHandle(EOS_ProductUserId PeerUserId);
+	static void EOS_CALL OnMessageToPeerCallback(const EOS_AntiCheatCommon_OnMessageToClientCallbackInfo* Message);
+	static void EOS_CALL OnPeerActionRequiredCallback(const EOS_AntiCheatCommon_OnClientActionRequiredCallbackInfo* Data);
+	static void EOS_CALL OnPeerAuthStatusChangedCallback(const EOS_AntiCheatCommon_OnClientAuthStatusChangedCallbackInfo* Data);
+
+	void SendProtectedMessages();
+
 private:
 	EOS_HAntiCheatClient AntiCheatClientHandle = nullptr;
 	EOS_NotificationId NotificationId = EOS_INVALID_NOTIFICATIONID;
 	bool bConnected = false;
+
+	EOS_NotificationId MessageToPeerNotificationId = EOS_INVALID_NOTIFICATIONID;
+	EOS_NotificationId PeerActionRequiredNotificationId = EOS_INVALID_NOTIFICATIONID;
+	EOS_NotificationId PeerAuthStatusChangedNotificationId = EOS_INVALID_NOTIFICATIONID;
+	bool bPeerMode = false;
+	FAntiCheatPeerTransport PeerTransport;
+
+	FAntiCheatStatusPoller StatusPoller;
+
+	FProtectedMessageChannel ProtectedMessageChannel;
+	FProtectedMessageChannel::FSendFunction SendProtectedMessageCallback;
 };
 
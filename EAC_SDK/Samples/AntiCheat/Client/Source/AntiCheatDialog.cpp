@@ -6,6 +6,8 @@
 #include "Authentication.h"
 #include "AntiCheatDialog.h"
 #include "AntiCheatClient.h"
+#include "AccountHelpers.h"
+#include "CommandLine.h"
 #include "DebugLog.h"
 #include "GameEvent.h"
 #include "Player.h"
@@ -13,6 +15,12 @@
 
 constexpr float HeaderLabelHeight = 30.0f;
 
+/** Join Game starts a peer-to-peer anti-cheat session instead of connecting to the anti-cheat server */
+const WCHAR* const PeerModeParam = L"peermode";
+
+/** Product user id of a player to connect to in peer mode. Players that connect to us are added on their own. */
+const WCHAR* const PeerParam = L"peer";
+
 FAntiCheatDialog::FAntiCheatDialog(
 	Vector2 InPosition,
 	Vector2 InSize,
@@ -326,19 +334,28 @@ void FAntiCheatDialog::OnJoinGameButtonPressed()
 		return;
 	}
 
-	const std::string IP = FStringUtils::Narrow(IPField->GetText());
-	const int Port = std::stoi(PortField->GetText());
-
-	// Get a Connect ID Token which will be sent to the server as part of the registration message.
-	EOS_ProductUserId ProductUserId = Player->GetProductUserID();
-	std::string ConnectIdToken = FGame::Get().GetAuthentication()->GetConnectIdToken(ProductUserId);
-	if (ConnectIdToken.empty())
+	bool bDidSessionBegin = false;
+	if (FCommandLine::Get().HasFlagParam(PeerModeParam))
 	{
-		FDebugLog::LogError(L"AntiCheatDialog - OnJoinGameButtonPressed: Failed to get Connect ID Token!");
-		return;
+		bDidSessionBegin = StartPeerGame(Player->GetProductUserID());
+	}
+	else
+	{
+		const std::string IP = FStringUtils::Narrow(IPField->GetText());
+		const int Port = std::stoi(PortField->GetText());
+
+		// Get a Connect ID Token which will be sent to the server as part of the registration message.
+		EOS_ProductUserId ProductUserId = Player->GetProductUserID();
+		std::string ConnectIdToken = FGame::Get().GetAuthentication()->GetConnectIdToken(ProductUserId);
+		if (ConnectIdToken.empty())
+		{
+			FDebugLog::LogError(L"AntiCheatDialog - OnJoinGameButtonPressed: Failed to get Connect ID Token!");
+			return;
+		}
+
+		bDidSessionBegin = FGame::Get().GetAntiCheatClient()->Start(IP, Port, Player->GetProductUserID(), ConnectIdToken.c_str());
 	}
 
-	const bool bDidSessionBegin = FGame::Get().GetAntiCheatClient()->Start(IP, Port, Player->GetProductUserID(), ConnectIdToken.c_str());
 	if (bDidSessionBegin)
 	{
 		JoinGameButton->Disable();
@@ -351,6 +368,27 @@ void FAntiCheatDialog::OnJoinGameButtonPressed()
 	}
 }
 
+bool FAntiCheatDialog::StartPeerGame(const FProductUserId& LocalUserId)
+{
+	const std::unique_ptr<FAntiCheatClient>& AntiCheatClient = FGame::Get().GetAntiCheatClient();
+	if (!AntiCheatClient->StartPeerMode(LocalUserId))
+	{
+		return false;
+	}
+
+	if (FCommandLine::Get().HasParam(PeerParam))
+	{
+		const std::string PeerUserIdString = FStringUtils::Narrow(FCommandLine::Get().GetParamValue(PeerParam));
+		EOS_ProductUserId PeerUserId = FAccountHelpers::ProductUserIDFromString(PeerUserIdString.c_str());
+		if (PeerUserId == nullptr || !AntiCheatClient->RegisterPeer(FProductUserId(PeerUserId), EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Unknown))
+		{
+			FDebugLog::LogError(L"AntiCheatDialog - StartPeerGame: Could not add peer %ls", FStringUtils::Widen(PeerUserIdString).c_str());
+		}
+	}
+
+	return true;
+}
+
 void FAntiCheatDialog::OnLeaveGameButtonPressed()
 {
 	LeaveGame();	
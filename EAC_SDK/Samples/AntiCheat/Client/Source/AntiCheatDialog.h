@@ -10,6 +10,9 @@
 
 class FGameEvent;
 
+template<typename> struct TEpicAccountId;
+using FProductUserId = TEpicAccountId<EOS_ProductUserId>;
+
 class FAntiCheatDialog : public FDialog
 {
 public:
@@ -60,6 +63,9 @@ private:
 
 	void LeaveGame();
 
+	/** Starts the anti-cheat session in peer-to-peer mode, used when the game runs with -peermode */
+	bool StartPeerGame(const FProductUserId& LocalUserId);
+
 	/** Header Label */
 	std::shared_ptr<FTextLabelWidget> HeaderLabel;
 
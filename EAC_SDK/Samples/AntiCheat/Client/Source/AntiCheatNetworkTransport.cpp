@@ -3,6 +3,11 @@
 #include "pch.h"
 
 #include "AntiCheatNetworkTransport.h"
+#include "MessageCompression.h"
+#include "DebugLog.h"
+
+constexpr size_t FAntiCheatNetworkTransport::MessageHeaderSize;
+constexpr uint32_t FAntiCheatNetworkTransport::MaxMessagePayloadSize;
 
 FAntiCheatNetworkTransport::FAntiCheatNetworkTransport(): TCPClient(4096)
 {
@@ -14,14 +19,17 @@ FAntiCheatNetworkTransport::~FAntiCheatNetworkTransport()
 
 }
 
-bool FAntiCheatNetworkTransport::Connect(const char* Host, uint16_t Port)
+void FAntiCheatNetworkTransport::Connect(const char* Host, uint16_t Port)
 {
-	return TCPClient.Connect(Host, Port);
+	bCompressMessagesToServer = false;
+	PartialMessage.clear();
+	TCPClient.Connect(Host, Port);
 }
 
 void FAntiCheatNetworkTransport::Disconnect()
 {
 	TCPClient.Disconnect();
+	PartialMessage.clear();
 }
 
 void FAntiCheatNetworkTransport::SetOnNewMessageCallback(FOnNewMessageCallback Callback)
@@ -34,11 +42,41 @@ void FAntiCheatNetworkTransport::SetOnClientActionRequiredCallback(FOnClientActi
 	OnClientActionRequiredCallback = std::move(Callback);
 }
 
+void FAntiCheatNetworkTransport::SetOnConnectionStateChangedCallback(FOnConnectionStateChangedCallback Callback)
+{
+	TCPClient.SetOnConnectionStateChangedCallback(std::move(Callback));
+}
+
 void FAntiCheatNetworkTransport::Send(const EOS_AntiCheatClient_OnMessageToServerCallbackInfo* Message)
 {
 	char Buffer[4096] = {};
 	size_t BufferPos = {};
 
+	if (bCompressMessagesToServer && Message->MessageDataSizeBytes >= MinCompressedMessageSize)
+	{
+		// Compressed straight behind the header, and only kept if it saves more than the uncompressed size field costs
+		constexpr size_t PayloadPos = sizeof(FMessageType) + sizeof(uint32_t) + sizeof(uint32_t);
+		const size_t MaxCompressedSize = std::min(sizeof(Buffer) - PayloadPos, Message->MessageDataSizeBytes - sizeof(uint32_t) - 1);
+		const size_t CompressedSize = FMessageCompression::Compress(Message->MessageData, Message->MessageDataSizeBytes, &Buffer[PayloadPos], MaxCompressedSize);
+		if (CompressedSize > 0)
+		{
+			constexpr FMessageType MessageType = FMessageType::CompressedOpaque;
+			const uint32_t MessageLength = sizeof(uint32_t) + static_cast<uint32_t>(CompressedSize);
+
+			Write(MessageType, Buffer, BufferPos);
+			Write(MessageLength, Buffer, BufferPos);
+			Write(Message->MessageDataSizeBytes, Buffer, BufferPos);
+
+			TCPClient.Send(Buffer, BufferPos + CompressedSize);
+
+			++SentCompressionStats.CompressedMessages;
+			SentCompressionStats.UncompressedBytes += Message->MessageDataSizeBytes;
+			SentCompressionStats.CompressedBytes += CompressedSize;
+			return;
+		}
+		++SentCompressionStats.IncompressibleMessages;
+	}
+
 	constexpr FMessageType MessageType = FMessageType::Opaque;
 	const uint32_t MessageLength = Message->MessageDataSizeBytes;
 
@@ -57,7 +95,9 @@ void FAntiCheatNetworkTransport::Send(const FRegistrationInfoMessage& Message)
 	constexpr FMessageType MessageType = FMessageType::RegistrationInfo;
 	const uint32_t MessageLength = 
 		static_cast<uint32_t>(Message.ProductUserId.size() + 1) +
-		sizeof(Message.ClientPlatform);
+		static_cast<uint32_t>(Message.EOSConnectIdTokenJWT.size() + 1) +
+		sizeof(Message.ClientPlatform) +
+		sizeof(CapabilityCompression);
 
 	Write(MessageType, Buffer, BufferPos);
 	Write(MessageLength, Buffer, BufferPos);
@@ -66,42 +106,189 @@ void FAntiCheatNetworkTransport::Send(const FRegistrationInfoMessage& Message)
 	Write(Message.EOSConnectIdTokenJWT.c_str(), Message.EOSConnectIdTokenJWT.size() + 1, Buffer, BufferPos);
 	Write(Message.ClientPlatform, Buffer, BufferPos);
 
+	// Servers that predate capabilities ignore the extra field and never confirm it
+	const uint32_t Capabilities = CapabilityCompression;
+	Write(Capabilities, Buffer, BufferPos);
+
 	TCPClient.Send(Buffer, BufferPos);
 }
 
-size_t FAntiCheatNetworkTransport::ProcessMessage(char* Buffer, size_t StartPosition)
+bool FAntiCheatNetworkTransport::ProcessMessage(char* Message, size_t MessageSize)
 {
-	size_t Position = StartPosition;
+	size_t Position = 0;
 
-	const FMessageType MessageType = Read<FMessageType>(Buffer, Position);
-	const uint32_t MessageLength = Read<uint32_t>(Buffer, Position);
+	const FMessageType MessageType = Read<FMessageType>(Message, Position);
+	const uint32_t MessageLength = Read<uint32_t>(Message, Position);
 
 	if (MessageType == FMessageType::Opaque)
 	{
-		const char* Message = Read<char*>(Buffer, MessageLength, Position);
-		OnNewMessageCallback(Message, MessageLength);
+		const char* Data = Read<char*>(Message, MessageLength, Position);
+		OnNewMessageCallback(Data, MessageLength);
 	}
 	else if (MessageType == FMessageType::ClientActionRequired)
 	{
-		EOS_AntiCheatCommon_OnClientActionRequiredCallbackInfo Message = {};
-		Message.ClientAction = Read<EOS_EAntiCheatCommonClientAction>(Buffer, Position);
-		Message.ActionReasonCode = Read<EOS_EAntiCheatCommonClientActionReason>(Buffer, Position);
-		Message.ActionReasonDetailsString = Read<char*>(Buffer, strlen(Buffer + Position) + 1, Position);
-		OnClientActionRequiredCallback(Message);
+		EOS_AntiCheatCommon_OnClientActionRequiredCallbackInfo ActionMessage = {};
+		if (MessageSize - Position < sizeof(ActionMessage.ClientAction) + sizeof(ActionMessage.ActionReasonCode))
+		{
+			FDebugLog::LogError(L"AntiCheatNetworkTransport: Malformed client action message");
+			return false;
+		}
+		ActionMessage.ClientAction = Read<EOS_EAntiCheatCommonClientAction>(Message, Position);
+		ActionMessage.ActionReasonCode = Read<EOS_EAntiCheatCommonClientActionReason>(Message, Position);
+
+		// The details string is sent with its null terminator, which must lie within the message
+		const void* Terminator = memchr(&Message[Position], '\0', MessageSize - Position);
+		if (!Terminator)
+		{
+			FDebugLog::LogError(L"AntiCheatNetworkTransport: Malformed client action message");
+			return false;
+		}
+		ActionMessage.ActionReasonDetailsString = Read<char*>(Message, static_cast<const char*>(Terminator) - &Message[Position] + 1, Position);
+		OnClientActionRequiredCallback(ActionMessage);
+	}
+	else if (MessageType == FMessageType::CompressedOpaque)
+	{
+		if (MessageSize - Position < sizeof(uint32_t))
+		{
+			FDebugLog::LogError(L"AntiCheatNetworkTransport: Malformed compressed message");
+			return false;
+		}
+
+		// The compressed payload is whatever follows the size field within this message
+		const uint32_t UncompressedSize = Read<uint32_t>(Message, Position);
+		const size_t CompressedSize = MessageSize - Position;
+		if (UncompressedSize > MaxMessagePayloadSize)
+		{
+			FDebugLog::LogError(L"AntiCheatNetworkTransport: Compressed message of %u bytes exceeds the maximum", UncompressedSize);
+			return false;
+		}
+
+		DecompressionBuffer.resize(UncompressedSize);
+		if (!FMessageCompression::Decompress(&Message[Position], CompressedSize, DecompressionBuffer.data(), UncompressedSize))
+		{
+			FDebugLog::LogError(L"AntiCheatNetworkTransport: Malformed compressed message");
+			return false;
+		}
+
+		++ReceivedCompressionStats.CompressedMessages;
+		ReceivedCompressionStats.UncompressedBytes += UncompressedSize;
+		ReceivedCompressionStats.CompressedBytes += CompressedSize;
+		OnNewMessageCallback(DecompressionBuffer.data(), UncompressedSize);
+	}
+	else if (MessageType == FMessageType::Capabilities)
+	{
+		if (MessageSize - Position < sizeof(uint32_t))
+		{
+			FDebugLog::LogError(L"AntiCheatNetworkTransport: Malformed capabilities message");
+			return false;
+		}
+
+		const uint32_t Capabilities = Read<uint32_t>(Message, Position);
+		bCompressMessagesToServer = (Capabilities & CapabilityCompression) != 0;
+	}
+	else
+	{
+		FDebugLog::LogWarning(L"AntiCheatNetworkTransport: Ignoring message of unknown type %d", static_cast<int>(MessageType));
+	}
+
+	return true;
+}
+
+bool FAntiCheatNetworkTransport::ReadMessageSize(const char* Header, size_t& OutMessageSize)
+{
+	uint32_t MessageLength = 0;
+	memcpy(&MessageLength, &Header[sizeof(char)], sizeof(MessageLength));
+	if (MessageLength > MaxMessagePayloadSize)
+	{
+		FDebugLog::LogError(L"AntiCheatNetworkTransport: Message of %u bytes exceeds the maximum of %u bytes", MessageLength, MaxMessagePayloadSize);
+		return false;
 	}
 
-	return Position - StartPosition;
+	OutMessageSize = MessageHeaderSize + MessageLength;
+	return true;
 }
 
 void FAntiCheatNetworkTransport::Receive(char* Buffer, size_t Length)
 {
+	// TCP is a byte stream, so a single receive can hold several messages and a message can be split across receives.
+	// Complete messages are handled in place, a trailing partial message is kept and completed from the following
+	// receives. Malformed data drops the connection, the same as on the server.
 	size_t Position = 0;
-	size_t BytesRemaining = Length;
-	while (BytesRemaining > 0)
+
+	if (!PartialMessage.empty())
+	{
+		// Complete the header first, then the rest of the message
+		if (PartialMessage.size() < MessageHeaderSize)
+		{
+			const size_t BytesToCopy = std::min(MessageHeaderSize - PartialMessage.size(), Length);
+			PartialMessage.insert(PartialMessage.end(), Buffer, Buffer + BytesToCopy);
+			Position += BytesToCopy;
+
+			if (PartialMessage.size() < MessageHeaderSize)
+			{
+				return;
+			}
+		}
+
+		size_t MessageSize = 0;
+		if (!ReadMessageSize(PartialMessage.data(), MessageSize))
+		{
+			Disconnect();
+			return;
+		}
+
+		const size_t BytesToCopy = std::min(MessageSize - PartialMessage.size(), Length - Position);
+		PartialMessage.insert(PartialMessage.end(), Buffer + Position, Buffer + Position + BytesToCopy);
+		Position += BytesToCopy;
+
+		if (PartialMessage.size() < MessageSize)
+		{
+			return;
+		}
+
+		// Moved out first, the callbacks may disconnect and clear the partial message
+		std::vector<char> Message;
+		Message.swap(PartialMessage);
+		if (!ProcessMessage(Message.data(), Message.size()))
+		{
+			Disconnect();
+			return;
+		}
+		if (!IsConnected())
+		{
+			return;
+		}
+	}
+
+	while (Length - Position >= MessageHeaderSize)
+	{
+		size_t MessageSize = 0;
+		if (!ReadMessageSize(&Buffer[Position], MessageSize))
+		{
+			Disconnect();
+			return;
+		}
+
+		if (Length - Position < MessageSize)
+		{
+			break;
+		}
+
+		if (!ProcessMessage(&Buffer[Position], MessageSize))
+		{
+			Disconnect();
+			return;
+		}
+		if (!IsConnected())
+		{
+			return;
+		}
+		Position += MessageSize;
+	}
+
+	if (Position < Length)
 	{
-		const size_t BytesRead = ProcessMessage(Buffer, Position);
-		Position += BytesRead;
-		BytesRemaining -= BytesRead;
+		PartialMessage.assign(Buffer + Position, Buffer + Length);
 	}
 }
 
@@ -109,3 +296,24 @@ void FAntiCheatNetworkTransport::Update()
 {
 	TCPClient.Update();
 }
+
+void FAntiCheatNetworkTransport::LogCompressionStats() const
+{
+	auto LogStats = [](const wchar_t* Direction, const FCompressionStats& Stats)
+	{
+		if (Stats.CompressedMessages == 0 && Stats.IncompressibleMessages == 0)
+		{
+			return;
+		}
+
+		FDebugLog::Log(L"Compressed %llu opaque messages %ls the server (%llu -> %llu bytes, %.1f%%), %llu incompressible",
+			static_cast<unsigned long long>(Stats.CompressedMessages),
+			Direction,
+			static_cast<unsigned long long>(Stats.UncompressedBytes),
+			static_cast<unsigned long long>(Stats.CompressedBytes),
+			Stats.UncompressedBytes > 0 ? 100.0 * Stats.CompressedBytes / Stats.UncompressedBytes : 0.0,
+			static_cast<unsigned long long>(Stats.IncompressibleMessages));
+	};
+	LogStats(L"to", SentCompressionStats);
+	LogStats(L"from", ReceivedCompressionStats);
+}
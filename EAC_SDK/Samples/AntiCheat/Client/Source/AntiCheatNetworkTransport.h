@@ -9,6 +9,32 @@
 class FAntiCheatNetworkTransport
 {
 public:
+	/** Optional protocol features, announced in the registration and confirmed by the server */
+	static constexpr uint32_t CapabilityCompression = 1 << 0;
+
+	/** Opaque messages of at least this many bytes are compressed once the server confirmed CapabilityCompression */
+	static constexpr uint32_t MinCompressedMessageSize = 128;
+
+	/** Every message starts with a one byte message type and the length of the payload that follows */
+	static constexpr size_t MessageHeaderSize = sizeof(char) + sizeof(uint32_t);
+
+	/** Largest accepted payload, same as on the server. Guards against corrupt or hostile length fields. */
+	static constexpr uint32_t MaxMessagePayloadSize = 1024 * 1024;
+
+	/** Savings of the opaque message compression in one direction */
+	struct FCompressionStats
+	{
+		/** Opaque messages that went over the wire compressed */
+		uint64_t CompressedMessages = 0;
+
+		/** Opaque messages that qualified for compression but did not get smaller, and were sent as they are */
+		uint64_t IncompressibleMessages = 0;
+
+		/** Payload bytes of the compressed messages before and after compression */
+		uint64_t UncompressedBytes = 0;
+		uint64_t CompressedBytes = 0;
+	};
+
 	struct FRegistrationInfoMessage
 	{
 		std::string ProductUserId;
@@ -32,7 +58,8 @@ public:
 	 */
 	virtual ~FAntiCheatNetworkTransport();
 
-	bool Connect(const char* Host, uint16_t Port);
+	/** Connects in the background, the result is reported through the connection state callback */
+	void Connect(const char* Host, uint16_t Port);
 	void Disconnect();
 
 	using FOnNewMessageCallback = std::function<void(const void*, uint32_t)>;
@@ -41,14 +68,26 @@ public:
 	using FOnClientActionRequiredCallback = std::function<void(EOS_AntiCheatCommon_OnClientActionRequiredCallbackInfo)>;
 	void SetOnClientActionRequiredCallback(FOnClientActionRequiredCallback Callback);
 
+	using FOnConnectionStateChangedCallback = FTCPClient::FOnConnectionStateChangedCallback;
+	void SetOnConnectionStateChangedCallback(FOnConnectionStateChangedCallback Callback);
+
 	void Send(const EOS_AntiCheatClient_OnMessageToServerCallbackInfo* Message);
 	void Send(const FRegistrationInfoMessage& Message);
 
 	void Update();
 
+	const FCompressionStats& GetSentCompressionStats() const { return SentCompressionStats; }
+	const FCompressionStats& GetReceivedCompressionStats() const { return ReceivedCompressionStats; }
+	void LogCompressionStats() const;
+
 private:
-	size_t ProcessMessage(char* Buffer, size_t StartPosition);
+	/** Handles one complete message including its header. Returns false if the message is malformed. */
+	bool ProcessMessage(char* Message, size_t MessageSize);
 	void Receive(char* Buffer, size_t Length);
+	bool ReadMessageSize(const char* Header, size_t& OutMessageSize);
+
+	/** False once a callback disconnected, the rest of the received data is dropped then */
+	bool IsConnected() const { return TCPClient.GetConnectionState() == FTCPClient::EConnectionState::Connected; }
 
 	template<typename T, typename = std::enable_if_t<!std::is_pointer<T>::value>>
 	void Write(T ObjectToWrite, char* Buffer, size_t& Position)
@@ -86,11 +125,28 @@ private:
 	{
 		Opaque = 1,
 		RegistrationInfo = 2,
-		ClientActionRequired = 3
+		ClientActionRequired = 3,
+
+		/** An Opaque message's uncompressed size as uint32_t followed by the compressed payload, see FMessageCompression */
+		CompressedOpaque = 4,
+
+		/** Sent by the server after the registration, with the capability flags it enabled for this client */
+		Capabilities = 5
 	};
 
 	FTCPClient TCPClient;
 
+	/** The start of a message whose remaining bytes have not been received yet, reset on connect and disconnect */
+	std::vector<char> PartialMessage;
+
+	/** Set when the server confirms CapabilityCompression, until the next connect */
+	bool bCompressMessagesToServer = false;
+	FCompressionStats SentCompressionStats;
+	FCompressionStats ReceivedCompressionStats;
+
+	/** Reused for every compressed message from the server */
+	std::vector<char> DecompressionBuffer;
+
 	FOnNewMessageCallback OnNewMessageCallback;
 	FOnClientActionRequiredCallback OnClientActionRequiredCallback;
 };
@@ -0,0 +1,340 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "AntiCheatPeerTransport.h"
+#include "DebugLog.h"
+#include "StringUtils.h"
+
+#include <eos_p2p.h>
+
+#include <cstring>
+
+constexpr char FAntiCheatPeerTransport::SocketName[];
+constexpr uint8_t FAntiCheatPeerTransport::Channel;
+constexpr uint32_t FAntiCheatPeerTransport::MaxMessageSize;
+
+FAntiCheatPeerTransport::~FAntiCheatPeerTransport()
+{
+	Shutdown();
+}
+
+void FAntiCheatPeerTransport::Init(EOS_HP2P InP2PHandle, EOS_ProductUserId InLocalUserId)
+{
+	Shutdown();
+
+	P2PHandle = InP2PHandle;
+	LocalUserId = InLocalUserId;
+
+	SocketId = {};
+	SocketId.ApiVersion = EOS_P2P_SOCKETID_API_LATEST;
+	static_assert(sizeof(SocketName) <= sizeof(SocketId.SocketName), "Socket name too long");
+	memcpy(SocketId.SocketName, SocketName, sizeof(SocketName));
+
+	ReceiveBuffer.resize(EOS_P2P_MAX_PACKET_SIZE);
+	Stats = FStats();
+
+	AddNotifyConnectionCallbacks();
+}
+
+void FAntiCheatPeerTransport::Shutdown()
+{
+	while (!Peers.empty())
+	{
+		RemovePeer(Peers.back().UserId);
+	}
+
+	RemoveNotifyConnectionCallbacks();
+	P2PHandle = nullptr;
+	LocalUserId = nullptr;
+}
+
+void FAntiCheatPeerTransport::AddPeer(EOS_ProductUserId RemoteUserId)
+{
+	if (!P2PHandle || FindPeer(RemoteUserId))
+	{
+		return;
+	}
+
+	// Accepting up front lets the first packet in either direction open the connection
+	EOS_P2P_AcceptConnectionOptions Options = {};
+	Options.ApiVersion = EOS_P2P_ACCEPTCONNECTION_API_LATEST;
+	Options.LocalUserId = LocalUserId;
+	Options.RemoteUserId = RemoteUserId;
+	Options.SocketId = &SocketId;
+
+	const EOS_EResult Result = EOS_P2P_AcceptConnection(P2PHandle, &Options);
+	if (Result != EOS_EResult::EOS_Success)
+	{
+		FDebugLog::LogError(L"AntiCheatPeerTransport: Could not accept peer connection: %ls", FStringUtils::Widen(EOS_EResult_ToString(Result)).c_str());
+		return;
+	}
+
+	FPeer Peer;
+	Peer.UserId = RemoteUserId;
+	Peer.Packet.reserve(EOS_P2P_MAX_PACKET_SIZE);
+	Peers.push_back(std::move(Peer));
+}
+
+void FAntiCheatPeerTransport::RemovePeer(EOS_ProductUserId RemoteUserId)
+{
+	FPeer* Peer = FindPeer(RemoteUserId);
+	if (!Peer)
+	{
+		return;
+	}
+
+	EOS_P2P_CloseConnectionOptions Options = {};
+	Options.ApiVersion = EOS_P2P_CLOSECONNECTION_API_LATEST;
+	Options.LocalUserId = LocalUserId;
+	Options.RemoteUserId = RemoteUserId;
+	Options.SocketId = &SocketId;
+	EOS_P2P_CloseConnection(P2PHandle, &Options);
+
+	*Peer = std::move(Peers.back());
+	Peers.pop_back();
+}
+
+std::vector<EOS_ProductUserId> FAntiCheatPeerTransport::GetPeers() const
+{
+	std::vector<EOS_ProductUserId> UserIds;
+	UserIds.reserve(Peers.size());
+	for (const FPeer& Peer : Peers)
+	{
+		UserIds.push_back(Peer.UserId);
+	}
+	return UserIds;
+}
+
+void FAntiCheatPeerTransport::SetOnMessageReceivedCallback(FOnMessageReceivedCallback Callback)
+{
+	OnMessageReceivedCallback = std::move(Callback);
+}
+
+void FAntiCheatPeerTransport::SetOnPeerConnectionRequestCallback(FOnPeerConnectionCallback Callback)
+{
+	OnPeerConnectionRequestCallback = std::move(Callback);
+}
+
+void FAntiCheatPeerTransport::SetOnPeerConnectionClosedCallback(FOnPeerConnectionCallback Callback)
+{
+	OnPeerConnectionClosedCallback = std::move(Callback);
+}
+
+void FAntiCheatPeerTransport::Send(EOS_ProductUserId RemoteUserId, const void* Data, uint32_t Length)
+{
+	FPeer* Peer = FindPeer(RemoteUserId);
+	if (!Peer)
+	{
+		return;
+	}
+
+	if (Length == 0 || Length > MaxMessageSize)
+	{
+		FDebugLog::LogError(L"AntiCheatPeerTransport: Dropping message of %u bytes", Length);
+		return;
+	}
+
+	// Start a new packet if the message does not fit into the current one
+	const size_t FramedLength = sizeof(uint16_t) + Length;
+	if (Peer->Packet.size() + FramedLength > EOS_P2P_MAX_PACKET_SIZE)
+	{
+		SendPacket(*Peer);
+	}
+
+	const uint16_t MessageLength = static_cast<uint16_t>(Length);
+	const size_t Position = Peer->Packet.size();
+	Peer->Packet.resize(Position + FramedLength);
+	memcpy(&Peer->Packet[Position], &MessageLength, sizeof(MessageLength));
+	memcpy(&Peer->Packet[Position + sizeof(MessageLength)], Data, Length);
+
+	++Stats.MessagesSent;
+}
+
+void FAntiCheatPeerTransport::Flush()
+{
+	for (FPeer& Peer : Peers)
+	{
+		if (!Peer.Packet.empty())
+		{
+			SendPacket(Peer);
+		}
+	}
+}
+
+void FAntiCheatPeerTransport::Receive()
+{
+	if (!P2PHandle)
+	{
+		return;
+	}
+
+	EOS_P2P_ReceivePacketOptions Options = {};
+	Options.ApiVersion = EOS_P2P_RECEIVEPACKET_API_LATEST;
+	Options.LocalUserId = LocalUserId;
+	Options.MaxDataSizeBytes = static_cast<uint32_t>(ReceiveBuffer.size());
+	Options.RequestedChannel = &Channel;
+
+	// The callback may shut the transport down
+	while (P2PHandle)
+	{
+		EOS_ProductUserId RemoteUserId = nullptr;
+		EOS_P2P_SocketId ReceivedSocketId = {};
+		ReceivedSocketId.ApiVersion = EOS_P2P_SOCKETID_API_LATEST;
+		uint8_t ReceivedChannel = 0;
+		uint32_t BytesWritten = 0;
+
+		const EOS_EResult Result = EOS_P2P_ReceivePacket(P2PHandle, &Options, &RemoteUserId, &ReceivedSocketId, &ReceivedChannel, ReceiveBuffer.data(), &BytesWritten);
+		if (Result == EOS_EResult::EOS_NotFound)
+		{
+			return;
+		}
+		if (Result != EOS_EResult::EOS_Success)
+		{
+			FDebugLog::LogError(L"AntiCheatPeerTransport: Error while receiving: %ls", FStringUtils::Widen(EOS_EResult_ToString(Result)).c_str());
+			return;
+		}
+
+		++Stats.PacketsReceived;
+		if (!IsOwnSocket(&ReceivedSocketId) || !FindPeer(RemoteUserId))
+		{
+			++Stats.PacketsDropped;
+			continue;
+		}
+
+		size_t Position = 0;
+		while (Position + sizeof(uint16_t) <= BytesWritten)
+		{
+			uint16_t MessageLength = 0;
+			memcpy(&MessageLength, &ReceiveBuffer[Position], sizeof(MessageLength));
+			Position += sizeof(MessageLength);
+			if (MessageLength == 0 || Position + MessageLength > BytesWritten)
+			{
+				break;
+			}
+
+			++Stats.MessagesReceived;
+			if (OnMessageReceivedCallback)
+			{
+				OnMessageReceivedCallback(RemoteUserId, &ReceiveBuffer[Position], MessageLength);
+			}
+			Position += MessageLength;
+		}
+
+		if (Position != BytesWritten)
+		{
+			FDebugLog::LogError(L"AntiCheatPeerTransport: Dropping the rest of a malformed packet");
+			++Stats.PacketsDropped;
+		}
+	}
+}
+
+FAntiCheatPeerTransport::FPeer* FAntiCheatPeerTransport::FindPeer(EOS_ProductUserId UserId)
+{
+	for (FPeer& Peer : Peers)
+	{
+		if (Peer.UserId == UserId)
+		{
+			return &Peer;
+		}
+	}
+	return nullptr;
+}
+
+void FAntiCheatPeerTransport::SendPacket(FPeer& Peer)
+{
+	EOS_P2P_SendPacketOptions Options = {};
+	Options.ApiVersion = EOS_P2P_SENDPACKET_API_LATEST;
+	Options.LocalUserId = LocalUserId;
+	Options.RemoteUserId = Peer.UserId;
+	Options.SocketId = &SocketId;
+	Options.Channel = Channel;
+	Options.DataLengthBytes = static_cast<uint32_t>(Peer.Packet.size());
+	Options.Data = Peer.Packet.data();
+	Options.bAllowDelayedDelivery = EOS_TRUE;
+	Options.Reliability = EOS_EPacketReliability::EOS_PR_ReliableOrdered;
+	Options.bDisableAutoAcceptConnection = EOS_FALSE;
+
+	const EOS_EResult Result = EOS_P2P_SendPacket(P2PHandle, &Options);
+	if (Result == EOS_EResult::EOS_Success)
+	{
+		++Stats.PacketsSent;
+		Stats.BytesSent += Peer.Packet.size();
+	}
+	else
+	{
+		FDebugLog::LogError(L"AntiCheatPeerTransport: Error while sending: %ls", FStringUtils::Widen(EOS_EResult_ToString(Result)).c_str());
+	}
+
+	Peer.Packet.clear();
+}
+
+bool FAntiCheatPeerTransport::IsOwnSocket(const EOS_P2P_SocketId* ReceivedSocketId) const
+{
+	return ReceivedSocketId && strncmp(ReceivedSocketId->SocketName, SocketName, sizeof(ReceivedSocketId->SocketName)) == 0;
+}
+
+void FAntiCheatPeerTransport::AddNotifyConnectionCallbacks()
+{
+	EOS_P2P_AddNotifyPeerConnectionRequestOptions RequestOptions = {};
+	RequestOptions.ApiVersion = EOS_P2P_ADDNOTIFYPEERCONNECTIONREQUEST_API_LATEST;
+	RequestOptions.LocalUserId = LocalUserId;
+	RequestOptions.SocketId = &SocketId;
+	ConnectionRequestNotificationId = EOS_P2P_AddNotifyPeerConnectionRequest(P2PHandle, &RequestOptions, this, OnIncomingConnectionRequest);
+	if (ConnectionRequestNotificationId == EOS_INVALID_NOTIFICATIONID)
+	{
+		FDebugLog::LogError(L"AntiCheatPeerTransport: Could not subscribe to connection requests, only peers added by the game can connect");
+	}
+
+	EOS_P2P_AddNotifyPeerConnectionClosedOptions ClosedOptions = {};
+	ClosedOptions.ApiVersion = EOS_P2P_ADDNOTIFYPEERCONNECTIONCLOSED_API_LATEST;
+	ClosedOptions.LocalUserId = LocalUserId;
+	ClosedOptions.SocketId = &SocketId;
+	ConnectionClosedNotificationId = EOS_P2P_AddNotifyPeerConnectionClosed(P2PHandle, &ClosedOptions, this, OnRemoteConnectionClosed);
+	if (ConnectionClosedNotificationId == EOS_INVALID_NOTIFICATIONID)
+	{
+		FDebugLog::LogError(L"AntiCheatPeerTransport: Could not subscribe to closed connections");
+	}
+}
+
+void FAntiCheatPeerTransport::RemoveNotifyConnectionCallbacks()
+{
+	if (ConnectionRequestNotificationId != EOS_INVALID_NOTIFICATIONID)
+	{
+		EOS_P2P_RemoveNotifyPeerConnectionRequest(P2PHandle, ConnectionRequestNotificationId);
+		ConnectionRequestNotificationId = EOS_INVALID_NOTIFICATIONID;
+	}
+	if (ConnectionClosedNotificationId != EOS_INVALID_NOTIFICATIONID)
+	{
+		EOS_P2P_RemoveNotifyPeerConnectionClosed(P2PHandle, ConnectionClosedNotificationId);
+		ConnectionClosedNotificationId = EOS_INVALID_NOTIFICATIONID;
+	}
+}
+
+void EOS_CALL FAntiCheatPeerTransport::OnIncomingConnectionRequest(const EOS_P2P_OnIncomingConnectionRequestInfo* Data)
+{
+	FAntiCheatPeerTransport* Transport = static_cast<FAntiCheatPeerTransport*>(Data->ClientData);
+	if (!Transport->P2PHandle || !Transport->IsOwnSocket(Data->SocketId) || Transport->FindPeer(Data->RemoteUserId))
+	{
+		return;
+	}
+
+	// Left unaccepted unless the owner adds the user as a peer
+	if (Transport->OnPeerConnectionRequestCallback)
+	{
+		Transport->OnPeerConnectionRequestCallback(Data->RemoteUserId);
+	}
+}
+
+void EOS_CALL FAntiCheatPeerTransport::OnRemoteConnectionClosed(const EOS_P2P_OnRemoteConnectionClosedInfo* Data)
+{
+	FAntiCheatPeerTransport* Transport = static_cast<FAntiCheatPeerTransport*>(Data->ClientData);
+	if (!Transport->P2PHandle || !Transport->IsOwnSocket(Data->SocketId) || !Transport->FindPeer(Data->RemoteUserId))
+	{
+		return;
+	}
+
+	if (Transport->OnPeerConnectionClosedCallback)
+	{
+		Transport->OnPeerConnectionClosedCallback(Data->RemoteUserId);
+	}
+}
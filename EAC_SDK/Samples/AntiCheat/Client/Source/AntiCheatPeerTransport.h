@@ -0,0 +1,125 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <eos_p2p_types.h>
+
+#include <functional>
+#include <vector>
+
+/**
+ * Carries anti-cheat peer messages over EOS P2P, for games without a dedicated server.
+ *
+ * Messages are not sent one packet each: everything queued for a peer during a frame is packed into as few packets as
+ * possible and sent by Flush, once per frame. Each message is prefixed with its length in the packet. All traffic uses
+ * its own socket and channel, so it never mixes with the game's packets. The game must not receive from Channel itself.
+ *
+ * Peers are identified by their product user id. Connection requests and closed connections on the socket are passed
+ * on to the owner, which decides whether the remote user becomes a peer. Not thread safe, call from the thread that
+ * ticks the platform.
+ */
+class FAntiCheatPeerTransport
+{
+public:
+	static constexpr char SocketName[] = "ANTICHEAT";
+	static constexpr uint8_t Channel = 200;
+
+	/** Anti-cheat messages are at most EOS_ANTICHEATCLIENT_ONMESSAGETOPEERCALLBACK_MAX_MESSAGE_SIZE bytes */
+	static constexpr uint32_t MaxMessageSize = EOS_P2P_MAX_PACKET_SIZE - sizeof(uint16_t);
+
+	using FOnMessageReceivedCallback = std::function<void(EOS_ProductUserId, const void*, uint32_t)>;
+	using FOnPeerConnectionCallback = std::function<void(EOS_ProductUserId)>;
+
+	struct FStats
+	{
+		uint64_t MessagesSent = 0;
+		uint64_t PacketsSent = 0;
+
+		/** Including the length prefixes */
+		uint64_t BytesSent = 0;
+
+		uint64_t MessagesReceived = 0;
+		uint64_t PacketsReceived = 0;
+
+		/** Packets from users that are not peers or that could not be parsed */
+		uint64_t PacketsDropped = 0;
+	};
+
+	FAntiCheatPeerTransport() = default;
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	FAntiCheatPeerTransport(FAntiCheatPeerTransport const&) = delete;
+	FAntiCheatPeerTransport& operator=(FAntiCheatPeerTransport const&) = delete;
+
+	~FAntiCheatPeerTransport();
+
+	void Init(EOS_HP2P InP2PHandle, EOS_ProductUserId InLocalUserId);
+
+	/** Removes all peers and stops listening for connections */
+	void Shutdown();
+
+	bool IsInitialized() const { return P2PHandle != nullptr; }
+
+	/** Accepts the peer's connection, packets from users that were not added are dropped */
+	void AddPeer(EOS_ProductUserId RemoteUserId);
+
+	/** Drops the messages still queued for the peer and closes the connection */
+	void RemovePeer(EOS_ProductUserId RemoteUserId);
+
+	std::vector<EOS_ProductUserId> GetPeers() const;
+
+	void SetOnMessageReceivedCallback(FOnMessageReceivedCallback Callback);
+
+	/** Called when a user that is not a peer yet asks to connect. The request is only accepted if the callback adds the peer. */
+	void SetOnPeerConnectionRequestCallback(FOnPeerConnectionCallback Callback);
+
+	/** Called when a peer closed its connection or the connection was lost */
+	void SetOnPeerConnectionClosedCallback(FOnPeerConnectionCallback Callback);
+
+	/** Queues the message, it is sent together with the peer's other messages on the next Flush */
+	void Send(EOS_ProductUserId RemoteUserId, const void* Data, uint32_t Length);
+
+	/** Sends the messages queued for every peer */
+	void Flush();
+
+	/** Receives all packets that arrived and calls the callback for every message in them */
+	void Receive();
+
+	const FStats& GetStats() const { return Stats; }
+
+private:
+	struct FPeer
+	{
+		EOS_ProductUserId UserId = nullptr;
+
+		/** Length prefixed messages for the next packet */
+		std::vector<char> Packet;
+	};
+
+	FPeer* FindPeer(EOS_ProductUserId UserId);
+	void SendPacket(FPeer& Peer);
+	bool IsOwnSocket(const EOS_P2P_SocketId* ReceivedSocketId) const;
+
+	void AddNotifyConnectionCallbacks();
+	void RemoveNotifyConnectionCallbacks();
+	static void EOS_CALL OnIncomingConnectionRequest(const EOS_P2P_OnIncomingConnectionRequestInfo* Data);
+	static void EOS_CALL OnRemoteConnectionClosed(const EOS_P2P_OnRemoteConnectionClosedInfo* Data);
+
+	EOS_HP2P P2PHandle = nullptr;
+	EOS_ProductUserId LocalUserId = nullptr;
+	EOS_P2P_SocketId SocketId = {};
+	EOS_NotificationId ConnectionRequestNotificationId = EOS_INVALID_NOTIFICATIONID;
+	EOS_NotificationId ConnectionClosedNotificationId = EOS_INVALID_NOTIFICATIONID;
+
+	/** Few enough for a linear search, a listen server has at most a few dozen peers */
+	std::vector<FPeer> Peers;
+
+	FOnMessageReceivedCallback OnMessageReceivedCallback;
+	FOnPeerConnectionCallback OnPeerConnectionRequestCallback;
+	FOnPeerConnectionCallback OnPeerConnectionClosedCallback;
+	FStats Stats;
+
+	std::vector<char> ReceiveBuffer;
+};
@@ -0,0 +1,125 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "AntiCheatStatusPoller.h"
+#include "DebugLog.h"
+#include "StringUtils.h"
+
+#include <eos_anticheatclient.h>
+
+#include <algorithm>
+
+constexpr size_t FAntiCheatStatusPoller::MaxMessageLength;
+constexpr size_t FAntiCheatStatusPoller::MaxPendingEvents;
+
+void FAntiCheatStatusPoller::Start(EOS_HAntiCheatClient Handle)
+{
+	AntiCheatClientHandle = Handle;
+	CurrentInterval = Settings.MinInterval;
+	NextPollTime = std::chrono::steady_clock::now();
+}
+
+void FAntiCheatStatusPoller::Stop()
+{
+	AntiCheatClientHandle = nullptr;
+}
+
+void FAntiCheatStatusPoller::Update()
+{
+	if (AntiCheatClientHandle && std::chrono::steady_clock::now() >= NextPollTime)
+	{
+		Poll();
+	}
+
+	DispatchEvents();
+}
+
+bool FAntiCheatStatusPoller::PollNow()
+{
+	return AntiCheatClientHandle && Poll();
+}
+
+FAntiCheatStatusPoller::FSubscriptionId FAntiCheatStatusPoller::Subscribe(FOnViolationCallback Callback)
+{
+	const FSubscriptionId Id = NextSubscriptionId++;
+	Subscribers.emplace_back(Id, std::move(Callback));
+	return Id;
+}
+
+void FAntiCheatStatusPoller::Unsubscribe(FSubscriptionId Id)
+{
+	Subscribers.erase(std::remove_if(Subscribers.begin(), Subscribers.end(),
+		[Id](const std::pair<FSubscriptionId, FOnViolationCallback>& Subscriber) { return Subscriber.first == Id; }),
+		Subscribers.end());
+}
+
+bool FAntiCheatStatusPoller::Poll()
+{
+	EOS_AntiCheatClient_PollStatusOptions Options = {};
+	Options.ApiVersion = EOS_ANTICHEATCLIENT_POLLSTATUS_API_LATEST;
+	Options.OutMessageLength = static_cast<uint32_t>(MaxMessageLength);
+
+	FViolationEvent Event;
+	EOS_EResult Result = EOS_AntiCheatClient_PollStatus(AntiCheatClientHandle, &Options, &Event.Type, Event.Message.data());
+	if (Result == EOS_EResult::EOS_LimitExceeded)
+	{
+		// Fetch the whole message once, the event keeps as much of it as fits
+		std::vector<char> LongMessage(MaxMessageLength * 16);
+		Options.OutMessageLength = static_cast<uint32_t>(LongMessage.size());
+		Result = EOS_AntiCheatClient_PollStatus(AntiCheatClientHandle, &Options, &Event.Type, LongMessage.data());
+		if (Result == EOS_EResult::EOS_Success)
+		{
+			LongMessage.back() = '\0';
+			std::copy_n(LongMessage.begin(), MaxMessageLength - 1, Event.Message.begin());
+		}
+		else
+		{
+			FDebugLog::LogError(L"AntiCheatStatusPoller: Could not fetch a long violation message: %ls", FStringUtils::Widen(EOS_EResult_ToString(Result)).c_str());
+		}
+	}
+
+	const auto Now = std::chrono::steady_clock::now();
+	const bool bHasViolation = Result == EOS_EResult::EOS_Success;
+	if (bHasViolation)
+	{
+		Event.Message.back() = '\0';
+		Event.Time = Now;
+		if (PendingEvents.size() < MaxPendingEvents)
+		{
+			PendingEvents.push_back(Event);
+		}
+		else
+		{
+			++NumDroppedEvents;
+		}
+		CurrentInterval = Settings.MinInterval;
+	}
+	else
+	{
+		CurrentInterval = std::min(CurrentInterval * 2, Settings.MaxInterval);
+	}
+
+	NextPollTime = Now + CurrentInterval;
+	return bHasViolation;
+}
+
+void FAntiCheatStatusPoller::DispatchEvents()
+{
+	if (NumDroppedEvents > 0)
+	{
+		FDebugLog::LogWarning(L"AntiCheatStatusPoller: Dropped %u violations, too many were waiting to be dispatched", NumDroppedEvents);
+		NumDroppedEvents = 0;
+	}
+
+	DispatchedEvents.clear();
+	DispatchedEvents.swap(PendingEvents);
+	for (const FViolationEvent& Event : DispatchedEvents)
+	{
+		// Subscribers may subscribe or unsubscribe from their callback
+		const auto CurrentSubscribers = Subscribers;
+		for (const auto& Subscriber : CurrentSubscribers)
+		{
+			Subscriber.second(Event);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <eos_anticheatclient_types.h>
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * Polls EOS_AntiCheatClient_PollStatus on a schedule instead of on request. The interval grows while no violations
+ * are reported and drops back to the minimum after one, so a violation is picked up quickly and an idle client
+ * hardly polls at all. Violations are collected and handed to the subscribers from Update.
+ * Everything, EOS calls included, runs on the thread that calls Update, which has to be the one ticking the platform.
+ */
+class FAntiCheatStatusPoller
+{
+public:
+	/** Longer violation messages are truncated */
+	static constexpr size_t MaxMessageLength = 256;
+
+	/** Violations that were not handed to the subscribers yet, newer ones are dropped beyond this */
+	static constexpr size_t MaxPendingEvents = 64;
+
+	struct FSettings
+	{
+		/** Interval after a violation and after Start */
+		std::chrono::milliseconds MinInterval = std::chrono::milliseconds(250);
+
+		/** The interval doubles after every poll without a violation, up to this */
+		std::chrono::milliseconds MaxInterval = std::chrono::seconds(8);
+	};
+
+	struct FViolationEvent
+	{
+		EOS_EAntiCheatClientViolationType Type = EOS_EAntiCheatClientViolationType::EOS_ACCVT_Invalid;
+
+		/** Null terminated message to display to the user */
+		std::array<char, MaxMessageLength> Message = {};
+
+		std::chrono::steady_clock::time_point Time;
+	};
+
+	using FOnViolationCallback = std::function<void(const FViolationEvent&)>;
+	using FSubscriptionId = uint32_t;
+
+	FAntiCheatStatusPoller() = default;
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	FAntiCheatStatusPoller(FAntiCheatStatusPoller const&) = delete;
+	FAntiCheatStatusPoller& operator=(FAntiCheatStatusPoller const&) = delete;
+
+	void SetSettings(const FSettings& InSettings) { Settings = InSettings; }
+
+	/** Starts polling the given anti-cheat client at the minimum interval */
+	void Start(EOS_HAntiCheatClient Handle);
+	void Stop();
+	bool IsRunning() const { return AntiCheatClientHandle != nullptr; }
+
+	/** Polls if the interval has passed, then hands the new violations to the subscribers */
+	void Update();
+
+	/**
+	 * Polls right away, independent of the schedule. The violation, if any, reaches the subscribers on the next Update.
+	 * @return True if a violation was reported
+	 */
+	bool PollNow();
+
+	/** The callback is called from Update for every violation */
+	FSubscriptionId Subscribe(FOnViolationCallback Callback);
+	void Unsubscribe(FSubscriptionId Id);
+
+	std::chrono::milliseconds GetCurrentInterval() const { return CurrentInterval; }
+
+private:
+	/** Polls once and adapts the interval. Returns true if a violation was reported. */
+	bool Poll();
+	void DispatchEvents();
+
+	EOS_HAntiCheatClient AntiCheatClientHandle = nullptr;
+	FSettings Settings;
+
+	std::chrono::milliseconds CurrentInterval = Settings.MinInterval;
+	std::chrono::steady_clock::time_point NextPollTime;
+
+	std::vector<FViolationEvent> PendingEvents;
+	uint32_t NumDroppedEvents = 0;
+
+	/** Events of the current DispatchEvents, kept apart so subscribers can call PollNow */
+	std::vector<FViolationEvent> DispatchedEvents;
+
+	std::vector<std::pair<FSubscriptionId, FOnViolationCallback>> Subscribers;
+	FSubscriptionId NextSubscriptionId = 1;
+};
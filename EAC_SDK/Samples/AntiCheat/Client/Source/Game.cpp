@@ -37,6 +37,7 @@ void FGame::Update()
 	FBaseGame::Update();
 
 	AntiCheatNetworkTransport->Update();
+	AntiCheatClient->Update();
 }
 
 void FGame::OnShutdown()
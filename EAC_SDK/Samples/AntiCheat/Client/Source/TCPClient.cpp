@@ -4,10 +4,336 @@
 #include "TCPClient.h"
 #include "DebugLog.h"
 
+#include <random>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+	// SDL_net only has blocking connects, so the network thread uses the platform sockets directly
+
+#ifdef _WIN32
+	using FSocket = SOCKET;
+	const FSocket InvalidSocket = INVALID_SOCKET;
+	constexpr int SendFlags = 0;
+
+	void CloseSocket(FSocket Socket) { closesocket(Socket); }
+	int GetSocketError() { return WSAGetLastError(); }
+	bool IsWouldBlock(int Error) { return Error == WSAEWOULDBLOCK; }
+	bool IsConnectInProgress(int Error) { return Error == WSAEWOULDBLOCK; }
+
+	bool SetNonBlocking(FSocket Socket)
+	{
+		u_long NonBlocking = 1;
+		return ioctlsocket(Socket, FIONBIO, &NonBlocking) == 0;
+	}
+#else
+	using FSocket = int;
+	const FSocket InvalidSocket = -1;
+#ifdef MSG_NOSIGNAL
+	constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+	constexpr int SendFlags = 0;
+#endif
+
+	void CloseSocket(FSocket Socket) { close(Socket); }
+	int GetSocketError() { return errno; }
+	bool IsWouldBlock(int Error) { return Error == EAGAIN || Error == EWOULDBLOCK || Error == EINTR; }
+	bool IsConnectInProgress(int Error) { return Error == EINPROGRESS || Error == EINTR; }
+
+	bool SetNonBlocking(FSocket Socket)
+	{
+		const int Flags = fcntl(Socket, F_GETFL, 0);
+		return Flags >= 0 && fcntl(Socket, F_SETFL, Flags | O_NONBLOCK) == 0;
+	}
+#endif
+
+	/** Timeout for WaitForSocket that waits until the socket or the wake socket is ready */
+	constexpr std::chrono::milliseconds InfiniteWait(-1);
+
+	struct FSocketReadiness
+	{
+		bool bIsReadable = false;
+		bool bIsWritable = false;
+
+		/** The socket has an error pending, e.g. a failed connect */
+		bool bHasError = false;
+
+		/** The wake socket was signaled */
+		bool bIsWoken = false;
+	};
+
+	/**
+	 * Waits until the socket is readable, or writable if asked for, the wake socket is readable or the timeout has passed.
+	 * A negative timeout waits without limit. False on failure.
+	 */
+	bool WaitForSocket(FSocket Socket, FSocket WakeSocket, bool bWaitForWritable, std::chrono::milliseconds Timeout, FSocketReadiness& OutReadiness)
+	{
+		OutReadiness = FSocketReadiness();
+
+#ifdef _WIN32
+		fd_set ReadSet;
+		fd_set WriteSet;
+		fd_set ErrorSet;
+		FD_ZERO(&ReadSet);
+		FD_ZERO(&WriteSet);
+		FD_ZERO(&ErrorSet);
+		FD_SET(Socket, &ReadSet);
+		FD_SET(WakeSocket, &ReadSet);
+		if (bWaitForWritable)
+		{
+			FD_SET(Socket, &WriteSet);
+		}
+		// Windows reports failed connects through the error set only
+		FD_SET(Socket, &ErrorSet);
+
+		timeval TimeoutValue = {};
+		TimeoutValue.tv_sec = static_cast<long>(Timeout.count() / 1000);
+		TimeoutValue.tv_usec = static_cast<long>((Timeout.count() % 1000) * 1000);
+
+		if (select(0, &ReadSet, &WriteSet, &ErrorSet, Timeout.count() < 0 ? nullptr : &TimeoutValue) == SOCKET_ERROR)
+		{
+			return false;
+		}
+
+		OutReadiness.bIsReadable = FD_ISSET(Socket, &ReadSet) != 0;
+		OutReadiness.bIsWritable = FD_ISSET(Socket, &WriteSet) != 0;
+		OutReadiness.bHasError = FD_ISSET(Socket, &ErrorSet) != 0;
+		OutReadiness.bIsWoken = FD_ISSET(WakeSocket, &ReadSet) != 0;
+#else
+		pollfd PollDescriptors[2] = {};
+		PollDescriptors[0].fd = Socket;
+		PollDescriptors[0].events = POLLIN | (bWaitForWritable ? POLLOUT : 0);
+		PollDescriptors[1].fd = WakeSocket;
+		PollDescriptors[1].events = POLLIN;
+
+		const int Result = poll(PollDescriptors, 2, Timeout.count() < 0 ? -1 : static_cast<int>(Timeout.count()));
+		if (Result < 0 && errno != EINTR)
+		{
+			return false;
+		}
+
+		// A hang up is reported as readable, so data that arrived before it is still received
+		OutReadiness.bIsReadable = (PollDescriptors[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+		OutReadiness.bIsWritable = (PollDescriptors[0].revents & POLLOUT) != 0;
+		OutReadiness.bHasError = (PollDescriptors[0].revents & POLLERR) != 0;
+		OutReadiness.bIsWoken = (PollDescriptors[1].revents & POLLIN) != 0;
+#endif
+		return true;
+	}
+}
+
+/** Lets other threads wake the network thread of an FTCPClient while it waits in WaitForSocket */
+struct FTCPWakeSocket
+{
+	/**
+	 * Read by the network thread, written by Signal. A socket pair on POSIX; on Windows, where select only takes sockets
+	 * and there is no socketpair, a loopback UDP socket connected to itself, so both are the same socket.
+	 */
+	FSocket ReadSocket = InvalidSocket;
+	FSocket WriteSocket = InvalidSocket;
+
+	/** Set from the first Signal until Drain, so a burst of sends writes a single byte */
+	std::atomic<bool> bIsSignaled{ false };
+
+	bool Open()
+	{
+#ifdef _WIN32
+		ReadSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (ReadSocket == InvalidSocket)
+		{
+			return false;
+		}
+
+		sockaddr_in Address = {};
+		Address.sin_family = AF_INET;
+		Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		int AddressLength = sizeof(Address);
+		if (bind(ReadSocket, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) != 0
+			|| getsockname(ReadSocket, reinterpret_cast<sockaddr*>(&Address), &AddressLength) != 0
+			|| connect(ReadSocket, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) != 0
+			|| !SetNonBlocking(ReadSocket))
+		{
+			Close();
+			return false;
+		}
+		WriteSocket = ReadSocket;
+#else
+		int Sockets[2] = { InvalidSocket, InvalidSocket };
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, Sockets) != 0)
+		{
+			return false;
+		}
+		ReadSocket = Sockets[0];
+		WriteSocket = Sockets[1];
+		if (!SetNonBlocking(ReadSocket) || !SetNonBlocking(WriteSocket))
+		{
+			Close();
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	void Close()
+	{
+		if (WriteSocket != InvalidSocket && WriteSocket != ReadSocket)
+		{
+			CloseSocket(WriteSocket);
+		}
+		if (ReadSocket != InvalidSocket)
+		{
+			CloseSocket(ReadSocket);
+		}
+		ReadSocket = InvalidSocket;
+		WriteSocket = InvalidSocket;
+	}
+
+	/** Makes ReadSocket readable until the next Drain. May be called from any thread. */
+	void Signal()
+	{
+		if (!bIsSignaled.exchange(true))
+		{
+			const char Byte = 0;
+			send(WriteSocket, &Byte, sizeof(Byte), SendFlags);
+		}
+	}
+
+	/** Called by the network thread before it looks for the work it was woken for */
+	void Drain()
+	{
+		// Reading the flag pairs with Signal's write, so whatever Send queued before it is visible afterwards
+		bIsSignaled.exchange(false);
+
+		char Bytes[64];
+		while (recv(ReadSocket, Bytes, sizeof(Bytes), 0) > 0)
+		{
+		}
+	}
+};
+
+namespace
+{
+	/** Connects a non-blocking socket to one address, giving up at the deadline or when asked to stop */
+	FSocket ConnectToAddress(const addrinfo& Address, std::chrono::steady_clock::time_point Deadline, const std::atomic<bool>& bStopRequested, FTCPWakeSocket& WakeSocket)
+	{
+		FSocket Socket = socket(Address.ai_family, Address.ai_socktype, Address.ai_protocol);
+		if (Socket == InvalidSocket)
+		{
+			return InvalidSocket;
+		}
+
+		if (!SetNonBlocking(Socket))
+		{
+			CloseSocket(Socket);
+			return InvalidSocket;
+		}
+
+		const int NoDelay = 1;
+		setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&NoDelay), sizeof(NoDelay));
+#ifdef SO_NOSIGPIPE
+		const int NoSigPipe = 1;
+		setsockopt(Socket, SOL_SOCKET, SO_NOSIGPIPE, &NoSigPipe, sizeof(NoSigPipe));
+#endif
+
+		if (connect(Socket, Address.ai_addr, static_cast<int>(Address.ai_addrlen)) == 0)
+		{
+			return Socket;
+		}
+		if (!IsConnectInProgress(GetSocketError()))
+		{
+			CloseSocket(Socket);
+			return InvalidSocket;
+		}
+
+		// Disconnect wakes the wait, Send as well, which only matters once connected
+		while (!bStopRequested)
+		{
+			const auto Remaining = std::chrono::duration_cast<std::chrono::milliseconds>(Deadline - std::chrono::steady_clock::now());
+			if (Remaining.count() <= 0)
+			{
+				break;
+			}
+
+			FSocketReadiness Readiness;
+			if (!WaitForSocket(Socket, WakeSocket.ReadSocket, true, Remaining, Readiness))
+			{
+				break;
+			}
+			if (Readiness.bIsWoken)
+			{
+				WakeSocket.Drain();
+			}
+			if (!Readiness.bIsWritable && !Readiness.bHasError)
+			{
+				continue;
+			}
+
+			int Error = 0;
+			socklen_t ErrorLength = sizeof(Error);
+			if (getsockopt(Socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&Error), &ErrorLength) == 0 && Error == 0)
+			{
+				return Socket;
+			}
+			break;
+		}
+
+		CloseSocket(Socket);
+		return InvalidSocket;
+	}
+
+	/** Resolves the host and tries its addresses in order until one connects, all within the timeout */
+	FSocket ConnectToHost(const std::string& Host, uint16_t Port, std::chrono::milliseconds Timeout, const std::atomic<bool>& bStopRequested, FTCPWakeSocket& WakeSocket)
+	{
+		const auto Deadline = std::chrono::steady_clock::now() + Timeout;
+
+		addrinfo Hints = {};
+		Hints.ai_family = AF_UNSPEC;
+		Hints.ai_socktype = SOCK_STREAM;
+		Hints.ai_protocol = IPPROTO_TCP;
+
+		addrinfo* Addresses = nullptr;
+		if (getaddrinfo(Host.c_str(), std::to_string(Port).c_str(), &Hints, &Addresses) != 0 || !Addresses)
+		{
+			FDebugLog::LogWarning(L"Could not resolve server address %ls", FStringUtils::Widen(Host).c_str());
+			return InvalidSocket;
+		}
+
+		FSocket Socket = InvalidSocket;
+		for (const addrinfo* Address = Addresses; Address && Socket == InvalidSocket && !bStopRequested; Address = Address->ai_next)
+		{
+			Socket = ConnectToAddress(*Address, Deadline, bStopRequested, WakeSocket);
+		}
+
+		freeaddrinfo(Addresses);
+		return Socket;
+	}
+}
+
 FTCPClient::FTCPClient(size_t MaxBufferSizeBytes)
+	: WakeSocket(new FTCPWakeSocket())
 {
-	SDLNet_Init();
-	SocketSet = SDLNet_AllocSocketSet(1);
+#ifdef _WIN32
+	WSADATA WsaData;
+	WSAStartup(MAKEWORD(2, 2), &WsaData);
+#endif
+
+	if (!WakeSocket->Open())
+	{
+		FDebugLog::LogError(L"TCPClient: Could not create the socket that wakes the network thread");
+	}
 
 	Buffer.resize(MaxBufferSizeBytes);
 }
@@ -15,49 +341,63 @@ FTCPClient::FTCPClient(size_t MaxBufferSizeBytes)
 FTCPClient::~FTCPClient()
 {
 	Disconnect();
-	SDLNet_Quit();
+	WakeSocket->Close();
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
 }
 
-bool FTCPClient::Connect(const char* Host, uint16_t Port)
+void FTCPClient::Connect(const char* Host, uint16_t Port)
 {
-	IPaddress IP;
-	SDLNet_ResolveHost(&IP, Host, Port);
-	
-	Client = SDLNet_TCP_Open(&IP);
-	if (!Client)
-	{
-		FDebugLog::LogError(L"Connect to server failed");
-		return false;
-	}
-	SDLNet_TCP_AddSocket(SocketSet, Client);
+	Disconnect();
 
-	bIsConnected = true;
-	return bIsConnected;
+	ConnectionState = EConnectionState::Connecting;
+	bStopRequested = false;
+	Thread = std::thread(&FTCPClient::Run, this, std::string(Host), Port, ConnectSettings);
 }
 
 void FTCPClient::Disconnect()
 {
-	if (!bIsConnected)
+	if (Thread.joinable())
 	{
-		return;
+		{
+			std::lock_guard<std::mutex> Lock(StopMutex);
+			bStopRequested = true;
+		}
+		StopCondition.notify_all();
+		WakeSocket->Signal();
+		Thread.join();
 	}
+	WakeSocket->Drain();
 
-	SDLNet_TCP_DelSocket(SocketSet, Client);
-	SDLNet_TCP_Close(Client);
+	// The network thread is gone, so this thread may empty both queues
+	std::vector<char> Message;
+	while (OutgoingMessages.Pop(Message))
+	{
+	}
+	FNetworkEvent Event;
+	while (IncomingEvents.Pop(Event))
+	{
+	}
 
-	Client = nullptr;
-	bIsConnected = false;
-	FDebugLog::LogWarning(L"Disconnected from server");
+	if (ConnectionState == EConnectionState::Connected)
+	{
+		FDebugLog::LogWarning(L"Disconnected from server");
+	}
+	ConnectionState = EConnectionState::Disconnected;
 }
 
 void FTCPClient::Send(const void* Data, size_t Length)
 {
-	if (!bIsConnected)
+	if (Length == 0 || (ConnectionState != EConnectionState::Connecting && ConnectionState != EConnectionState::Connected))
 	{
 		return;
 	}
 
-	SDLNet_TCP_Send(Client, Data, static_cast<int>(Length));
+	const char* Bytes = static_cast<const char*>(Data);
+	OutgoingMessages.Push(std::vector<char>(Bytes, Bytes + Length));
+	WakeSocket->Signal();
 }
 
 void FTCPClient::SetOnBufferReceivedCallback(std::function<void(char*, int)> Callback)
@@ -65,25 +405,157 @@ void FTCPClient::SetOnBufferReceivedCallback(std::function<void(char*, int)> Cal
 	OnBufferReceivedCallback = std::move(Callback);
 }
 
+void FTCPClient::SetOnConnectionStateChangedCallback(FOnConnectionStateChangedCallback Callback)
+{
+	OnConnectionStateChangedCallback = std::move(Callback);
+}
+
 void FTCPClient::Update()
 {
-	if (!bIsConnected)
+	FNetworkEvent Event;
+	while (IncomingEvents.Pop(Event))
+	{
+		if (!Event.bIsStateChange)
+		{
+			OnBufferReceivedCallback(Event.Data.data(), static_cast<int>(Event.Data.size()));
+			continue;
+		}
+
+		if (Event.State == EConnectionState::Disconnected)
+		{
+			FDebugLog::LogWarning(L"Disconnected from server");
+		}
+
+		ConnectionState = Event.State;
+		if (OnConnectionStateChangedCallback)
+		{
+			OnConnectionStateChangedCallback(Event.State);
+		}
+	}
+}
+
+void FTCPClient::PushStateChange(EConnectionState State)
+{
+	FNetworkEvent Event;
+	Event.bIsStateChange = true;
+	Event.State = State;
+	IncomingEvents.Push(std::move(Event));
+}
+
+bool FTCPClient::WaitUnlessStopped(std::chrono::milliseconds Duration)
+{
+	std::unique_lock<std::mutex> Lock(StopMutex);
+	return !StopCondition.wait_for(Lock, Duration, [this]() { return bStopRequested.load(); });
+}
+
+void FTCPClient::Run(std::string Host, uint16_t Port, FConnectSettings Settings)
+{
+	if (WakeSocket->ReadSocket == InvalidSocket)
+	{
+		PushStateChange(EConnectionState::Failed);
+		return;
+	}
+
+	std::minstd_rand Random(std::random_device{}());
+	std::chrono::milliseconds RetryDelay = Settings.InitialRetryDelay;
+
+	FSocket Socket = InvalidSocket;
+	for (uint32_t Attempt = 1; ; ++Attempt)
+	{
+		Socket = ConnectToHost(Host, Port, Settings.AttemptTimeout, bStopRequested, *WakeSocket);
+		if (Socket != InvalidSocket || bStopRequested)
+		{
+			break;
+		}
+
+		if (Attempt >= Settings.MaxAttempts)
+		{
+			FDebugLog::LogError(L"Connect to server failed after %u attempts", Attempt);
+			PushStateChange(EConnectionState::Failed);
+			return;
+		}
+
+		const std::chrono::milliseconds Delay(std::uniform_int_distribution<long long>(RetryDelay.count() / 2, RetryDelay.count())(Random));
+		FDebugLog::LogWarning(L"Connect to server failed (attempt %u of %u), retrying in %lld ms", Attempt, Settings.MaxAttempts, static_cast<long long>(Delay.count()));
+		if (!WaitUnlessStopped(Delay))
+		{
+			return;
+		}
+		RetryDelay = std::min(RetryDelay * 2, Settings.MaxRetryDelay);
+	}
+
+	if (Socket == InvalidSocket)
 	{
 		return;
 	}
-	
-	SDLNet_CheckSockets(SocketSet, 0);
-	
-	if (SDLNet_SocketReady(Client))
+
+	PushStateChange(EConnectionState::Connected);
+
+	// The message being sent and how much of it the socket has taken so far
+	std::vector<char> Message;
+	size_t MessageOffset = 0;
+
+	bool bIsConnected = true;
+	while (bIsConnected && !bStopRequested)
 	{
-		const int ReceivedBufferLength = SDLNet_TCP_Recv(Client, &Buffer[0], static_cast<int>(Buffer.size()));
-		if (ReceivedBufferLength > 0)
+		// Send until the queue is empty or the socket is full
+		for (;;)
 		{
-			OnBufferReceivedCallback(&Buffer[0], ReceivedBufferLength);
+			if (MessageOffset == Message.size())
+			{
+				MessageOffset = 0;
+				if (!OutgoingMessages.Pop(Message))
+				{
+					Message.clear();
+					break;
+				}
+			}
+
+			const int BytesSent = send(Socket, &Message[MessageOffset], static_cast<int>(Message.size() - MessageOffset), SendFlags);
+			if (BytesSent > 0)
+			{
+				MessageOffset += static_cast<size_t>(BytesSent);
+			}
+			else
+			{
+				bIsConnected = BytesSent < 0 && IsWouldBlock(GetSocketError());
+				break;
+			}
 		}
-		else
+
+		// Sleeps until the server sends, the socket takes more data, or Send or Disconnect signal the wake socket
+		FSocketReadiness Readiness;
+		if (!bIsConnected || !WaitForSocket(Socket, WakeSocket->ReadSocket, MessageOffset < Message.size(), InfiniteWait, Readiness))
 		{
-			Disconnect();
+			break;
+		}
+		if (Readiness.bIsWoken)
+		{
+			WakeSocket->Drain();
+		}
+
+		// Receive until the socket would block
+		while (Readiness.bIsReadable)
+		{
+			const int ReceivedBufferLength = recv(Socket, Buffer.data(), static_cast<int>(Buffer.size()), 0);
+			if (ReceivedBufferLength > 0)
+			{
+				FNetworkEvent Event;
+				Event.Data.assign(Buffer.data(), Buffer.data() + ReceivedBufferLength);
+				IncomingEvents.Push(std::move(Event));
+			}
+			else
+			{
+				bIsConnected = ReceivedBufferLength < 0 && IsWouldBlock(GetSocketError());
+				break;
+			}
 		}
 	}
-}
\ No newline at end of file
+
+	CloseSocket(Socket);
+
+	if (!bStopRequested)
+	{
+		PushStateChange(EConnectionState::Disconnected);
+	}
+}
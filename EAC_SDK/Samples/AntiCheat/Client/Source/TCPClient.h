@@ -2,12 +2,55 @@
 
 #pragma once
 
-#define WITHOUT_SDL
-#include "SDL_net.h"
+#include "LockFreeQueue.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FTCPWakeSocket;
+
+/**
+ * Connection to the anti-cheat server. All socket I/O runs on a network thread owned by this class, so the game thread
+ * never blocks on the network: Connect returns right away, Send only queues the data, and Update hands received data
+ * and connection state changes to the callbacks on the game thread.
+ */
 class FTCPClient
 {
 public:
+	enum class EConnectionState
+	{
+		Disconnected,
+		Connecting,
+		Connected,
+
+		/** Every connection attempt failed */
+		Failed
+	};
+
+	/** How the network thread connects */
+	struct FConnectSettings
+	{
+		/** Longest time a single connection attempt may take */
+		std::chrono::milliseconds AttemptTimeout = std::chrono::seconds(5);
+
+		/** Number of attempts before the connection counts as failed, including the first one */
+		uint32_t MaxAttempts = 5;
+
+		/**
+		 * Delay before the first retry, doubled for every further retry up to MaxRetryDelay. Every delay is randomized
+		 * to between half and all of it, so clients that lost the same server do not retry in lockstep.
+		 */
+		std::chrono::milliseconds InitialRetryDelay = std::chrono::milliseconds(500);
+		std::chrono::milliseconds MaxRetryDelay = std::chrono::seconds(8);
+	};
+
 	/**
 	 * No default constructor for this class
 	 */
@@ -29,22 +72,66 @@ public:
 	 */
 	virtual ~FTCPClient();
 
-	bool Connect(const char* Host, uint16_t Port);
+	/** Applies to the following Connect calls */
+	void SetConnectSettings(const FConnectSettings& Settings) { ConnectSettings = Settings; }
+
+	/**
+	 * Starts connecting on the network thread and returns right away, ending any previous connection first.
+	 * Reports Connected or Failed through the connection state callback.
+	 */
+	void Connect(const char* Host, uint16_t Port);
+
+	/** Stops the network thread and drops data that was not sent or handed to the callbacks yet */
 	void Disconnect();
 
+	/** Queues the data for the network thread. Data sent while still connecting goes out once connected. */
 	void Send(const void* Data, size_t Length);
 	void SetOnBufferReceivedCallback(std::function<void(char*, int)> Callback);
 
+	using FOnConnectionStateChangedCallback = std::function<void(EConnectionState)>;
+	void SetOnConnectionStateChangedCallback(FOnConnectionStateChangedCallback Callback);
+
+	EConnectionState GetConnectionState() const { return ConnectionState; }
+
+	/** Calls the callbacks for everything the network thread received since the last Update */
 	void Update();
 
 private:
-	bool bIsConnected = false;
+	/** Passed from the network thread to the game thread */
+	struct FNetworkEvent
+	{
+		/** Set for state changes, received data otherwise */
+		bool bIsStateChange = false;
+		EConnectionState State = EConnectionState::Disconnected;
+		std::vector<char> Data;
+	};
+
+	void Run(std::string Host, uint16_t Port, FConnectSettings Settings);
+	void PushStateChange(EConnectionState State);
+
+	/** Waits for the given time or until Disconnect is called. Returns false if Disconnect was called. */
+	bool WaitUnlessStopped(std::chrono::milliseconds Duration);
 
-	TCPsocket Client = nullptr;
-	SDLNet_SocketSet SocketSet;
+	EConnectionState ConnectionState = EConnectionState::Disconnected;
+	FConnectSettings ConnectSettings;
 
+	std::thread Thread;
+	std::atomic<bool> bStopRequested{ false };
+	std::mutex StopMutex;
+	std::condition_variable StopCondition;
+
+	/** Waited on by the network thread along with the server connection, signaled by Send and Disconnect */
+	std::unique_ptr<FTCPWakeSocket> WakeSocket;
+
+	/** Messages from the game thread to the network thread */
+	TSpscQueue<std::vector<char>> OutgoingMessages;
+
+	/** Received data and state changes from the network thread to the game thread */
+	TSpscQueue<FNetworkEvent> IncomingEvents;
+
+	/** Receive buffer of the network thread */
 	std::vector<char> Buffer;
 
 	std::function<void(char*, int)> OnBufferReceivedCallback;
+	FOnConnectionStateChangedCallback OnConnectionStateChangedCallback;
 };
-
@@ -0,0 +1,630 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "CaptureReplay.h"
+#include "DebugLog.h"
+#include "StringUtils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint32_t FCaptureReplay::FileMagic;
+constexpr uint32_t FCaptureReplay::FileVersion;
+constexpr size_t FCaptureReplay::MaxStepsPerIteration;
+
+namespace
+{
+	/** Every message starts with a one byte message type and the length of the payload that follows */
+	constexpr size_t MessageHeaderSize = sizeof(char) + sizeof(uint32_t);
+}
+
+void FCaptureReplay::FResults::Merge(const FResults& Other)
+{
+	Connected += Other.Connected;
+	ConnectFailures += Other.ConnectFailures;
+	Disconnected += Other.Disconnected;
+	MessagesSent += Other.MessagesSent;
+	MessagesReceived += Other.MessagesReceived;
+	BytesSent += Other.BytesSent;
+	BytesReceived += Other.BytesReceived;
+	if (FirstSendTime == LoadTestTimePoint() || (Other.FirstSendTime != LoadTestTimePoint() && Other.FirstSendTime < FirstSendTime))
+	{
+		FirstSendTime = Other.FirstSendTime;
+	}
+	LastActivityTime = std::max(LastActivityTime, Other.LastActivityTime);
+	SendDelays.Merge(Other.SendDelays);
+	ResponseTimes.Merge(Other.ResponseTimes);
+}
+
+FCaptureReplay::FCaptureReplay(const FConfig& InConfig)
+	: Config(InConfig)
+{
+	Config.NumThreads = std::max(1u, Config.NumThreads);
+	Config.Speed = std::max(1u, Config.Speed);
+}
+
+FCaptureReplay::~FCaptureReplay()
+{
+	if (CaptureData)
+	{
+		munmap(const_cast<char*>(CaptureData), CaptureSize);
+	}
+}
+
+bool FCaptureReplay::MapCapture()
+{
+	const int File = open(Config.CaptureFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (File < 0)
+	{
+		FDebugLog::LogError(L"CaptureReplay: Can't open %ls, errno %d", FStringUtils::Widen(Config.CaptureFilePath).c_str(), errno);
+		return false;
+	}
+
+	struct stat FileStatus = {};
+	if (fstat(File, &FileStatus) != 0 || FileStatus.st_size < static_cast<off_t>(sizeof(FFileHeader)))
+	{
+		FDebugLog::LogError(L"CaptureReplay: %ls is not a capture", FStringUtils::Widen(Config.CaptureFilePath).c_str());
+		close(File);
+		return false;
+	}
+
+	CaptureSize = static_cast<size_t>(FileStatus.st_size);
+	void* Mapping = mmap(nullptr, CaptureSize, PROT_READ, MAP_PRIVATE, File, 0);
+	close(File);
+	if (Mapping == MAP_FAILED)
+	{
+		FDebugLog::LogError(L"CaptureReplay: Can't map %ls, errno %d", FStringUtils::Widen(Config.CaptureFilePath).c_str(), errno);
+		CaptureSize = 0;
+		return false;
+	}
+
+	// Indexing and replaying both walk the file front to back
+	madvise(Mapping, CaptureSize, MADV_SEQUENTIAL);
+	CaptureData = static_cast<const char*>(Mapping);
+
+	FFileHeader Header;
+	memcpy(&Header, CaptureData, sizeof(Header));
+	if (Header.Magic != FileMagic || Header.Version != FileVersion)
+	{
+		FDebugLog::LogError(L"CaptureReplay: %ls is not a capture of version %u", FStringUtils::Widen(Config.CaptureFilePath).c_str(), FileVersion);
+		return false;
+	}
+	return true;
+}
+
+bool FCaptureReplay::IndexCapture(std::vector<FWorker>& Workers)
+{
+	// Capture client handles to replay client indices. A handle is forgotten on its disconnect, so if the server
+	// reused it, the next client with that handle gets a connection of its own.
+	std::unordered_map<uint64_t, uint32_t> ClientIndices;
+
+	size_t Offset = sizeof(FFileHeader);
+	while (Offset < CaptureSize)
+	{
+		FRecordHeader Header;
+		if (CaptureSize - Offset < sizeof(Header))
+		{
+			FDebugLog::LogWarning(L"CaptureReplay: Capture ends in a truncated record, replaying what comes before it");
+			break;
+		}
+		memcpy(&Header, CaptureData + Offset, sizeof(Header));
+		Offset += sizeof(Header);
+
+		if (CaptureSize - Offset < Header.Size)
+		{
+			FDebugLog::LogWarning(L"CaptureReplay: Capture ends in a truncated record, replaying what comes before it");
+			break;
+		}
+
+		FReplayStep Step;
+		Step.TimeNs = Header.TimeNs;
+		Step.Size = Header.Size;
+		Step.DataOffset = Offset;
+		Offset += Header.Size;
+
+		CaptureDurationNs = std::max(CaptureDurationNs, Header.TimeNs);
+
+		const ERecordType Type = static_cast<ERecordType>(Header.Type);
+		if (Type == ERecordType::Outgoing)
+		{
+			++NumCapturedOutgoing;
+			NumCapturedOutgoingBytes += Header.Size;
+			continue;
+		}
+
+		auto ClientItr = ClientIndices.find(Header.ClientHandle);
+		if (Type == ERecordType::Incoming)
+		{
+			if (Header.Size < MessageHeaderSize)
+			{
+				continue;
+			}
+			if (ClientItr == ClientIndices.end())
+			{
+				ClientItr = ClientIndices.emplace(Header.ClientHandle, NumCapturedClients++).first;
+			}
+			++NumCapturedIncoming;
+			NumCapturedIncomingBytes += Header.Size;
+		}
+		else if (Type == ERecordType::Disconnected)
+		{
+			if (ClientItr == ClientIndices.end())
+			{
+				continue;
+			}
+			Step.DataOffset = 0;
+		}
+		else
+		{
+			FDebugLog::LogError(L"CaptureReplay: Unknown record type %u, the capture is corrupt", static_cast<uint32_t>(Header.Type));
+			return false;
+		}
+
+		Step.ClientIndex = ClientItr->second;
+		Workers[Step.ClientIndex % Config.NumThreads].Steps.push_back(Step);
+
+		if (Type == ERecordType::Disconnected)
+		{
+			ClientIndices.erase(ClientItr);
+		}
+	}
+
+	for (uint32_t ThreadIndex = 0; ThreadIndex < Config.NumThreads; ++ThreadIndex)
+	{
+		Workers[ThreadIndex].Clients.resize((NumCapturedClients + Config.NumThreads - 1 - ThreadIndex) / Config.NumThreads);
+	}
+	return true;
+}
+
+bool FCaptureReplay::Run()
+{
+	if (!MapCapture())
+	{
+		return false;
+	}
+
+	addrinfo Hints = {};
+	Hints.ai_family = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* AddressInfo = nullptr;
+	const std::string Port = std::to_string(Config.Port);
+	if (getaddrinfo(Config.Host.c_str(), Port.c_str(), &Hints, &AddressInfo) != 0 || !AddressInfo)
+	{
+		FDebugLog::LogError(L"CaptureReplay: Can't resolve %ls", FStringUtils::Widen(Config.Host).c_str());
+		return false;
+	}
+	const char* Address = reinterpret_cast<const char*>(AddressInfo->ai_addr);
+	ServerAddress.assign(Address, Address + AddressInfo->ai_addrlen);
+	freeaddrinfo(AddressInfo);
+
+	std::vector<FWorker> Workers(Config.NumThreads);
+	if (!IndexCapture(Workers))
+	{
+		return false;
+	}
+
+	for (FWorker& Worker : Workers)
+	{
+		Worker.EpollHandle = epoll_create1(EPOLL_CLOEXEC);
+		if (Worker.EpollHandle < 0)
+		{
+			FDebugLog::LogError(L"CaptureReplay: epoll_create1 failed, errno %d", errno);
+			for (FWorker& CreatedWorker : Workers)
+			{
+				if (CreatedWorker.EpollHandle >= 0)
+				{
+					close(CreatedWorker.EpollHandle);
+				}
+			}
+			return false;
+		}
+	}
+
+	FDebugLog::Log(L"CaptureReplay: Replaying %u clients from %ls at %ux speed on %u threads",
+		NumCapturedClients, FStringUtils::Widen(Config.CaptureFilePath).c_str(), Config.Speed, Config.NumThreads);
+
+	StartTime = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> Threads;
+	for (FWorker& Worker : Workers)
+	{
+		Threads.emplace_back([this, &Worker]() { RunWorker(Worker); });
+	}
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	Results = FResults();
+	for (FWorker& Worker : Workers)
+	{
+		close(Worker.EpollHandle);
+		Results.Merge(Worker.Results);
+	}
+
+	return true;
+}
+
+void FCaptureReplay::RunWorker(FWorker& Worker)
+{
+	LoadTestTimePoint DrainStartTime;
+
+	size_t NextStep = 0;
+	std::vector<epoll_event> Events(256);
+
+	auto GetScheduledTime = [this](const FReplayStep& Step)
+	{
+		return StartTime + std::chrono::nanoseconds(Step.TimeNs / Config.Speed);
+	};
+
+	for (;;)
+	{
+		LoadTestTimePoint Now = std::chrono::steady_clock::now();
+
+		for (size_t NumSteps = 0; NumSteps < MaxStepsPerIteration && NextStep < Worker.Steps.size(); ++NumSteps)
+		{
+			const FReplayStep& Step = Worker.Steps[NextStep];
+			const LoadTestTimePoint ScheduledTime = GetScheduledTime(Step);
+			if (ScheduledTime > Now)
+			{
+				break;
+			}
+
+			if (ReplayStep(Worker, Step, ScheduledTime, Now))
+			{
+				if (Worker.Results.FirstSendTime == LoadTestTimePoint())
+				{
+					Worker.Results.FirstSendTime = Now;
+				}
+				Worker.Results.LastActivityTime = Now;
+			}
+			++NextStep;
+		}
+
+		if (NextStep == Worker.Steps.size())
+		{
+			if (DrainStartTime == LoadTestTimePoint())
+			{
+				DrainStartTime = Now;
+			}
+
+			uint64_t NumUnanswered = 0;
+			for (const FReplayClient& Client : Worker.Clients)
+			{
+				NumUnanswered += Client.UnansweredSendTimes.size();
+			}
+			if (NumUnanswered == 0 || Now >= DrainStartTime + Config.DrainTimeout)
+			{
+				break;
+			}
+		}
+
+		// Sleep until the next step is due, or the socket events
+		LoadTestTimePoint WakeTime = NextStep < Worker.Steps.size() ? GetScheduledTime(Worker.Steps[NextStep]) : DrainStartTime + Config.DrainTimeout;
+		const int64_t TimeoutMs = std::max<int64_t>(0, std::min<int64_t>(100, std::chrono::duration_cast<std::chrono::milliseconds>(WakeTime - Now + std::chrono::microseconds(999)).count()));
+
+		const int NumEvents = epoll_wait(Worker.EpollHandle, Events.data(), static_cast<int>(Events.size()), static_cast<int>(TimeoutMs));
+		if (NumEvents < 0 && errno != EINTR)
+		{
+			FDebugLog::LogError(L"CaptureReplay: epoll_wait failed, errno %d", errno);
+			break;
+		}
+
+		Now = std::chrono::steady_clock::now();
+		for (int EventIndex = 0; EventIndex < NumEvents; ++EventIndex)
+		{
+			const epoll_event& Event = Events[EventIndex];
+			FReplayClient& Client = Worker.Clients[static_cast<size_t>(Event.data.u64)];
+			if (Client.bIsClosed)
+			{
+				continue;
+			}
+
+			if (Client.bIsConnecting)
+			{
+				int Error = 0;
+				socklen_t ErrorSize = sizeof(Error);
+				if (getsockopt(Client.Socket, SOL_SOCKET, SO_ERROR, &Error, &ErrorSize) != 0 || Error != 0)
+				{
+					++Worker.Results.ConnectFailures;
+					Close(Worker, Client, false);
+					continue;
+				}
+
+				++Worker.Results.Connected;
+				Client.bIsConnecting = false;
+				WatchSocket(Worker, Client, EPOLLIN, EPOLL_CTL_MOD);
+				FlushSendBuffer(Worker, Client);
+				continue;
+			}
+
+			if ((Event.events & EPOLLIN) != 0)
+			{
+				OnReadable(Worker, Client, Now);
+			}
+			if ((Event.events & EPOLLOUT) != 0 && !Client.bIsClosed)
+			{
+				FlushSendBuffer(Worker, Client);
+			}
+			if ((Event.events & (EPOLLERR | EPOLLHUP)) != 0 && !Client.bIsClosed)
+			{
+				Close(Worker, Client, true);
+			}
+		}
+	}
+
+	for (FReplayClient& Client : Worker.Clients)
+	{
+		if (Client.Socket >= 0)
+		{
+			Close(Worker, Client, false);
+		}
+	}
+}
+
+bool FCaptureReplay::ReplayStep(FWorker& Worker, const FReplayStep& Step, LoadTestTimePoint ScheduledTime, LoadTestTimePoint Now)
+{
+	FReplayClient& Client = Worker.Clients[Step.ClientIndex / Config.NumThreads];
+	if (Client.bIsClosed)
+	{
+		// Closed by the server, or failed to connect
+		return false;
+	}
+
+	if (Step.DataOffset == 0)
+	{
+		// Disconnect as recorded, but only after everything recorded before it went out
+		if (Client.bIsConnecting || Client.SendOffset < Client.SendBuffer.size())
+		{
+			Client.bCloseWhenSent = true;
+		}
+		else if (Client.Socket >= 0)
+		{
+			Close(Worker, Client, false);
+		}
+		return false;
+	}
+
+	if (Client.Socket < 0 && !Connect(Worker, Client))
+	{
+		return false;
+	}
+
+	Worker.Results.SendDelays.Add(Now - ScheduledTime);
+
+	const char* Message = CaptureData + Step.DataOffset;
+	const bool bWasIdle = Client.SendOffset == Client.SendBuffer.size();
+	Client.SendBuffer.insert(Client.SendBuffer.end(), Message, Message + Step.Size);
+	Client.UnansweredSendTimes.push_back(Now);
+
+	++Worker.Results.MessagesSent;
+	Worker.Results.BytesSent += Step.Size;
+
+	// Only the first queued message has to start a write, the rest goes out when the socket becomes writable
+	if (bWasIdle && !Client.bIsConnecting)
+	{
+		FlushSendBuffer(Worker, Client);
+	}
+	return true;
+}
+
+bool FCaptureReplay::Connect(FWorker& Worker, FReplayClient& Client)
+{
+	const sockaddr* Address = reinterpret_cast<const sockaddr*>(ServerAddress.data());
+	Client.Socket = socket(Address->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (Client.Socket < 0)
+	{
+		++Worker.Results.ConnectFailures;
+		Client.bIsClosed = true;
+		return false;
+	}
+
+	const int NoDelay = 1;
+	setsockopt(Client.Socket, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+
+	if (connect(Client.Socket, Address, static_cast<socklen_t>(ServerAddress.size())) == 0)
+	{
+		++Worker.Results.Connected;
+		WatchSocket(Worker, Client, EPOLLIN, EPOLL_CTL_ADD);
+		return true;
+	}
+
+	if (errno != EINPROGRESS)
+	{
+		++Worker.Results.ConnectFailures;
+		Close(Worker, Client, false);
+		return false;
+	}
+
+	// Writable once connected, recorded messages are queued until then
+	Client.bIsConnecting = true;
+	WatchSocket(Worker, Client, EPOLLOUT, EPOLL_CTL_ADD);
+	return true;
+}
+
+void FCaptureReplay::OnReadable(FWorker& Worker, FReplayClient& Client, LoadTestTimePoint Now)
+{
+	if (Client.ReceiveBuffer.empty())
+	{
+		Client.ReceiveBuffer.resize(4096);
+	}
+
+	for (;;)
+	{
+		if (Client.ReceivedSize == Client.ReceiveBuffer.size())
+		{
+			Client.ReceiveBuffer.resize(Client.ReceiveBuffer.size() * 2);
+		}
+
+		const ssize_t BytesRead = recv(Client.Socket, &Client.ReceiveBuffer[Client.ReceivedSize], Client.ReceiveBuffer.size() - Client.ReceivedSize, 0);
+		if (BytesRead == 0 || (BytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		{
+			Close(Worker, Client, true);
+			return;
+		}
+		if (BytesRead < 0)
+		{
+			break;
+		}
+
+		Client.ReceivedSize += static_cast<size_t>(BytesRead);
+		Worker.Results.BytesReceived += static_cast<uint64_t>(BytesRead);
+
+		// Only message boundaries matter here, the contents are not looked at
+		size_t Position = 0;
+		while (Client.ReceivedSize - Position >= MessageHeaderSize)
+		{
+			uint32_t PayloadSize = 0;
+			memcpy(&PayloadSize, &Client.ReceiveBuffer[Position + sizeof(char)], sizeof(PayloadSize));
+			if (Client.ReceivedSize - Position < MessageHeaderSize + PayloadSize)
+			{
+				if (Client.ReceiveBuffer.size() < MessageHeaderSize + PayloadSize)
+				{
+					Client.ReceiveBuffer.resize(MessageHeaderSize + PayloadSize);
+				}
+				break;
+			}
+			Position += MessageHeaderSize + PayloadSize;
+
+			++Worker.Results.MessagesReceived;
+			Worker.Results.LastActivityTime = Now;
+			if (!Client.UnansweredSendTimes.empty())
+			{
+				Worker.Results.ResponseTimes.Add(Now - Client.UnansweredSendTimes.front());
+				Client.UnansweredSendTimes.pop_front();
+			}
+		}
+
+		if (Position > 0)
+		{
+			memmove(Client.ReceiveBuffer.data(), &Client.ReceiveBuffer[Position], Client.ReceivedSize - Position);
+			Client.ReceivedSize -= Position;
+		}
+	}
+}
+
+bool FCaptureReplay::FlushSendBuffer(FWorker& Worker, FReplayClient& Client)
+{
+	while (Client.SendOffset < Client.SendBuffer.size())
+	{
+		const ssize_t BytesWritten = send(Client.Socket, &Client.SendBuffer[Client.SendOffset], Client.SendBuffer.size() - Client.SendOffset, MSG_NOSIGNAL);
+		if (BytesWritten < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				Close(Worker, Client, true);
+				return false;
+			}
+
+			if (!Client.bWaitingForWritable)
+			{
+				WatchSocket(Worker, Client, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+				Client.bWaitingForWritable = true;
+			}
+			return true;
+		}
+		Client.SendOffset += static_cast<size_t>(BytesWritten);
+	}
+
+	Client.SendBuffer.clear();
+	Client.SendOffset = 0;
+
+	if (Client.bCloseWhenSent)
+	{
+		Close(Worker, Client, false);
+		return true;
+	}
+
+	if (Client.bWaitingForWritable)
+	{
+		WatchSocket(Worker, Client, EPOLLIN, EPOLL_CTL_MOD);
+		Client.bWaitingForWritable = false;
+	}
+	return true;
+}
+
+void FCaptureReplay::WatchSocket(FWorker& Worker, FReplayClient& Client, uint32_t Events, int Operation)
+{
+	epoll_event Event = {};
+	Event.events = Events;
+	Event.data.u64 = static_cast<uint64_t>(&Client - Worker.Clients.data());
+	epoll_ctl(Worker.EpollHandle, Operation, Client.Socket, &Event);
+}
+
+void FCaptureReplay::Close(FWorker& Worker, FReplayClient& Client, bool bDisconnected)
+{
+	if (Client.Socket >= 0)
+	{
+		epoll_ctl(Worker.EpollHandle, EPOLL_CTL_DEL, Client.Socket, nullptr);
+		close(Client.Socket);
+		Client.Socket = -1;
+	}
+
+	if (bDisconnected)
+	{
+		++Worker.Results.Disconnected;
+	}
+
+	Client.bIsClosed = true;
+	Client.bIsConnecting = false;
+	Client.bWaitingForWritable = false;
+	std::vector<char>().swap(Client.ReceiveBuffer);
+	std::vector<char>().swap(Client.SendBuffer);
+	Client.ReceivedSize = 0;
+	Client.SendOffset = 0;
+	Client.UnansweredSendTimes.clear();
+}
+
+void FCaptureReplay::LogResults() const
+{
+	auto PerSecond = [](uint64_t Count, double Seconds)
+	{
+		return Seconds > 0.0 ? Count / Seconds : 0.0;
+	};
+
+	const double CaptureSeconds = CaptureDurationNs / 1e9;
+	const double ReplaySeconds = std::chrono::duration<double>(Results.LastActivityTime - Results.FirstSendTime).count();
+
+	FDebugLog::Log(L"Capture: %u clients, %llu messages (%llu bytes) from clients, %llu messages (%llu bytes) to clients, %.3f s",
+		NumCapturedClients,
+		static_cast<unsigned long long>(NumCapturedIncoming),
+		static_cast<unsigned long long>(NumCapturedIncomingBytes),
+		static_cast<unsigned long long>(NumCapturedOutgoing),
+		static_cast<unsigned long long>(NumCapturedOutgoingBytes),
+		CaptureSeconds);
+
+	FDebugLog::Log(L"Connections: %llu established, %llu failed, %llu disconnected by the server",
+		static_cast<unsigned long long>(Results.Connected),
+		static_cast<unsigned long long>(Results.ConnectFailures),
+		static_cast<unsigned long long>(Results.Disconnected));
+
+	FDebugLog::Log(L"Messages: %llu sent, %llu received, %llu bytes sent, %llu bytes received",
+		static_cast<unsigned long long>(Results.MessagesSent),
+		static_cast<unsigned long long>(Results.MessagesReceived),
+		static_cast<unsigned long long>(Results.BytesSent),
+		static_cast<unsigned long long>(Results.BytesReceived));
+	FDebugLog::Log(L"Throughput: %.0f messages/s sent, %.0f messages/s received over %.3f s, recorded %.0f messages/s from clients",
+		PerSecond(Results.MessagesSent, ReplaySeconds),
+		PerSecond(Results.MessagesReceived, ReplaySeconds),
+		ReplaySeconds,
+		PerSecond(NumCapturedIncoming, CaptureSeconds));
+
+	Results.SendDelays.Log(L"Send delay");
+	Results.ResponseTimes.Log(L"Response time");
+}
@@ -0,0 +1,188 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "LatencyHistogram.h"
+
+#include <deque>
+
+/**
+ * Replays a transport capture recorded by the server (-capture, see FTransportCapture in the server sample) against a
+ * server, so transport changes can be measured with the same traffic every time.
+ *
+ * Every client of the capture gets its own connection, opened at the time of its first message. Its recorded incoming
+ * messages are sent at their original times divided by the speed factor, and it disconnects where the capture has
+ * its disconnect. The capture file is memory mapped, so captures larger than memory replay without being read in
+ * first.
+ *
+ * The time from sending a message to the next message received on that connection is reported as response time.
+ * Against a server linked with EosSdkStub.cpp, which echoes every message, this is the round trip time. Recorded
+ * Connect ID tokens may have expired by the time of the replay, a server with the real SDK will then reject the
+ * clients. Linux only.
+ */
+class FCaptureReplay
+{
+public:
+	struct FConfig
+	{
+		std::string Host = "127.0.0.1";
+		uint16_t Port = 1234;
+
+		uint32_t NumThreads = 4;
+
+		std::string CaptureFilePath;
+
+		/**
+		 * Replay at this multiple of the recorded speed. At high speeds clients may send messages before the server
+		 * finished registering them, which the server drops, so responses go missing.
+		 */
+		uint32_t Speed = 1;
+
+		/** How long to wait for outstanding responses after the last message was sent */
+		std::chrono::milliseconds DrainTimeout{ 2000 };
+	};
+
+	struct FResults
+	{
+		uint64_t Connected = 0;
+		uint64_t ConnectFailures = 0;
+
+		/** Connections the server closed before the capture did */
+		uint64_t Disconnected = 0;
+
+		uint64_t MessagesSent = 0;
+		uint64_t MessagesReceived = 0;
+		uint64_t BytesSent = 0;
+		uint64_t BytesReceived = 0;
+
+		/** First message sent, and last message sent or received */
+		LoadTestTimePoint FirstSendTime;
+		LoadTestTimePoint LastActivityTime;
+
+		/** How much later than scheduled each message was sent, grows when the replay cannot keep up */
+		FLatencyHistogram SendDelays;
+
+		/** From sending a message to the next message received on the same connection */
+		FLatencyHistogram ResponseTimes;
+
+		void Merge(const FResults& Other);
+	};
+
+	explicit FCaptureReplay(const FConfig& InConfig);
+	~FCaptureReplay();
+
+	/** Maps and indexes the capture, then replays it on NumThreads threads. Returns false if it could not start. */
+	bool Run();
+
+	/** Logs what the capture holds next to what the replay achieved */
+	void LogResults() const;
+
+private:
+	/** Same layout as FTransportCapture::FFileHeader and FRecordHeader in the server sample */
+	struct FFileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+	};
+
+	struct FRecordHeader
+	{
+		uint64_t TimeNs;
+		uint64_t ClientHandle;
+		uint32_t Size;
+		uint8_t Type;
+		uint8_t Reserved[3];
+	};
+
+	static constexpr uint32_t FileMagic = 0x43544341;
+	static constexpr uint32_t FileVersion = 1;
+
+	enum class ERecordType : uint8_t
+	{
+		Incoming = 1,
+		Outgoing = 2,
+		Disconnected = 3
+	};
+
+	/** A record to replay: a message to send or a disconnect */
+	struct FReplayStep
+	{
+		uint64_t TimeNs = 0;
+		uint32_t ClientIndex = 0;
+		uint32_t Size = 0;
+
+		/** Offset of the message in the mapped file, 0 for a disconnect */
+		size_t DataOffset = 0;
+	};
+
+	struct FReplayClient
+	{
+		int Socket = -1;
+		bool bIsConnecting = false;
+		bool bIsClosed = false;
+
+		/** Set when the capture disconnects the client while it still has bytes to send */
+		bool bCloseWhenSent = false;
+
+		/** Bytes the socket did not accept yet */
+		std::vector<char> SendBuffer;
+		size_t SendOffset = 0;
+		bool bWaitingForWritable = false;
+
+		/** Received bytes not yet parsed into messages */
+		std::vector<char> ReceiveBuffer;
+		size_t ReceivedSize = 0;
+
+		/** Send times of the messages that did not get a response yet, oldest first */
+		std::deque<LoadTestTimePoint> UnansweredSendTimes;
+	};
+
+	/** Per thread state, only touched by its thread until the thread has finished */
+	struct FWorker
+	{
+		int EpollHandle = -1;
+
+		/** The steps of clients ThreadIndex, ThreadIndex + NumThreads and so on, in capture order */
+		std::vector<FReplayStep> Steps;
+
+		/** Clients by capture client index divided by NumThreads */
+		std::vector<FReplayClient> Clients;
+
+		FResults Results;
+	};
+
+	bool MapCapture();
+	bool IndexCapture(std::vector<FWorker>& Workers);
+
+	void RunWorker(FWorker& Worker);
+	/** Sends the step's message or disconnects. Returns true if a message was sent. */
+	bool ReplayStep(FWorker& Worker, const FReplayStep& Step, LoadTestTimePoint ScheduledTime, LoadTestTimePoint Now);
+	bool Connect(FWorker& Worker, FReplayClient& Client);
+	void OnReadable(FWorker& Worker, FReplayClient& Client, LoadTestTimePoint Now);
+	bool FlushSendBuffer(FWorker& Worker, FReplayClient& Client);
+	void WatchSocket(FWorker& Worker, FReplayClient& Client, uint32_t Events, int Operation);
+	void Close(FWorker& Worker, FReplayClient& Client, bool bDisconnected);
+
+	/** Most steps replayed in a row, so a burst of steps does not hold up the socket I/O of the thread */
+	static constexpr size_t MaxStepsPerIteration = 1024;
+
+	FConfig Config;
+
+	/** Resolved server address, a sockaddr of the size of the vector */
+	std::vector<char> ServerAddress;
+
+	const char* CaptureData = nullptr;
+	size_t CaptureSize = 0;
+
+	/** What the capture holds */
+	uint32_t NumCapturedClients = 0;
+	uint64_t NumCapturedIncoming = 0;
+	uint64_t NumCapturedOutgoing = 0;
+	uint64_t NumCapturedIncomingBytes = 0;
+	uint64_t NumCapturedOutgoingBytes = 0;
+	uint64_t CaptureDurationNs = 0;
+
+	LoadTestTimePoint StartTime;
+
+	FResults Results;
+};
@@ -0,0 +1,146 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+/**
+ * Local stand-in for the EOS P2P functions used by FAntiCheatPeerTransport, for the peer loopback harness. Any number
+ * of local users can talk to each other: EOS_P2P_SendPacket appends the packet to the remote user's inbox and
+ * EOS_P2P_ReceivePacket takes it out again, in order and without loss, as with reliable ordered packets. Connections
+ * always count as accepted, so connection requests and closed connections are never notified.
+ *
+ * All functions must be called from the same thread.
+ */
+
+#include "pch.h"
+
+#include <eos_sdk.h>
+#include <eos_p2p.h>
+
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+	class FStubP2P
+	{
+	public:
+		struct FPacket
+		{
+			EOS_ProductUserId From = nullptr;
+			EOS_P2P_SocketId SocketId = {};
+			uint8_t Channel = 0;
+			std::vector<char> Data;
+		};
+
+		static FStubP2P& Get()
+		{
+			static FStubP2P Instance;
+			return Instance;
+		}
+
+		EOS_ProductUserId ProductUserIdFromString(const char* ProductUserIdString)
+		{
+			// Interned, so the same string always maps to the same id and ids stay valid until shutdown
+			const std::string& Interned = *ProductUserIds.emplace(ProductUserIdString).first;
+			return reinterpret_cast<EOS_ProductUserId>(const_cast<char*>(Interned.c_str()));
+		}
+
+		std::deque<FPacket>& GetInbox(EOS_ProductUserId UserId)
+		{
+			return Inboxes[UserId];
+		}
+
+	private:
+		std::unordered_set<std::string> ProductUserIds;
+		std::unordered_map<EOS_ProductUserId, std::deque<FPacket>> Inboxes;
+	};
+}
+
+EOS_DECLARE_FUNC(const char*) EOS_EResult_ToString(EOS_EResult Result)
+{
+	switch (Result)
+	{
+		case EOS_EResult::EOS_Success: return "EOS_Success";
+		case EOS_EResult::EOS_NotFound: return "EOS_NotFound";
+		case EOS_EResult::EOS_InvalidParameters: return "EOS_InvalidParameters";
+		case EOS_EResult::EOS_LimitExceeded: return "EOS_LimitExceeded";
+		default: return "EOS_UnexpectedError";
+	}
+}
+
+EOS_DECLARE_FUNC(EOS_ProductUserId) EOS_ProductUserId_FromString(const char* ProductUserIdString)
+{
+	return FStubP2P::Get().ProductUserIdFromString(ProductUserIdString);
+}
+
+EOS_DECLARE_FUNC(EOS_NotificationId) EOS_P2P_AddNotifyPeerConnectionRequest(EOS_HP2P /*Handle*/, const EOS_P2P_AddNotifyPeerConnectionRequestOptions* /*Options*/, void* /*ClientData*/, EOS_P2P_OnIncomingConnectionRequestCallback /*ConnectionRequestHandler*/)
+{
+	return 1;
+}
+
+EOS_DECLARE_FUNC(void) EOS_P2P_RemoveNotifyPeerConnectionRequest(EOS_HP2P /*Handle*/, EOS_NotificationId /*NotificationId*/)
+{
+}
+
+EOS_DECLARE_FUNC(EOS_NotificationId) EOS_P2P_AddNotifyPeerConnectionClosed(EOS_HP2P /*Handle*/, const EOS_P2P_AddNotifyPeerConnectionClosedOptions* /*Options*/, void* /*ClientData*/, EOS_P2P_OnRemoteConnectionClosedCallback /*ConnectionClosedHandler*/)
+{
+	return 2;
+}
+
+EOS_DECLARE_FUNC(void) EOS_P2P_RemoveNotifyPeerConnectionClosed(EOS_HP2P /*Handle*/, EOS_NotificationId /*NotificationId*/)
+{
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_P2P_AcceptConnection(EOS_HP2P /*Handle*/, const EOS_P2P_AcceptConnectionOptions* /*Options*/)
+{
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_P2P_CloseConnection(EOS_HP2P /*Handle*/, const EOS_P2P_CloseConnectionOptions* /*Options*/)
+{
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_P2P_SendPacket(EOS_HP2P /*Handle*/, const EOS_P2P_SendPacketOptions* Options)
+{
+	if (!Options || !Options->SocketId || !Options->Data || Options->DataLengthBytes > EOS_P2P_MAX_PACKET_SIZE)
+	{
+		return EOS_EResult::EOS_InvalidParameters;
+	}
+
+	FStubP2P::FPacket Packet;
+	Packet.From = Options->LocalUserId;
+	Packet.SocketId = *Options->SocketId;
+	Packet.Channel = Options->Channel;
+
+	const char* Bytes = static_cast<const char*>(Options->Data);
+	Packet.Data.assign(Bytes, Bytes + Options->DataLengthBytes);
+
+	FStubP2P::Get().GetInbox(Options->RemoteUserId).push_back(std::move(Packet));
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_P2P_ReceivePacket(EOS_HP2P /*Handle*/, const EOS_P2P_ReceivePacketOptions* Options, EOS_ProductUserId* OutPeerId, EOS_P2P_SocketId* OutSocketId, uint8_t* OutChannel, void* OutData, uint32_t* OutBytesWritten)
+{
+	std::deque<FStubP2P::FPacket>& Inbox = FStubP2P::Get().GetInbox(Options->LocalUserId);
+
+	auto PacketIt = Inbox.begin();
+	if (Options->RequestedChannel)
+	{
+		PacketIt = std::find_if(Inbox.begin(), Inbox.end(), [Options](const FStubP2P::FPacket& Packet) { return Packet.Channel == *Options->RequestedChannel; });
+	}
+	if (PacketIt == Inbox.end())
+	{
+		return EOS_EResult::EOS_NotFound;
+	}
+
+	const uint32_t BytesWritten = std::min(static_cast<uint32_t>(PacketIt->Data.size()), Options->MaxDataSizeBytes);
+	memcpy(OutData, PacketIt->Data.data(), BytesWritten);
+	*OutBytesWritten = BytesWritten;
+	*OutPeerId = PacketIt->From;
+	*OutSocketId = PacketIt->SocketId;
+	*OutChannel = PacketIt->Channel;
+
+	Inbox.erase(PacketIt);
+	return EOS_EResult::EOS_Success;
+}
@@ -0,0 +1,421 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+/**
+ * Local stand-in for the parts of the EOS SDK used by the anti-cheat server sample, for load testing the server
+ * without the SDK or any backend. Build the server sources with this file instead of linking the EOS SDK library
+ * (on Windows also define EOS_MONOLITHIC=1, so the SDK functions are not declared dllimport) and drive it with the
+ * load generator in this directory.
+ *
+ * - EOS_Connect_VerifyIdToken accepts every token as a Windows account after SimulatedVerifyIdTokenLatency.
+ * - EOS_AntiCheatServer_RegisterClient answers with a short message to the client, which tells the load generator the
+ *   client is registered.
+ * - Every message a registered client sends with EOS_AntiCheatServer_ReceiveMessageFromClient is sent back to it
+ *   unchanged on the next EOS_Platform_Tick, so the load generator can measure round trips through the server.
+ * - ProtectMessage appends ProtectMessageOverhead bytes, UnprotectMessage strips them.
+ *
+ * All functions must be called from the same thread, as with the server sample.
+ */
+
+#include "pch.h"
+
+#include "DebugLog.h"
+
+#include <eos_sdk.h>
+#include <eos_logging.h>
+#include <eos_connect.h>
+#include <eos_anticheatserver.h>
+
+#include <cstring>
+#include <unordered_set>
+
+namespace
+{
+	/** Time a token verification takes, the real one is a request to the EOS backend */
+	constexpr std::chrono::milliseconds SimulatedVerifyIdTokenLatency(50);
+
+	/** Extra bytes added by ProtectMessage, in the range of an authenticated cipher's IV and tag */
+	constexpr uint32_t ProtectMessageOverhead = 28;
+
+	/** Message sent to every client on registration, shorter than any message the load generator sends */
+	constexpr char RegisteredMessage[] = "ACS";
+
+	class FStubSdk
+	{
+	public:
+		struct FCounters
+		{
+			uint64_t VerifiedIdTokens = 0;
+			uint64_t RegisteredClients = 0;
+			uint64_t ReceivedMessages = 0;
+			uint64_t ReceivedBytes = 0;
+			uint64_t RejectedMessages = 0;
+			uint64_t GameplayEvents = 0;
+		};
+
+		static FStubSdk& Get()
+		{
+			static FStubSdk Instance;
+			return Instance;
+		}
+
+		EOS_ProductUserId ProductUserIdFromString(const char* ProductUserIdString)
+		{
+			// Interned, so the same string always maps to the same id and ids stay valid until shutdown
+			const std::string& Interned = *ProductUserIds.emplace(ProductUserIdString).first;
+			return reinterpret_cast<EOS_ProductUserId>(const_cast<char*>(Interned.c_str()));
+		}
+
+		void VerifyIdToken(EOS_ProductUserId ProductUserId, void* ClientData, EOS_Connect_OnVerifyIdTokenCallback Callback)
+		{
+			FPendingVerification Verification;
+			Verification.CompletionTime = std::chrono::steady_clock::now() + SimulatedVerifyIdTokenLatency;
+			Verification.ProductUserId = ProductUserId;
+			Verification.ClientData = ClientData;
+			Verification.Callback = Callback;
+			PendingVerifications.push_back(Verification);
+		}
+
+		void SetMessageToClientCallback(void* ClientData, EOS_AntiCheatServer_OnMessageToClientCallback Callback)
+		{
+			MessageToClientClientData = ClientData;
+			MessageToClientCallback = Callback;
+		}
+
+		void RegisterClient(void* ClientHandle)
+		{
+			if (RegisteredClients.insert(ClientHandle).second)
+			{
+				++Counters.RegisteredClients;
+				QueueMessageToClient(ClientHandle, RegisteredMessage, sizeof(RegisteredMessage));
+			}
+		}
+
+		void UnregisterClient(void* ClientHandle)
+		{
+			RegisteredClients.erase(ClientHandle);
+		}
+
+		void UnregisterAllClients()
+		{
+			RegisteredClients.clear();
+		}
+
+		bool ReceiveMessageFromClient(void* ClientHandle, const void* Data, uint32_t DataLengthBytes)
+		{
+			if (RegisteredClients.count(ClientHandle) == 0)
+			{
+				++Counters.RejectedMessages;
+				return false;
+			}
+
+			++Counters.ReceivedMessages;
+			Counters.ReceivedBytes += DataLengthBytes;
+			QueueMessageToClient(ClientHandle, Data, DataLengthBytes);
+			return true;
+		}
+
+		void CountGameplayEvent()
+		{
+			++Counters.GameplayEvents;
+		}
+
+		void Tick()
+		{
+			const std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+
+			// Verifications are queued in completion order, all with the same latency
+			size_t NumCompleted = 0;
+			while (NumCompleted < PendingVerifications.size() && PendingVerifications[NumCompleted].CompletionTime <= Now)
+			{
+				// Copied, a callback could queue another verification
+				const FPendingVerification Verification = PendingVerifications[NumCompleted++];
+
+				EOS_Connect_VerifyIdTokenCallbackInfo Info = {};
+				Info.ResultCode = EOS_EResult::EOS_Success;
+				Info.ClientData = Verification.ClientData;
+				Info.ProductUserId = Verification.ProductUserId;
+				Info.bIsAccountInfoPresent = EOS_TRUE;
+				Info.AccountIdType = EOS_EExternalAccountType::EOS_EAT_EPIC;
+				Info.AccountId = "";
+				Info.Platform = "Other";
+				Info.DeviceType = "Windows";
+				Info.ClientId = "";
+				Info.ProductId = "";
+				Info.SandboxId = "";
+				Info.DeploymentId = "";
+
+				++Counters.VerifiedIdTokens;
+				Verification.Callback(&Info);
+			}
+			PendingVerifications.erase(PendingVerifications.begin(), PendingVerifications.begin() + NumCompleted);
+
+			// Swapped out first, the callbacks may queue new messages
+			std::swap(PendingMessages, DeliveredMessages);
+			std::swap(PendingMessageData, DeliveredMessageData);
+			for (const FPendingMessage& Message : DeliveredMessages)
+			{
+				// Clients unregistered since the message was queued do not get it
+				if (MessageToClientCallback && RegisteredClients.count(Message.ClientHandle) != 0)
+				{
+					EOS_AntiCheatCommon_OnMessageToClientCallbackInfo Info = {};
+					Info.ClientData = MessageToClientClientData;
+					Info.ClientHandle = Message.ClientHandle;
+					Info.MessageData = &DeliveredMessageData[Message.Offset];
+					Info.MessageDataSizeBytes = Message.Size;
+					MessageToClientCallback(&Info);
+				}
+			}
+			DeliveredMessages.clear();
+			DeliveredMessageData.clear();
+		}
+
+		void LogCounters() const
+		{
+			FDebugLog::Log(L"[EOS SDK stub] %llu tokens verified, %llu clients registered, %llu messages (%llu bytes) echoed, %llu rejected, %llu gameplay events",
+				static_cast<unsigned long long>(Counters.VerifiedIdTokens),
+				static_cast<unsigned long long>(Counters.RegisteredClients),
+				static_cast<unsigned long long>(Counters.ReceivedMessages),
+				static_cast<unsigned long long>(Counters.ReceivedBytes),
+				static_cast<unsigned long long>(Counters.RejectedMessages),
+				static_cast<unsigned long long>(Counters.GameplayEvents));
+		}
+
+	private:
+		struct FPendingVerification
+		{
+			std::chrono::steady_clock::time_point CompletionTime;
+			EOS_ProductUserId ProductUserId = nullptr;
+			void* ClientData = nullptr;
+			EOS_Connect_OnVerifyIdTokenCallback Callback = nullptr;
+		};
+
+		/** A message waiting for the next tick, its data is stored in PendingMessageData */
+		struct FPendingMessage
+		{
+			void* ClientHandle = nullptr;
+			size_t Offset = 0;
+			uint32_t Size = 0;
+		};
+
+		void QueueMessageToClient(void* ClientHandle, const void* Data, uint32_t DataLengthBytes)
+		{
+			FPendingMessage Message;
+			Message.ClientHandle = ClientHandle;
+			Message.Offset = PendingMessageData.size();
+			Message.Size = DataLengthBytes;
+			PendingMessages.push_back(Message);
+
+			const char* Bytes = static_cast<const char*>(Data);
+			PendingMessageData.insert(PendingMessageData.end(), Bytes, Bytes + DataLengthBytes);
+		}
+
+		std::unordered_set<std::string> ProductUserIds;
+		std::unordered_set<void*> RegisteredClients;
+
+		std::vector<FPendingVerification> PendingVerifications;
+
+		/** Messages to clients queued since the last tick, all data in one buffer, kept allocated between ticks */
+		std::vector<FPendingMessage> PendingMessages;
+		std::vector<char> PendingMessageData;
+		std::vector<FPendingMessage> DeliveredMessages;
+		std::vector<char> DeliveredMessageData;
+
+		void* MessageToClientClientData = nullptr;
+		EOS_AntiCheatServer_OnMessageToClientCallback MessageToClientCallback = nullptr;
+
+		FCounters Counters;
+	};
+
+	/** Notification ids handed out by the stub, there is only ever one of each */
+	constexpr EOS_NotificationId MessageToClientNotificationId = 1;
+	constexpr EOS_NotificationId ClientActionRequiredNotificationId = 2;
+
+	/** Every interface handle points at the same stub */
+	template<typename HandleType>
+	HandleType GetStubHandle()
+	{
+		return reinterpret_cast<HandleType>(&FStubSdk::Get());
+	}
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_Initialize(const EOS_InitializeOptions* /*Options*/)
+{
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_Shutdown()
+{
+	FStubSdk::Get().LogCounters();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_Logging_SetCallback(EOS_LogMessageFunc /*Callback*/)
+{
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_Logging_SetLogLevel(EOS_ELogCategory /*LogCategory*/, EOS_ELogLevel /*LogLevel*/)
+{
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_HPlatform) EOS_Platform_Create(const EOS_Platform_Options* /*Options*/)
+{
+	FDebugLog::LogWarning(L"[EOS SDK stub] Using the local EOS SDK stub, for load testing only");
+	return GetStubHandle<EOS_HPlatform>();
+}
+
+EOS_DECLARE_FUNC(void) EOS_Platform_Release(EOS_HPlatform /*Handle*/)
+{
+}
+
+EOS_DECLARE_FUNC(void) EOS_Platform_Tick(EOS_HPlatform /*Handle*/)
+{
+	FStubSdk::Get().Tick();
+}
+
+EOS_DECLARE_FUNC(EOS_HConnect) EOS_Platform_GetConnectInterface(EOS_HPlatform /*Handle*/)
+{
+	return GetStubHandle<EOS_HConnect>();
+}
+
+EOS_DECLARE_FUNC(EOS_HAntiCheatServer) EOS_Platform_GetAntiCheatServerInterface(EOS_HPlatform /*Handle*/)
+{
+	return GetStubHandle<EOS_HAntiCheatServer>();
+}
+
+EOS_DECLARE_FUNC(EOS_ProductUserId) EOS_ProductUserId_FromString(const char* ProductUserIdString)
+{
+	return ProductUserIdString ? FStubSdk::Get().ProductUserIdFromString(ProductUserIdString) : nullptr;
+}
+
+EOS_DECLARE_FUNC(void) EOS_Connect_VerifyIdToken(EOS_HConnect /*Handle*/, const EOS_Connect_VerifyIdTokenOptions* Options, void* ClientData, const EOS_Connect_OnVerifyIdTokenCallback CompletionDelegate)
+{
+	FStubSdk::Get().VerifyIdToken(Options->IdToken->ProductUserId, ClientData, CompletionDelegate);
+}
+
+EOS_DECLARE_FUNC(EOS_NotificationId) EOS_AntiCheatServer_AddNotifyMessageToClient(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_AddNotifyMessageToClientOptions* /*Options*/, void* ClientData, EOS_AntiCheatServer_OnMessageToClientCallback NotificationFn)
+{
+	FStubSdk::Get().SetMessageToClientCallback(ClientData, NotificationFn);
+	return MessageToClientNotificationId;
+}
+
+EOS_DECLARE_FUNC(void) EOS_AntiCheatServer_RemoveNotifyMessageToClient(EOS_HAntiCheatServer /*Handle*/, EOS_NotificationId NotificationId)
+{
+	if (NotificationId == MessageToClientNotificationId)
+	{
+		FStubSdk::Get().SetMessageToClientCallback(nullptr, nullptr);
+	}
+}
+
+EOS_DECLARE_FUNC(EOS_NotificationId) EOS_AntiCheatServer_AddNotifyClientActionRequired(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_AddNotifyClientActionRequiredOptions* /*Options*/, void* /*ClientData*/, EOS_AntiCheatServer_OnClientActionRequiredCallback /*NotificationFn*/)
+{
+	// The stub never asks for a client to be removed
+	return ClientActionRequiredNotificationId;
+}
+
+EOS_DECLARE_FUNC(void) EOS_AntiCheatServer_RemoveNotifyClientActionRequired(EOS_HAntiCheatServer /*Handle*/, EOS_NotificationId /*NotificationId*/)
+{
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_BeginSession(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_BeginSessionOptions* /*Options*/)
+{
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_EndSession(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_EndSessionOptions* /*Options*/)
+{
+	FStubSdk::Get().UnregisterAllClients();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_RegisterClient(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_RegisterClientOptions* Options)
+{
+	FStubSdk::Get().RegisterClient(Options->ClientHandle);
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_UnregisterClient(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_UnregisterClientOptions* Options)
+{
+	FStubSdk::Get().UnregisterClient(Options->ClientHandle);
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_ReceiveMessageFromClient(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_ReceiveMessageFromClientOptions* Options)
+{
+	return FStubSdk::Get().ReceiveMessageFromClient(Options->ClientHandle, Options->Data, Options->DataLengthBytes) ? EOS_EResult::EOS_Success : EOS_EResult::EOS_NotFound;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_GetProtectMessageOutputLength(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_GetProtectMessageOutputLengthOptions* Options, uint32_t* OutBufferSizeBytes)
+{
+	*OutBufferSizeBytes = Options->DataLengthBytes + ProtectMessageOverhead;
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_ProtectMessage(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_ProtectMessageOptions* Options, void* OutBuffer, uint32_t* OutBytesWritten)
+{
+	if (Options->OutBufferSizeBytes < Options->DataLengthBytes + ProtectMessageOverhead)
+	{
+		return EOS_EResult::EOS_LimitExceeded;
+	}
+
+	// The input may be OutBuffer itself
+	memmove(OutBuffer, Options->Data, Options->DataLengthBytes);
+	memset(static_cast<char*>(OutBuffer) + Options->DataLengthBytes, 0, ProtectMessageOverhead);
+	*OutBytesWritten = Options->DataLengthBytes + ProtectMessageOverhead;
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_UnprotectMessage(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatServer_UnprotectMessageOptions* Options, void* OutBuffer, uint32_t* OutBytesWritten)
+{
+	if (Options->DataLengthBytes < ProtectMessageOverhead || Options->OutBufferSizeBytes < Options->DataLengthBytes - ProtectMessageOverhead)
+	{
+		return EOS_EResult::EOS_InvalidParameters;
+	}
+
+	*OutBytesWritten = Options->DataLengthBytes - ProtectMessageOverhead;
+	memmove(OutBuffer, Options->Data, *OutBytesWritten);
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_LogPlayerSpawn(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatCommon_LogPlayerSpawnOptions* /*Options*/)
+{
+	FStubSdk::Get().CountGameplayEvent();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_LogPlayerDespawn(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatCommon_LogPlayerDespawnOptions* /*Options*/)
+{
+	FStubSdk::Get().CountGameplayEvent();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_LogPlayerRevive(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatCommon_LogPlayerReviveOptions* /*Options*/)
+{
+	FStubSdk::Get().CountGameplayEvent();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_LogPlayerTick(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatCommon_LogPlayerTickOptions* /*Options*/)
+{
+	FStubSdk::Get().CountGameplayEvent();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_LogPlayerUseWeapon(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatCommon_LogPlayerUseWeaponOptions* /*Options*/)
+{
+	FStubSdk::Get().CountGameplayEvent();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_LogPlayerUseAbility(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatCommon_LogPlayerUseAbilityOptions* /*Options*/)
+{
+	FStubSdk::Get().CountGameplayEvent();
+	return EOS_EResult::EOS_Success;
+}
+
+EOS_DECLARE_FUNC(EOS_EResult) EOS_AntiCheatServer_LogPlayerTakeDamage(EOS_HAntiCheatServer /*Handle*/, const EOS_AntiCheatCommon_LogPlayerTakeDamageOptions* /*Options*/)
+{
+	FStubSdk::Get().CountGameplayEvent();
+	return EOS_EResult::EOS_Success;
+}
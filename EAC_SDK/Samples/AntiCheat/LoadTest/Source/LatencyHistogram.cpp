@@ -0,0 +1,96 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "LatencyHistogram.h"
+#include "DebugLog.h"
+
+size_t FLatencyHistogram::GetBucket(uint64_t Microseconds)
+{
+	if (Microseconds < NumSubBuckets)
+	{
+		return static_cast<size_t>(Microseconds);
+	}
+
+	uint32_t HighestBit = 0;
+	while ((Microseconds >> (HighestBit + 1)) != 0)
+	{
+		++HighestBit;
+	}
+
+	// Range 2^HighestBit to 2^(HighestBit+1)-1, split by the bits right below the highest one
+	const uint32_t Shift = HighestBit - SubBucketBits;
+	return (Shift + 1) * NumSubBuckets + static_cast<size_t>((Microseconds >> Shift) & (NumSubBuckets - 1));
+}
+
+uint64_t FLatencyHistogram::GetBucketUpperBound(size_t Bucket)
+{
+	if (Bucket < NumSubBuckets)
+	{
+		return Bucket;
+	}
+
+	const uint32_t Shift = static_cast<uint32_t>(Bucket / NumSubBuckets) - 1;
+	const uint64_t LowerBound = (NumSubBuckets + Bucket % NumSubBuckets) << Shift;
+	return LowerBound + (uint64_t(1) << Shift) - 1;
+}
+
+void FLatencyHistogram::Add(std::chrono::steady_clock::duration Duration)
+{
+	const uint64_t Microseconds = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(Duration).count()));
+
+	++Buckets[GetBucket(Microseconds)];
+	++Count;
+	TotalMicroseconds += Microseconds;
+	MaxMicroseconds = std::max(MaxMicroseconds, Microseconds);
+}
+
+void FLatencyHistogram::Merge(const FLatencyHistogram& Other)
+{
+	for (size_t Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		Buckets[Bucket] += Other.Buckets[Bucket];
+	}
+	Count += Other.Count;
+	TotalMicroseconds += Other.TotalMicroseconds;
+	MaxMicroseconds = std::max(MaxMicroseconds, Other.MaxMicroseconds);
+}
+
+std::chrono::microseconds FLatencyHistogram::GetPercentile(double Percentile) const
+{
+	if (Count == 0)
+	{
+		return std::chrono::microseconds(0);
+	}
+
+	const uint64_t Rank = std::max<uint64_t>(1, static_cast<uint64_t>(Count * Percentile / 100.0 + 0.5));
+	uint64_t NumSamples = 0;
+	for (size_t Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		NumSamples += Buckets[Bucket];
+		if (NumSamples >= Rank)
+		{
+			return std::chrono::microseconds(std::min(GetBucketUpperBound(Bucket), MaxMicroseconds));
+		}
+	}
+	return std::chrono::microseconds(MaxMicroseconds);
+}
+
+void FLatencyHistogram::Log(const wchar_t* Name) const
+{
+	if (Count == 0)
+	{
+		FDebugLog::Log(L"%ls: no samples", Name);
+		return;
+	}
+
+	auto Milliseconds = [](std::chrono::microseconds Duration) { return Duration.count() / 1000.0; };
+
+	FDebugLog::Log(L"%ls: %llu samples, avg %.3f ms, p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms",
+		Name,
+		static_cast<unsigned long long>(Count),
+		Milliseconds(GetAverage()),
+		Milliseconds(GetPercentile(50.0)),
+		Milliseconds(GetPercentile(99.0)),
+		Milliseconds(GetPercentile(99.9)),
+		Milliseconds(GetMax()));
+}
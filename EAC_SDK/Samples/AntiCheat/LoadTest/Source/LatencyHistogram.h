@@ -0,0 +1,41 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+/**
+ * Histogram of durations in microseconds, fine enough for tail percentiles: every power of two range is split into
+ * NumSubBuckets linear buckets, so a percentile is accurate to within about 6%.
+ */
+class FLatencyHistogram
+{
+public:
+	static constexpr uint32_t SubBucketBits = 4;
+	static constexpr uint32_t NumSubBuckets = 1u << SubBucketBits;
+
+	/** Enough buckets for any 64 bit microsecond count */
+	static constexpr size_t NumBuckets = (64 - SubBucketBits + 1) * NumSubBuckets;
+
+	void Add(std::chrono::steady_clock::duration Duration);
+
+	/** Adds all samples of another histogram, e.g. to sum up the histograms of several threads */
+	void Merge(const FLatencyHistogram& Other);
+
+	uint64_t GetCount() const { return Count; }
+	std::chrono::microseconds GetMax() const { return std::chrono::microseconds(MaxMicroseconds); }
+	std::chrono::microseconds GetAverage() const { return std::chrono::microseconds(Count > 0 ? TotalMicroseconds / Count : 0); }
+
+	/** Upper bound of the bucket that holds the given percentile (0 - 100), never more than the largest sample */
+	std::chrono::microseconds GetPercentile(double Percentile) const;
+
+	/** Logs count, average, p50, p99, p99.9 and maximum in milliseconds under the given name */
+	void Log(const wchar_t* Name) const;
+
+private:
+	static size_t GetBucket(uint64_t Microseconds);
+	static uint64_t GetBucketUpperBound(size_t Bucket);
+
+	uint64_t Buckets[NumBuckets] = {};
+	uint64_t Count = 0;
+	uint64_t TotalMicroseconds = 0;
+	uint64_t MaxMicroseconds = 0;
+};
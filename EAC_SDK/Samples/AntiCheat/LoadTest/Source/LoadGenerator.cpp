@@ -0,0 +1,673 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "LoadGenerator.h"
+#include "DebugLog.h"
+#include "StringUtils.h"
+
+#include "eos_anticheatcommon_types.h"
+
+#include <cerrno>
+#include <cstring>
+#include <queue>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+	int64_t ToNanoseconds(LoadTestTimePoint Time)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Time.time_since_epoch()).count();
+	}
+
+	std::string EncodeBase64Url(const std::string& Data)
+	{
+		static const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+		std::string Encoded;
+		uint32_t Bits = 0;
+		int NumBits = 0;
+		for (const char Char : Data)
+		{
+			Bits = (Bits << 8) | static_cast<unsigned char>(Char);
+			NumBits += 8;
+			while (NumBits >= 6)
+			{
+				NumBits -= 6;
+				Encoded.push_back(Alphabet[(Bits >> NumBits) & 0x3F]);
+			}
+		}
+		if (NumBits > 0)
+		{
+			Encoded.push_back(Alphabet[(Bits << (6 - NumBits)) & 0x3F]);
+		}
+		return Encoded;
+	}
+
+	/** Lets a single process hold thousands of connections, as far as the hard limit allows */
+	void RaiseOpenFileLimit(uint32_t NumClients)
+	{
+		rlimit Limit = {};
+		if (getrlimit(RLIMIT_NOFILE, &Limit) == 0 && Limit.rlim_cur < Limit.rlim_max)
+		{
+			Limit.rlim_cur = Limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &Limit);
+			getrlimit(RLIMIT_NOFILE, &Limit);
+		}
+
+		if (Limit.rlim_cur != RLIM_INFINITY && Limit.rlim_cur < NumClients + 64)
+		{
+			FDebugLog::LogWarning(L"LoadGenerator: Open file limit is %llu, not all %u clients will be able to connect",
+				static_cast<unsigned long long>(Limit.rlim_cur), NumClients);
+		}
+	}
+}
+
+void FLoadGenerator::FResults::Merge(const FResults& Other)
+{
+	ConnectAttempts += Other.ConnectAttempts;
+	Connected += Other.Connected;
+	ConnectFailures += Other.ConnectFailures;
+	Registered += Other.Registered;
+	Disconnected += Other.Disconnected;
+	ClientActions += Other.ClientActions;
+	MessagesSent += Other.MessagesSent;
+	MessagesReceived += Other.MessagesReceived;
+	BytesSent += Other.BytesSent;
+	BytesReceived += Other.BytesReceived;
+	CorruptMessages += Other.CorruptMessages;
+	SteadyMessagesSent += Other.SteadyMessagesSent;
+	SteadyMessagesReceived += Other.SteadyMessagesReceived;
+	SteadyDuration = std::max(SteadyDuration, Other.SteadyDuration);
+	ConnectDuration = std::max(ConnectDuration, Other.ConnectDuration);
+	ConnectTimes.Merge(Other.ConnectTimes);
+	RegistrationTimes.Merge(Other.RegistrationTimes);
+	RoundTripTimes.Merge(Other.RoundTripTimes);
+}
+
+FLoadGenerator::FLoadGenerator(const FConfig& InConfig)
+	: Config(InConfig)
+{
+	Config.NumThreads = std::max(1u, std::min(Config.NumThreads, std::max(1u, Config.NumClients)));
+	Config.ConnectionsPerSecond = std::max(1u, Config.ConnectionsPerSecond);
+	Config.MessageSize = std::max<uint32_t>(Config.MessageSize, sizeof(FProbeHeader));
+}
+
+bool FLoadGenerator::Run()
+{
+	addrinfo Hints = {};
+	Hints.ai_family = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* AddressInfo = nullptr;
+	const std::string Port = std::to_string(Config.Port);
+	if (getaddrinfo(Config.Host.c_str(), Port.c_str(), &Hints, &AddressInfo) != 0 || !AddressInfo)
+	{
+		FDebugLog::LogError(L"LoadGenerator: Can't resolve %ls", FStringUtils::Widen(Config.Host).c_str());
+		return false;
+	}
+	const char* Address = reinterpret_cast<const char*>(AddressInfo->ai_addr);
+	ServerAddress.assign(Address, Address + AddressInfo->ai_addrlen);
+	freeaddrinfo(AddressInfo);
+
+	RaiseOpenFileLimit(Config.NumClients);
+
+	std::vector<FWorker> Workers(Config.NumThreads);
+	for (uint32_t ThreadIndex = 0; ThreadIndex < Config.NumThreads; ++ThreadIndex)
+	{
+		FWorker& Worker = Workers[ThreadIndex];
+		Worker.ThreadIndex = ThreadIndex;
+		Worker.EpollHandle = epoll_create1(EPOLL_CLOEXEC);
+		if (Worker.EpollHandle < 0)
+		{
+			FDebugLog::LogError(L"LoadGenerator: epoll_create1 failed, errno %d", errno);
+			for (FWorker& CreatedWorker : Workers)
+			{
+				if (CreatedWorker.EpollHandle >= 0)
+				{
+					close(CreatedWorker.EpollHandle);
+				}
+			}
+			return false;
+		}
+
+		for (uint32_t ClientIndex = ThreadIndex; ClientIndex < Config.NumClients; ClientIndex += Config.NumThreads)
+		{
+			FSyntheticClient Client;
+			Client.Index = ClientIndex;
+			Worker.Clients.push_back(std::move(Client));
+		}
+	}
+
+	// Connections are spread evenly over the ramp up, the measured part of the test starts once all were attempted
+	const std::chrono::nanoseconds RampUpDuration(static_cast<int64_t>(1e9 * Config.NumClients / Config.ConnectionsPerSecond));
+	StartTime = std::chrono::steady_clock::now();
+	SteadyStartTime = StartTime + RampUpDuration;
+	StopSendingTime = SteadyStartTime + Config.Duration;
+
+	FDebugLog::Log(L"LoadGenerator: %u clients on %u threads, %u connections/s, %u messages/s per client of %u bytes, %lld s",
+		Config.NumClients, Config.NumThreads, Config.ConnectionsPerSecond, Config.MessagesPerSecond, Config.MessageSize,
+		static_cast<long long>(Config.Duration.count()));
+
+	std::vector<std::thread> Threads;
+	for (FWorker& Worker : Workers)
+	{
+		Threads.emplace_back([this, &Worker]() { RunWorker(Worker); });
+	}
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	Results = FResults();
+	for (FWorker& Worker : Workers)
+	{
+		close(Worker.EpollHandle);
+		Results.Merge(Worker.Results);
+	}
+	Results.SteadyDuration = StopSendingTime - SteadyStartTime;
+
+	return true;
+}
+
+void FLoadGenerator::RunWorker(FWorker& Worker)
+{
+	const std::chrono::nanoseconds ConnectInterval(static_cast<int64_t>(1e9 / Config.ConnectionsPerSecond));
+	const std::chrono::nanoseconds SendInterval(Config.MessagesPerSecond > 0 ? static_cast<int64_t>(1e9 / Config.MessagesPerSecond) : 0);
+
+	// Next probe of each active client, earliest first
+	using FScheduledProbe = std::pair<LoadTestTimePoint, size_t>;
+	std::priority_queue<FScheduledProbe, std::vector<FScheduledProbe>, std::greater<FScheduledProbe>> ProbeSchedule;
+
+	size_t NextClientToConnect = 0;
+	std::vector<epoll_event> Events(256);
+
+	for (;;)
+	{
+		LoadTestTimePoint Now = std::chrono::steady_clock::now();
+		const bool bSending = Now < StopSendingTime;
+
+		// Clients connect at the time of their global index, interleaved with the other threads
+		while (bSending && NextClientToConnect < Worker.Clients.size())
+		{
+			FSyntheticClient& Client = Worker.Clients[NextClientToConnect];
+			if (StartTime + ConnectInterval * Client.Index > Now)
+			{
+				break;
+			}
+			StartConnecting(Worker, Client, Now);
+			++NextClientToConnect;
+		}
+
+		while (bSending && !ProbeSchedule.empty() && ProbeSchedule.top().first <= Now)
+		{
+			const FScheduledProbe Probe = ProbeSchedule.top();
+			ProbeSchedule.pop();
+
+			FSyntheticClient& Client = Worker.Clients[Probe.second];
+			if (Client.State != EClientState::Active)
+			{
+				continue;
+			}
+			SendProbe(Worker, Client, Now);
+
+			// Keep the rate when falling behind a little, but do not burst to catch up on a long stall
+			LoadTestTimePoint NextSendTime = Probe.first + SendInterval;
+			if (NextSendTime + std::chrono::seconds(1) < Now)
+			{
+				NextSendTime = Now + SendInterval;
+			}
+			ProbeSchedule.emplace(NextSendTime, Probe.second);
+		}
+
+		if (!bSending)
+		{
+			const bool bAllAnswered = Worker.Results.MessagesReceived >= Worker.Results.MessagesSent;
+			if (bAllAnswered || Now >= StopSendingTime + Config.DrainTimeout)
+			{
+				break;
+			}
+		}
+
+		// Sleep until the next connection or probe is due, or the socket events
+		LoadTestTimePoint WakeTime = bSending ? StopSendingTime : StopSendingTime + Config.DrainTimeout;
+		if (bSending && NextClientToConnect < Worker.Clients.size())
+		{
+			WakeTime = std::min(WakeTime, StartTime + ConnectInterval * Worker.Clients[NextClientToConnect].Index);
+		}
+		if (bSending && !ProbeSchedule.empty())
+		{
+			WakeTime = std::min(WakeTime, ProbeSchedule.top().first);
+		}
+		const int64_t TimeoutMs = std::max<int64_t>(0, std::min<int64_t>(100, std::chrono::duration_cast<std::chrono::milliseconds>(WakeTime - Now + std::chrono::microseconds(999)).count()));
+
+		const int NumEvents = epoll_wait(Worker.EpollHandle, Events.data(), static_cast<int>(Events.size()), static_cast<int>(TimeoutMs));
+		if (NumEvents < 0 && errno != EINTR)
+		{
+			FDebugLog::LogError(L"LoadGenerator: epoll_wait failed, errno %d", errno);
+			break;
+		}
+
+		Now = std::chrono::steady_clock::now();
+		for (int EventIndex = 0; EventIndex < NumEvents; ++EventIndex)
+		{
+			const epoll_event& Event = Events[EventIndex];
+			const size_t LocalIndex = static_cast<size_t>(Event.data.u64);
+			FSyntheticClient& Client = Worker.Clients[LocalIndex];
+
+			if (Client.State == EClientState::Connecting)
+			{
+				int Error = 0;
+				socklen_t ErrorSize = sizeof(Error);
+				if (getsockopt(Client.Socket, SOL_SOCKET, SO_ERROR, &Error, &ErrorSize) != 0 || Error != 0)
+				{
+					++Worker.Results.ConnectFailures;
+					Close(Worker, Client, false);
+					continue;
+				}
+				OnConnected(Worker, Client, Now);
+				continue;
+			}
+
+			if ((Event.events & EPOLLIN) != 0)
+			{
+				const bool bWasRegistering = Client.State == EClientState::Registering;
+				OnReadable(Worker, Client, Now);
+
+				// Clients that just registered start sending, staggered over one interval so they do not all send at once
+				if (bWasRegistering && Client.State == EClientState::Active && SendInterval.count() > 0)
+				{
+					const std::chrono::nanoseconds Offset(SendInterval.count() * (Client.Index % 64) / 64);
+					ProbeSchedule.emplace(Now + Offset, LocalIndex);
+				}
+			}
+			if ((Event.events & EPOLLOUT) != 0 && Client.State != EClientState::Closed)
+			{
+				FlushSendBuffer(Worker, Client);
+			}
+			if ((Event.events & (EPOLLERR | EPOLLHUP)) != 0 && Client.State != EClientState::Closed)
+			{
+				Close(Worker, Client, true);
+			}
+		}
+	}
+
+	for (FSyntheticClient& Client : Worker.Clients)
+	{
+		if (Client.State != EClientState::Idle && Client.State != EClientState::Closed)
+		{
+			Close(Worker, Client, false);
+		}
+	}
+}
+
+void FLoadGenerator::StartConnecting(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now)
+{
+	++Worker.Results.ConnectAttempts;
+	Client.ConnectStartTime = Now;
+
+	const sockaddr* Address = reinterpret_cast<const sockaddr*>(ServerAddress.data());
+	Client.Socket = socket(Address->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (Client.Socket < 0)
+	{
+		++Worker.Results.ConnectFailures;
+		Client.State = EClientState::Closed;
+		return;
+	}
+
+	const int NoDelay = 1;
+	setsockopt(Client.Socket, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+
+	if (connect(Client.Socket, Address, static_cast<socklen_t>(ServerAddress.size())) != 0 && errno != EINPROGRESS)
+	{
+		++Worker.Results.ConnectFailures;
+		Close(Worker, Client, false);
+		return;
+	}
+
+	// Writable once connected, readable from then on
+	epoll_event Event = {};
+	Event.events = EPOLLOUT;
+	Event.data.u64 = static_cast<uint64_t>(&Client - Worker.Clients.data());
+	epoll_ctl(Worker.EpollHandle, EPOLL_CTL_ADD, Client.Socket, &Event);
+
+	Client.State = EClientState::Connecting;
+}
+
+void FLoadGenerator::OnConnected(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now)
+{
+	++Worker.Results.Connected;
+	Worker.Results.ConnectTimes.Add(Now - Client.ConnectStartTime);
+	Worker.Results.ConnectDuration = std::max(Worker.Results.ConnectDuration, Now - StartTime);
+
+	epoll_event Event = {};
+	Event.events = EPOLLIN;
+	Event.data.u64 = static_cast<uint64_t>(&Client - Worker.Clients.data());
+	epoll_ctl(Worker.EpollHandle, EPOLL_CTL_MOD, Client.Socket, &Event);
+
+	Client.State = EClientState::Registering;
+	Client.ReceiveBuffer.resize(4096);
+
+	// RegistrationInfo: product user id and Connect ID token as null terminated strings, then the client platform
+	const std::string ProductUserId = MakeProductUserId(Client.Index);
+	const std::string ConnectIdToken = MakeConnectIdToken(ProductUserId);
+	const EOS_EAntiCheatCommonClientPlatform ClientPlatform = EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Windows;
+
+	const uint32_t PayloadSize = static_cast<uint32_t>(ProductUserId.size() + 1 + ConnectIdToken.size() + 1 + sizeof(ClientPlatform));
+	std::vector<char> Message(MessageHeaderSize + PayloadSize);
+
+	const FMessageType Type = FMessageType::RegistrationInfo;
+	char* Position = Message.data();
+	memcpy(Position, &Type, sizeof(Type));
+	Position += sizeof(Type);
+	memcpy(Position, &PayloadSize, sizeof(PayloadSize));
+	Position += sizeof(PayloadSize);
+	memcpy(Position, ProductUserId.c_str(), ProductUserId.size() + 1);
+	Position += ProductUserId.size() + 1;
+	memcpy(Position, ConnectIdToken.c_str(), ConnectIdToken.size() + 1);
+	Position += ConnectIdToken.size() + 1;
+	memcpy(Position, &ClientPlatform, sizeof(ClientPlatform));
+
+	Client.RegistrationSendTime = Now;
+	Send(Worker, Client, Message.data(), Message.size());
+}
+
+void FLoadGenerator::OnReadable(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now)
+{
+	for (;;)
+	{
+		if (Client.ReceivedSize == Client.ReceiveBuffer.size())
+		{
+			Client.ReceiveBuffer.resize(Client.ReceiveBuffer.size() * 2);
+		}
+
+		const ssize_t BytesRead = recv(Client.Socket, &Client.ReceiveBuffer[Client.ReceivedSize], Client.ReceiveBuffer.size() - Client.ReceivedSize, 0);
+		if (BytesRead == 0 || (BytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		{
+			Close(Worker, Client, true);
+			return;
+		}
+		if (BytesRead < 0)
+		{
+			break;
+		}
+
+		Client.ReceivedSize += static_cast<size_t>(BytesRead);
+		Worker.Results.BytesReceived += static_cast<uint64_t>(BytesRead);
+
+		size_t Position = 0;
+		while (Client.ReceivedSize - Position >= MessageHeaderSize)
+		{
+			FMessageType Type;
+			uint32_t PayloadSize = 0;
+			memcpy(&Type, &Client.ReceiveBuffer[Position], sizeof(Type));
+			memcpy(&PayloadSize, &Client.ReceiveBuffer[Position + sizeof(Type)], sizeof(PayloadSize));
+
+			if (Client.ReceivedSize - Position < MessageHeaderSize + PayloadSize)
+			{
+				// Make sure the whole message fits once it has arrived
+				if (Client.ReceiveBuffer.size() < MessageHeaderSize + PayloadSize)
+				{
+					Client.ReceiveBuffer.resize(MessageHeaderSize + PayloadSize);
+				}
+				break;
+			}
+
+			OnMessage(Worker, Client, Type, &Client.ReceiveBuffer[Position + MessageHeaderSize], PayloadSize, Now);
+			Position += MessageHeaderSize + PayloadSize;
+
+			if (Client.State == EClientState::Closed)
+			{
+				return;
+			}
+		}
+
+		if (Position > 0)
+		{
+			memmove(Client.ReceiveBuffer.data(), &Client.ReceiveBuffer[Position], Client.ReceivedSize - Position);
+			Client.ReceivedSize -= Position;
+		}
+	}
+}
+
+void FLoadGenerator::OnMessage(FWorker& Worker, FSyntheticClient& Client, FMessageType Type, const char* Payload, uint32_t PayloadSize, LoadTestTimePoint Now)
+{
+	if (Type == FMessageType::ClientActionRequired)
+	{
+		++Worker.Results.ClientActions;
+		return;
+	}
+
+	if (Type != FMessageType::Opaque)
+	{
+		return;
+	}
+
+	if (Client.State == EClientState::Registering)
+	{
+		// The server only sends anti-cheat messages to registered clients
+		++Worker.Results.Registered;
+		Worker.Results.RegistrationTimes.Add(Now - Client.RegistrationSendTime);
+		Client.State = EClientState::Active;
+	}
+
+	FProbeHeader Header;
+	if (PayloadSize < sizeof(Header))
+	{
+		return;
+	}
+	memcpy(&Header, Payload, sizeof(Header));
+	if (Header.Magic != ProbeMagic)
+	{
+		return;
+	}
+
+	if (Header.ClientIndex != Client.Index || !IsPayloadIntact(Payload, PayloadSize, Header.Sequence))
+	{
+		++Worker.Results.CorruptMessages;
+		return;
+	}
+
+	++Worker.Results.MessagesReceived;
+	if (Now >= SteadyStartTime && Now < StopSendingTime)
+	{
+		++Worker.Results.SteadyMessagesReceived;
+	}
+	Worker.Results.RoundTripTimes.Add(std::chrono::nanoseconds(ToNanoseconds(Now) - Header.SendTimeNs));
+}
+
+void FLoadGenerator::SendProbe(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now)
+{
+	char Buffer[MessageHeaderSize + 1024];
+	std::vector<char> LargeBuffer;
+	char* Message = Buffer;
+	if (MessageHeaderSize + Config.MessageSize > sizeof(Buffer))
+	{
+		LargeBuffer.resize(MessageHeaderSize + Config.MessageSize);
+		Message = LargeBuffer.data();
+	}
+
+	const FMessageType Type = FMessageType::Opaque;
+	memcpy(Message, &Type, sizeof(Type));
+	memcpy(Message + sizeof(Type), &Config.MessageSize, sizeof(Config.MessageSize));
+
+	FProbeHeader Header;
+	Header.Magic = ProbeMagic;
+	Header.ClientIndex = Client.Index;
+	Header.Sequence = Client.NextSequence++;
+	Header.SendTimeNs = ToNanoseconds(Now);
+
+	char* Payload = Message + MessageHeaderSize;
+	memcpy(Payload, &Header, sizeof(Header));
+	FillPayload(Payload, Config.MessageSize, Header.Sequence);
+
+	if (Send(Worker, Client, Message, MessageHeaderSize + Config.MessageSize))
+	{
+		++Worker.Results.MessagesSent;
+		if (Now >= SteadyStartTime)
+		{
+			++Worker.Results.SteadyMessagesSent;
+		}
+	}
+}
+
+bool FLoadGenerator::Send(FWorker& Worker, FSyntheticClient& Client, const void* Data, size_t Size)
+{
+	const char* Bytes = static_cast<const char*>(Data);
+	Client.SendBuffer.insert(Client.SendBuffer.end(), Bytes, Bytes + Size);
+	Worker.Results.BytesSent += Size;
+
+	// Only the first queued message has to start a write, the rest goes out when the socket becomes writable
+	if (Client.SendBuffer.size() - Client.SendOffset == Size)
+	{
+		return FlushSendBuffer(Worker, Client);
+	}
+	return true;
+}
+
+bool FLoadGenerator::FlushSendBuffer(FWorker& Worker, FSyntheticClient& Client)
+{
+	while (Client.SendOffset < Client.SendBuffer.size())
+	{
+		const ssize_t BytesWritten = send(Client.Socket, &Client.SendBuffer[Client.SendOffset], Client.SendBuffer.size() - Client.SendOffset, MSG_NOSIGNAL);
+		if (BytesWritten < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				Close(Worker, Client, true);
+				return false;
+			}
+
+			if (!Client.bWaitingForWritable)
+			{
+				epoll_event Event = {};
+				Event.events = EPOLLIN | EPOLLOUT;
+				Event.data.u64 = static_cast<uint64_t>(&Client - Worker.Clients.data());
+				epoll_ctl(Worker.EpollHandle, EPOLL_CTL_MOD, Client.Socket, &Event);
+				Client.bWaitingForWritable = true;
+			}
+			return true;
+		}
+		Client.SendOffset += static_cast<size_t>(BytesWritten);
+	}
+
+	Client.SendBuffer.clear();
+	Client.SendOffset = 0;
+
+	if (Client.bWaitingForWritable)
+	{
+		epoll_event Event = {};
+		Event.events = EPOLLIN;
+		Event.data.u64 = static_cast<uint64_t>(&Client - Worker.Clients.data());
+		epoll_ctl(Worker.EpollHandle, EPOLL_CTL_MOD, Client.Socket, &Event);
+		Client.bWaitingForWritable = false;
+	}
+	return true;
+}
+
+void FLoadGenerator::Close(FWorker& Worker, FSyntheticClient& Client, bool bDisconnected)
+{
+	if (Client.Socket >= 0)
+	{
+		epoll_ctl(Worker.EpollHandle, EPOLL_CTL_DEL, Client.Socket, nullptr);
+		close(Client.Socket);
+		Client.Socket = -1;
+	}
+
+	if (bDisconnected)
+	{
+		++Worker.Results.Disconnected;
+	}
+
+	Client.State = EClientState::Closed;
+	std::vector<char>().swap(Client.ReceiveBuffer);
+	std::vector<char>().swap(Client.SendBuffer);
+	Client.ReceivedSize = 0;
+	Client.SendOffset = 0;
+	Client.bWaitingForWritable = false;
+}
+
+std::string FLoadGenerator::MakeProductUserId(uint32_t ClientIndex) const
+{
+	// Product user ids are 32 hex digits
+	char ProductUserId[33];
+	snprintf(ProductUserId, sizeof(ProductUserId), "%08x%08x%016x", 0x10AD7E57u, Config.UserIdSeed, ClientIndex);
+	return ProductUserId;
+}
+
+std::string FLoadGenerator::MakeConnectIdToken(const std::string& ProductUserId)
+{
+	// An unsigned JWT, only its expiration time is read by the server (for its token cache), the stub accepts any token
+	const int64_t ExpirationTime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() + 60 * 60;
+	const std::string Header = "{\"alg\":\"none\",\"typ\":\"JWT\"}";
+	const std::string Payload = "{\"sub\":\"" + ProductUserId + "\",\"exp\":" + std::to_string(ExpirationTime) + "}";
+	return EncodeBase64Url(Header) + "." + EncodeBase64Url(Payload) + ".";
+}
+
+void FLoadGenerator::FillPayload(char* Payload, uint32_t PayloadSize, uint64_t Sequence)
+{
+	for (uint32_t Position = sizeof(FProbeHeader); Position < PayloadSize; ++Position)
+	{
+		Payload[Position] = static_cast<char>((Sequence + Position) & 0xFF);
+	}
+}
+
+bool FLoadGenerator::IsPayloadIntact(const char* Payload, uint32_t PayloadSize, uint64_t Sequence) const
+{
+	if (PayloadSize != Config.MessageSize)
+	{
+		return false;
+	}
+
+	for (uint32_t Position = sizeof(FProbeHeader); Position < PayloadSize; ++Position)
+	{
+		if (Payload[Position] != static_cast<char>((Sequence + Position) & 0xFF))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FLoadGenerator::LogResults() const
+{
+	auto PerSecond = [](uint64_t Count, std::chrono::steady_clock::duration Duration)
+	{
+		const double Seconds = std::chrono::duration<double>(Duration).count();
+		return Seconds > 0.0 ? Count / Seconds : 0.0;
+	};
+
+	FDebugLog::Log(L"Connections: %llu of %llu established (%.1f/s), %llu failed, %llu registered, %llu disconnected by the server, %llu client actions",
+		static_cast<unsigned long long>(Results.Connected),
+		static_cast<unsigned long long>(Results.ConnectAttempts),
+		PerSecond(Results.Connected, Results.ConnectDuration),
+		static_cast<unsigned long long>(Results.ConnectFailures),
+		static_cast<unsigned long long>(Results.Registered),
+		static_cast<unsigned long long>(Results.Disconnected),
+		static_cast<unsigned long long>(Results.ClientActions));
+	Results.ConnectTimes.Log(L"Connect time");
+	Results.RegistrationTimes.Log(L"Registration time");
+
+	FDebugLog::Log(L"Messages: %llu sent, %llu echoed, %llu unanswered, %llu corrupt, %llu bytes sent, %llu bytes received",
+		static_cast<unsigned long long>(Results.MessagesSent),
+		static_cast<unsigned long long>(Results.MessagesReceived),
+		static_cast<unsigned long long>(Results.MessagesSent - std::min(Results.MessagesSent, Results.MessagesReceived + Results.CorruptMessages)),
+		static_cast<unsigned long long>(Results.CorruptMessages),
+		static_cast<unsigned long long>(Results.BytesSent),
+		static_cast<unsigned long long>(Results.BytesReceived));
+	FDebugLog::Log(L"Throughput after ramp up: %.0f messages/s sent, %.0f messages/s echoed",
+		PerSecond(Results.SteadyMessagesSent, Results.SteadyDuration),
+		PerSecond(Results.SteadyMessagesReceived, Results.SteadyDuration));
+	Results.RoundTripTimes.Log(L"Round trip time");
+}
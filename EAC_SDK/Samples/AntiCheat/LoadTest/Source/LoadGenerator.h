@@ -0,0 +1,195 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "LatencyHistogram.h"
+
+/**
+ * Drives an anti-cheat server sample with synthetic clients speaking its TCP protocol: every message is an
+ * FMessageType byte, the payload length as uint32 and the payload.
+ *
+ * Each client connects, sends a RegistrationInfo message with a generated product user id and Connect ID token, waits
+ * for the first message from the server and from then on sends Opaque messages at a fixed rate. Every Opaque message
+ * carries its send time, so when the server echoes it back (as it does when linked against EosSdkStub.cpp) the round
+ * trip through the transport, the server main loop and the SDK tick is measured.
+ *
+ * Clients are spread over a number of threads, each serving its clients with epoll. Linux only.
+ */
+class FLoadGenerator
+{
+public:
+	struct FConfig
+	{
+		std::string Host = "127.0.0.1";
+		uint16_t Port = 1234;
+
+		uint32_t NumClients = 1000;
+		uint32_t NumThreads = 4;
+
+		/** New connections per second over all threads, while ramping up */
+		uint32_t ConnectionsPerSecond = 500;
+
+		/** Opaque messages each registered client sends per second, 0 to only connect and register */
+		uint32_t MessagesPerSecond = 10;
+
+		/** Payload size of the Opaque messages, at least the size of the timestamp they carry */
+		uint32_t MessageSize = 64;
+
+		/** How long clients keep sending once all of them had their turn to connect */
+		std::chrono::seconds Duration{ 10 };
+
+		/** How long to wait for outstanding echoes after the clients stopped sending */
+		std::chrono::milliseconds DrainTimeout{ 2000 };
+
+		/** Varies the generated product user ids, runs with the same seed reuse the same ids and tokens */
+		uint32_t UserIdSeed = 0;
+	};
+
+	struct FResults
+	{
+		uint64_t ConnectAttempts = 0;
+		uint64_t Connected = 0;
+		uint64_t ConnectFailures = 0;
+		uint64_t Registered = 0;
+
+		/** Connections the server closed, or that failed, before the test ended */
+		uint64_t Disconnected = 0;
+
+		/** ClientActionRequired messages received */
+		uint64_t ClientActions = 0;
+
+		uint64_t MessagesSent = 0;
+		uint64_t MessagesReceived = 0;
+		uint64_t BytesSent = 0;
+		uint64_t BytesReceived = 0;
+
+		/** Echoes whose payload did not match what was sent */
+		uint64_t CorruptMessages = 0;
+
+		/** Messages sent and echoes received between the end of the ramp up and the end of the test, for the rates */
+		uint64_t SteadyMessagesSent = 0;
+		uint64_t SteadyMessagesReceived = 0;
+		std::chrono::steady_clock::duration SteadyDuration{ 0 };
+
+		/** Time from the start of the test to the last established connection */
+		std::chrono::steady_clock::duration ConnectDuration{ 0 };
+
+		/** From starting to connect to the connection being established */
+		FLatencyHistogram ConnectTimes;
+
+		/** From sending RegistrationInfo to the first message from the server */
+		FLatencyHistogram RegistrationTimes;
+
+		/** From sending an Opaque message to receiving its echo */
+		FLatencyHistogram RoundTripTimes;
+
+		void Merge(const FResults& Other);
+	};
+
+	explicit FLoadGenerator(const FConfig& InConfig);
+
+	/** Runs the whole test on NumThreads threads and blocks until it is done. Returns false if it could not start. */
+	bool Run();
+
+	const FResults& GetResults() const { return Results; }
+
+	/** Logs the results: connection rate, message rates and latency percentiles */
+	void LogResults() const;
+
+private:
+	enum class FMessageType : char
+	{
+		Opaque = 1,
+		RegistrationInfo = 2,
+		ClientActionRequired = 3
+	};
+
+	/** Same header as the server: type followed by the payload length */
+	static constexpr size_t MessageHeaderSize = sizeof(FMessageType) + sizeof(uint32_t);
+
+	/** Start of every Opaque payload, the rest is filled with a pattern derived from Sequence */
+	struct FProbeHeader
+	{
+		uint32_t Magic;
+		uint32_t ClientIndex;
+		uint64_t Sequence;
+		int64_t SendTimeNs;
+	};
+
+	static constexpr uint32_t ProbeMagic = 0x4C4F4144;
+
+	enum class EClientState
+	{
+		Idle,
+		Connecting,
+		Registering,
+		Active,
+		Closed
+	};
+
+	struct FSyntheticClient
+	{
+		uint32_t Index = 0;
+		int Socket = -1;
+		EClientState State = EClientState::Idle;
+
+		LoadTestTimePoint ConnectStartTime;
+		LoadTestTimePoint RegistrationSendTime;
+
+		/** Received bytes not yet parsed into messages */
+		std::vector<char> ReceiveBuffer;
+		size_t ReceivedSize = 0;
+
+		/** Bytes the socket did not accept yet */
+		std::vector<char> SendBuffer;
+		size_t SendOffset = 0;
+
+		/** Whether epoll also reports the socket as writable, while SendBuffer has bytes left */
+		bool bWaitingForWritable = false;
+
+		uint64_t NextSequence = 0;
+	};
+
+	/** Per thread state, only touched by its thread until the thread has finished */
+	struct FWorker
+	{
+		uint32_t ThreadIndex = 0;
+		int EpollHandle = -1;
+
+		/** Clients ThreadIndex, ThreadIndex + NumThreads and so on */
+		std::vector<FSyntheticClient> Clients;
+
+		FResults Results;
+	};
+
+	void RunWorker(FWorker& Worker);
+
+	void StartConnecting(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now);
+	void OnConnected(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now);
+	void OnReadable(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now);
+	void OnMessage(FWorker& Worker, FSyntheticClient& Client, FMessageType Type, const char* Payload, uint32_t PayloadSize, LoadTestTimePoint Now);
+	void SendProbe(FWorker& Worker, FSyntheticClient& Client, LoadTestTimePoint Now);
+
+	/** Queues the bytes and writes as much as the socket takes, waits for the socket to become writable for the rest */
+	bool Send(FWorker& Worker, FSyntheticClient& Client, const void* Data, size_t Size);
+	bool FlushSendBuffer(FWorker& Worker, FSyntheticClient& Client);
+	void Close(FWorker& Worker, FSyntheticClient& Client, bool bDisconnected);
+
+	/** Generated, but stable for a seed and client index */
+	std::string MakeProductUserId(uint32_t ClientIndex) const;
+	static std::string MakeConnectIdToken(const std::string& ProductUserId);
+
+	static void FillPayload(char* Payload, uint32_t PayloadSize, uint64_t Sequence);
+	bool IsPayloadIntact(const char* Payload, uint32_t PayloadSize, uint64_t Sequence) const;
+
+	FConfig Config;
+
+	/** Resolved server address, a sockaddr of the size of the vector */
+	std::vector<char> ServerAddress;
+
+	LoadTestTimePoint StartTime;
+	LoadTestTimePoint SteadyStartTime;
+	LoadTestTimePoint StopSendingTime;
+
+	FResults Results;
+};
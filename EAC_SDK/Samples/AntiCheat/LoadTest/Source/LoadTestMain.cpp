@@ -0,0 +1,178 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+/**
+ * Headless load generator for the anti-cheat server sample, to find out how many clients a server can handle.
+ *
+ * The server is built from its usual sources plus EosSdkStub.cpp in place of the EOS SDK library and started with any
+ * non-empty product, sandbox and deployment ids. The stub registers every client and echoes its messages, so the
+ * results cover the server's transport, main loop and message handling but not the work of the real SDK.
+ * CMakeLists.txt in the LoadTest directory builds both, as AntiCheatLoadTestServer and AntiCheatLoadTest.
+ *
+ * Usage: AntiCheatLoadTest [-host 127.0.0.1] [-port 1234] [-clients 1000] [-threads 4] [-connectrate 500]
+ *                          [-rate 10] [-size 64] [-duration 10] [-seed 0]
+ *        AntiCheatLoadTest -replay capture.bin [-speed 1] [-host 127.0.0.1] [-port 1234] [-threads 4]
+ *
+ * -connectrate is new connections per second, -rate is messages per second per client, -size the message payload
+ * size in bytes and -duration the number of seconds to send for after all clients connected.
+ *
+ * -replay replays a capture the server recorded with -capture instead of generating clients, see FCaptureReplay.
+ * -speed is the multiple of the recorded speed to replay at.
+ */
+
+#include "pch.h"
+#include "LoadGenerator.h"
+#include "CaptureReplay.h"
+#include "DebugLog.h"
+#include "StringUtils.h"
+
+#include <cstring>
+
+namespace
+{
+	bool ParseUnsigned(const char* Name, const char* Value, uint64_t Max, uint64_t& OutValue)
+	{
+		try
+		{
+			size_t NumParsed = 0;
+			const unsigned long long Parsed = std::stoull(Value, &NumParsed);
+			if (NumParsed == strlen(Value) && Parsed <= Max)
+			{
+				OutValue = Parsed;
+				return true;
+			}
+		}
+		catch (const std::exception&)
+		{
+		}
+
+		FDebugLog::LogError(L"Error: Can't parse %ls value '%ls'", FStringUtils::Widen(Name).c_str(), FStringUtils::Widen(Value).c_str());
+		return false;
+	}
+
+	bool ParseCommandLine(int Argc, const char* Args[], FLoadGenerator::FConfig& OutConfig, FCaptureReplay::FConfig& OutReplayConfig)
+	{
+		for (int i = 1; i < Argc; i += 2)
+		{
+			const char* Name = Args[i];
+			if (i + 1 >= Argc)
+			{
+				FDebugLog::LogError(L"Error: Missing value for %ls", FStringUtils::Widen(Name).c_str());
+				return false;
+			}
+			const char* Value = Args[i + 1];
+
+			uint64_t Number = 0;
+			bool bIsValid = true;
+			if (strcmp(Name, "-host") == 0)
+			{
+				OutConfig.Host = Value;
+				OutReplayConfig.Host = Value;
+			}
+			else if (strcmp(Name, "-port") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, UINT16_MAX, Number);
+				OutConfig.Port = static_cast<uint16_t>(Number);
+				OutReplayConfig.Port = OutConfig.Port;
+			}
+			else if (strcmp(Name, "-clients") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, UINT32_MAX, Number);
+				OutConfig.NumClients = static_cast<uint32_t>(Number);
+			}
+			else if (strcmp(Name, "-threads") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, 1024, Number);
+				OutConfig.NumThreads = static_cast<uint32_t>(Number);
+				OutReplayConfig.NumThreads = OutConfig.NumThreads;
+			}
+			else if (strcmp(Name, "-connectrate") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, UINT32_MAX, Number);
+				OutConfig.ConnectionsPerSecond = static_cast<uint32_t>(Number);
+			}
+			else if (strcmp(Name, "-rate") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, 1000000, Number);
+				OutConfig.MessagesPerSecond = static_cast<uint32_t>(Number);
+			}
+			else if (strcmp(Name, "-size") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, 1024 * 1024, Number);
+				OutConfig.MessageSize = static_cast<uint32_t>(Number);
+			}
+			else if (strcmp(Name, "-duration") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, 24 * 60 * 60, Number);
+				OutConfig.Duration = std::chrono::seconds(Number);
+			}
+			else if (strcmp(Name, "-seed") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, UINT32_MAX, Number);
+				OutConfig.UserIdSeed = static_cast<uint32_t>(Number);
+			}
+			else if (strcmp(Name, "-replay") == 0)
+			{
+				OutReplayConfig.CaptureFilePath = Value;
+			}
+			else if (strcmp(Name, "-speed") == 0)
+			{
+				bIsValid = ParseUnsigned(Name, Value, 1000000, Number);
+				OutReplayConfig.Speed = static_cast<uint32_t>(Number);
+			}
+			else
+			{
+				FDebugLog::LogError(L"Error: Unknown parameter %ls", FStringUtils::Widen(Name).c_str());
+				return false;
+			}
+
+			if (!bIsValid)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int Argc, const char* Args[])
+{
+	FDebugLog::Init();
+	FDebugLog::AddTarget(FDebugLog::ELogTarget::Console);
+
+	FDebugLog::Log(L"EOS AntiCheat Server Load Test");
+
+	FLoadGenerator::FConfig Config;
+	FCaptureReplay::FConfig ReplayConfig;
+	if (!ParseCommandLine(Argc, Args, Config, ReplayConfig))
+	{
+		FDebugLog::Close();
+		return 1;
+	}
+
+	if (!ReplayConfig.CaptureFilePath.empty())
+	{
+		FCaptureReplay Replay(ReplayConfig);
+		if (!Replay.Run())
+		{
+			FDebugLog::Close();
+			return 1;
+		}
+
+		Replay.LogResults();
+
+		FDebugLog::Close();
+		return 0;
+	}
+
+	FLoadGenerator LoadGenerator(Config);
+	if (!LoadGenerator.Run())
+	{
+		FDebugLog::Close();
+		return 1;
+	}
+
+	LoadGenerator.LogResults();
+
+	FDebugLog::Close();
+	return 0;
+}
@@ -0,0 +1,209 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "PeerLoopback.h"
+#include "AntiCheatPeerTransport.h"
+#include "DebugLog.h"
+
+#include <eos_sdk.h>
+
+#include <cstring>
+#include <random>
+#include <unordered_map>
+
+namespace
+{
+	/** Messages start with their sequence number, followed by bytes of Pattern starting at an offset taken from it */
+	constexpr uint32_t SequenceSize = sizeof(uint32_t);
+	constexpr size_t PatternOffsets = 256;
+
+	/** Stands in for EOS_Platform_GetP2PInterface, the stub ignores the handle */
+	EOS_HP2P GetStubP2PHandle()
+	{
+		static char StubHandle;
+		return reinterpret_cast<EOS_HP2P>(&StubHandle);
+	}
+}
+
+void FPeerLoopback::Run()
+{
+	Config.MinPeers = std::max(Config.MinPeers, 2u);
+	Config.MinMessageSize = std::max(Config.MinMessageSize, SequenceSize);
+	Config.MaxMessageSize = std::min(std::max(Config.MaxMessageSize, Config.MinMessageSize), FAntiCheatPeerTransport::MaxMessageSize);
+
+	Results.clear();
+	for (uint32_t NumPeers = Config.MinPeers; NumPeers <= Config.MaxPeers; NumPeers *= 2)
+	{
+		Results.push_back(RunWithPeers(NumPeers));
+	}
+}
+
+FPeerLoopback::FResults FPeerLoopback::RunWithPeers(uint32_t NumPeers)
+{
+	std::mt19937 Random(Config.Seed);
+	std::uniform_int_distribution<uint32_t> MessageSizes(Config.MinMessageSize, Config.MaxMessageSize);
+
+	std::vector<char> Pattern(Config.MaxMessageSize + PatternOffsets);
+	for (char& Byte : Pattern)
+	{
+		Byte = static_cast<char>(Random());
+	}
+
+	FResults Result;
+	Result.NumPeers = NumPeers;
+
+	// Fresh ids for every run, so no packet of a previous run can reach this one
+	std::vector<EOS_ProductUserId> UserIds(NumPeers);
+	std::unordered_map<EOS_ProductUserId, uint32_t> PeerIndices;
+	for (uint32_t PeerIndex = 0; PeerIndex < NumPeers; ++PeerIndex)
+	{
+		const std::string UserIdString = "loopback" + std::to_string(NumPeers) + "_" + std::to_string(PeerIndex);
+		UserIds[PeerIndex] = EOS_ProductUserId_FromString(UserIdString.c_str());
+		PeerIndices[UserIds[PeerIndex]] = PeerIndex;
+	}
+
+	// Next sequence number to send and to receive for every sender and receiver pair
+	std::vector<uint32_t> NextSentSequence(NumPeers * NumPeers, 0);
+	std::vector<uint32_t> NextReceivedSequence(NumPeers * NumPeers, 0);
+	uint64_t PayloadBytes = 0;
+
+	std::vector<std::unique_ptr<FAntiCheatPeerTransport>> Transports;
+	for (uint32_t PeerIndex = 0; PeerIndex < NumPeers; ++PeerIndex)
+	{
+		Transports.push_back(std::make_unique<FAntiCheatPeerTransport>());
+		FAntiCheatPeerTransport& Transport = *Transports.back();
+		Transport.Init(GetStubP2PHandle(), UserIds[PeerIndex]);
+		for (uint32_t OtherIndex = 0; OtherIndex < NumPeers; ++OtherIndex)
+		{
+			if (OtherIndex != PeerIndex)
+			{
+				Transport.AddPeer(UserIds[OtherIndex]);
+			}
+		}
+
+		// Checking every message stands in for the anti-cheat client reading it
+		Transport.SetOnMessageReceivedCallback([&, PeerIndex](EOS_ProductUserId From, const void* Data, uint32_t Length)
+		{
+			const auto SenderIt = PeerIndices.find(From);
+			if (SenderIt == PeerIndices.end() || Length < SequenceSize)
+			{
+				++Result.MessagesCorrupt;
+				return;
+			}
+
+			uint32_t Sequence = 0;
+			memcpy(&Sequence, Data, SequenceSize);
+			uint32_t& ExpectedSequence = NextReceivedSequence[SenderIt->second * NumPeers + PeerIndex];
+			if (Sequence != ExpectedSequence)
+			{
+				Result.MessagesLost += Sequence > ExpectedSequence ? Sequence - ExpectedSequence : 1;
+			}
+			ExpectedSequence = Sequence + 1;
+
+			const char* Payload = static_cast<const char*>(Data) + SequenceSize;
+			if (memcmp(Payload, &Pattern[Sequence % PatternOffsets], Length - SequenceSize) != 0)
+			{
+				++Result.MessagesCorrupt;
+			}
+		});
+	}
+
+	std::vector<char> Message(Config.MaxMessageSize);
+	std::chrono::steady_clock::duration TransportTime{};
+
+	for (uint32_t Frame = 0; Frame < Config.NumFrames; ++Frame)
+	{
+		for (uint32_t PeerIndex = 0; PeerIndex < NumPeers; ++PeerIndex)
+		{
+			for (uint32_t OtherIndex = 0; OtherIndex < NumPeers; ++OtherIndex)
+			{
+				if (OtherIndex == PeerIndex)
+				{
+					continue;
+				}
+
+				for (uint32_t MessageIndex = 0; MessageIndex < Config.MessagesPerFrame; ++MessageIndex)
+				{
+					const uint32_t Sequence = NextSentSequence[PeerIndex * NumPeers + OtherIndex]++;
+					const uint32_t MessageSize = MessageSizes(Random);
+					memcpy(Message.data(), &Sequence, SequenceSize);
+					memcpy(Message.data() + SequenceSize, &Pattern[Sequence % PatternOffsets], MessageSize - SequenceSize);
+					PayloadBytes += MessageSize;
+
+					const auto SendStartTime = std::chrono::steady_clock::now();
+					Transports[PeerIndex]->Send(UserIds[OtherIndex], Message.data(), MessageSize);
+					TransportTime += std::chrono::steady_clock::now() - SendStartTime;
+				}
+			}
+		}
+
+		// As FAntiCheatClient::Update does it at the end of every frame
+		const auto UpdateStartTime = std::chrono::steady_clock::now();
+		for (std::unique_ptr<FAntiCheatPeerTransport>& Transport : Transports)
+		{
+			Transport->Flush();
+		}
+		for (std::unique_ptr<FAntiCheatPeerTransport>& Transport : Transports)
+		{
+			Transport->Receive();
+		}
+		TransportTime += std::chrono::steady_clock::now() - UpdateStartTime;
+	}
+
+	for (uint32_t PairIndex = 0; PairIndex < NumPeers * NumPeers; ++PairIndex)
+	{
+		Result.MessagesLost += NextSentSequence[PairIndex] - NextReceivedSequence[PairIndex];
+	}
+
+	uint64_t MessagesSent = 0;
+	uint64_t PacketsSent = 0;
+	uint64_t BytesSent = 0;
+	for (std::unique_ptr<FAntiCheatPeerTransport>& Transport : Transports)
+	{
+		const FAntiCheatPeerTransport::FStats& Stats = Transport->GetStats();
+		MessagesSent += Stats.MessagesSent;
+		PacketsSent += Stats.PacketsSent;
+		BytesSent += Stats.BytesSent;
+		Transport->Shutdown();
+	}
+
+	const double PeerFrames = static_cast<double>(NumPeers) * Config.NumFrames;
+	Result.MessagesSent = MessagesSent / PeerFrames;
+	Result.PacketsSent = PacketsSent / PeerFrames;
+	Result.BytesSent = BytesSent / PeerFrames;
+	Result.PayloadBytes = PayloadBytes / PeerFrames;
+	Result.Microseconds = std::chrono::duration<double, std::micro>(TransportTime).count() / PeerFrames;
+	return Result;
+}
+
+void FPeerLoopback::LogResults() const
+{
+	FDebugLog::Log(L"Per peer and frame, %u messages to every other peer, %u to %u bytes each:", Config.MessagesPerFrame, Config.MinMessageSize, Config.MaxMessageSize);
+	FDebugLog::Log(L"  Peers  Messages  Packets  Msgs/Packet  Payload B  Framing B   Time us  us/Remote  Lost  Corrupt");
+	for (const FResults& Result : Results)
+	{
+		FDebugLog::Log(L"  %5u  %8.1f  %7.1f  %11.2f  %9.0f  %9.0f  %8.2f  %9.3f  %4llu  %7llu",
+			Result.NumPeers,
+			Result.MessagesSent,
+			Result.PacketsSent,
+			Result.PacketsSent > 0.0 ? Result.MessagesSent / Result.PacketsSent : 0.0,
+			Result.PayloadBytes,
+			Result.BytesSent - Result.PayloadBytes,
+			Result.Microseconds,
+			Result.Microseconds / (Result.NumPeers - 1),
+			static_cast<unsigned long long>(Result.MessagesLost),
+			static_cast<unsigned long long>(Result.MessagesCorrupt));
+	}
+}
+
+bool FPeerLoopback::HasErrors() const
+{
+	for (const FResults& Result : Results)
+	{
+		if (Result.MessagesLost > 0 || Result.MessagesCorrupt > 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,65 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+/**
+ * Measures what FAntiCheatPeerTransport costs per peer. A full mesh of local peers runs in one process over
+ * EosP2PStub.cpp; every frame each peer queues anti-cheat sized messages for every other peer, flushes and receives.
+ * Each message carries a sequence number and a checkable pattern, so lost, reordered or corrupt messages are counted.
+ *
+ * The run is repeated for MinPeers, twice as many and so on up to MaxPeers.
+ */
+class FPeerLoopback
+{
+public:
+	struct FConfig
+	{
+		uint32_t MinPeers = 2;
+		uint32_t MaxPeers = 64;
+
+		/** Messages each peer sends to each other peer per frame */
+		uint32_t MessagesPerFrame = 2;
+
+		/** Message sizes are picked evenly from this range, the anti-cheat client's messages are at most 512 bytes */
+		uint32_t MinMessageSize = 16;
+		uint32_t MaxMessageSize = 512;
+
+		uint32_t NumFrames = 300;
+		uint32_t Seed = 0;
+	};
+
+	struct FResults
+	{
+		uint32_t NumPeers = 0;
+
+		/** Averages per peer and frame */
+		double MessagesSent = 0.0;
+		double PacketsSent = 0.0;
+		double BytesSent = 0.0;
+		double PayloadBytes = 0.0;
+		double Microseconds = 0.0;
+
+		uint64_t MessagesLost = 0;
+		uint64_t MessagesCorrupt = 0;
+	};
+
+	explicit FPeerLoopback(const FConfig& InConfig) : Config(InConfig) {}
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	FPeerLoopback(FPeerLoopback const&) = delete;
+	FPeerLoopback& operator=(FPeerLoopback const&) = delete;
+
+	void Run();
+	void LogResults() const;
+
+	/** True if any run lost or corrupted a message */
+	bool HasErrors() const;
+
+private:
+	FResults RunWithPeers(uint32_t NumPeers);
+
+	FConfig Config;
+	std::vector<FResults> Results;
+};
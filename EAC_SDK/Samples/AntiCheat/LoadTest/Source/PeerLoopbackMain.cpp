@@ -0,0 +1,113 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+/**
+ * Loopback harness for the anti-cheat client's peer-to-peer transport, to find out what peer mode costs per peer.
+ *
+ * Built from FAntiCheatPeerTransport (Client/Source/AntiCheatPeerTransport.cpp), PeerLoopback.cpp, this file and
+ * EosP2PStub.cpp in place of the EOS SDK library, see CMakeLists.txt in the LoadTest directory. Runs anywhere, the stub
+ * keeps all packets in memory.
+ *
+ * Usage: AntiCheatPeerLoopback [-minpeers 2] [-maxpeers 64] [-messages 2] [-minsize 16] [-maxsize 512]
+ *                              [-frames 300] [-seed 0]
+ *
+ * -messages is the number of messages each peer sends to each other peer per frame, -minsize and -maxsize the range of
+ * their sizes in bytes.
+ */
+
+#include "pch.h"
+#include "PeerLoopback.h"
+#include "DebugLog.h"
+#include "StringUtils.h"
+
+#include <cstring>
+
+namespace
+{
+	bool ParseUnsigned(const char* Name, const char* Value, uint64_t Max, uint64_t& OutValue)
+	{
+		try
+		{
+			size_t NumParsed = 0;
+			const unsigned long long Parsed = std::stoull(Value, &NumParsed);
+			if (NumParsed == strlen(Value) && Parsed <= Max)
+			{
+				OutValue = Parsed;
+				return true;
+			}
+		}
+		catch (const std::exception&)
+		{
+		}
+
+		FDebugLog::LogError(L"Error: Can't parse %ls value '%ls'", FStringUtils::Widen(Name).c_str(), FStringUtils::Widen(Value).c_str());
+		return false;
+	}
+
+	bool ParseCommandLine(int Argc, const char* Args[], FPeerLoopback::FConfig& OutConfig)
+	{
+		struct FParameter
+		{
+			const char* Name;
+			uint64_t Max;
+			uint32_t* Value;
+		};
+		const FParameter Parameters[] =
+		{
+			{ "-minpeers", 1024, &OutConfig.MinPeers },
+			{ "-maxpeers", 1024, &OutConfig.MaxPeers },
+			{ "-messages", 1000, &OutConfig.MessagesPerFrame },
+			{ "-minsize", 1024, &OutConfig.MinMessageSize },
+			{ "-maxsize", 1024, &OutConfig.MaxMessageSize },
+			{ "-frames", 1000000, &OutConfig.NumFrames },
+			{ "-seed", UINT32_MAX, &OutConfig.Seed },
+		};
+
+		for (int i = 1; i < Argc; i += 2)
+		{
+			const char* Name = Args[i];
+			if (i + 1 >= Argc)
+			{
+				FDebugLog::LogError(L"Error: Missing value for %ls", FStringUtils::Widen(Name).c_str());
+				return false;
+			}
+
+			const FParameter* Parameter = std::find_if(std::begin(Parameters), std::end(Parameters), [Name](const FParameter& Candidate) { return strcmp(Candidate.Name, Name) == 0; });
+			if (Parameter == std::end(Parameters))
+			{
+				FDebugLog::LogError(L"Error: Unknown parameter %ls", FStringUtils::Widen(Name).c_str());
+				return false;
+			}
+
+			uint64_t Number = 0;
+			if (!ParseUnsigned(Name, Args[i + 1], Parameter->Max, Number))
+			{
+				return false;
+			}
+			*Parameter->Value = static_cast<uint32_t>(Number);
+		}
+		return true;
+	}
+}
+
+int main(int Argc, const char* Args[])
+{
+	FDebugLog::Init();
+	FDebugLog::AddTarget(FDebugLog::ELogTarget::Console);
+
+	FDebugLog::Log(L"EOS AntiCheat Peer Transport Loopback");
+
+	FPeerLoopback::FConfig Config;
+	if (!ParseCommandLine(Argc, Args, Config))
+	{
+		FDebugLog::Close();
+		return 1;
+	}
+
+	FPeerLoopback Loopback(Config);
+	Loopback.Run();
+	Loopback.LogResults();
+
+	const bool bHasErrors = Loopback.HasErrors();
+	FDebugLog::Close();
+	return bHasErrors ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+namespace CommandLineConstants
+{
+	const wchar_t* const ServerPort = L"port";
+	const wchar_t* const ProductId = L"productid";
+	const wchar_t* const SandboxId = L"sandboxid";
+	const wchar_t* const DeploymentId = L"deploymentid";
+	const wchar_t* const ClientId = L"clientid";
+	const wchar_t* const ClientSecret = L"clientsecret";
+}
+
+/**
+ * Stand-in for the samples' FCommandLine (Shared/Source/Utils), used by CMakeLists.txt when the shared utilities are not
+ * part of the checkout. Accepts -name=value and -name value, names are not case sensitive.
+ */
+class FCommandLine
+{
+public:
+	static FCommandLine& Get();
+
+	void Init(wchar_t* CommandLine);
+
+	bool HasParam(const std::wstring& Name) const;
+
+	/** Returns an empty string if the parameter is missing or has no value */
+	std::wstring GetParamValue(const std::wstring& Name) const;
+
+private:
+	static std::wstring ToLower(std::wstring String);
+
+	std::unordered_map<std::wstring, std::wstring> Params;
+};
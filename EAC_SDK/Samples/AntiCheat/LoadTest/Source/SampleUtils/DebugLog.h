@@ -0,0 +1,26 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+/**
+ * Stand-in for the samples' FDebugLog (Shared/Source/Utils), used by CMakeLists.txt when the shared utilities are not
+ * part of the checkout. Writes every message to the console, the other targets are accepted and ignored.
+ */
+class FDebugLog
+{
+public:
+	enum class ELogTarget
+	{
+		Console,
+		File,
+		DebugOutput
+	};
+
+	static void Init();
+	static void Close();
+	static void AddTarget(ELogTarget Target);
+
+	static void Log(const wchar_t* Format, ...);
+	static void LogWarning(const wchar_t* Format, ...);
+	static void LogError(const wchar_t* Format, ...);
+};
@@ -0,0 +1,186 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "CommandLine.h"
+#include "DebugLog.h"
+#include "Settings.h"
+#include "StringUtils.h"
+#include "Utils.h"
+
+#include <codecvt>
+#include <cstdio>
+#include <cwchar>
+#include <cwctype>
+#include <locale>
+#include <mutex>
+
+namespace
+{
+	/** Keeps lines logged by different threads apart */
+	std::mutex LogMutex;
+
+	void LogToConsole(FILE* Stream, const wchar_t* Format, va_list Args)
+	{
+		wchar_t Buffer[4096];
+		if (vswprintf(Buffer, sizeof(Buffer) / sizeof(Buffer[0]), Format, Args) < 0)
+		{
+			// Too long for the buffer, which then holds the truncated message on most C libraries
+			Buffer[sizeof(Buffer) / sizeof(Buffer[0]) - 1] = L'\0';
+		}
+
+		// Written as narrow strings, the console output in Main.cpp uses puts and a stream can't mix both widths
+		const std::string Line = FStringUtils::Narrow(Buffer);
+		std::lock_guard<std::mutex> Lock(LogMutex);
+		fputs(Line.c_str(), Stream);
+		fputc('\n', Stream);
+		fflush(Stream);
+	}
+
+#ifdef _WIN32
+	using FUtf8Converter = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>;
+#else
+	using FUtf8Converter = std::wstring_convert<std::codecvt_utf8<wchar_t>>;
+#endif
+}
+
+void FDebugLog::Init()
+{
+}
+
+void FDebugLog::Close()
+{
+}
+
+void FDebugLog::AddTarget(ELogTarget Target)
+{
+}
+
+void FDebugLog::Log(const wchar_t* Format, ...)
+{
+	va_list Args;
+	va_start(Args, Format);
+	LogToConsole(stdout, Format, Args);
+	va_end(Args);
+}
+
+void FDebugLog::LogWarning(const wchar_t* Format, ...)
+{
+	va_list Args;
+	va_start(Args, Format);
+	LogToConsole(stderr, Format, Args);
+	va_end(Args);
+}
+
+void FDebugLog::LogError(const wchar_t* Format, ...)
+{
+	va_list Args;
+	va_start(Args, Format);
+	LogToConsole(stderr, Format, Args);
+	va_end(Args);
+}
+
+FCommandLine& FCommandLine::Get()
+{
+	static FCommandLine Instance;
+	return Instance;
+}
+
+void FCommandLine::Init(wchar_t* CommandLine)
+{
+	Params.clear();
+
+	// Split at whitespace, the callers join their arguments with spaces
+	std::vector<std::wstring> Tokens;
+	std::wstring Token;
+	for (const wchar_t* Char = CommandLine; *Char != L'\0'; ++Char)
+	{
+		if (iswspace(*Char))
+		{
+			if (!Token.empty())
+			{
+				Tokens.push_back(std::move(Token));
+				Token.clear();
+			}
+		}
+		else
+		{
+			Token += *Char;
+		}
+	}
+	if (!Token.empty())
+	{
+		Tokens.push_back(std::move(Token));
+	}
+
+	for (size_t Index = 0; Index < Tokens.size(); ++Index)
+	{
+		const std::wstring& Param = Tokens[Index];
+		if (Param.size() < 2 || Param[0] != L'-')
+		{
+			continue;
+		}
+
+		const size_t Equals = Param.find(L'=');
+		if (Equals != std::wstring::npos)
+		{
+			Params[ToLower(Param.substr(1, Equals - 1))] = Param.substr(Equals + 1);
+		}
+		else if (Index + 1 < Tokens.size() && Tokens[Index + 1][0] != L'-')
+		{
+			Params[ToLower(Param.substr(1))] = Tokens[Index + 1];
+			++Index;
+		}
+		else
+		{
+			Params[ToLower(Param.substr(1))] = std::wstring();
+		}
+	}
+}
+
+bool FCommandLine::HasParam(const std::wstring& Name) const
+{
+	return Params.find(ToLower(Name)) != Params.end();
+}
+
+std::wstring FCommandLine::GetParamValue(const std::wstring& Name) const
+{
+	auto ParamItr = Params.find(ToLower(Name));
+	return ParamItr != Params.end() ? ParamItr->second : std::wstring();
+}
+
+std::wstring FCommandLine::ToLower(std::wstring String)
+{
+	std::transform(String.begin(), String.end(), String.begin(), [](wchar_t Char) { return static_cast<wchar_t>(towlower(Char)); });
+	return String;
+}
+
+FSettings& FSettings::Get()
+{
+	static FSettings Instance;
+	return Instance;
+}
+
+void FSettings::Init()
+{
+}
+
+std::wstring FStringUtils::Widen(const std::string& String)
+{
+	FUtf8Converter Converter("?", L"?");
+	return Converter.from_bytes(String);
+}
+
+std::string FStringUtils::Narrow(const std::wstring& String)
+{
+	FUtf8Converter Converter("?", L"?");
+	return Converter.to_bytes(String);
+}
+
+const char* FUtils::GetTempDirectory()
+{
+#ifdef _WIN32
+	return ".";
+#else
+	return "/tmp";
+#endif
+}
@@ -0,0 +1,12 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+/** Stand-in for the samples' FSettings (Shared/Source/Utils). The load test tools have no settings file. */
+class FSettings
+{
+public:
+	static FSettings& Get();
+
+	void Init();
+};
@@ -0,0 +1,13 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <string>
+
+/** Stand-in for the samples' FStringUtils (Shared/Source/Utils), converts between UTF-8 and wide strings */
+class FStringUtils
+{
+public:
+	static std::wstring Widen(const std::string& String);
+	static std::string Narrow(const std::wstring& String);
+};
@@ -0,0 +1,11 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+/** Stand-in for the samples' FUtils (Shared/Source/Utils) */
+class FUtils
+{
+public:
+	/** Directory the EOS SDK keeps its cache in */
+	static const char* GetTempDirectory();
+};
@@ -0,0 +1,30 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+#include <stdarg.h>
+
+// Linux does not have _DEBUG in debug builds
+#if !defined(NDEBUG) && !defined(_DEBUG)
+#define _DEBUG
+#endif
+
+#ifndef _WIN32
+typedef wchar_t WCHAR;
+typedef wchar_t* LPWSTR, *PWSTR;
+#define sprintf_s snprintf
+#define __cdecl
+#define wsprintf(BUF, FMT, ...) swprintf(BUF, sizeof(BUF)/sizeof(wchar_t), FMT, __VA_ARGS__)
+#define OutputDebugStringW(STRING) wprintf(STRING)
+#endif // !_WIN32
+
+using LoadTestTimePoint = std::chrono::time_point<std::chrono::steady_clock>;
@@ -2,38 +2,115 @@
 
 #include "pch.h"
 #include "AntiCheatNetworkTransport.h"
+#include "DebugLog.h"
+#include "MessageCompression.h"
 
-FAntiCheatNetworkTransport::FAntiCheatNetworkTransport()
-	: TCPClient(10, 4096)
+FAntiCheatNetworkTransport::~FAntiCheatNetworkTransport()
 {
-	TCPClient.SetOnBufferReceivedCallback([this](void* From, char* Buffer, size_t Length) { Receive(From, Buffer, Length); });
-	TCPClient.SetOnClientDisconnectedCallback([this](void* Which) { OnClientDisconnectedCallback(Which); });
-	TCPClient.Open(1234);
+	Stop();
+}
+
+bool FAntiCheatNetworkTransport::Start(uint16_t Port, size_t NumNetworkThreads)
+{
+#if !TCPCLIENT_USE_EPOLL
+	// Without epoll the listen port cannot be shared between TCP clients
+	NumNetworkThreads = 1;
+#endif
+	NumNetworkThreads = std::max<size_t>(NumNetworkThreads, 1);
+
+	for (size_t WorkerIndex = 0; WorkerIndex < NumNetworkThreads; ++WorkerIndex)
+	{
+		Workers.push_back(std::unique_ptr<FAntiCheatNetworkWorker>(new FAntiCheatNetworkWorker(WorkerIndex, NumNetworkThreads, OnIncomingEventsCallback)));
+		if (!Workers.back()->Start(Port, NumNetworkThreads > 1, bUseIoUring, SendQueueSettings))
+		{
+			Stop();
+			return false;
+		}
+	}
+	WorkersToWake.assign(NumNetworkThreads, false);
+
+	return true;
+}
+
+void FAntiCheatNetworkTransport::Stop()
+{
+	for (std::unique_ptr<FAntiCheatNetworkWorker>& Worker : Workers)
+	{
+		Worker->Stop();
+	}
+	Workers.clear();
+	WorkersToWake.clear();
+
+	OutgoingBatches.clear();
+	ClientsWithOutgoingBatch.clear();
+	CompressionClients.clear();
+
+	StopCapture();
+}
+
+bool FAntiCheatNetworkTransport::StartCapture(const std::string& FilePath)
+{
+	return Capture.Open(FilePath);
+}
+
+void FAntiCheatNetworkTransport::StopCapture()
+{
+	Capture.Close();
+}
+
+FTCPClient::FSendQueueStats FAntiCheatNetworkTransport::GetSendQueueStats() const
+{
+	FTCPClient::FSendQueueStats Stats;
+	for (const std::unique_ptr<FAntiCheatNetworkWorker>& Worker : Workers)
+	{
+		const FTCPClient::FSendQueueStats WorkerStats = Worker->GetSendQueueStats();
+		Stats.QueuedBytes += WorkerStats.QueuedBytes;
+		// Each worker has its own peak, the peaks were not necessarily reached at the same time
+		Stats.PeakQueuedBytes = std::max(Stats.PeakQueuedBytes, WorkerStats.PeakQueuedBytes);
+		Stats.TotalQueuedBytes += WorkerStats.TotalQueuedBytes;
+		Stats.Stalls += WorkerStats.Stalls;
+		Stats.StallDisconnects += WorkerStats.StallDisconnects;
+		Stats.OverflowDisconnects += WorkerStats.OverflowDisconnects;
+	}
+	return Stats;
 }
 
 void FAntiCheatNetworkTransport::Send(const EOS_AntiCheatCommon_OnClientActionRequiredCallbackInfo* Message)
 {
-	char Buffer[4096] = {};
+	// Only the fixed size fields are written out here, the details string is sent straight from the SDK's memory
+	char Buffer[MessageHeaderSize + sizeof(Message->ClientAction) + sizeof(Message->ActionReasonCode)];
 	size_t BufferPos = {};
 
 	constexpr FMessageType MessageType = FMessageType::ClientActionRequired;
+	const size_t ActionReasonDetailsLength = strlen(Message->ActionReasonDetailsString) + 1;
 	const uint32_t MessageLength = 
 		sizeof(Message->ActionReasonCode) +
 		sizeof(Message->ClientAction) +
-		static_cast<uint32_t>(strlen(Message->ActionReasonDetailsString)) + 1;
+		static_cast<uint32_t>(ActionReasonDetailsLength);
 
 	Write(MessageType, Buffer, BufferPos);
 	Write(MessageLength, Buffer, BufferPos);
 	Write(Message->ClientAction, Buffer, BufferPos);
 	Write(Message->ActionReasonCode, Buffer, BufferPos);
-	Write(Message->ActionReasonDetailsString, strlen(Message->ActionReasonDetailsString) + 1, Buffer, BufferPos);
 
-	TCPClient.Send(Message->ClientHandle, &Buffer, BufferPos);
+	const FTCPSendBuffer SendBuffers[] = {
+		{ Buffer, BufferPos },
+		{ Message->ActionReasonDetailsString, ActionReasonDetailsLength }
+	};
+	SendOrAppendToBatch(Message->ClientHandle, SendBuffers, 2);
 }
 
 void FAntiCheatNetworkTransport::Send(const EOS_AntiCheatCommon_OnMessageToClientCallbackInfo* Message)
 {
-	char Buffer[4096] = {};
+	if (CompressionThreshold > 0 && Message->MessageDataSizeBytes >= CompressionThreshold &&
+		CompressionClients.count(Message->ClientHandle) > 0 &&
+		SendCompressed(Message->ClientHandle, Message->MessageData, Message->MessageDataSizeBytes))
+	{
+		return;
+	}
+
+	// Only the header is written out here, the payload is sent straight from the SDK's memory
+	char Buffer[MessageHeaderSize];
 	size_t BufferPos = {};
 
 	constexpr FMessageType MessageType = FMessageType::Opaque;
@@ -41,50 +118,353 @@ void FAntiCheatNetworkTransport::Send(const EOS_AntiCheatCommon_OnMessageToClien
 
 	Write(MessageType, Buffer, BufferPos);
 	Write(MessageLength, Buffer, BufferPos);
-	Write(Message->MessageData, Message->MessageDataSizeBytes, Buffer, BufferPos);
 
-	TCPClient.Send(Message->ClientHandle, Buffer, BufferPos);
+	const FTCPSendBuffer SendBuffers[] = {
+		{ Buffer, BufferPos },
+		{ Message->MessageData, Message->MessageDataSizeBytes }
+	};
+	SendOrAppendToBatch(Message->ClientHandle, SendBuffers, 2);
+}
+
+bool FAntiCheatNetworkTransport::SendCompressed(void* To, const void* Data, uint32_t DataSize)
+{
+	// Only worth sending if it saves more than the uncompressed size field costs, anything larger fails early
+	const size_t MaxCompressedSize = DataSize - std::min<uint32_t>(DataSize, sizeof(uint32_t) + 1);
+	CompressionBuffer.resize(MaxCompressedSize);
+	const size_t CompressedSize = FMessageCompression::Compress(Data, DataSize, CompressionBuffer.data(), MaxCompressedSize);
+	if (CompressedSize == 0)
+	{
+		++SentCompressionStats.IncompressibleMessages;
+		return false;
+	}
+
+	char Buffer[MessageHeaderSize + sizeof(uint32_t)];
+	size_t BufferPos = {};
+
+	constexpr FMessageType MessageType = FMessageType::CompressedOpaque;
+	const uint32_t MessageLength = sizeof(uint32_t) + static_cast<uint32_t>(CompressedSize);
+
+	Write(MessageType, Buffer, BufferPos);
+	Write(MessageLength, Buffer, BufferPos);
+	Write(DataSize, Buffer, BufferPos);
+
+	const FTCPSendBuffer SendBuffers[] = {
+		{ Buffer, BufferPos },
+		{ CompressionBuffer.data(), CompressedSize }
+	};
+	SendOrAppendToBatch(To, SendBuffers, 2);
+
+	++SentCompressionStats.CompressedMessages;
+	SentCompressionStats.UncompressedBytes += DataSize;
+	SentCompressionStats.CompressedBytes += CompressedSize;
+	return true;
+}
+
+void FAntiCheatNetworkTransport::SendCapabilities(void* To, uint32_t Capabilities)
+{
+	char Buffer[MessageHeaderSize + sizeof(Capabilities)];
+	size_t BufferPos = {};
+
+	constexpr FMessageType MessageType = FMessageType::Capabilities;
+	const uint32_t MessageLength = sizeof(Capabilities);
+
+	Write(MessageType, Buffer, BufferPos);
+	Write(MessageLength, Buffer, BufferPos);
+	Write(Capabilities, Buffer, BufferPos);
+
+	const FTCPSendBuffer SendBuffer = { Buffer, BufferPos };
+	SendOrAppendToBatch(To, &SendBuffer, 1);
+}
+
+void FAntiCheatNetworkTransport::LogCompressionStats() const
+{
+	auto LogStats = [](const wchar_t* Direction, const FCompressionStats& Stats)
+	{
+		if (Stats.CompressedMessages == 0 && Stats.IncompressibleMessages == 0)
+		{
+			return;
+		}
+
+		FDebugLog::Log(L"Compressed %llu opaque messages %ls clients (%llu -> %llu bytes, %.1f%%), %llu incompressible",
+			static_cast<unsigned long long>(Stats.CompressedMessages),
+			Direction,
+			static_cast<unsigned long long>(Stats.UncompressedBytes),
+			static_cast<unsigned long long>(Stats.CompressedBytes),
+			Stats.UncompressedBytes > 0 ? 100.0 * Stats.CompressedBytes / Stats.UncompressedBytes : 0.0,
+			static_cast<unsigned long long>(Stats.IncompressibleMessages));
+	};
+	LogStats(L"to", SentCompressionStats);
+	LogStats(L"from", ReceivedCompressionStats);
 }
 
 void FAntiCheatNetworkTransport::CloseClientConnection(void* ClientHandle)
 {
-	TCPClient.CloseClientConnection(reinterpret_cast<TCPsocket>(ClientHandle));
+	// Messages sent right before closing, such as the client action that caused it, must still go out first
+	FlushOutgoingBatch(ClientHandle);
+
+	FAntiCheatNetworkWorker::FOutgoingCommand Command;
+	Command.Type = FAntiCheatNetworkWorker::FOutgoingCommand::EType::Close;
+	Command.ClientHandle = ClientHandle;
+	PushCommand(std::move(Command));
+}
+
+void FAntiCheatNetworkTransport::PushCommand(FAntiCheatNetworkWorker::FOutgoingCommand Command)
+{
+	if (Workers.empty())
+	{
+		return;
+	}
+
+	const size_t WorkerIndex = FAntiCheatNetworkWorker::GetWorkerIndex(Command.ClientHandle, Workers.size());
+	Workers[WorkerIndex]->PushCommand(std::move(Command));
+	WorkersToWake[WorkerIndex] = true;
+}
+
+void FAntiCheatNetworkTransport::SendOrAppendToBatch(void* To, const FTCPSendBuffer* Buffers, size_t NumBuffers)
+{
+	if (Capture.IsOpen())
+	{
+		Capture.Record(FTransportCapture::ERecordType::Outgoing, To, Buffers, NumBuffers);
+	}
+
+	if (!bCoalesceOutgoingMessages)
+	{
+		SendToWorker(To, Buffers, NumBuffers);
+		return;
+	}
+
+	size_t MessageSize = 0;
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		MessageSize += Buffers[BufferIndex].Length;
+	}
+
+	FOutgoingBatch& Batch = OutgoingBatches[To];
+	if (Batch.NumMessages > 0 && Batch.Data.size() + MessageSize > MaxOutgoingBatchBytes)
+	{
+		// A full batch goes out right away, a single message larger than the limit still gets a batch of its own
+		FlushOutgoingBatch(To);
+	}
+	if (!Batch.bIsWaitingForFlush)
+	{
+		Batch.bIsWaitingForFlush = true;
+		ClientsWithOutgoingBatch.push_back(To);
+	}
+
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		const char* Data = reinterpret_cast<const char*>(Buffers[BufferIndex].Data);
+		Batch.Data.insert(Batch.Data.end(), Data, Data + Buffers[BufferIndex].Length);
+	}
+	++Batch.NumMessages;
+}
+
+void FAntiCheatNetworkTransport::SendToWorker(void* To, const FTCPSendBuffer* Buffers, size_t NumBuffers)
+{
+	if (Workers.empty())
+	{
+		return;
+	}
+
+	// The SDK only guarantees the message memory for the duration of the callback. Whatever the socket does not take
+	// right away is copied for the network thread, usually nothing.
+	FAntiCheatNetworkWorker& Worker = *Workers[FAntiCheatNetworkWorker::GetWorkerIndex(To, Workers.size())];
+	size_t BytesToSkip = Worker.SendDirect(To, Buffers, NumBuffers);
+
+	FAntiCheatNetworkWorker::FOutgoingCommand Command;
+	Command.ClientHandle = To;
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		const size_t Length = Buffers[BufferIndex].Length;
+		if (BytesToSkip >= Length)
+		{
+			BytesToSkip -= Length;
+			continue;
+		}
+
+		const char* Data = reinterpret_cast<const char*>(Buffers[BufferIndex].Data);
+		Command.Data.insert(Command.Data.end(), Data + BytesToSkip, Data + Length);
+		BytesToSkip = 0;
+	}
+
+	if (!Command.Data.empty())
+	{
+		PushCommand(std::move(Command));
+	}
+}
+
+void FAntiCheatNetworkTransport::FlushOutgoingBatch(void* ClientHandle)
+{
+	auto BatchItr = OutgoingBatches.find(ClientHandle);
+	if (BatchItr == OutgoingBatches.end() || BatchItr->second.NumMessages == 0 || Workers.empty())
+	{
+		return;
+	}
+
+	FOutgoingBatch& Batch = BatchItr->second;
+
+	CoalescingStats.Messages += Batch.NumMessages;
+	CoalescingStats.Batches += 1;
+	CoalescingStats.Bytes += Batch.Data.size();
+	CoalescingStats.LargestBatch = std::max(CoalescingStats.LargestBatch, Batch.NumMessages);
+
+	size_t Bucket = 0;
+	while ((Batch.NumMessages >> (Bucket + 1)) != 0 && Bucket + 1 < FCoalescingStats::NumHistogramBuckets)
+	{
+		++Bucket;
+	}
+	++CoalescingStats.BatchSizeHistogram[Bucket];
+
+	Batch.NumMessages = 0;
+
+	// Usually the socket takes the whole batch and its storage is reused for the next one. Otherwise the unsent rest
+	// moves on to the network thread.
+	const FTCPSendBuffer BatchBuffer = { Batch.Data.data(), Batch.Data.size() };
+	FAntiCheatNetworkWorker& Worker = *Workers[FAntiCheatNetworkWorker::GetWorkerIndex(ClientHandle, Workers.size())];
+	const size_t BytesSent = Worker.SendDirect(ClientHandle, &BatchBuffer, 1);
+	if (BytesSent == Batch.Data.size())
+	{
+		Batch.Data.clear();
+		return;
+	}
+
+	Batch.Data.erase(Batch.Data.begin(), Batch.Data.begin() + BytesSent);
+
+	FAntiCheatNetworkWorker::FOutgoingCommand Command;
+	Command.ClientHandle = ClientHandle;
+	Command.Data = std::move(Batch.Data);
+	PushCommand(std::move(Command));
+
+	Batch.Data.clear();
+}
+
+void FAntiCheatNetworkTransport::SetCoalesceOutgoingMessages(bool bEnabled, size_t MaxBatchBytes)
+{
+	if (!bEnabled)
+	{
+		FlushOutgoingMessages();
+	}
+	bCoalesceOutgoingMessages = bEnabled;
+	MaxOutgoingBatchBytes = MaxBatchBytes;
+}
+
+void FAntiCheatNetworkTransport::FlushOutgoingMessages()
+{
+	for (void* ClientHandle : ClientsWithOutgoingBatch)
+	{
+		FlushOutgoingBatch(ClientHandle);
+
+		auto BatchItr = OutgoingBatches.find(ClientHandle);
+		if (BatchItr != OutgoingBatches.end())
+		{
+			BatchItr->second.bIsWaitingForFlush = false;
+		}
+	}
+	ClientsWithOutgoingBatch.clear();
+
+	// One wake up per network thread and flush, no matter how many commands it was given
+	for (size_t WorkerIndex = 0; WorkerIndex < WorkersToWake.size(); ++WorkerIndex)
+	{
+		if (WorkersToWake[WorkerIndex])
+		{
+			WorkersToWake[WorkerIndex] = false;
+			Workers[WorkerIndex]->Wake();
+		}
+	}
+}
+
+bool FAntiCheatNetworkTransport::ReadString(char* Buffer, size_t EndPosition, const char*& OutString, size_t& Position)
+{
+	// Strings are sent with their null terminator, which must lie within the message
+	const void* Terminator = memchr(&Buffer[Position], '\0', EndPosition - Position);
+	if (!Terminator)
+	{
+		return false;
+	}
+
+	OutString = Read<char*>(Buffer, static_cast<const char*>(Terminator) - &Buffer[Position] + 1, Position);
+	return true;
 }
 
-size_t FAntiCheatNetworkTransport::ProcessMessage(void* From, char* Buffer, size_t StartPosition)
+bool FAntiCheatNetworkTransport::ProcessMessage(void* From, char* Message, size_t MessageSize)
 {
-	size_t Position = StartPosition;
+	size_t Position = 0;
 
-	const FMessageType MessageType = Read<FMessageType>(Buffer, Position);
-	const uint32_t MessageLength = Read<uint32_t>(Buffer, Position);
+	const FMessageType MessageType = Read<FMessageType>(Message, Position);
+	const uint32_t MessageLength = Read<uint32_t>(Message, Position);
 
 	if (MessageType == FMessageType::Opaque)
 	{
-		const char* Message = Read<char*>(Buffer, MessageLength, Position);
-		OnNewMessageCallback(From, Message, MessageLength);
+		const char* Data = Read<char*>(Message, MessageLength, Position);
+		OnNewMessageCallback(From, Data, MessageLength);
 	}
 	else if (MessageType == FMessageType::RegistrationInfo)
 	{
-		FRegistrationInfoMessage Message = {};
-		Message.ProductUserId = Read<char*>(Buffer, strlen(Buffer + Position) + 1, Position);
-		Message.EOSConnectIdTokenJWT = Read<char*>(Buffer, strlen(Buffer + Position) + 1, Position);
-		Message.ClientPlatform = Read<EOS_EAntiCheatCommonClientPlatform>(Buffer, Position);
-		OnNewClientCallback(From, Message);
+		FRegistrationInfoMessage RegistrationInfo = {};
+		if (!ReadString(Message, MessageSize, RegistrationInfo.ProductUserId, Position) ||
+			!ReadString(Message, MessageSize, RegistrationInfo.EOSConnectIdTokenJWT, Position) ||
+			MessageSize - Position < sizeof(RegistrationInfo.ClientPlatform))
+		{
+			FDebugLog::LogError(L"AntiCheatNetworkTransport: Malformed registration message");
+			return false;
+		}
+		RegistrationInfo.ClientPlatform = Read<EOS_EAntiCheatCommonClientPlatform>(Message, Position);
+		if (MessageSize - Position >= sizeof(RegistrationInfo.Capabilities))
+		{
+			RegistrationInfo.Capabilities = Read<uint32_t>(Message, Position);
+		}
+
+		// Confirmed before the SDK learns about the client, so the client knows before the first opaque message arrives
+		if ((RegistrationInfo.Capabilities & CapabilityCompression) != 0 && CompressionThreshold > 0)
+		{
+			CompressionClients.insert(From);
+			SendCapabilities(From, CapabilityCompression);
+		}
+
+		OnNewClientCallback(From, RegistrationInfo);
+	}
+	else if (MessageType == FMessageType::CompressedOpaque)
+	{
+		return ProcessCompressedMessage(From, Message, MessageSize);
+	}
+	else
+	{
+		FDebugLog::LogWarning(L"AntiCheatNetworkTransport: Ignoring message of unknown type %d", static_cast<int>(MessageType));
 	}
 
-	return Position - StartPosition;
+	return true;
 }
 
-void FAntiCheatNetworkTransport::Receive(void* From, char* Buffer, size_t Length)
+bool FAntiCheatNetworkTransport::ProcessCompressedMessage(void* From, char* Message, size_t MessageSize)
 {
-	size_t Position = 0;
-	size_t BytesRemaining = Length;
-	while (BytesRemaining > 0)
+	size_t Position = MessageHeaderSize;
+	if (CompressionClients.count(From) == 0 || MessageSize - Position < sizeof(uint32_t))
+	{
+		FDebugLog::LogError(L"AntiCheatNetworkTransport: Unexpected compressed message");
+		return false;
+	}
+
+	const uint32_t UncompressedSize = Read<uint32_t>(Message, Position);
+	const size_t CompressedSize = MessageSize - Position;
+	if (UncompressedSize > FAntiCheatNetworkWorker::MaxMessagePayloadSize)
 	{
-		const size_t BytesRead = ProcessMessage(From, Buffer, Position);
-		Position += BytesRead;
-		BytesRemaining -= BytesRead;
+		FDebugLog::LogError(L"AntiCheatNetworkTransport: Compressed message of %u bytes exceeds the maximum", UncompressedSize);
+		return false;
 	}
+
+	DecompressionBuffer.resize(UncompressedSize);
+	if (!FMessageCompression::Decompress(&Message[Position], CompressedSize, DecompressionBuffer.data(), UncompressedSize))
+	{
+		FDebugLog::LogError(L"AntiCheatNetworkTransport: Malformed compressed message");
+		return false;
+	}
+
+	++ReceivedCompressionStats.CompressedMessages;
+	ReceivedCompressionStats.UncompressedBytes += UncompressedSize;
+	ReceivedCompressionStats.CompressedBytes += CompressedSize;
+
+	OnNewMessageCallback(From, DecompressionBuffer.data(), UncompressedSize);
+	return true;
 }
 
 FAntiCheatNetworkTransport& FAntiCheatNetworkTransport::GetInstance()
@@ -95,7 +475,43 @@ FAntiCheatNetworkTransport& FAntiCheatNetworkTransport::GetInstance()
 
 void FAntiCheatNetworkTransport::Update()
 {
-	TCPClient.Update();
+	FAntiCheatNetworkWorker::FIncomingEvent Event;
+	for (const std::unique_ptr<FAntiCheatNetworkWorker>& Worker : Workers)
+	{
+		while (Worker->PopEvent(Event))
+		{
+			if (Event.Type == FAntiCheatNetworkWorker::FIncomingEvent::EType::Disconnected)
+			{
+				if (Capture.IsOpen())
+				{
+					Capture.Record(FTransportCapture::ERecordType::Disconnected, Event.ClientHandle, nullptr, 0);
+				}
+
+				OutgoingBatches.erase(Event.ClientHandle);
+				CompressionClients.erase(Event.ClientHandle);
+				OnClientDisconnectedCallback(Event.ClientHandle);
+				continue;
+			}
+
+			if (Capture.IsOpen())
+			{
+				const FTCPSendBuffer Message = { Event.Message.data(), Event.Message.size() };
+				Capture.Record(FTransportCapture::ERecordType::Incoming, Event.ClientHandle, &Message, 1);
+			}
+
+			if (!ProcessMessage(Event.ClientHandle, Event.Message.data(), Event.Message.size()))
+			{
+				CloseClientConnection(Event.ClientHandle);
+			}
+
+			Worker->RecycleMessage(std::move(Event.Message));
+		}
+	}
+}
+
+void FAntiCheatNetworkTransport::SetOnIncomingEventsCallback(FOnIncomingEventsCallback Callback)
+{
+	OnIncomingEventsCallback = std::move(Callback);
 }
 
 void FAntiCheatNetworkTransport::SetOnNewMessageCallback(FOnNewMessageCallback Callback)
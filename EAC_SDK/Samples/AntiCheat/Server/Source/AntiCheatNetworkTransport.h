@@ -3,19 +3,70 @@
 #pragma once
 
 #include "eos_anticheatserver_types.h"
-#include "TCPClient.h"
+#include "AntiCheatNetworkWorker.h"
+#include "TransportCapture.h"
 
 #include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <type_traits>
 
+/**
+ * Anti-cheat message transport. Sockets are served by a number of network threads (see FAntiCheatNetworkWorker),
+ * while all callbacks run on the thread calling Update, which is the thread owning the EOS SDK.
+ */
 class FAntiCheatNetworkTransport
 {
 public:
+	/** Optional protocol features, announced by the client in its registration and confirmed by the server */
+	static constexpr uint32_t CapabilityCompression = 1 << 0;
+
 	struct FRegistrationInfoMessage
 	{
 		const char* ProductUserId = nullptr;
 		const char* EOSConnectIdTokenJWT = nullptr;
 		EOS_EAntiCheatCommonClientPlatform ClientPlatform = EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Unknown;
+
+		/** Capability flags, 0 for clients that predate them and end the message after ClientPlatform */
+		uint32_t Capabilities = 0;
+	};
+
+	/** Batch size counters of the outgoing message coalescing, see SetCoalesceOutgoingMessages */
+	struct FCoalescingStats
+	{
+		/** Number of buckets in BatchSizeHistogram, the last bucket also counts all larger batches */
+		static constexpr size_t NumHistogramBuckets = 8;
+
+		/** Messages that went through a batch */
+		uint64_t Messages = 0;
+
+		/** Batches flushed, each one a single send to the TCP client */
+		uint64_t Batches = 0;
+
+		/** Bytes flushed, including message headers */
+		uint64_t Bytes = 0;
+
+		/** Most messages flushed in a single batch */
+		uint32_t LargestBatch = 0;
+
+		/** Batches by number of messages, bucket N counts batches of 2^N to 2^(N+1)-1 messages */
+		uint64_t BatchSizeHistogram[NumHistogramBuckets] = {};
+	};
+
+	/** Savings of the opaque message compression in one direction, see SetCompressionThreshold */
+	struct FCompressionStats
+	{
+		/** Opaque messages that went over the wire compressed */
+		uint64_t CompressedMessages = 0;
+
+		/** Opaque messages that qualified for compression but did not get smaller, and were sent as they are */
+		uint64_t IncompressibleMessages = 0;
+
+		/** Payload bytes of the compressed messages before and after compression */
+		uint64_t UncompressedBytes = 0;
+		uint64_t CompressedBytes = 0;
 	};
 
 	static FAntiCheatNetworkTransport& GetInstance();
@@ -29,6 +80,22 @@ public:
 	using FOnClientDisconnectedCallback = std::function<void(void*)>;
 	void SetOnClientDisconnectedCallback(FOnClientDisconnectedCallback Callback);
 
+	/** Called from the network threads when there are new events for Update, e.g. to wake up the main loop. Set before Start. */
+	using FOnIncomingEventsCallback = std::function<void()>;
+	void SetOnIncomingEventsCallback(FOnIncomingEventsCallback Callback);
+
+	/**
+	 * Starts the network threads
+	 *
+	 * @param Port - Port to listen on
+	 * @param NumNetworkThreads - Number of network threads. More than one is only supported with epoll.
+	 */
+	bool Start(uint16_t Port, size_t NumNetworkThreads);
+
+	/** Stops the network threads and closes all connections without reporting them as disconnected */
+	void Stop();
+
+	/** Dispatches the messages and disconnects received by the network threads to the callbacks */
 	void Update();
 
 	void Send(const EOS_AntiCheatCommon_OnClientActionRequiredCallbackInfo* Message);
@@ -36,11 +103,57 @@ public:
 
 	void CloseClientConnection(void* ClientHandle);
 
-private:
-	FAntiCheatNetworkTransport();
+	/**
+	 * Messages are handed to the network threads on FlushOutgoingMessages, meant to be called once per EOS_Platform_Tick.
+	 * When coalescing is enabled, the messages for a client are appended to a batch which goes out as a single send.
+	 * A batch holds whole messages and is sent early once the next message would grow it past MaxBatchBytes.
+	 */
+	void SetCoalesceOutgoingMessages(bool bEnabled, size_t MaxBatchBytes);
+	void FlushOutgoingMessages();
+	const FCoalescingStats& GetCoalescingStats() const { return CoalescingStats; }
+
+	/**
+	 * Opaque messages of at least MinMessageSize bytes are compressed for clients that announced CapabilityCompression,
+	 * if that makes them smaller. Such clients are also told they may compress their own messages. 0 turns compression
+	 * off for clients registering afterwards.
+	 */
+	void SetCompressionThreshold(uint32_t MinMessageSize) { CompressionThreshold = MinMessageSize; }
+	const FCompressionStats& GetSentCompressionStats() const { return SentCompressionStats; }
+	const FCompressionStats& GetReceivedCompressionStats() const { return ReceivedCompressionStats; }
+	void LogCompressionStats() const;
+
+	/**
+	 * Backpressure limits for clients that do not read their messages fast enough. Set before Start.
+	 * Only applied on Linux, see FTCPClient::FSendQueueSettings.
+	 */
+	void SetSendQueueSettings(const FTCPClient::FSendQueueSettings& Settings) { SendQueueSettings = Settings; }
+
+	/** Lets the network threads use io_uring where the kernel supports it, see FTCPClient::Open. Set before Start. */
+	void SetUseIoUring(bool bEnabled) { bUseIoUring = bEnabled; }
+
+	/** Send queue counters summed over all network threads, except PeakQueuedBytes which is the highest peak of any of them */
+	FTCPClient::FSendQueueStats GetSendQueueStats() const;
+
+	/**
+	 * Records every message received from and sent to clients, and every disconnect, into the given file until
+	 * StopCapture or Stop, see FTransportCapture
+	 */
+	bool StartCapture(const std::string& FilePath);
+	void StopCapture();
 
-	void Receive(void* From, char* Buffer, size_t Length);
-	size_t ProcessMessage(void* From, char* Buffer, size_t StartPosition);
+private:
+	FAntiCheatNetworkTransport() = default;
+	~FAntiCheatNetworkTransport();
+
+	bool ProcessMessage(void* From, char* Message, size_t MessageSize);
+	bool ReadString(char* Buffer, size_t EndPosition, const char*& OutString, size_t& Position);
+	bool ProcessCompressedMessage(void* From, char* Message, size_t MessageSize);
+	bool SendCompressed(void* To, const void* Data, uint32_t DataSize);
+	void SendCapabilities(void* To, uint32_t Capabilities);
+	void SendOrAppendToBatch(void* To, const FTCPSendBuffer* Buffers, size_t NumBuffers);
+	void SendToWorker(void* To, const FTCPSendBuffer* Buffers, size_t NumBuffers);
+	void FlushOutgoingBatch(void* ClientHandle);
+	void PushCommand(FAntiCheatNetworkWorker::FOutgoingCommand Command);
 
 	template<typename T, typename = std::enable_if_t<!std::is_pointer<T>::value>>
 	void Write(T ObjectToWrite, char* Buffer, size_t& Position)
@@ -78,10 +191,61 @@ private:
 	{
 		Opaque = 1,
 		RegistrationInfo = 2,
-		ClientActionRequired = 3
+		ClientActionRequired = 3,
+
+		/** An Opaque message's uncompressed size as uint32_t followed by the compressed payload, see FMessageCompression */
+		CompressedOpaque = 4,
+
+		/** Sent to a client after its registration, with the capability flags the server enabled for it */
+		Capabilities = 5
 	};
 
-	FTCPClient TCPClient;
+	/** Every message starts with its FMessageType and the length of the payload that follows */
+	static constexpr size_t MessageHeaderSize = FAntiCheatNetworkWorker::MessageHeaderSize;
+	static_assert(sizeof(FMessageType) == sizeof(char), "The network threads read the message type as a single byte");
+
+	FTCPClient::FSendQueueSettings SendQueueSettings;
+	bool bUseIoUring = false;
+
+	std::vector<std::unique_ptr<FAntiCheatNetworkWorker>> Workers;
+
+	/** Workers that were given commands since the last flush and have to be woken up */
+	std::vector<bool> WorkersToWake;
+
+	FOnIncomingEventsCallback OnIncomingEventsCallback;
+
+	/** Messages of a single client waiting for the next flush */
+	struct FOutgoingBatch
+	{
+		std::vector<char> Data;
+		uint32_t NumMessages = 0;
+
+		/** Set while the client is in ClientsWithOutgoingBatch */
+		bool bIsWaitingForFlush = false;
+	};
+
+	bool bCoalesceOutgoingMessages = false;
+	size_t MaxOutgoingBatchBytes = 0;
+
+	/** Per client batch, erased on disconnect */
+	std::unordered_map<void*, FOutgoingBatch> OutgoingBatches;
+
+	/** Clients with a non-empty batch, in the order their first message was added */
+	std::vector<void*> ClientsWithOutgoingBatch;
+
+	FCoalescingStats CoalescingStats;
+
+	uint32_t CompressionThreshold = 0;
+
+	/** Clients that were sent CapabilityCompression, erased on disconnect */
+	std::unordered_set<void*> CompressionClients;
+
+	std::vector<char> CompressionBuffer;
+	std::vector<char> DecompressionBuffer;
+	FCompressionStats SentCompressionStats;
+	FCompressionStats ReceivedCompressionStats;
+
+	FTransportCapture Capture;
 
 	FOnNewMessageCallback OnNewMessageCallback;
 	FOnNewClientCallback OnNewClientCallback;
@@ -0,0 +1,409 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "AntiCheatNetworkWorker.h"
+#include "DebugLog.h"
+
+#include <cstring>
+
+constexpr size_t FAntiCheatNetworkWorker::MessageHeaderSize;
+constexpr uint32_t FAntiCheatNetworkWorker::MaxMessagePayloadSize;
+constexpr size_t FAntiCheatNetworkWorker::MaxRecycledMessageCapacity;
+constexpr size_t FAntiCheatNetworkWorker::MaxRecycledMessages;
+
+namespace
+{
+	/**
+	 * Longest time between two TCP client updates when nothing wakes the worker. With epoll this only bounds how late
+	 * send queue stall timeouts are noticed, with SDL_net it is the socket polling interval.
+	 */
+	constexpr std::chrono::milliseconds MaxUpdateInterval(10);
+}
+
+FAntiCheatNetworkWorker::FAntiCheatNetworkWorker(size_t InWorkerIndex, size_t InNumWorkers, std::function<void()> InOnIncomingEventsCallback)
+	: OnIncomingEventsCallback(std::move(InOnIncomingEventsCallback))
+	, TCPClient(10, 4096, InWorkerIndex, InNumWorkers)
+	, Loop(MaxUpdateInterval)
+{
+	TCPClient.SetOnBufferReceivedCallback([this](void* From, char* Buffer, size_t Length) { Receive(From, Buffer, Length); });
+	TCPClient.SetOnClientDisconnectedCallback([this](void* Which) { OnDisconnected(Which); });
+}
+
+FAntiCheatNetworkWorker::~FAntiCheatNetworkWorker()
+{
+	Stop();
+}
+
+bool FAntiCheatNetworkWorker::Start(uint16_t Port, bool bShareListenPort, bool bUseIoUring, const FTCPClient::FSendQueueSettings& SendQueueSettings)
+{
+	TCPClient.SetSendQueueSettings(SendQueueSettings);
+	if (!TCPClient.Open(Port, bShareListenPort, bUseIoUring))
+	{
+		return false;
+	}
+
+#if TCPCLIENT_USE_EPOLL
+	Loop.AddReadableHandle(TCPClient.GetWaitHandle());
+#endif
+
+	bIsRunning = true;
+	Thread = std::thread([this]() { Run(); });
+	return true;
+}
+
+void FAntiCheatNetworkWorker::Stop()
+{
+	if (!Thread.joinable())
+	{
+		return;
+	}
+
+	bIsRunning = false;
+	Loop.Wake();
+	Thread.join();
+
+	{
+		FScopedLock Lock(DirectSendMutex);
+		DirectSendClients.clear();
+	}
+	ClientsWithQueuedSends.clear();
+
+	// Connections closed from here on, e.g. by the TCP client's destructor, are not reported to the SDK thread anymore
+	TCPClient.SetOnClientDisconnectedCallback([](void*) {});
+}
+
+void FAntiCheatNetworkWorker::PushCommand(FOutgoingCommand Command)
+{
+	{
+		// Later messages must not overtake this one through SendDirect
+		FScopedLock Lock(DirectSendMutex);
+		auto StateItr = DirectSendClients.find(Command.ClientHandle);
+		if (StateItr != DirectSendClients.end())
+		{
+			++StateItr->second.NumPendingCommands;
+		}
+	}
+
+	Commands.Push(std::move(Command));
+}
+
+size_t FAntiCheatNetworkWorker::SendDirect(void* ClientHandle, const FTCPSendBuffer* Buffers, size_t NumBuffers)
+{
+#if TCPCLIENT_USE_EPOLL
+	// The lock keeps the worker thread from closing the socket while it is written to
+	FScopedLock Lock(DirectSendMutex);
+	auto StateItr = DirectSendClients.find(ClientHandle);
+	if (StateItr == DirectSendClients.end() || StateItr->second.NumPendingCommands > 0 || StateItr->second.bHasQueuedSends)
+	{
+		return 0;
+	}
+
+	// A failed write leaves the rest to the worker thread, whose own write fails as well and closes the connection
+	size_t BytesSent = 0;
+	FTCPClient::WriteToSocket(StateItr->second.Socket, Buffers, NumBuffers, DirectSendVectors, BytesSent);
+	return BytesSent;
+#else
+	return 0;
+#endif
+}
+
+void FAntiCheatNetworkWorker::Wake()
+{
+	Loop.Wake();
+}
+
+bool FAntiCheatNetworkWorker::PopEvent(FIncomingEvent& OutEvent)
+{
+	return IncomingEvents.Pop(OutEvent);
+}
+
+void FAntiCheatNetworkWorker::RecycleMessage(std::vector<char> Message)
+{
+	// Freed right here rather than sent back just to be dropped by ReleaseMessage
+	if (Message.capacity() == 0 || Message.capacity() > MaxRecycledMessageCapacity)
+	{
+		return;
+	}
+
+	RecycledMessages.Push(std::move(Message));
+}
+
+size_t FAntiCheatNetworkWorker::GetWorkerIndex(void* ClientHandle, size_t NumWorkers)
+{
+	return FSlotMapHandle::GetIndexField(ClientHandle) % NumWorkers;
+}
+
+FTCPClient::FSendQueueStats FAntiCheatNetworkWorker::GetSendQueueStats() const
+{
+	FScopedLock Lock(StatsMutex);
+	return SendQueueStats;
+}
+
+void FAntiCheatNetworkWorker::Run()
+{
+	while (bIsRunning)
+	{
+		Loop.Wait();
+
+		ProcessCommands();
+
+		Loop.BeginTick();
+		TCPClient.Update();
+		Loop.EndTick();
+
+		if (bHasPushedEvents)
+		{
+			bHasPushedEvents = false;
+			OnIncomingEventsCallback();
+		}
+
+		if (!ClientsWithQueuedSends.empty())
+		{
+			UpdateClientsWithQueuedSends();
+		}
+
+#if TCPCLIENT_USE_EPOLL
+		// Data left behind by the receive budget does not make the wait handle readable again
+		if (TCPClient.HasPendingData())
+		{
+			Loop.Wake();
+		}
+#endif
+
+		{
+			FScopedLock Lock(StatsMutex);
+			SendQueueStats = TCPClient.GetSendQueueStats();
+		}
+	}
+}
+
+void FAntiCheatNetworkWorker::ProcessCommands()
+{
+	FOutgoingCommand Command;
+	while (Commands.Pop(Command))
+	{
+		// Commands for clients that disconnected in the meantime are dropped by the TCP client, their handles are stale
+		if (Command.Type == FOutgoingCommand::EType::Send)
+		{
+			TCPClient.Send(Command.ClientHandle, Command.Data.data(), Command.Data.size());
+		}
+		else
+		{
+			TCPClient.CloseClientConnection(Command.ClientHandle);
+		}
+
+#if TCPCLIENT_USE_EPOLL
+		// Closed clients were already removed by OnDisconnected
+		FScopedLock Lock(DirectSendMutex);
+		auto StateItr = DirectSendClients.find(Command.ClientHandle);
+		if (StateItr != DirectSendClients.end())
+		{
+			FDirectSendState& State = StateItr->second;
+			--State.NumPendingCommands;
+			if (!State.bHasQueuedSends && TCPClient.HasQueuedSends(Command.ClientHandle))
+			{
+				State.bHasQueuedSends = true;
+				ClientsWithQueuedSends.push_back(Command.ClientHandle);
+			}
+		}
+#endif
+	}
+}
+
+void FAntiCheatNetworkWorker::UpdateClientsWithQueuedSends()
+{
+#if TCPCLIENT_USE_EPOLL
+	// SendDirect may write to a client again once its send queue has drained
+	FScopedLock Lock(DirectSendMutex);
+	erase_if(ClientsWithQueuedSends, [this](void* ClientHandle)
+	{
+		auto StateItr = DirectSendClients.find(ClientHandle);
+		if (StateItr == DirectSendClients.end())
+		{
+			return true;
+		}
+		if (TCPClient.HasQueuedSends(ClientHandle))
+		{
+			return false;
+		}
+		StateItr->second.bHasQueuedSends = false;
+		return true;
+	});
+#endif
+}
+
+void FAntiCheatNetworkWorker::AddDirectSendClient(void* ClientHandle)
+{
+#if TCPCLIENT_USE_EPOLL
+	if (TCPClient.IsUsingIoUring())
+	{
+		return;
+	}
+
+	FScopedLock Lock(DirectSendMutex);
+	DirectSendClients[ClientHandle].Socket = TCPClient.GetClientSocket(ClientHandle);
+#endif
+}
+
+void FAntiCheatNetworkWorker::OnDisconnected(void* Which)
+{
+	{
+		// The TCP client closes the socket right after this returns
+		FScopedLock Lock(DirectSendMutex);
+		DirectSendClients.erase(Which);
+	}
+
+	auto ConnectionItr = Connections.find(Which);
+	if (ConnectionItr == Connections.end())
+	{
+		return;
+	}
+
+	ReleaseMessage(std::move(ConnectionItr->second.PartialMessage));
+
+	FIncomingEvent Event;
+	Event.Type = FIncomingEvent::EType::Disconnected;
+	Event.ClientHandle = Which;
+	IncomingEvents.Push(std::move(Event));
+	bHasPushedEvents = true;
+
+	Connections.erase(ConnectionItr);
+}
+
+bool FAntiCheatNetworkWorker::ReadMessageSize(const char* Header, size_t& OutMessageSize)
+{
+	uint32_t MessageLength = 0;
+	memcpy(&MessageLength, &Header[sizeof(char)], sizeof(MessageLength));
+	if (MessageLength > MaxMessagePayloadSize)
+	{
+		FDebugLog::LogError(L"AntiCheatNetworkWorker: Message of %u bytes exceeds the maximum of %u bytes", MessageLength, MaxMessagePayloadSize);
+		return false;
+	}
+
+	OutMessageSize = MessageHeaderSize + MessageLength;
+	return true;
+}
+
+void FAntiCheatNetworkWorker::PushMessage(void* ClientHandle, std::vector<char> Message)
+{
+	FIncomingEvent Event;
+	Event.Type = FIncomingEvent::EType::Message;
+	Event.ClientHandle = ClientHandle;
+	Event.Message = std::move(Message);
+	IncomingEvents.Push(std::move(Event));
+	bHasPushedEvents = true;
+}
+
+std::vector<char> FAntiCheatNetworkWorker::AcquireMessage()
+{
+	if (FreeMessages.empty())
+	{
+		// Take over everything the SDK thread handed back since the free list last ran dry
+		std::vector<char> Message;
+		while (RecycledMessages.Pop(Message))
+		{
+			ReleaseMessage(std::move(Message));
+		}
+
+		if (FreeMessages.empty())
+		{
+			return std::vector<char>();
+		}
+	}
+
+	std::vector<char> Message = std::move(FreeMessages.back());
+	FreeMessages.pop_back();
+	return Message;
+}
+
+void FAntiCheatNetworkWorker::ReleaseMessage(std::vector<char> Message)
+{
+	if (Message.capacity() == 0 || Message.capacity() > MaxRecycledMessageCapacity || FreeMessages.size() >= MaxRecycledMessages)
+	{
+		return;
+	}
+
+	Message.clear();
+	FreeMessages.push_back(std::move(Message));
+}
+
+void FAntiCheatNetworkWorker::Receive(void* From, char* Buffer, size_t Length)
+{
+	// Created on the first data from a new connection, which is also before the SDK thread can send anything to it
+	auto ConnectionItr = Connections.find(From);
+	if (ConnectionItr == Connections.end())
+	{
+		ConnectionItr = Connections.emplace(From, FConnection()).first;
+		AddDirectSendClient(From);
+	}
+	FConnection& Connection = ConnectionItr->second;
+
+	// TCP is a byte stream, so a single receive can hold several messages and a message can be split across receives.
+	// Messages are copied out of the receive buffer once, into the event that carries them to the SDK thread. A trailing
+	// partial message is kept in the connection and completed from the following receives. The buffers come from the
+	// ones the SDK thread recycled, so once enough of them circulate receiving allocates nothing.
+	size_t Position = 0;
+
+	std::vector<char>& PartialMessage = Connection.PartialMessage;
+	if (!PartialMessage.empty())
+	{
+		// Complete the header first, then the rest of the message
+		if (PartialMessage.size() < MessageHeaderSize)
+		{
+			const size_t BytesToCopy = std::min(MessageHeaderSize - PartialMessage.size(), Length);
+			PartialMessage.insert(PartialMessage.end(), Buffer, Buffer + BytesToCopy);
+			Position += BytesToCopy;
+
+			if (PartialMessage.size() < MessageHeaderSize)
+			{
+				return;
+			}
+		}
+
+		size_t MessageSize = 0;
+		if (!ReadMessageSize(PartialMessage.data(), MessageSize))
+		{
+			TCPClient.CloseClientConnection(From);
+			return;
+		}
+
+		PartialMessage.reserve(MessageSize);
+		const size_t BytesToCopy = std::min(MessageSize - PartialMessage.size(), Length - Position);
+		PartialMessage.insert(PartialMessage.end(), Buffer + Position, Buffer + Position + BytesToCopy);
+		Position += BytesToCopy;
+
+		if (PartialMessage.size() < MessageSize)
+		{
+			return;
+		}
+
+		PushMessage(From, std::move(PartialMessage));
+		PartialMessage = std::vector<char>();
+	}
+
+	while (Length - Position >= MessageHeaderSize)
+	{
+		size_t MessageSize = 0;
+		if (!ReadMessageSize(&Buffer[Position], MessageSize))
+		{
+			TCPClient.CloseClientConnection(From);
+			return;
+		}
+
+		if (Length - Position < MessageSize)
+		{
+			break;
+		}
+
+		std::vector<char> Message = AcquireMessage();
+		Message.assign(Buffer + Position, Buffer + Position + MessageSize);
+		PushMessage(From, std::move(Message));
+		Position += MessageSize;
+	}
+
+	if (Position < Length)
+	{
+		PartialMessage = AcquireMessage();
+		PartialMessage.assign(Buffer + Position, Buffer + Length);
+	}
+}
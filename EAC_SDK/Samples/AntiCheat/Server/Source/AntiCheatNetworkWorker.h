@@ -0,0 +1,183 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "NonCopyable.h"
+#include "LockFreeQueue.h"
+#include "ServerLoop.h"
+#include "TCPClient.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Network thread of the anti-cheat transport. Owns an FTCPClient and the connections it accepts, splits the received
+ * byte streams into messages and hands them to the SDK thread. Never calls into the EOS SDK.
+ */
+class FAntiCheatNetworkWorker final : public FNonCopyable
+{
+public:
+	/** A complete message or a disconnect, passed from a network thread to the SDK thread */
+	struct FIncomingEvent
+	{
+		enum class EType
+		{
+			Message,
+			Disconnected
+		};
+
+		EType Type = EType::Message;
+		void* ClientHandle = nullptr;
+
+		/** The whole message including its header, empty for disconnects. Hand it back with RecycleMessage once processed. */
+		std::vector<char> Message;
+	};
+
+	/** Data to send or a connection to close, passed from the SDK thread to the network thread owning the client */
+	struct FOutgoingCommand
+	{
+		enum class EType
+		{
+			Send,
+			Close
+		};
+
+		EType Type = EType::Send;
+		void* ClientHandle = nullptr;
+
+		/** One or more complete messages, empty for Close */
+		std::vector<char> Data;
+	};
+
+	/** Every message starts with a one byte message type and the length of the payload that follows */
+	static constexpr size_t MessageHeaderSize = sizeof(char) + sizeof(uint32_t);
+
+	/** Largest accepted payload. Anti-cheat payloads are opaque, so this only guards against corrupt or hostile length fields. */
+	static constexpr uint32_t MaxMessagePayloadSize = 1024 * 1024;
+
+	/** Message buffers with more capacity than this are freed instead of recycled, so rare large messages don't pin memory */
+	static constexpr size_t MaxRecycledMessageCapacity = 16 * 1024;
+
+	/** Most message buffers a worker keeps for reuse, enough for the messages of several loop iterations */
+	static constexpr size_t MaxRecycledMessages = 4096;
+
+	/**
+	 * Constructor
+	 *
+	 * @param InWorkerIndex - Index of this worker, encoded into the handles of its clients, see GetWorkerIndex
+	 * @param InNumWorkers - Total number of workers
+	 * @param InOnIncomingEventsCallback - Called on the worker thread after it pushed new events, see PopEvent
+	 */
+	FAntiCheatNetworkWorker(size_t InWorkerIndex, size_t InNumWorkers, std::function<void()> InOnIncomingEventsCallback);
+	~FAntiCheatNetworkWorker();
+
+	/** Starts listening and runs the worker thread. Several workers listen on the same port with SO_REUSEPORT. */
+	bool Start(uint16_t Port, bool bShareListenPort, bool bUseIoUring, const FTCPClient::FSendQueueSettings& SendQueueSettings);
+	void Stop();
+
+	/** Queues a command for the worker thread. Must only be called from the SDK thread, takes effect after Wake. */
+	void PushCommand(FOutgoingCommand Command);
+	void Wake();
+
+	/** Takes the oldest message or disconnect of the worker's clients. Must only be called from the SDK thread. */
+	bool PopEvent(FIncomingEvent& OutEvent);
+
+	/**
+	 * Hands the buffer of a processed message back to the worker thread, which receives later messages into it. Must only
+	 * be called from the SDK thread.
+	 */
+	void RecycleMessage(std::vector<char> Message);
+
+	/**
+	 * Writes the buffers to the client's socket right away, on the calling thread, if nothing sent earlier is still waiting
+	 * in a command or the send queue. Returns the number of bytes written, the rest must be pushed as a Send command.
+	 * Must only be called from the SDK thread. Only supported with epoll, elsewhere it always returns 0.
+	 */
+	size_t SendDirect(void* ClientHandle, const FTCPSendBuffer* Buffers, size_t NumBuffers);
+
+	/**
+	 * Returns the index of the worker that owns the client. Client handles are those of the worker's TCP client, whose
+	 * slot indices are laid out so that the index part of a handle modulo NumWorkers is the worker index.
+	 */
+	static size_t GetWorkerIndex(void* ClientHandle, size_t NumWorkers);
+
+	/** Snapshot of the TCP client's send queue counters, refreshed once per worker loop iteration */
+	FTCPClient::FSendQueueStats GetSendQueueStats() const;
+
+private:
+	/** Per connection state, keyed by the FTCPClient handle which the SDK thread knows the client by as well */
+	struct FConnection
+	{
+		/** The start of a message whose remaining bytes have not been received yet */
+		std::vector<char> PartialMessage;
+	};
+
+	/** What SendDirect needs to know about a connection, guarded by DirectSendMutex */
+	struct FDirectSendState
+	{
+		int Socket = -1;
+
+		/** Commands pushed for the client that the worker thread has not processed yet */
+		uint32_t NumPendingCommands = 0;
+
+		/** Set while the TCP client has data queued for the client */
+		bool bHasQueuedSends = false;
+	};
+
+	void Run();
+	void ProcessCommands();
+	void Receive(void* From, char* Buffer, size_t Length);
+	void OnDisconnected(void* Which);
+	void AddDirectSendClient(void* ClientHandle);
+	void UpdateClientsWithQueuedSends();
+	bool ReadMessageSize(const char* Header, size_t& OutMessageSize);
+	void PushMessage(void* ClientHandle, std::vector<char> Message);
+
+	/** Returns an empty buffer, a recycled one if there is any */
+	std::vector<char> AcquireMessage();
+	void ReleaseMessage(std::vector<char> Message);
+
+	/** Messages and disconnects of this worker's clients, consumed by the SDK thread */
+	TSpscQueue<FIncomingEvent> IncomingEvents;
+	std::function<void()> OnIncomingEventsCallback;
+
+	/** Buffers of processed messages, pushed by the SDK thread */
+	TSpscQueue<std::vector<char>> RecycledMessages;
+
+	/** Buffers ready to receive into, only used by the worker thread */
+	std::vector<std::vector<char>> FreeMessages;
+
+	/** Set when events were pushed during the current loop iteration, the SDK thread is woken once at its end */
+	bool bHasPushedEvents = false;
+
+	TSpscQueue<FOutgoingCommand> Commands;
+
+	FTCPClient TCPClient;
+	FServerLoop Loop;
+
+	std::thread Thread;
+	std::atomic<bool> bIsRunning{ false };
+
+	std::unordered_map<void*, FConnection> Connections;
+
+	/**
+	 * Connections the SDK thread may write to itself, added on their first receive and removed before their socket is
+	 * closed. Not used with io_uring, whose sends are all submitted by the worker thread.
+	 */
+	std::mutex DirectSendMutex;
+	std::unordered_map<void*, FDirectSendState> DirectSendClients;
+
+	/** Clients whose bHasQueuedSends is set, checked after every TCP client update. Only used by the worker thread. */
+	std::vector<void*> ClientsWithQueuedSends;
+
+#if TCPCLIENT_USE_EPOLL
+	/** Scatter/gather list for SendDirect, only used by the SDK thread */
+	std::vector<iovec> DirectSendVectors;
+#endif
+
+	mutable std::mutex StatsMutex;
+	FTCPClient::FSendQueueStats SendQueueStats;
+};
@@ -11,6 +11,38 @@
 #include "eos_sdk.h"
 #include "TCPClient.h"
 
+FAntiCheatServer::FAntiCheatServer()
+	: ProtectedMessageChannel(
+		[this](uint32_t DataLengthBytes, uint32_t& OutBufferSizeBytes)
+		{
+			EOS_AntiCheatServer_GetProtectMessageOutputLengthOptions Options = {};
+			Options.ApiVersion = EOS_ANTICHEATSERVER_GETPROTECTMESSAGEOUTPUTLENGTH_API_LATEST;
+			Options.DataLengthBytes = DataLengthBytes;
+			return EOS_AntiCheatServer_GetProtectMessageOutputLength(AntiCheatServerHandle, &Options, &OutBufferSizeBytes) == EOS_EResult::EOS_Success;
+		},
+		[this](void* ClientHandle, const void* Data, uint32_t DataLengthBytes, void* OutBuffer, uint32_t OutBufferSizeBytes, uint32_t& OutBytesWritten)
+		{
+			EOS_AntiCheatServer_ProtectMessageOptions Options = {};
+			Options.ApiVersion = EOS_ANTICHEATSERVER_PROTECTMESSAGE_API_LATEST;
+			Options.ClientHandle = ClientHandle;
+			Options.DataLengthBytes = DataLengthBytes;
+			Options.Data = Data;
+			Options.OutBufferSizeBytes = OutBufferSizeBytes;
+			return EOS_AntiCheatServer_ProtectMessage(AntiCheatServerHandle, &Options, OutBuffer, &OutBytesWritten) == EOS_EResult::EOS_Success;
+		},
+		[this](void* ClientHandle, const void* Data, uint32_t DataLengthBytes, void* OutBuffer, uint32_t OutBufferSizeBytes, uint32_t& OutBytesWritten)
+		{
+			EOS_AntiCheatServer_UnprotectMessageOptions Options = {};
+			Options.ApiVersion = EOS_ANTICHEATSERVER_UNPROTECTMESSAGE_API_LATEST;
+			Options.ClientHandle = ClientHandle;
+			Options.DataLengthBytes = DataLengthBytes;
+			Options.Data = Data;
+			Options.OutBufferSizeBytes = OutBufferSizeBytes;
+			return EOS_AntiCheatServer_UnprotectMessage(AntiCheatServerHandle, &Options, OutBuffer, &OutBytesWritten) == EOS_EResult::EOS_Success;
+		})
+{
+}
+
 void FAntiCheatServer::Init(EOS_HPlatform Platform)
 {
 	ConnectHandle = EOS_Platform_GetConnectInterface(Platform);
@@ -36,7 +68,7 @@ void FAntiCheatServer::BeginSession()
 		Options.ApiVersion = EOS_ANTICHEATSERVER_BEGINSESSION_API_LATEST;
 		Options.RegisterTimeoutSeconds = EOS_ANTICHEATSERVER_BEGINSESSION_MAX_REGISTERTIMEOUT;
 		Options.ServerName = "Anti-Cheat Samples Server";
-		Options.bEnableGameplayData = EOS_FALSE;
+		Options.bEnableGameplayData = GameplayTelemetry.IsEnabled() ? EOS_TRUE : EOS_FALSE;
 		Options.LocalUserId = nullptr;
 		EOS_AntiCheatServer_BeginSession(AntiCheatServerHandle, &Options);
 	}
@@ -90,8 +122,34 @@ void FAntiCheatServer::UnregisterClient(void* ClientHandle)
 	EOS_AntiCheatServer_UnregisterClient(AntiCheatServerHandle, &Options);
 }
 
+void FAntiCheatServer::EnableGameplayTelemetry(size_t MaxGameThreads, size_t EventsPerThread)
+{
+	GameplayTelemetry.Init(AntiCheatServerHandle, MaxGameThreads, EventsPerThread);
+}
+
+void FAntiCheatServer::SetSendProtectedMessageCallback(FProtectedMessageChannel::FSendFunction Callback)
+{
+	SendProtectedMessageCallback = std::move(Callback);
+}
+
+void FAntiCheatServer::SendProtectedMessages()
+{
+	if (SendProtectedMessageCallback)
+	{
+		ProtectedMessageChannel.ProtectQueuedMessages(SendProtectedMessageCallback);
+	}
+	else
+	{
+		ProtectedMessageChannel.DiscardQueuedMessages();
+	}
+}
+
 void FAntiCheatServer::EndSession()
 {
+	// Pass on what the game logged or queued before the session ended, client handles are only valid during the session
+	GameplayTelemetry.Drain(SIZE_MAX);
+	SendProtectedMessages();
+
 	EOS_AntiCheatServer_RemoveNotifyMessageToClient(AntiCheatServerHandle, MessageToClientId);
 	EOS_AntiCheatServer_RemoveNotifyClientActionRequired(AntiCheatServerHandle, ClientActionRequiredId);
 
@@ -3,6 +3,8 @@
 #pragma once
 
 #include "AntiCheatNetworkTransport.h"
+#include "GameplayTelemetry.h"
+#include "ProtectedMessageChannel.h"
 
 #include "eos_connect_types.h"
 #include "eos_anticheatserver_types.h"
@@ -11,6 +13,8 @@
 class FAntiCheatServer
 {
 public:
+	FAntiCheatServer();
+
 	void Init(EOS_HPlatform Platform);
 	void BeginSession();
 	void EndSession();
@@ -20,6 +24,22 @@ public:
 	void UnregisterClient(void* ClientHandle);
 
 	void OnMessageFromClientReceived(void* ClientHandle, const void* Data, uint32_t DataLengthBytes);
+
+	/** Enables gameplay data for the next session. Game threads log through GetGameplayTelemetry, see FGameplayTelemetry. */
+	void EnableGameplayTelemetry(size_t MaxGameThreads, size_t EventsPerThread);
+	FGameplayTelemetry& GetGameplayTelemetry() { return GameplayTelemetry; }
+
+	/**
+	 * Encrypts game traffic to and decrypts game traffic from registered clients with NetProtect. Game code queues its
+	 * outgoing messages on the channel, SendProtectedMessages protects them in one batch per tick.
+	 */
+	FProtectedMessageChannel& GetProtectedMessageChannel() { return ProtectedMessageChannel; }
+
+	/** Receives the protected game messages, to send them to the client over the game's own connection */
+	void SetSendProtectedMessageCallback(FProtectedMessageChannel::FSendFunction Callback);
+
+	/** Protects the game messages queued since the last call and passes them to the send callback. Call once per tick. */
+	void SendProtectedMessages();
 	
 private:
 	static void EOS_CALL OnMessageToClientCb(const EOS_AntiCheatCommon_OnMessageToClientCallbackInfo* Data);
@@ -31,5 +51,10 @@ private:
 
 	EOS_NotificationId MessageToClientId;
 	EOS_NotificationId ClientActionRequiredId;
+
+	FGameplayTelemetry GameplayTelemetry;
+
+	FProtectedMessageChannel ProtectedMessageChannel;
+	FProtectedMessageChannel::FSendFunction SendProtectedMessageCallback;
 };
 
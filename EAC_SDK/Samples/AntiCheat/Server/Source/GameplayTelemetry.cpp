@@ -0,0 +1,397 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "GameplayTelemetry.h"
+#include "DebugLog.h"
+
+#include "eos_anticheatserver.h"
+
+#include <cstring>
+
+namespace
+{
+	std::atomic<uint64_t> NextInstanceId{ 1 };
+
+	/** Ring buffer claimed by the current thread, valid while InstanceId matches the telemetry instance */
+	struct FThreadRingCache
+	{
+		uint64_t InstanceId = 0;
+		void* Ring = nullptr;
+	};
+	thread_local FThreadRingCache ThreadRingCache;
+
+	const wchar_t* EventTypeNames[FGameplayTelemetry::NumEventTypes] = {
+		L"PlayerSpawn",
+		L"PlayerDespawn",
+		L"PlayerRevive",
+		L"PlayerTick",
+		L"PlayerUseWeapon",
+		L"PlayerUseAbility",
+		L"PlayerTakeDamage"
+	};
+}
+
+FGameplayTelemetry::FGameplayTelemetry()
+	: InstanceId(NextInstanceId.fetch_add(1, std::memory_order_relaxed))
+{
+}
+
+void FGameplayTelemetry::Init(EOS_HAntiCheatServer InAntiCheatServerHandle, size_t MaxGameThreads, size_t EventsPerThread)
+{
+	Rings.clear();
+	Rings.reserve(MaxGameThreads);
+	for (size_t RingIndex = 0; RingIndex < MaxGameThreads; ++RingIndex)
+	{
+		Rings.push_back(std::make_unique<FRing>(EventsPerThread));
+	}
+
+	LastRefillTime = std::chrono::steady_clock::now();
+	AntiCheatServerHandle = InAntiCheatServerHandle;
+}
+
+void FGameplayTelemetry::SetRateLimit(EEventType Type, uint32_t EventsPerSecond)
+{
+	FRateLimit& RateLimit = RateLimits[static_cast<size_t>(Type)];
+	RateLimit.EventsPerSecond = EventsPerSecond;
+	RateLimit.Tokens = EventsPerSecond;
+}
+
+FGameplayTelemetry::FRing* FGameplayTelemetry::GetThreadRing()
+{
+	if (ThreadRingCache.InstanceId == InstanceId)
+	{
+		return static_cast<FRing*>(ThreadRingCache.Ring);
+	}
+
+	const size_t RingIndex = NumClaimedRings.fetch_add(1, std::memory_order_relaxed);
+	FRing* Ring = RingIndex < Rings.size() ? Rings[RingIndex].get() : nullptr;
+
+	// Threads that did not get a ring keep dropping their events without claiming again
+	ThreadRingCache.InstanceId = InstanceId;
+	ThreadRingCache.Ring = Ring;
+	return Ring;
+}
+
+FGameplayTelemetry::FEvent* FGameplayTelemetry::BeginEvent(EEventType Type, FRing*& OutRing)
+{
+	if (!IsEnabled())
+	{
+		return nullptr;
+	}
+
+	OutRing = GetThreadRing();
+	if (!OutRing)
+	{
+		NoRingAvailableDrops.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	FEvent* Event = OutRing->BeginPush();
+	if (!Event)
+	{
+		RingFullDrops.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Event->Type = Type;
+	Event->NumVectors = 0;
+	Event->NumRotations = 0;
+	return Event;
+}
+
+EOS_AntiCheatCommon_Vec3f* FGameplayTelemetry::FEvent::CopyVector(const EOS_AntiCheatCommon_Vec3f* Vector)
+{
+	if (!Vector)
+	{
+		return nullptr;
+	}
+
+	assert(NumVectors < MaxVectors);
+	Vectors[NumVectors] = *Vector;
+	return &Vectors[NumVectors++];
+}
+
+EOS_AntiCheatCommon_Quat* FGameplayTelemetry::FEvent::CopyRotation(const EOS_AntiCheatCommon_Quat* Rotation)
+{
+	if (!Rotation)
+	{
+		return nullptr;
+	}
+
+	assert(NumRotations < MaxRotations);
+	Rotations[NumRotations] = *Rotation;
+	return &Rotations[NumRotations++];
+}
+
+EOS_AntiCheatCommon_LogPlayerUseWeaponData* FGameplayTelemetry::FEvent::CopyUseWeaponData(const EOS_AntiCheatCommon_LogPlayerUseWeaponData* Data)
+{
+	if (!Data)
+	{
+		return nullptr;
+	}
+
+	UseWeaponData = *Data;
+	UseWeaponData.PlayerPosition = CopyVector(Data->PlayerPosition);
+	UseWeaponData.PlayerViewRotation = CopyRotation(Data->PlayerViewRotation);
+
+	// The SDK truncates longer names anyway
+	if (Data->WeaponName)
+	{
+		strncpy(WeaponName, Data->WeaponName, sizeof(WeaponName) - 1);
+		WeaponName[sizeof(WeaponName) - 1] = '\0';
+		UseWeaponData.WeaponName = WeaponName;
+	}
+	return &UseWeaponData;
+}
+
+bool FGameplayTelemetry::LogPlayerSpawn(const EOS_AntiCheatCommon_LogPlayerSpawnOptions& Options)
+{
+	FRing* Ring = nullptr;
+	FEvent* Event = BeginEvent(EEventType::PlayerSpawn, Ring);
+	if (!Event)
+	{
+		return false;
+	}
+
+	Event->PlayerSpawn = Options;
+	Event->PlayerSpawn.ApiVersion = EOS_ANTICHEATCOMMON_LOGPLAYERSPAWN_API_LATEST;
+	Ring->EndPush();
+	return true;
+}
+
+bool FGameplayTelemetry::LogPlayerDespawn(const EOS_AntiCheatCommon_LogPlayerDespawnOptions& Options)
+{
+	FRing* Ring = nullptr;
+	FEvent* Event = BeginEvent(EEventType::PlayerDespawn, Ring);
+	if (!Event)
+	{
+		return false;
+	}
+
+	Event->PlayerDespawn = Options;
+	Event->PlayerDespawn.ApiVersion = EOS_ANTICHEATCOMMON_LOGPLAYERDESPAWN_API_LATEST;
+	Ring->EndPush();
+	return true;
+}
+
+bool FGameplayTelemetry::LogPlayerRevive(const EOS_AntiCheatCommon_LogPlayerReviveOptions& Options)
+{
+	FRing* Ring = nullptr;
+	FEvent* Event = BeginEvent(EEventType::PlayerRevive, Ring);
+	if (!Event)
+	{
+		return false;
+	}
+
+	Event->PlayerRevive = Options;
+	Event->PlayerRevive.ApiVersion = EOS_ANTICHEATCOMMON_LOGPLAYERREVIVE_API_LATEST;
+	Ring->EndPush();
+	return true;
+}
+
+bool FGameplayTelemetry::LogPlayerTick(const EOS_AntiCheatCommon_LogPlayerTickOptions& Options)
+{
+	FRing* Ring = nullptr;
+	FEvent* Event = BeginEvent(EEventType::PlayerTick, Ring);
+	if (!Event)
+	{
+		return false;
+	}
+
+	Event->PlayerTick = Options;
+	Event->PlayerTick.ApiVersion = EOS_ANTICHEATCOMMON_LOGPLAYERTICK_API_LATEST;
+	Event->PlayerTick.PlayerPosition = Event->CopyVector(Options.PlayerPosition);
+	Event->PlayerTick.PlayerViewRotation = Event->CopyRotation(Options.PlayerViewRotation);
+	Event->PlayerTick.PlayerViewPosition = Event->CopyVector(Options.PlayerViewPosition);
+	Ring->EndPush();
+	return true;
+}
+
+bool FGameplayTelemetry::LogPlayerUseWeapon(const EOS_AntiCheatCommon_LogPlayerUseWeaponOptions& Options)
+{
+	FRing* Ring = nullptr;
+	FEvent* Event = BeginEvent(EEventType::PlayerUseWeapon, Ring);
+	if (!Event)
+	{
+		return false;
+	}
+
+	Event->PlayerUseWeapon.ApiVersion = EOS_ANTICHEATCOMMON_LOGPLAYERUSEWEAPON_API_LATEST;
+	Event->PlayerUseWeapon.UseWeaponData = Event->CopyUseWeaponData(Options.UseWeaponData);
+	Ring->EndPush();
+	return true;
+}
+
+bool FGameplayTelemetry::LogPlayerUseAbility(const EOS_AntiCheatCommon_LogPlayerUseAbilityOptions& Options)
+{
+	FRing* Ring = nullptr;
+	FEvent* Event = BeginEvent(EEventType::PlayerUseAbility, Ring);
+	if (!Event)
+	{
+		return false;
+	}
+
+	Event->PlayerUseAbility = Options;
+	Event->PlayerUseAbility.ApiVersion = EOS_ANTICHEATCOMMON_LOGPLAYERUSEABILITY_API_LATEST;
+	Ring->EndPush();
+	return true;
+}
+
+bool FGameplayTelemetry::LogPlayerTakeDamage(const EOS_AntiCheatCommon_LogPlayerTakeDamageOptions& Options)
+{
+	FRing* Ring = nullptr;
+	FEvent* Event = BeginEvent(EEventType::PlayerTakeDamage, Ring);
+	if (!Event)
+	{
+		return false;
+	}
+
+	EOS_AntiCheatCommon_LogPlayerTakeDamageOptions& TakeDamage = Event->PlayerTakeDamage;
+	TakeDamage = Options;
+	TakeDamage.ApiVersion = EOS_ANTICHEATCOMMON_LOGPLAYERTAKEDAMAGE_API_LATEST;
+	TakeDamage.VictimPlayerPosition = Event->CopyVector(Options.VictimPlayerPosition);
+	TakeDamage.VictimPlayerViewRotation = Event->CopyRotation(Options.VictimPlayerViewRotation);
+	TakeDamage.AttackerPlayerPosition = Event->CopyVector(Options.AttackerPlayerPosition);
+	TakeDamage.AttackerPlayerViewRotation = Event->CopyRotation(Options.AttackerPlayerViewRotation);
+	TakeDamage.PlayerUseWeaponData = Event->CopyUseWeaponData(Options.PlayerUseWeaponData);
+	TakeDamage.DamagePosition = Event->CopyVector(Options.DamagePosition);
+	TakeDamage.AttackerPlayerViewPosition = Event->CopyVector(Options.AttackerPlayerViewPosition);
+	Ring->EndPush();
+	return true;
+}
+
+bool FGameplayTelemetry::ConsumeRateLimitToken(EEventType Type)
+{
+	FRateLimit& RateLimit = RateLimits[static_cast<size_t>(Type)];
+	if (RateLimit.EventsPerSecond == 0)
+	{
+		return true;
+	}
+
+	if (RateLimit.Tokens < 1.0)
+	{
+		return false;
+	}
+
+	RateLimit.Tokens -= 1.0;
+	return true;
+}
+
+void FGameplayTelemetry::LogToSdk(const FEvent& Event)
+{
+	switch (Event.Type)
+	{
+		case EEventType::PlayerSpawn:
+			EOS_AntiCheatServer_LogPlayerSpawn(AntiCheatServerHandle, &Event.PlayerSpawn);
+			break;
+		case EEventType::PlayerDespawn:
+			EOS_AntiCheatServer_LogPlayerDespawn(AntiCheatServerHandle, &Event.PlayerDespawn);
+			break;
+		case EEventType::PlayerRevive:
+			EOS_AntiCheatServer_LogPlayerRevive(AntiCheatServerHandle, &Event.PlayerRevive);
+			break;
+		case EEventType::PlayerTick:
+			EOS_AntiCheatServer_LogPlayerTick(AntiCheatServerHandle, &Event.PlayerTick);
+			break;
+		case EEventType::PlayerUseWeapon:
+			EOS_AntiCheatServer_LogPlayerUseWeapon(AntiCheatServerHandle, &Event.PlayerUseWeapon);
+			break;
+		case EEventType::PlayerUseAbility:
+			EOS_AntiCheatServer_LogPlayerUseAbility(AntiCheatServerHandle, &Event.PlayerUseAbility);
+			break;
+		case EEventType::PlayerTakeDamage:
+			EOS_AntiCheatServer_LogPlayerTakeDamage(AntiCheatServerHandle, &Event.PlayerTakeDamage);
+			break;
+		default:
+			break;
+	}
+}
+
+size_t FGameplayTelemetry::Drain(size_t MaxEvents)
+{
+	Stats.RingFull = RingFullDrops.load(std::memory_order_relaxed);
+	Stats.NoRingAvailable = NoRingAvailableDrops.load(std::memory_order_relaxed);
+
+	if (!IsEnabled())
+	{
+		return 0;
+	}
+
+	// Refill the token buckets for the time since the last drain
+	const ServerTimePoint Now = std::chrono::steady_clock::now();
+	const double SecondsElapsed = std::chrono::duration<double>(Now - LastRefillTime).count();
+	LastRefillTime = Now;
+	for (FRateLimit& RateLimit : RateLimits)
+	{
+		RateLimit.Tokens = std::min<double>(RateLimit.EventsPerSecond, RateLimit.Tokens + SecondsElapsed * RateLimit.EventsPerSecond);
+	}
+
+	// Take a few events from each ring in turn, so one busy game thread cannot use up MaxEvents on its own
+	constexpr size_t EventsPerTurn = 64;
+
+	const size_t NumRings = std::min(NumClaimedRings.load(std::memory_order_relaxed), Rings.size());
+	size_t NumLogged = 0;
+	size_t NumTakenTotal = 0;
+	size_t NumEmptyRingsInARow = 0;
+	while (NumRings > 0 && NumTakenTotal < MaxEvents && NumEmptyRingsInARow < NumRings)
+	{
+		FRing& Ring = *Rings[NextRing % NumRings];
+		NextRing = (NextRing + 1) % NumRings;
+
+		size_t NumTaken = 0;
+		while (NumTaken < EventsPerTurn && NumTakenTotal < MaxEvents)
+		{
+			FEvent* Event = Ring.Peek();
+			if (!Event)
+			{
+				break;
+			}
+
+			// The SDK reads the event in place, the slot is only handed back once it returned
+			const size_t TypeIndex = static_cast<size_t>(Event->Type);
+			if (ConsumeRateLimitToken(Event->Type))
+			{
+				LogToSdk(*Event);
+				++Stats.Logged[TypeIndex];
+				++NumLogged;
+			}
+			else
+			{
+				++Stats.RateLimited[TypeIndex];
+			}
+
+			Ring.Pop();
+			++NumTaken;
+			++NumTakenTotal;
+		}
+
+		NumEmptyRingsInARow = NumTaken == 0 ? NumEmptyRingsInARow + 1 : 0;
+	}
+
+	if (NumLogged > 0)
+	{
+		++Stats.Batches;
+		Stats.LargestBatch = std::max<uint64_t>(Stats.LargestBatch, NumLogged);
+	}
+
+	return NumLogged;
+}
+
+void FGameplayTelemetry::LogStats() const
+{
+	FDebugLog::Log(L"Gameplay telemetry: %llu batches (largest %llu events), %llu events dropped on full rings, %llu from threads without a ring",
+		static_cast<unsigned long long>(Stats.Batches),
+		static_cast<unsigned long long>(Stats.LargestBatch),
+		static_cast<unsigned long long>(Stats.RingFull),
+		static_cast<unsigned long long>(Stats.NoRingAvailable));
+
+	for (size_t TypeIndex = 0; TypeIndex < NumEventTypes; ++TypeIndex)
+	{
+		if (Stats.Logged[TypeIndex] > 0 || Stats.RateLimited[TypeIndex] > 0)
+		{
+			FDebugLog::Log(L"  %ls: %llu logged, %llu over rate limit", EventTypeNames[TypeIndex],
+				static_cast<unsigned long long>(Stats.Logged[TypeIndex]),
+				static_cast<unsigned long long>(Stats.RateLimited[TypeIndex]));
+		}
+	}
+}
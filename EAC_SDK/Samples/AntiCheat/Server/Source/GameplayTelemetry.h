@@ -0,0 +1,170 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "NonCopyable.h"
+#include "LockFreeQueue.h"
+
+#include "eos_anticheatserver_types.h"
+
+#include <atomic>
+
+/**
+ * Collects gameplay events for EOS_AntiCheatServer_LogPlayer* from the game threads and passes them to the SDK in
+ * batches on the SDK thread.
+ *
+ * Every game thread writes into its own ring buffer, allocated up front when the telemetry is initialized, so logging
+ * an event never allocates, locks or calls into the SDK. The data the options point to (positions, rotations, weapon
+ * data) is copied into the ring slot as well, so the caller's options only have to be valid during the call.
+ * Events logged while a ring is full are dropped and counted.
+ */
+class FGameplayTelemetry : public FNonCopyable
+{
+public:
+	enum class EEventType : uint8_t
+	{
+		PlayerSpawn,
+		PlayerDespawn,
+		PlayerRevive,
+		PlayerTick,
+		PlayerUseWeapon,
+		PlayerUseAbility,
+		PlayerTakeDamage,
+		Count
+	};
+
+	static constexpr size_t NumEventTypes = static_cast<size_t>(EEventType::Count);
+
+	struct FStats
+	{
+		/** Events passed to the SDK, by event type */
+		uint64_t Logged[NumEventTypes] = {};
+
+		/** Events dropped because their type was over its rate limit, by event type */
+		uint64_t RateLimited[NumEventTypes] = {};
+
+		/** Events dropped on the game threads because their ring buffer was full */
+		uint64_t RingFull = 0;
+
+		/** Events dropped because more game threads logged events than there are ring buffers */
+		uint64_t NoRingAvailable = 0;
+
+		/** Calls to Drain that passed at least one event to the SDK */
+		uint64_t Batches = 0;
+
+		/** Most events passed to the SDK in a single Drain */
+		uint64_t LargestBatch = 0;
+	};
+
+	FGameplayTelemetry();
+
+	/**
+	 * Allocates the ring buffers and enables logging. Call on the SDK thread before any game thread logs events.
+	 *
+	 * @param InAntiCheatServerHandle - Interface the events are logged to
+	 * @param MaxGameThreads - Number of ring buffers, each game thread claims one on its first event
+	 * @param EventsPerThread - Capacity of each ring buffer
+	 */
+	void Init(EOS_HAntiCheatServer InAntiCheatServerHandle, size_t MaxGameThreads, size_t EventsPerThread);
+
+	bool IsEnabled() const { return AntiCheatServerHandle != nullptr; }
+
+	/** Caps the number of events of a type passed to the SDK per second, 0 for no cap. Call on the SDK thread. */
+	void SetRateLimit(EEventType Type, uint32_t EventsPerSecond);
+
+	/**
+	 * Game thread interface, the ApiVersion of the options is ignored.
+	 * Return false if the event was dropped because the telemetry is disabled or the thread's ring buffer is full.
+	 */
+	bool LogPlayerSpawn(const EOS_AntiCheatCommon_LogPlayerSpawnOptions& Options);
+	bool LogPlayerDespawn(const EOS_AntiCheatCommon_LogPlayerDespawnOptions& Options);
+	bool LogPlayerRevive(const EOS_AntiCheatCommon_LogPlayerReviveOptions& Options);
+	bool LogPlayerTick(const EOS_AntiCheatCommon_LogPlayerTickOptions& Options);
+	bool LogPlayerUseWeapon(const EOS_AntiCheatCommon_LogPlayerUseWeaponOptions& Options);
+	bool LogPlayerUseAbility(const EOS_AntiCheatCommon_LogPlayerUseAbilityOptions& Options);
+	bool LogPlayerTakeDamage(const EOS_AntiCheatCommon_LogPlayerTakeDamageOptions& Options);
+
+	/**
+	 * Takes up to MaxEvents queued events, taking turns between the game threads' ring buffers, and passes those within
+	 * their rate limit to the SDK. Must be called on the SDK thread, typically once before every EOS_Platform_Tick.
+	 *
+	 * @return Number of events passed to the SDK
+	 */
+	size_t Drain(size_t MaxEvents);
+
+	/** Counters, the ring buffer drops are summed up by Drain */
+	const FStats& GetStats() const { return Stats; }
+	void LogStats() const;
+
+private:
+	/** A queued event: the SDK options, with all pointers pointing at data stored in the event itself */
+	struct FEvent
+	{
+		EEventType Type = EEventType::PlayerTick;
+
+		union
+		{
+			EOS_AntiCheatCommon_LogPlayerSpawnOptions PlayerSpawn;
+			EOS_AntiCheatCommon_LogPlayerDespawnOptions PlayerDespawn;
+			EOS_AntiCheatCommon_LogPlayerReviveOptions PlayerRevive;
+			EOS_AntiCheatCommon_LogPlayerTickOptions PlayerTick;
+			EOS_AntiCheatCommon_LogPlayerUseWeaponOptions PlayerUseWeapon;
+			EOS_AntiCheatCommon_LogPlayerUseAbilityOptions PlayerUseAbility;
+			EOS_AntiCheatCommon_LogPlayerTakeDamageOptions PlayerTakeDamage;
+		};
+
+		/** Most positions and rotations referenced by a single event (LogPlayerTakeDamage plus its weapon data) */
+		static constexpr size_t MaxVectors = 5;
+		static constexpr size_t MaxRotations = 3;
+
+		EOS_AntiCheatCommon_Vec3f Vectors[MaxVectors];
+		EOS_AntiCheatCommon_Quat Rotations[MaxRotations];
+		EOS_AntiCheatCommon_LogPlayerUseWeaponData UseWeaponData;
+		char WeaponName[EOS_ANTICHEATCOMMON_LOGPLAYERUSEWEAPON_WEAPONNAME_MAX_LENGTH + 1];
+
+		size_t NumVectors = 0;
+		size_t NumRotations = 0;
+
+		EOS_AntiCheatCommon_Vec3f* CopyVector(const EOS_AntiCheatCommon_Vec3f* Vector);
+		EOS_AntiCheatCommon_Quat* CopyRotation(const EOS_AntiCheatCommon_Quat* Rotation);
+		EOS_AntiCheatCommon_LogPlayerUseWeaponData* CopyUseWeaponData(const EOS_AntiCheatCommon_LogPlayerUseWeaponData* Data);
+	};
+
+	using FRing = TSpscRingBuffer<FEvent>;
+
+	/** Token bucket holding up to one second worth of events */
+	struct FRateLimit
+	{
+		uint32_t EventsPerSecond = 0;
+		double Tokens = 0.0;
+	};
+
+	/** Returns a free slot in the calling thread's ring buffer or nullptr, publish the filled in slot with OutRing->EndPush */
+	FEvent* BeginEvent(EEventType Type, FRing*& OutRing);
+
+	/** Returns the ring buffer of the calling thread, claiming one on first use */
+	FRing* GetThreadRing();
+
+	bool ConsumeRateLimitToken(EEventType Type);
+	void LogToSdk(const FEvent& Event);
+
+	EOS_HAntiCheatServer AntiCheatServerHandle = nullptr;
+
+	/** Distinguishes this instance from earlier ones in the per thread ring cache */
+	const uint64_t InstanceId;
+
+	std::vector<std::unique_ptr<FRing>> Rings;
+	std::atomic<size_t> NumClaimedRings{ 0 };
+
+	/** Drops counted on the game threads, collected into Stats by Drain */
+	std::atomic<uint64_t> RingFullDrops{ 0 };
+	std::atomic<uint64_t> NoRingAvailableDrops{ 0 };
+
+	/** Ring buffer Drain starts with next, so no game thread is starved when MaxEvents is reached */
+	size_t NextRing = 0;
+
+	FRateLimit RateLimits[NumEventTypes];
+	ServerTimePoint LastRefillTime;
+
+	FStats Stats;
+};
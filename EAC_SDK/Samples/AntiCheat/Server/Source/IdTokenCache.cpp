@@ -0,0 +1,217 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "IdTokenCache.h"
+
+#include <cstring>
+
+namespace
+{
+	/** Value of a base64url character, or -1 for characters outside the alphabet */
+	int DecodeBase64UrlChar(char Char)
+	{
+		if (Char >= 'A' && Char <= 'Z')
+		{
+			return Char - 'A';
+		}
+		if (Char >= 'a' && Char <= 'z')
+		{
+			return Char - 'a' + 26;
+		}
+		if (Char >= '0' && Char <= '9')
+		{
+			return Char - '0' + 52;
+		}
+		if (Char == '-')
+		{
+			return 62;
+		}
+		if (Char == '_')
+		{
+			return 63;
+		}
+		return -1;
+	}
+
+	bool DecodeBase64Url(const char* Begin, const char* End, std::string& OutDecoded)
+	{
+		OutDecoded.clear();
+		OutDecoded.reserve((End - Begin) * 3 / 4);
+
+		uint32_t Bits = 0;
+		int NumBits = 0;
+		for (const char* Char = Begin; Char != End && *Char != '='; ++Char)
+		{
+			const int Value = DecodeBase64UrlChar(*Char);
+			if (Value < 0)
+			{
+				return false;
+			}
+
+			Bits = (Bits << 6) | static_cast<uint32_t>(Value);
+			NumBits += 6;
+			if (NumBits >= 8)
+			{
+				NumBits -= 8;
+				OutDecoded.push_back(static_cast<char>((Bits >> NumBits) & 0xFF));
+			}
+		}
+		return true;
+	}
+}
+
+FIdTokenCache::FIdTokenCache(size_t InCapacity, std::chrono::seconds InMaxAge)
+	: Capacity(InCapacity)
+	, MaxAge(InMaxAge)
+{
+	Entries.reserve(Capacity);
+}
+
+const FIdTokenCache::FVerifiedToken* FIdTokenCache::Find(const char* ProductUserId, const char* ConnectIdTokenJWT)
+{
+	auto EntryItr = Entries.find(ProductUserId);
+	if (EntryItr == Entries.end())
+	{
+		++Stats.Misses;
+		return nullptr;
+	}
+
+	FEntry& Entry = EntryItr->second;
+	if (Entry.TokenHash != HashToken(ConnectIdTokenJWT) || Entry.ConnectIdTokenJWT != ConnectIdTokenJWT)
+	{
+		// A different token has to be verified, even when it belongs to the same player
+		++Stats.Misses;
+		return nullptr;
+	}
+
+	if (std::chrono::system_clock::now() >= Entry.ExpirationTime)
+	{
+		++Stats.Expired;
+		Erase(EntryItr);
+		return nullptr;
+	}
+
+	RecentlyUsed.splice(RecentlyUsed.begin(), RecentlyUsed, Entry.RecentlyUsedItr);
+	++Stats.Hits;
+	return &Entry.VerifiedToken;
+}
+
+void FIdTokenCache::Add(const char* ProductUserId, const char* ConnectIdTokenJWT, const char* DeviceType, const char* Platform)
+{
+	if (Capacity == 0)
+	{
+		return;
+	}
+
+	std::chrono::seconds ExpirationTime;
+	if (!ReadExpirationTime(ConnectIdTokenJWT, ExpirationTime))
+	{
+		return;
+	}
+
+	const std::chrono::system_clock::time_point Now = std::chrono::system_clock::now();
+	const std::chrono::seconds TimeToLive = std::min(ExpirationTime - std::chrono::duration_cast<std::chrono::seconds>(Now.time_since_epoch()), MaxAge);
+	if (TimeToLive.count() <= 0)
+	{
+		return;
+	}
+
+	Remove(ProductUserId);
+	if (Entries.size() >= Capacity)
+	{
+		++Stats.Evictions;
+		Erase(Entries.find(RecentlyUsed.back()));
+	}
+
+	RecentlyUsed.emplace_front(ProductUserId);
+
+	FEntry& Entry = Entries[RecentlyUsed.front()];
+	Entry.TokenHash = HashToken(ConnectIdTokenJWT);
+	Entry.ConnectIdTokenJWT = ConnectIdTokenJWT;
+	Entry.VerifiedToken.DeviceType = DeviceType ? DeviceType : "";
+	Entry.VerifiedToken.Platform = Platform ? Platform : "";
+	Entry.ExpirationTime = Now + TimeToLive;
+	Entry.RecentlyUsedItr = RecentlyUsed.begin();
+
+	++Stats.Inserts;
+}
+
+void FIdTokenCache::Remove(const char* ProductUserId)
+{
+	auto EntryItr = Entries.find(ProductUserId);
+	if (EntryItr != Entries.end())
+	{
+		Erase(EntryItr);
+	}
+}
+
+void FIdTokenCache::Erase(std::unordered_map<std::string, FEntry>::iterator EntryItr)
+{
+	RecentlyUsed.erase(EntryItr->second.RecentlyUsedItr);
+	Entries.erase(EntryItr);
+}
+
+uint64_t FIdTokenCache::HashToken(const char* ConnectIdTokenJWT)
+{
+	// FNV-1a, only used to reject different tokens early, matches are confirmed by comparing the whole token
+	uint64_t Hash = 14695981039346656037ull;
+	for (const char* Char = ConnectIdTokenJWT; *Char; ++Char)
+	{
+		Hash ^= static_cast<unsigned char>(*Char);
+		Hash *= 1099511628211ull;
+	}
+	return Hash;
+}
+
+bool FIdTokenCache::ReadExpirationTime(const char* ConnectIdTokenJWT, std::chrono::seconds& OutExpirationTime)
+{
+	// A JWT is header.payload.signature, each part base64url encoded, the payload is a JSON object
+	const char* PayloadBegin = strchr(ConnectIdTokenJWT, '.');
+	if (!PayloadBegin)
+	{
+		return false;
+	}
+	++PayloadBegin;
+
+	const char* PayloadEnd = strchr(PayloadBegin, '.');
+	if (!PayloadEnd)
+	{
+		return false;
+	}
+
+	std::string Payload;
+	if (!DecodeBase64Url(PayloadBegin, PayloadEnd, Payload))
+	{
+		return false;
+	}
+
+	// "exp" is a NumericDate, seconds since the Unix epoch
+	static const char ExpirationClaim[] = "\"exp\"";
+	size_t Position = Payload.find(ExpirationClaim);
+	if (Position == std::string::npos)
+	{
+		return false;
+	}
+	Position += sizeof(ExpirationClaim) - 1;
+
+	while (Position < Payload.size() && (Payload[Position] == ' ' || Payload[Position] == ':'))
+	{
+		++Position;
+	}
+
+	int64_t ExpirationSeconds = 0;
+	size_t NumDigits = 0;
+	while (Position < Payload.size() && Payload[Position] >= '0' && Payload[Position] <= '9' && NumDigits < 18)
+	{
+		ExpirationSeconds = ExpirationSeconds * 10 + (Payload[Position] - '0');
+		++Position;
+		++NumDigits;
+	}
+	if (NumDigits == 0)
+	{
+		return false;
+	}
+
+	OutExpirationTime = std::chrono::seconds(ExpirationSeconds);
+	return true;
+}
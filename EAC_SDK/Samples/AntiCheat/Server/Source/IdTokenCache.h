@@ -0,0 +1,96 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "NonCopyable.h"
+
+#include <list>
+#include <unordered_map>
+
+/**
+ * Remembers Connect ID tokens that passed EOS_Connect_VerifyIdToken, so a player reconnecting with the same token can
+ * be registered without waiting for another verification. Entries expire with the token or after a maximum age,
+ * whichever comes first, and the least recently used entry is evicted when the cache is full.
+ * Not thread safe, meant to be used from the thread owning the EOS SDK.
+ */
+class FIdTokenCache : public FNonCopyable
+{
+public:
+	/** Account info reported by the verification, needed to check the platform the client claims */
+	struct FVerifiedToken
+	{
+		std::string DeviceType;
+		std::string Platform;
+	};
+
+	struct FStats
+	{
+		/** Lookups that found a valid entry and skipped the verification */
+		uint64_t Hits = 0;
+
+		/** Lookups without an entry, or with an entry for a different token */
+		uint64_t Misses = 0;
+
+		/** Lookups that found an expired entry */
+		uint64_t Expired = 0;
+
+		uint64_t Inserts = 0;
+
+		/** Entries dropped to make room for new ones */
+		uint64_t Evictions = 0;
+	};
+
+	/**
+	 * Constructor
+	 *
+	 * @param InCapacity - Maximum number of players remembered
+	 * @param InMaxAge - Longest time an entry is used, even when the token itself is valid for longer
+	 */
+	FIdTokenCache(size_t InCapacity, std::chrono::seconds InMaxAge);
+
+	/** Returns the verified account info if this exact token was verified for the player and has not expired, otherwise nullptr. */
+	const FVerifiedToken* Find(const char* ProductUserId, const char* ConnectIdTokenJWT);
+
+	/** Remembers a successful verification. Tokens without a readable expiration time are not cached. */
+	void Add(const char* ProductUserId, const char* ConnectIdTokenJWT, const char* DeviceType, const char* Platform);
+
+	/** Forgets the player, e.g. after a failed verification */
+	void Remove(const char* ProductUserId);
+
+	const FStats& GetStats() const { return Stats; }
+
+private:
+	struct FEntry
+	{
+		/** Hash of the token, compared before the token itself */
+		uint64_t TokenHash = 0;
+		std::string ConnectIdTokenJWT;
+
+		FVerifiedToken VerifiedToken;
+		std::chrono::system_clock::time_point ExpirationTime;
+
+		/** Position in RecentlyUsed */
+		std::list<std::string>::iterator RecentlyUsedItr;
+	};
+
+	static uint64_t HashToken(const char* ConnectIdTokenJWT);
+
+	/**
+	 * Reads the "exp" claim from the token payload, in seconds since the Unix epoch.
+	 * The token must have been verified before its claims are trusted.
+	 */
+	static bool ReadExpirationTime(const char* ConnectIdTokenJWT, std::chrono::seconds& OutExpirationTime);
+
+	void Erase(std::unordered_map<std::string, FEntry>::iterator EntryItr);
+
+	const size_t Capacity;
+	const std::chrono::seconds MaxAge;
+
+	/** Entries by ProductUserId, a player has at most one cached token */
+	std::unordered_map<std::string, FEntry> Entries;
+
+	/** ProductUserIds, most recently used first */
+	std::list<std::string> RecentlyUsed;
+
+	FStats Stats;
+};
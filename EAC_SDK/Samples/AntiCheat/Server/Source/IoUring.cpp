@@ -0,0 +1,280 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "TCPClient.h"
+#include "DebugLog.h"
+
+#if TCPCLIENT_USE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+constexpr uint16_t FIoUring::ProvidedBufferGroup;
+
+namespace
+{
+	int IoUringSetup(uint32_t NumEntries, io_uring_params* Params)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_setup, NumEntries, Params));
+	}
+
+	int IoUringEnter(int RingHandle, uint32_t NumToSubmit, uint32_t MinCompletions, uint32_t Flags)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_enter, RingHandle, NumToSubmit, MinCompletions, Flags, nullptr, 0));
+	}
+
+	int IoUringRegister(int RingHandle, uint32_t Opcode, const void* Arg, uint32_t NumArgs)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_register, RingHandle, Opcode, Arg, NumArgs));
+	}
+
+	template<typename T>
+	T* RingPointer(void* RingMemory, uint32_t Offset)
+	{
+		return reinterpret_cast<T*>(static_cast<char*>(RingMemory) + Offset);
+	}
+}
+
+FIoUring::~FIoUring()
+{
+	Close();
+}
+
+bool FIoUring::Init(uint32_t NumEntries)
+{
+	Close();
+
+	io_uring_params Params = {};
+	Params.flags = IORING_SETUP_CQSIZE;
+	Params.cq_entries = NumEntries * 4;
+
+	RingHandle = IoUringSetup(NumEntries, &Params);
+	if (RingHandle < 0)
+	{
+		FDebugLog::LogWarning(L"IoUring: io_uring_setup failed (errno %d)", errno);
+		return false;
+	}
+
+	// Both features are older than the operations the TCP client needs, they only keep this wrapper simple
+	if (!(Params.features & IORING_FEAT_SINGLE_MMAP) || !(Params.features & IORING_FEAT_NODROP))
+	{
+		FDebugLog::LogWarning(L"IoUring: Kernel lacks required io_uring features (0x%x)", Params.features);
+		Close();
+		return false;
+	}
+
+	RingMemorySize = std::max<size_t>(Params.sq_off.array + Params.sq_entries * sizeof(uint32_t), Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe));
+	RingMemory = mmap(nullptr, RingMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingHandle, IORING_OFF_SQ_RING);
+	if (RingMemory == MAP_FAILED)
+	{
+		RingMemory = nullptr;
+		FDebugLog::LogWarning(L"IoUring: Could not map the rings (errno %d)", errno);
+		Close();
+		return false;
+	}
+
+	SubmissionEntriesSize = Params.sq_entries * sizeof(io_uring_sqe);
+	void* Entries = mmap(nullptr, SubmissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingHandle, IORING_OFF_SQES);
+	if (Entries == MAP_FAILED)
+	{
+		FDebugLog::LogWarning(L"IoUring: Could not map the submission queue entries (errno %d)", errno);
+		Close();
+		return false;
+	}
+	SubmissionEntries = static_cast<io_uring_sqe*>(Entries);
+
+	SubmissionHead = RingPointer<uint32_t>(RingMemory, Params.sq_off.head);
+	SubmissionTail = RingPointer<uint32_t>(RingMemory, Params.sq_off.tail);
+	SubmissionFlags = RingPointer<uint32_t>(RingMemory, Params.sq_off.flags);
+	SubmissionMask = *RingPointer<uint32_t>(RingMemory, Params.sq_off.ring_mask);
+	NumSubmissionEntries = Params.sq_entries;
+	PendingSubmissionTail = *SubmissionTail;
+
+	// Entries are always used in ring order, so the indirection array is set up once as identity
+	uint32_t* SubmissionArray = RingPointer<uint32_t>(RingMemory, Params.sq_off.array);
+	for (uint32_t Index = 0; Index < Params.sq_entries; ++Index)
+	{
+		SubmissionArray[Index] = Index;
+	}
+
+	CompletionHead = RingPointer<uint32_t>(RingMemory, Params.cq_off.head);
+	CompletionTail = RingPointer<uint32_t>(RingMemory, Params.cq_off.tail);
+	CompletionMask = *RingPointer<uint32_t>(RingMemory, Params.cq_off.ring_mask);
+	Completions = RingPointer<io_uring_cqe>(RingMemory, Params.cq_off.cqes);
+
+	// Kernels without probing (before 5.6) are far too old for the operations the TCP client needs anyway
+	const size_t ProbeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+	std::vector<char> ProbeMemory(ProbeSize, 0);
+	io_uring_probe* Probe = reinterpret_cast<io_uring_probe*>(ProbeMemory.data());
+	if (IoUringRegister(RingHandle, IORING_REGISTER_PROBE, Probe, 256) < 0)
+	{
+		FDebugLog::LogWarning(L"IoUring: Could not probe supported operations (errno %d)", errno);
+		Close();
+		return false;
+	}
+	for (uint32_t OperationIndex = 0; OperationIndex < Probe->ops_len; ++OperationIndex)
+	{
+		if (Probe->ops[OperationIndex].flags & IO_URING_OP_SUPPORTED)
+		{
+			SupportedOperations.set(Probe->ops[OperationIndex].op);
+		}
+	}
+
+	return true;
+}
+
+void FIoUring::Close()
+{
+	// Closing the ring cancels what is in flight, before the buffers those requests may point to are released
+	if (RingHandle >= 0)
+	{
+		close(RingHandle);
+		RingHandle = -1;
+	}
+
+	if (SubmissionEntries)
+	{
+		munmap(SubmissionEntries, SubmissionEntriesSize);
+		SubmissionEntries = nullptr;
+	}
+	if (RingMemory)
+	{
+		munmap(RingMemory, RingMemorySize);
+		RingMemory = nullptr;
+	}
+	if (ProvidedBufferRing)
+	{
+		munmap(ProvidedBufferRing, ProvidedBufferRingSize);
+		ProvidedBufferRing = nullptr;
+	}
+
+	delete[] ProvidedBuffers;
+	ProvidedBuffers = nullptr;
+
+	SupportedOperations.reset();
+}
+
+bool FIoUring::RegisterEventFd(int EventHandle)
+{
+	if (IoUringRegister(RingHandle, IORING_REGISTER_EVENTFD, &EventHandle, 1) < 0)
+	{
+		FDebugLog::LogWarning(L"IoUring: Could not register eventfd (errno %d)", errno);
+		return false;
+	}
+	return true;
+}
+
+bool FIoUring::InitProvidedBuffers(uint16_t NumBuffers, uint32_t BufferSize)
+{
+	assert(NumBuffers > 0 && (NumBuffers & (NumBuffers - 1)) == 0);
+
+	// The ring has to be page aligned, which an anonymous mapping always is
+	ProvidedBufferRingSize = NumBuffers * sizeof(io_uring_buf);
+	void* RingAddress = mmap(nullptr, ProvidedBufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (RingAddress == MAP_FAILED)
+	{
+		FDebugLog::LogWarning(L"IoUring: Could not allocate the provided buffer ring (errno %d)", errno);
+		return false;
+	}
+	ProvidedBufferRing = static_cast<io_uring_buf_ring*>(RingAddress);
+
+	io_uring_buf_reg Registration = {};
+	Registration.ring_addr = reinterpret_cast<uintptr_t>(ProvidedBufferRing);
+	Registration.ring_entries = NumBuffers;
+	Registration.bgid = ProvidedBufferGroup;
+	if (IoUringRegister(RingHandle, IORING_REGISTER_PBUF_RING, &Registration, 1) < 0)
+	{
+		FDebugLog::LogWarning(L"IoUring: Could not register provided buffers (errno %d)", errno);
+		munmap(ProvidedBufferRing, ProvidedBufferRingSize);
+		ProvidedBufferRing = nullptr;
+		return false;
+	}
+
+	ProvidedBuffers = new char[size_t(NumBuffers) * BufferSize];
+	ProvidedBufferSize = BufferSize;
+	ProvidedBufferMask = static_cast<uint16_t>(NumBuffers - 1);
+	ProvidedBufferTail = 0;
+
+	for (uint16_t BufferId = 0; BufferId < NumBuffers; ++BufferId)
+	{
+		RecycleProvidedBuffer(BufferId);
+	}
+	CommitProvidedBuffers();
+	return true;
+}
+
+void FIoUring::RecycleProvidedBuffer(uint16_t BufferId)
+{
+	// Not through io_uring_buf_ring::bufs: compiled as C++ the header's flexible array member has an empty struct in
+	// front of it, which moves it off the start of the ring
+	io_uring_buf& Buffer = reinterpret_cast<io_uring_buf*>(ProvidedBufferRing)[ProvidedBufferTail & ProvidedBufferMask];
+	Buffer.addr = reinterpret_cast<uintptr_t>(GetProvidedBuffer(BufferId));
+	Buffer.len = ProvidedBufferSize;
+	Buffer.bid = BufferId;
+	++ProvidedBufferTail;
+}
+
+void FIoUring::CommitProvidedBuffers()
+{
+	if (ProvidedBufferRing)
+	{
+		__atomic_store_n(&ProvidedBufferRing->tail, ProvidedBufferTail, __ATOMIC_RELEASE);
+	}
+}
+
+io_uring_sqe* FIoUring::GetSqe()
+{
+	if (PendingSubmissionTail - __atomic_load_n(SubmissionHead, __ATOMIC_ACQUIRE) >= NumSubmissionEntries)
+	{
+		if (!Submit() || PendingSubmissionTail - __atomic_load_n(SubmissionHead, __ATOMIC_ACQUIRE) >= NumSubmissionEntries)
+		{
+			return nullptr;
+		}
+	}
+
+	io_uring_sqe* Sqe = &SubmissionEntries[PendingSubmissionTail & SubmissionMask];
+	memset(Sqe, 0, sizeof(*Sqe));
+	++PendingSubmissionTail;
+	return Sqe;
+}
+
+bool FIoUring::Submit()
+{
+	// Counted from the kernel's head, which also covers entries a previous call could not submit
+	const uint32_t NumToSubmit = PendingSubmissionTail - __atomic_load_n(SubmissionHead, __ATOMIC_ACQUIRE);
+	if (NumToSubmit == 0)
+	{
+		return true;
+	}
+
+	__atomic_store_n(SubmissionTail, PendingSubmissionTail, __ATOMIC_RELEASE);
+
+	int Result;
+	do
+	{
+		Result = IoUringEnter(RingHandle, NumToSubmit, 0, 0);
+	} while (Result < 0 && errno == EINTR);
+
+	// Entries the kernel could not take right away, e.g. on EBUSY while completions overflow, stay queued for the next call
+	if (Result < 0 && errno != EAGAIN && errno != EBUSY)
+	{
+		FDebugLog::LogError(L"IoUring: io_uring_enter failed (errno %d)", errno);
+		return false;
+	}
+	return true;
+}
+
+bool FIoUring::FlushOverflow()
+{
+	int Result;
+	do
+	{
+		Result = IoUringEnter(RingHandle, 0, 0, IORING_ENTER_GETEVENTS);
+	} while (Result < 0 && errno == EINTR);
+	return Result >= 0;
+}
+
+#endif // TCPCLIENT_USE_IO_URING
@@ -0,0 +1,127 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "NonCopyable.h"
+
+#include <linux/io_uring.h>
+
+#include <bitset>
+
+/**
+ * Thin wrapper around an io_uring instance, built on the raw system calls so the server does not depend on liburing.
+ * Covers what FTCPClient needs: the submission and completion queues, an eventfd that signals new completions and
+ * one ring of provided receive buffers. Linux only, not thread safe.
+ */
+class FIoUring final : public FNonCopyable
+{
+public:
+	/** Buffer group of the provided buffers, for IOSQE_BUFFER_SELECT requests */
+	static constexpr uint16_t ProvidedBufferGroup = 0;
+
+	FIoUring() = default;
+	~FIoUring();
+
+	/**
+	 * Creates the ring
+	 *
+	 * @param NumEntries - Size of the submission queue, the completion queue gets four times as many entries
+	 * @return False if io_uring is not available, e.g. on old kernels, with /proc/sys/kernel/io_uring_disabled set or
+	 *         where a seccomp profile blocks it. The reason is logged.
+	 */
+	bool Init(uint32_t NumEntries);
+
+	/** Destroys the ring, which cancels all requests still in flight */
+	void Close();
+
+	bool IsInitialized() const { return RingHandle >= 0; }
+
+	/** Whether the kernel supports the IORING_OP_* operation */
+	bool IsSupported(uint8_t Operation) const { return SupportedOperations[Operation]; }
+
+	/** Makes the eventfd readable whenever completions are posted, so the ring can be waited on with epoll */
+	bool RegisterEventFd(int EventHandle);
+
+	/**
+	 * Registers NumBuffers buffers of BufferSize bytes each as ProvidedBufferGroup. The kernel picks a free one for
+	 * every receive, the completion carries its id.
+	 *
+	 * @param NumBuffers - Must be a power of two
+	 */
+	bool InitProvidedBuffers(uint16_t NumBuffers, uint32_t BufferSize);
+
+	char* GetProvidedBuffer(uint16_t BufferId) const { return ProvidedBuffers + size_t(BufferId) * ProvidedBufferSize; }
+
+	/** Hands a buffer back to the kernel once its data was consumed. Takes effect on CommitProvidedBuffers. */
+	void RecycleProvidedBuffer(uint16_t BufferId);
+	void CommitProvidedBuffers();
+
+	/** Returns a cleared submission queue entry. Submits first if the queue is full, nullptr if that failed. */
+	io_uring_sqe* GetSqe();
+
+	/** Passes all queued entries to the kernel with a single system call */
+	bool Submit();
+
+	/**
+	 * Calls Function(const io_uring_cqe&) for every posted completion and marks them as seen. Completions the kernel
+	 * held back because the completion queue was full are fetched as well.
+	 */
+	template<typename FunctionType>
+	void ProcessCompletions(FunctionType&& Function)
+	{
+		for (;;)
+		{
+			uint32_t Head = *CompletionHead;
+			const uint32_t Tail = __atomic_load_n(CompletionTail, __ATOMIC_ACQUIRE);
+			if (Head == Tail)
+			{
+				if (!(__atomic_load_n(SubmissionFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) || !FlushOverflow())
+				{
+					return;
+				}
+				continue;
+			}
+
+			for (; Head != Tail; ++Head)
+			{
+				Function(Completions[Head & CompletionMask]);
+			}
+			__atomic_store_n(CompletionHead, Tail, __ATOMIC_RELEASE);
+		}
+	}
+
+private:
+	bool FlushOverflow();
+
+	int RingHandle = -1;
+	std::bitset<256> SupportedOperations;
+
+	void* RingMemory = nullptr;
+	size_t RingMemorySize = 0;
+
+	io_uring_sqe* SubmissionEntries = nullptr;
+	size_t SubmissionEntriesSize = 0;
+
+	uint32_t* SubmissionHead = nullptr;
+	uint32_t* SubmissionTail = nullptr;
+	uint32_t* SubmissionFlags = nullptr;
+	uint32_t SubmissionMask = 0;
+	uint32_t NumSubmissionEntries = 0;
+
+	/** Tail of the entries handed out by GetSqe, published to the kernel by Submit */
+	uint32_t PendingSubmissionTail = 0;
+
+	uint32_t* CompletionHead = nullptr;
+	uint32_t* CompletionTail = nullptr;
+	io_uring_cqe* Completions = nullptr;
+	uint32_t CompletionMask = 0;
+
+	io_uring_buf_ring* ProvidedBufferRing = nullptr;
+	size_t ProvidedBufferRingSize = 0;
+	char* ProvidedBuffers = nullptr;
+	uint32_t ProvidedBufferSize = 0;
+	uint16_t ProvidedBufferMask = 0;
+
+	/** Tail of the recycled buffers, published to the kernel by CommitProvidedBuffers */
+	uint16_t ProvidedBufferTail = 0;
+};
@@ -18,11 +18,22 @@
 #include "SampleConstants.h"
 #include "AntiCheatNetworkTransport.h"
 #include "AntiCheatServer.h"
+#include "ServerLoop.h"
+#include "IdTokenCache.h"
 
 using namespace std;
 
+constexpr uint32_t SampleConstants::SdkTickIntervalMs;
+constexpr uint32_t SampleConstants::IdTokenCacheMaxAgeSeconds;
+
 bool bIsRunning = true;
 
+/** Command line parameter naming a file to record the transport traffic into, for replaying it with the load test */
+const WCHAR* const CaptureFileParam = L"capture";
+
+/** Command line switch to run the network threads on io_uring instead of epoll, on Linux kernels that support it */
+const WCHAR* const IoUringParam = L"iouring";
+
 #ifdef _WIN32
 BOOL WINAPI ConsoleHandler(DWORD CtrlType)
 {
@@ -53,6 +64,65 @@ BOOL WINAPI ConsoleHandler(DWORD CtrlType)
 }
 #endif // _WIN32
 
+/** Checks the platform a client claims in its registration message against the account info of its verified Connect ID token */
+static bool IsClaimedPlatformVerified(EOS_EAntiCheatCommonClientPlatform ClientPlatform, const char* DeviceType, const char* Platform)
+{
+	bool bIsPlatformOk = true;
+	switch (ClientPlatform)
+	{
+		// The anti-cheat client does not support consoles or mobile devices, so we must handle
+		// the anti-cheat ClientPlatform and related ClientType with care to prevent exploits.
+
+		// If the user registration message claims to be on console, verify that an actual console device is being used.
+		// See platform types here https://dev.epicgames.com/docs/game-services/eos-connect-interface#user-verification-using-an-id-token
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Nintendo:
+			if (strcmp(DeviceType, "Switch") != 0)
+			{
+				FDebugLog::LogError(L"Player claims to be on Nintendo but EOS Connect ID Token DeviceType doesn't match");
+				bIsPlatformOk = false;
+			}
+			break;
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_PlayStation:
+			if (strcmp(DeviceType, "PSVITA") != 0 && strcmp(Platform, "PS3") != 0 && strcmp(Platform, "PS4") != 0 && strcmp(Platform, "PS5") != 0)
+			{
+				FDebugLog::LogError(L"Player claims to be on Playstation but EOS Connect ID Token DeviceType doesn't match");
+				bIsPlatformOk = false;
+			}
+			break;
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Xbox:
+			if (strcmp(DeviceType, "Xbox360") != 0 && strcmp(Platform, "XboxOne") != 0)
+			{
+				FDebugLog::LogError(L"Player claims to be on Xbox but EOS Connect ID Token DeviceType doesn't match");
+				bIsPlatformOk = false;
+			}
+			break;
+
+		// These platforms do not require verification because they have anti-cheat client support and we will 
+		// require it by setting the anti-cheat ClientType to EOS_ACCCT_ProtectedClient in RegisterClient.
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Windows:
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Mac:
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Linux:
+			break;
+			
+		// If the user registration message claims to be a mobile device and your game supports mobile clients,
+		// you must must implement your own check to verify that players are really using the claimed device type.
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Android:
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_iOS:
+			// Your own platform check could go here. This sample does not support mobile clients.
+			FDebugLog::LogError(L"Player claims to be on mobile but this sample does not support mobile clients");
+			bIsPlatformOk = false;
+			break;
+
+		case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Unknown:
+		default:
+			FDebugLog::LogError(L"Player claims to be on an unknown platform");
+			bIsPlatformOk = false;
+			break;
+	}
+
+	return bIsPlatformOk;
+}
+
 int MasterMain(int Argc, const char* Args[])
 {
 	std::wstring CommandLine;
@@ -109,22 +179,57 @@ int MasterMain(int Argc, const char* Args[])
 		return 1;
 	}
 
-	FDebugLog::Log(L"Listening on port %d", Port);
-	FDebugLog::Log(L"(ctrl - c) to exit");
-
 	FAntiCheatServer Server;
 
 	Server.Init(EosSdk->PlatformHandle);
 
+	if (SampleConstants::bEnableGameplayData)
+	{
+		// game threads queue gameplay events without calling into the sdk, they are passed on in batches before each tick
+		Server.EnableGameplayTelemetry(SampleConstants::MaxGameplayThreads, SampleConstants::GameplayEventsPerThread);
+		Server.GetGameplayTelemetry().SetRateLimit(FGameplayTelemetry::EEventType::PlayerTick, SampleConstants::MaxPlayerTickEventsPerSecond);
+	}
+
+	// sleep until the network threads deliver messages or the sdk is due for a tick
+	FServerLoop Loop(std::chrono::milliseconds(SampleConstants::SdkTickIntervalMs));
+
+	FAntiCheatNetworkTransport::GetInstance().SetOnIncomingEventsCallback([&Loop]() { Loop.Wake(); });
+	FAntiCheatNetworkTransport::GetInstance().SetCoalesceOutgoingMessages(SampleConstants::bCoalesceMessagesToClients, SampleConstants::MaxCoalescedBatchBytes);
+	FAntiCheatNetworkTransport::GetInstance().SetCompressionThreshold(SampleConstants::MinCompressedMessageSize);
+	FAntiCheatNetworkTransport::GetInstance().SetUseIoUring(FCommandLine::Get().HasParam(IoUringParam));
+
 	Server.BeginSession();
 
-	FAntiCheatNetworkTransport::GetInstance().SetOnNewClientCallback([&Server](void* ClientHandle, FAntiCheatNetworkTransport::FRegistrationInfoMessage Message)
+	// remembers verified Connect ID tokens, so players reconnecting with the same token do not wait for another verification
+	FIdTokenCache IdTokenCache(SampleConstants::IdTokenCacheCapacity, std::chrono::seconds(SampleConstants::IdTokenCacheMaxAgeSeconds));
+
+	FAntiCheatNetworkTransport::GetInstance().SetOnNewClientCallback([&Server, &IdTokenCache](void* ClientHandle, FAntiCheatNetworkTransport::FRegistrationInfoMessage Message)
 	{
+		// The token was verified for this player before and has not expired, only the claimed platform has to be checked again.
+		if (const FIdTokenCache::FVerifiedToken* VerifiedToken = IdTokenCache.Find(Message.ProductUserId, Message.EOSConnectIdTokenJWT))
+		{
+			if (IsClaimedPlatformVerified(Message.ClientPlatform, VerifiedToken->DeviceType.c_str(), VerifiedToken->Platform.c_str()))
+			{
+				Server.RegisterClient(ClientHandle, Message);
+			}
+			else
+			{
+				FDebugLog::LogError(L"EOS Connect ID Token verification failed, player will be removed");
+				FAntiCheatNetworkTransport::GetInstance().CloseClientConnection(ClientHandle);
+			}
+			return;
+		}
+
 		struct VerifyCallbackHelper
 		{
 			FAntiCheatServer* Server = nullptr;
+			FIdTokenCache* IdTokenCache = nullptr;
 			void* ClientHandle = nullptr;
-			FAntiCheatNetworkTransport::FRegistrationInfoMessage Message;
+
+			// Copies, the strings of the registration message are only valid during this callback
+			std::string ProductUserId;
+			std::string EOSConnectIdTokenJWT;
+			EOS_EAntiCheatCommonClientPlatform ClientPlatform = EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Unknown;
 		};
 		auto VerifyCallback = [](const EOS_Connect_VerifyIdTokenCallbackInfo* Data)
 		{
@@ -137,68 +242,31 @@ int MasterMain(int Argc, const char* Args[])
 				{
 					FDebugLog::Log(L"EOS Connect ID Token DeviceType: %ls", FStringUtils::Widen(Data->DeviceType).c_str());
 
-					bool bIsPlatformOk = true;
-					switch (Helper->Message.ClientPlatform)
-					{
-						// The anti-cheat client does not support consoles or mobile devices, so we must handle
-						// the anti-cheat ClientPlatform and related ClientType with care to prevent exploits.
-
-						// If the user registration message claims to be on console, verify that an actual console device is being used.
-						// See platform types here https://dev.epicgames.com/docs/game-services/eos-connect-interface#user-verification-using-an-id-token
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Nintendo:
-							if (strcmp(Data->DeviceType, "Switch") != 0)
-							{
-								FDebugLog::LogError(L"Player claims to be on Nintendo but EOS Connect ID Token DeviceType doesn't match");
-								bIsPlatformOk = false;
-							}
-							break;
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_PlayStation:
-							if (strcmp(Data->DeviceType, "PSVITA") != 0 && strcmp(Data->Platform, "PS3") != 0 && strcmp(Data->Platform, "PS4") != 0 && strcmp(Data->Platform, "PS5") != 0)
-							{
-								FDebugLog::LogError(L"Player claims to be on Playstation but EOS Connect ID Token DeviceType doesn't match");
-								bIsPlatformOk = false;
-							}
-							break;
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Xbox:
-							if (strcmp(Data->DeviceType, "Xbox360") != 0 && strcmp(Data->Platform, "XboxOne") != 0)
-							{
-								FDebugLog::LogError(L"Player claims to be on Xbox but EOS Connect ID Token DeviceType doesn't match");
-								bIsPlatformOk = false;
-							}
-							break;
-
-						// These platforms do not require verification because they have anti-cheat client support and we will 
-						// require it by setting the anti-cheat ClientType to EOS_ACCCT_ProtectedClient in RegisterClient.
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Windows:
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Mac:
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Linux:
-							break;
-							
-						// If the user registration message claims to be a mobile device and your game supports mobile clients,
-						// you must must implement your own check to verify that players are really using the claimed device type.
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Android:
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_iOS:
-							// Your own platform check could go here. This sample does not support mobile clients.
-							FDebugLog::LogError(L"Player claims to be on mobile but this sample does not support mobile clients");
-							bIsPlatformOk = false;
-							break;
-
-						case EOS_EAntiCheatCommonClientPlatform::EOS_ACCCP_Unknown:
-						default:
-							FDebugLog::LogError(L"Player claims to be on an unknown platform");
-							bIsPlatformOk = false;
-							break;
-					}
+					// The token itself is valid, whatever platform this connection claims
+					Helper->IdTokenCache->Add(Helper->ProductUserId.c_str(), Helper->EOSConnectIdTokenJWT.c_str(), Data->DeviceType, Data->Platform);
+
+					const bool bIsPlatformOk = IsClaimedPlatformVerified(Helper->ClientPlatform, Data->DeviceType, Data->Platform);
 
 					// On success, continue to anti-cheat registration.
 					if (bIsPlatformOk)
 					{
 						bIsValidationOk = true;
-						Helper->Server->RegisterClient(Helper->ClientHandle, Helper->Message);
+
+						FAntiCheatNetworkTransport::FRegistrationInfoMessage Message;
+						Message.ProductUserId = Helper->ProductUserId.c_str();
+						Message.EOSConnectIdTokenJWT = Helper->EOSConnectIdTokenJWT.c_str();
+						Message.ClientPlatform = Helper->ClientPlatform;
+						Helper->Server->RegisterClient(Helper->ClientHandle, Message);
 					}
 				}
 			}
 
+			if (Data->ResultCode != EOS_EResult::EOS_Success || !Data->bIsAccountInfoPresent)
+			{
+				// Do not keep using an earlier verification of this player once a newer token failed
+				Helper->IdTokenCache->Remove(Helper->ProductUserId.c_str());
+			}
+
 			if (!bIsValidationOk)
 			{
 				// On failure, the player should not be allowed to continue connecting to the server.
@@ -209,7 +277,8 @@ int MasterMain(int Argc, const char* Args[])
 		};
 
 		// We must verify the the player's identity using the provided Connect ID Token before we allow them to continue connecting.
-		Server.VerifyIdToken(EOS_ProductUserId_FromString(Message.ProductUserId), Message.EOSConnectIdTokenJWT, new VerifyCallbackHelper{&Server, ClientHandle, Message}, VerifyCallback);
+		VerifyCallbackHelper* Helper = new VerifyCallbackHelper{ &Server, &IdTokenCache, ClientHandle, Message.ProductUserId, Message.EOSConnectIdTokenJWT, Message.ClientPlatform };
+		Server.VerifyIdToken(EOS_ProductUserId_FromString(Message.ProductUserId), Message.EOSConnectIdTokenJWT, Helper, VerifyCallback);
 	});
 	FAntiCheatNetworkTransport::GetInstance().SetOnClientDisconnectedCallback([&Server](void* ClientHandle) 
 	{
@@ -221,19 +290,74 @@ int MasterMain(int Argc, const char* Args[])
 		Server.OnMessageFromClientReceived(ClientHandle, Data, Length);
 	});
 
+	if (FCommandLine::Get().HasParam(CaptureFileParam))
+	{
+		FAntiCheatNetworkTransport::GetInstance().StartCapture(FStringUtils::Narrow(FCommandLine::Get().GetParamValue(CaptureFileParam)));
+	}
+
+	// socket i/o runs on the network threads, this thread only handles the messages and makes all sdk calls
+	if (!FAntiCheatNetworkTransport::GetInstance().Start(Port, SampleConstants::NumNetworkThreads))
+	{
+		FDebugLog::LogError(L"Unable to listen on port %d", Port);
+		FDebugLog::Log(L"Exiting...");
+		return 1;
+	}
+
+	FDebugLog::Log(L"Listening on port %d", Port);
+	FDebugLog::Log(L"(ctrl - c) to exit");
+
 	// main loop
 	while (bIsRunning)
 	{
+		Loop.Wait();
+
+		// handle the messages received by the network threads
 		FAntiCheatNetworkTransport::GetInstance().Update();
 
 		// update the sdk on the mainthread
+		Loop.BeginTick();
+		Server.GetGameplayTelemetry().Drain(SampleConstants::MaxGameplayEventsPerDrain);
 		EosSdk->Tick();
-		
-		// simulate other server activity
-		std::this_thread::sleep_for(std::chrono::milliseconds(30));
+		Server.SendProtectedMessages();
+		Loop.EndTick();
+
+		// hand the messages the sdk generated during the tick to the network threads
+		FAntiCheatNetworkTransport::GetInstance().FlushOutgoingMessages();
 	}
 
+	Loop.LogStats();
+
 	Server.EndSession();
+	FAntiCheatNetworkTransport::GetInstance().FlushOutgoingMessages();
+	FAntiCheatNetworkTransport::GetInstance().Stop();
+
+	if (SampleConstants::bCoalesceMessagesToClients)
+	{
+		const FAntiCheatNetworkTransport::FCoalescingStats& Stats = FAntiCheatNetworkTransport::GetInstance().GetCoalescingStats();
+		FDebugLog::Log(L"Coalesced %llu messages to clients into %llu sends (largest batch %u messages)",
+			static_cast<unsigned long long>(Stats.Messages), static_cast<unsigned long long>(Stats.Batches), Stats.LargestBatch);
+		for (size_t Bucket = 0; Bucket < FAntiCheatNetworkTransport::FCoalescingStats::NumHistogramBuckets; ++Bucket)
+		{
+			if (Stats.BatchSizeHistogram[Bucket] > 0)
+			{
+				FDebugLog::Log(L"  batches of %u+ messages: %llu", 1u << Bucket, static_cast<unsigned long long>(Stats.BatchSizeHistogram[Bucket]));
+			}
+		}
+	}
+
+	FAntiCheatNetworkTransport::GetInstance().LogCompressionStats();
+
+	if (SampleConstants::bEnableGameplayData)
+	{
+		Server.GetGameplayTelemetry().LogStats();
+	}
+
+	Server.GetProtectedMessageChannel().LogStats(L"Protected game messages");
+
+	const FIdTokenCache::FStats& IdTokenCacheStats = IdTokenCache.GetStats();
+	FDebugLog::Log(L"Connect ID token cache: %llu hits, %llu misses, %llu expired, %llu evictions",
+		static_cast<unsigned long long>(IdTokenCacheStats.Hits), static_cast<unsigned long long>(IdTokenCacheStats.Misses),
+		static_cast<unsigned long long>(IdTokenCacheStats.Expired), static_cast<unsigned long long>(IdTokenCacheStats.Evictions));
 
 	// then shutdown the sdk
 	EosSdk->Shutdown();
@@ -27,4 +27,41 @@ struct SampleConstants
 
 	/** Server Port */
 	static constexpr uint16 ServerPort = 1234;
+
+	/** Longest time the main loop waits between two SDK ticks when no network activity wakes it up earlier */
+	static constexpr uint32_t SdkTickIntervalMs = 30;
+
+	/** Number of threads serving client connections. Only Linux (epoll) supports more than one. */
+	static constexpr size_t NumNetworkThreads = 2;
+
+	/** Number of players whose verified Connect ID token is remembered for fast reconnects */
+	static constexpr size_t IdTokenCacheCapacity = 4096;
+
+	/** Longest time a verified Connect ID token is reused without verifying it again, tokens expiring earlier are dropped earlier */
+	static constexpr uint32_t IdTokenCacheMaxAgeSeconds = 10 * 60;
+
+	/**
+	 * Enables gameplay data (EOS_AntiCheatServer_LogPlayer*) for the session. Needs a game feeding FGameplayTelemetry,
+	 * this sample has no gameplay of its own.
+	 */
+	static constexpr bool bEnableGameplayData = false;
+
+	/** Game threads that can log gameplay events, each one gets a ring buffer of GameplayEventsPerThread events */
+	static constexpr size_t MaxGameplayThreads = 8;
+	static constexpr size_t GameplayEventsPerThread = 4096;
+
+	/** Most gameplay events passed to the SDK per main loop iteration */
+	static constexpr size_t MaxGameplayEventsPerDrain = 8192;
+
+	/** Cap on LogPlayerTick calls per second over all players, the other event types are not capped */
+	static constexpr uint32_t MaxPlayerTickEventsPerSecond = 20000;
+
+	/** Coalesce the anti-cheat messages sent to each client during an SDK tick into a single send */
+	static constexpr bool bCoalesceMessagesToClients = false;
+
+	/** Largest coalesced send, a client's messages beyond it go out in further sends */
+	static constexpr uint32_t MaxCoalescedBatchBytes = 64 * 1024;
+
+	/** Compress opaque anti-cheat messages of at least this many bytes, for clients that support it. 0 turns compression off. */
+	static constexpr uint32_t MinCompressedMessageSize = 128;
 };
@@ -0,0 +1,187 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Layout of the opaque handles handed out by TSlotMap. A handle packs the index of its slot and the generation the
+ * slot had when the value was added. The generation is never 0, so neither is a handle.
+ */
+struct FSlotMapHandle
+{
+#if UINTPTR_MAX > 0xFFFFFFFFu
+	static constexpr uint32_t IndexBits = 32;
+#else
+	static constexpr uint32_t IndexBits = 20;
+#endif
+	static constexpr uint32_t GenerationBits = sizeof(uintptr_t) * 8 - IndexBits;
+
+	static constexpr uintptr_t IndexMask = (uintptr_t(1) << IndexBits) - 1;
+	static constexpr uint32_t GenerationMask = static_cast<uint32_t>((uint64_t(1) << GenerationBits) - 1);
+
+	/** The index part of a handle, including the offset and stride the slot map was created with */
+	static uintptr_t GetIndexField(void* Handle) { return reinterpret_cast<uintptr_t>(Handle) & IndexMask; }
+	static uint32_t GetGeneration(void* Handle) { return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(Handle) >> IndexBits); }
+
+	static void* Make(uintptr_t IndexField, uint32_t Generation) { return reinterpret_cast<void*>((uintptr_t(Generation) << IndexBits) | IndexField); }
+};
+
+/**
+ * Values addressed by generational handles, with constant time add, find and remove.
+ *
+ * Removing a value frees its slot for reuse and bumps the slot's generation, so the handles of removed values are
+ * rejected by Find instead of reaching whatever value takes the slot next. A slot's generation wraps around after
+ * 2^GenerationBits reuses, which is the only way a handle can ever come back.
+ *
+ * Values do not move when other values are removed. They do move when adding grows the slot array, so pointers
+ * returned by Find are only valid until the next Add, while handles stay valid until the value is removed.
+ */
+template<typename T>
+class TSlotMap final
+{
+public:
+	/**
+	 * Constructor
+	 *
+	 * @param InIndexOffset - Added to the index of every slot when building a handle
+	 * @param InIndexStride - Multiplied with the index of every slot when building a handle. Together with the offset
+	 *                        this keeps the handles of several slot maps apart, e.g. one per thread.
+	 */
+	explicit TSlotMap(uintptr_t InIndexOffset = 0, uintptr_t InIndexStride = 1)
+		: IndexOffset(InIndexOffset)
+		, IndexStride(InIndexStride > 0 ? InIndexStride : 1)
+	{
+	}
+
+	void Reserve(size_t NumValues)
+	{
+		Slots.reserve(NumValues);
+	}
+
+	size_t Num() const { return NumValues; }
+	bool IsEmpty() const { return NumValues == 0; }
+
+	/**
+	 * Adds a value
+	 *
+	 * @return Handle of the new value, nullptr if the handle index space is exhausted
+	 */
+	void* Add(T Value)
+	{
+		uint32_t Index;
+		if (!FreeSlots.empty())
+		{
+			Index = FreeSlots.back();
+			FreeSlots.pop_back();
+		}
+		else
+		{
+			if ((Slots.size() * IndexStride + IndexOffset) > FSlotMapHandle::IndexMask)
+			{
+				return nullptr;
+			}
+			Index = static_cast<uint32_t>(Slots.size());
+			Slots.emplace_back();
+		}
+
+		FSlot& Slot = Slots[Index];
+		Slot.Value = std::move(Value);
+		Slot.bIsOccupied = true;
+		++NumValues;
+
+		return FSlotMapHandle::Make(Index * IndexStride + IndexOffset, Slot.Generation);
+	}
+
+	/** Returns the value of the handle, nullptr if it was removed or never belonged to this slot map */
+	T* Find(void* Handle)
+	{
+		FSlot* Slot = FindSlot(Handle);
+		return Slot ? &Slot->Value : nullptr;
+	}
+
+	/**
+	 * Removes the value of the handle and releases its slot for reuse
+	 *
+	 * @return False if the handle was not valid
+	 */
+	bool Remove(void* Handle)
+	{
+		FSlot* Slot = FindSlot(Handle);
+		if (!Slot)
+		{
+			return false;
+		}
+
+		// Reset rather than keep the old value around, it may own memory or other resources
+		Slot->Value = T();
+		Slot->bIsOccupied = false;
+		Slot->Generation = (Slot->Generation + 1) & FSlotMapHandle::GenerationMask;
+		if (Slot->Generation == 0)
+		{
+			Slot->Generation = 1;
+		}
+		--NumValues;
+
+		FreeSlots.push_back(static_cast<uint32_t>(Slot - Slots.data()));
+		return true;
+	}
+
+	/**
+	 * Calls Function(void* Handle, T& Value) for every value. The function may remove values, including the one it
+	 * was called for. It may also add values, which may or may not be visited, but must not touch Value afterwards.
+	 */
+	template<typename FunctionType>
+	void ForEach(FunctionType&& Function)
+	{
+		for (size_t Index = 0; Index < Slots.size(); ++Index)
+		{
+			if (Slots[Index].bIsOccupied)
+			{
+				Function(FSlotMapHandle::Make(Index * IndexStride + IndexOffset, Slots[Index].Generation), Slots[Index].Value);
+			}
+		}
+	}
+
+private:
+	struct FSlot
+	{
+		T Value = T();
+		uint32_t Generation = 1;
+		bool bIsOccupied = false;
+	};
+
+	FSlot* FindSlot(void* Handle)
+	{
+		const uintptr_t IndexField = FSlotMapHandle::GetIndexField(Handle);
+		if (IndexField < IndexOffset || (IndexField - IndexOffset) % IndexStride != 0)
+		{
+			return nullptr;
+		}
+
+		const uintptr_t Index = (IndexField - IndexOffset) / IndexStride;
+		if (Index >= Slots.size())
+		{
+			return nullptr;
+		}
+
+		FSlot& Slot = Slots[Index];
+		if (!Slot.bIsOccupied || Slot.Generation != FSlotMapHandle::GetGeneration(Handle))
+		{
+			return nullptr;
+		}
+		return &Slot;
+	}
+
+	const uintptr_t IndexOffset;
+	const uintptr_t IndexStride;
+
+	std::vector<FSlot> Slots;
+
+	/** Indices of unoccupied slots, reused last in first out so recently touched memory is reused first */
+	std::vector<uint32_t> FreeSlots;
+
+	size_t NumValues = 0;
+};
@@ -4,12 +4,16 @@
 #include "TCPClient.h"
 #include "DebugLog.h"
 
-FTCPClient::FTCPClient(int MaxSockets, size_t MaxBufferSizeBytes)
+#if !TCPCLIENT_USE_EPOLL
+
+FTCPClient::FTCPClient(int MaxSockets, size_t MaxBufferSizeBytes, uintptr_t HandleIndexOffset, uintptr_t HandleIndexStride)
+	: ClientsSockets(HandleIndexOffset, HandleIndexStride)
 {
 	SDLNet_Init();
 
-	ClientsSockets.reserve(MaxSockets);
-	SocketSet = SDLNet_AllocSocketSet(MaxSockets + 1); // +1 for the Server socket
+	ClientsSockets.Reserve(MaxSockets);
+	SocketSetCapacity = MaxSockets + 1; // +1 for the Server socket
+	SocketSet = SDLNet_AllocSocketSet(SocketSetCapacity);
 
 	Buffer.resize(MaxBufferSizeBytes);
 }
@@ -17,27 +21,77 @@ FTCPClient::FTCPClient(int MaxSockets, size_t MaxBufferSizeBytes)
 FTCPClient::~FTCPClient()
 {
 	CloseServerConnection();
-	for (TCPsocket ClientSocket : ClientsSockets)
-	{
-		CloseClientConnection(ClientSocket);
-	}
+	ClientsSockets.ForEach([this](void* ClientHandle, FClientSocket&) { CloseClientConnection(ClientHandle); });
+	ReleaseClosedClients();
 
 	SDLNet_FreeSocketSet(SocketSet);
 	SDLNet_Quit();
 }
 
-void FTCPClient::Open(uint16_t Port)
+bool FTCPClient::Open(uint16_t Port, bool bShareListenPort, bool bUseIoUring)
 {
+	if (bShareListenPort)
+	{
+		FDebugLog::LogError(L"TCPClient: Sharing a listen port is not supported with SDL_net");
+		return false;
+	}
+
+	if (bUseIoUring)
+	{
+		FDebugLog::LogWarning(L"TCPClient: io_uring is not available with SDL_net");
+	}
+
 	IPaddress IP;
 	SDLNet_ResolveHost(&IP, nullptr, Port);
-	
+
 	ServerSocket = SDLNet_TCP_Open(&IP);
+	if (!ServerSocket)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not listen on port %d", Port);
+		return false;
+	}
+
 	SDLNet_TCP_AddSocket(SocketSet, ServerSocket);
+
+	// SDL_net sockets are blocking and report no write readiness, so sends are never queued on this backend
+	FDebugLog::LogWarning(L"TCPClient: Sends block with SDL_net, slow clients are not queued or disconnected on this platform");
+	return true;
 }
 
 void FTCPClient::Send(void* To, const void* Data, size_t Length)
 {
-	SDLNet_TCP_Send(reinterpret_cast<TCPsocket>(To), Data, static_cast<int>(Length));
+	// The SDK may still send to a client that just disconnected, its handle no longer finds a socket then
+	FClientSocket* Client = ClientsSockets.Find(To);
+	if (!Client || Client->bIsClosed)
+	{
+		return;
+	}
+
+	SDLNet_TCP_Send(Client->Socket, Data, static_cast<int>(Length));
+}
+
+void FTCPClient::Send(void* To, const FTCPSendBuffer* Buffers, size_t NumBuffers)
+{
+	if (NumBuffers == 1)
+	{
+		Send(To, Buffers[0].Data, Buffers[0].Length);
+		return;
+	}
+
+	SendBuffer.clear();
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		const char* Data = reinterpret_cast<const char*>(Buffers[BufferIndex].Data);
+		SendBuffer.insert(SendBuffer.end(), Data, Data + Buffers[BufferIndex].Length);
+	}
+
+	Send(To, SendBuffer.data(), SendBuffer.size());
+}
+
+void FTCPClient::SetSendQueueSettings(const FSendQueueSettings& Settings)
+{
+	// Not used on this backend, Open already warned that sends block
+	SendQueueSettings = Settings;
 }
 
 void FTCPClient::SetOnClientDisconnectedCallback(FOnClientDisconnectedCallback Callback)
@@ -50,30 +104,93 @@ void FTCPClient::SetOnBufferReceivedCallback(FOnBufferReceivedCallback Callback)
 	OnBufferReceivedCallback = std::move(Callback);
 }
 
+void FTCPClient::GrowSocketSet()
+{
+	// SDL_net socket sets have a fixed size, so move all sockets over to a set twice as large
+	const int NewCapacity = SocketSetCapacity * 2;
+	SDLNet_SocketSet NewSocketSet = SDLNet_AllocSocketSet(NewCapacity);
+	if (!NewSocketSet)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not grow socket set to %d sockets", NewCapacity);
+		return;
+	}
+
+	SDLNet_TCP_AddSocket(NewSocketSet, ServerSocket);
+	ClientsSockets.ForEach([NewSocketSet](void*, FClientSocket& Client)
+	{
+		if (!Client.bIsClosed)
+		{
+			SDLNet_TCP_AddSocket(NewSocketSet, Client.Socket);
+		}
+	});
+
+	SDLNet_FreeSocketSet(SocketSet);
+	SocketSet = NewSocketSet;
+	SocketSetCapacity = NewCapacity;
+}
+
 void FTCPClient::OpenNewClientConnection()
 {
 	TCPsocket NewlyConnectedClientSocket = SDLNet_TCP_Accept(ServerSocket);
+	if (!NewlyConnectedClientSocket)
+	{
+		return;
+	}
+
+	FClientSocket NewClient;
+	NewClient.Socket = NewlyConnectedClientSocket;
+
+	if (static_cast<int>(ClientsSockets.Num()) + 1 >= SocketSetCapacity)
+	{
+		GrowSocketSet();
+	}
+
+	if (!ClientsSockets.Add(NewClient))
+	{
+		FDebugLog::LogError(L"TCPClient: Out of client handles, dropping new client");
+		SDLNet_TCP_Close(NewlyConnectedClientSocket);
+		return;
+	}
 
 	SDLNet_TCP_AddSocket(SocketSet, NewlyConnectedClientSocket);
-	ClientsSockets.push_back(NewlyConnectedClientSocket);
 }
 
-void FTCPClient::CloseClientConnection(TCPsocket Socket)
+void FTCPClient::CloseClientConnection(void* ClientHandle)
 {
-	OnClientDisconnectedCallback(Socket);
+	FClientSocket* Client = ClientsSockets.Find(ClientHandle);
+	if (!Client || Client->bIsClosed)
+	{
+		return;
+	}
 
-	ClientsSockets.erase(std::find(ClientsSockets.begin(), ClientsSockets.end(), Socket));
-	SDLNet_TCP_DelSocket(SocketSet, Socket);
+	Client->bIsClosed = true;
 
-	SDLNet_TCP_Close(Socket);
+	OnClientDisconnectedCallback(ClientHandle);
+
+	SDLNet_TCP_DelSocket(SocketSet, Client->Socket);
+	SDLNet_TCP_Close(Client->Socket);
+	Client->Socket = nullptr;
+
+	// Update may be walking the clients right now, so the slot is only released once it is done
+	ClosedClients.push_back(ClientHandle);
+}
+
+void FTCPClient::ReleaseClosedClients()
+{
+	for (void* ClientHandle : ClosedClients)
+	{
+		ClientsSockets.Remove(ClientHandle);
+	}
+	ClosedClients.clear();
 }
 
-void FTCPClient::CloseServerConnection() const
+void FTCPClient::CloseServerConnection()
 {
 	if (ServerSocket)
 	{
 		SDLNet_TCP_DelSocket(SocketSet, ServerSocket);
 		SDLNet_TCP_Close(ServerSocket);
+		ServerSocket = nullptr;
 	}
 }
 
@@ -81,24 +198,32 @@ void FTCPClient::Update()
 {
 	SDLNet_CheckSockets(SocketSet, 0);
 
-	for (TCPsocket ClientSocket : ClientsSockets)
+	// Receive callbacks may close any connection. Closing only marks the slot, so walking the clients stays valid and
+	// the sockets closed along the way are skipped.
+	ClientsSockets.ForEach([this](void* ClientHandle, FClientSocket& Client)
 	{
-		if (SDLNet_SocketReady(ClientSocket))
+		if (Client.bIsClosed || !SDLNet_SocketReady(Client.Socket))
 		{
-			const int ReceivedBufferLength = SDLNet_TCP_Recv(ClientSocket, &Buffer[0], static_cast<int>(Buffer.size()));
-			if (ReceivedBufferLength > 0)
-			{
-				OnBufferReceivedCallback(ClientSocket, &Buffer[0], static_cast<size_t>(ReceivedBufferLength));
-			}
-			else
-			{
-				CloseClientConnection(ClientSocket);
-			}
+			return;
 		}
-	}
+
+		const int ReceivedBufferLength = SDLNet_TCP_Recv(Client.Socket, &Buffer[0], static_cast<int>(Buffer.size()));
+		if (ReceivedBufferLength > 0)
+		{
+			OnBufferReceivedCallback(ClientHandle, &Buffer[0], static_cast<size_t>(ReceivedBufferLength));
+		}
+		else
+		{
+			CloseClientConnection(ClientHandle);
+		}
+	});
+
+	ReleaseClosedClients();
+
 	if (SDLNet_SocketReady(ServerSocket))
 	{
 		OpenNewClientConnection();
 	}
-	
 }
+
+#endif // !TCPCLIENT_USE_EPOLL
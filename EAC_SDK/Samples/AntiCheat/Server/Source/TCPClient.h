@@ -2,15 +2,85 @@
 
 #pragma once
 
+/** Linux servers use a native edge-triggered epoll loop (TCPClientEpoll.cpp), other platforms use SDL_net socket sets (TCPClient.cpp) */
+#if defined(__linux__)
+#define TCPCLIENT_USE_EPOLL 1
+#else
+#define TCPCLIENT_USE_EPOLL 0
+#endif
+
+/** With epoll, Linux servers can switch to io_uring at runtime (see Open). Build with TCPCLIENT_USE_IO_URING=0 for kernel headers older than 6.0. */
+#if !defined(TCPCLIENT_USE_IO_URING)
+#define TCPCLIENT_USE_IO_URING TCPCLIENT_USE_EPOLL
+#endif
+
+#if TCPCLIENT_USE_EPOLL
+#include <sys/uio.h>
+#include <sys/socket.h>
+#else
 #define WITHOUT_SDL
 #include "SDL_net.h"
+#endif
+
+#include "TCPSendQueue.h"
+#include "SlotMap.h"
+
+#if TCPCLIENT_USE_IO_URING
+#include "IoUring.h"
+#endif
 
 #include <vector>
 #include <functional>
+#include <memory>
+#include <chrono>
 
 class FTCPClient final
 {
 public:
+	/**
+	 * Limits for the per-client queue of outgoing data that could not be written to the socket yet.
+	 *
+	 * Only the epoll and io_uring backends (Linux) queue sends. SDL_net has no non-blocking sockets, so with it Send
+	 * blocks until the socket took all of the data, and a client that stops reading holds up its network thread until
+	 * the connection times out. These settings are ignored there.
+	 */
+	struct FSendQueueSettings
+	{
+		/** A client whose queue grows to this size counts as stalled */
+		size_t HighWatermarkBytes = 256 * 1024;
+
+		/** A stalled client recovers once its queue drains down to this size */
+		size_t LowWatermarkBytes = 64 * 1024;
+
+		/** Hard limit, a client is disconnected as soon as its queue would grow past this size */
+		size_t MaxQueuedBytes = 4 * 1024 * 1024;
+
+		/** A client that stays stalled for this long is disconnected */
+		std::chrono::milliseconds StallTimeout = std::chrono::seconds(10);
+	};
+
+	/** Send queue counters, summed over all clients */
+	struct FSendQueueStats
+	{
+		/** Bytes currently waiting in send queues */
+		size_t QueuedBytes = 0;
+
+		/** Highest value QueuedBytes has reached */
+		size_t PeakQueuedBytes = 0;
+
+		/** Bytes that could not be sent right away and had to be queued. With io_uring every sent byte is queued. */
+		uint64_t TotalQueuedBytes = 0;
+
+		/** Number of times a client reached the high watermark */
+		uint64_t Stalls = 0;
+
+		/** Clients disconnected because they stayed stalled for longer than the stall timeout */
+		uint64_t StallDisconnects = 0;
+
+		/** Clients disconnected because their queue would have exceeded the hard limit */
+		uint64_t OverflowDisconnects = 0;
+	};
+
 	/**
 	 * No default constructor for this class
 	 */
@@ -18,8 +88,16 @@ public:
 
 	/**
 	 * Constructor
+	 *
+	 * Client handles passed to the callbacks are generational slot map handles: they stay valid until the client is
+	 * disconnected, and a handle of a disconnected client is ignored rather than reaching a later client.
+	 *
+	 * @param MaxSockets - Number of client connections to reserve room for. This is not a hard limit, more clients can connect.
+	 * @param MaxBufferSizeBytes - Size of the buffer that a single receive call reads into
+	 * @param HandleIndexOffset - See TSlotMap, lets several TCP clients hand out handles that never collide
+	 * @param HandleIndexStride - See TSlotMap
 	 */
-	FTCPClient(int MaxSockets, size_t MaxBufferSizeBytes);
+	FTCPClient(int MaxSockets, size_t MaxBufferSizeBytes, uintptr_t HandleIndexOffset = 0, uintptr_t HandleIndexStride = 1);
 
 	/**
 	 * No copying or copy assignment allowed for this class.
@@ -32,9 +110,29 @@ public:
 	 */
 	virtual ~FTCPClient();
 
-	void Open(uint16_t Port);
+	/**
+	 * Starts listening for client connections
+	 *
+	 * @param Port - Port to listen on
+	 * @param bShareListenPort - Allow several TCP clients to listen on the same port, the kernel spreads new connections
+	 *                           across them. Only supported with epoll.
+	 * @param bUseIoUring - Use io_uring instead of epoll: multishot accept, multishot receives into kernel provided
+	 *                      buffers, and all sends of an Update submitted with a single system call. Falls back to epoll
+	 *                      if the kernel does not support it. Only supported with TCPCLIENT_USE_IO_URING.
+	 */
+	bool Open(uint16_t Port, bool bShareListenPort = false, bool bUseIoUring = false);
 	void Send(void* To, const void* Data, size_t Length);
 
+	/**
+	 * Sends the buffers back to back as one contiguous message, using vectored I/O where the platform supports it.
+	 * With epoll and io_uring this never blocks: whatever the socket does not take right away is queued and written from
+	 * Update. With SDL_net it blocks, see FSendQueueSettings.
+	 */
+	void Send(void* To, const FTCPSendBuffer* Buffers, size_t NumBuffers);
+
+	void SetSendQueueSettings(const FSendQueueSettings& Settings);
+	const FSendQueueStats& GetSendQueueStats() const { return SendQueueStats; }
+
 	using FOnBufferReceivedCallback = std::function<void(void*, char*, int)>;
 	void SetOnBufferReceivedCallback(FOnBufferReceivedCallback Callback);
 
@@ -43,22 +141,164 @@ public:
 
 	void Update();
 
+#if TCPCLIENT_USE_IO_URING
+	bool IsUsingIoUring() const { return Ring.IsInitialized(); }
+#else
+	bool IsUsingIoUring() const { return false; }
+#endif
+
+#if TCPCLIENT_USE_EPOLL
+	/** Readable whenever Update has work to do, so the server loop can sleep on it */
+	int GetWaitHandle() const { return EpollHandle; }
+
+	/** True if a client hit the receive budget and Update must run again without waiting for new readiness */
+	bool HasPendingData() const { return !ClientsWithPendingData.empty(); }
+
+	/** Socket of the client, -1 if the handle is unknown or the client is closed */
+	int GetClientSocket(void* ClientHandle);
+
+	/** True if data for the client is waiting in its send queue */
+	bool HasQueuedSends(void* ClientHandle);
+
+	/**
+	 * Writes as much of the buffers to the non-blocking socket as it takes without waiting. Does not touch any TCP client
+	 * state, so another thread can write to a client that has nothing queued, see FAntiCheatNetworkWorker::SendDirect.
+	 * Returns false if the socket failed.
+	 */
+	static bool WriteToSocket(int Socket, const FTCPSendBuffer* Buffers, size_t NumBuffers, std::vector<iovec>& VectorStorage, size_t& OutBytesSent);
+#endif
+
 private:
-	friend class FAntiCheatNetworkTransport;
+	friend class FAntiCheatNetworkWorker;
 	void OpenNewClientConnection();
-	void CloseClientConnection(TCPsocket ClientSocket);
+	void CloseClientConnection(void* ClientHandle);
 
-	void CloseServerConnection() const;
+	void CloseServerConnection();
+	void ReleaseClosedClients();
 
 private:
+#if TCPCLIENT_USE_EPOLL
+	/** State of a single accepted connection */
+	struct FClientConnection
+	{
+		int Socket = -1;
+
+		/** Client handle, also stored in the epoll event data of the socket */
+		void* Handle = nullptr;
+
+		/** Set once the connection is closed, the object itself is only released at the end of Update */
+		bool bIsClosed = false;
+
+		/** Set when a receive stopped before draining the socket, see ReceiveFromClient */
+		bool bHasPendingData = false;
+
+		/** Outgoing data the socket did not accept yet, written when epoll reports the socket as writable */
+		FTCPSendQueue SendQueue;
+
+		/** Set while the send queue is above the high watermark and has not drained to the low watermark yet */
+		bool bIsStalled = false;
+		ServerTimePoint StallStartTime;
+
+		/** io_uring requests that have not completed yet. The connection is only released once there are none left. */
+		uint32_t NumPendingOperations = 0;
+
+		/** Set while an io_uring send of the front of the send queue is in flight, there is at most one at a time */
+		bool bIsSending = false;
+
+#if TCPCLIENT_USE_IO_URING
+		/** Describes the data of the send in flight, must stay put until it completes */
+		std::vector<iovec> SendVectors;
+		msghdr SendMessage = {};
+#endif
+	};
+
+	/** Accepts a new socket as a client connection, nullptr if that failed and the socket was closed */
+	FClientConnection* AddClientConnection(int ClientSocket);
+
+	/** Returns the connection of the handle, nullptr if it is unknown or already closed */
+	FClientConnection* FindClient(void* ClientHandle);
+
+	void ReceiveFromClient(FClientConnection* Client);
+	bool WriteToSocket(FClientConnection* Client, const FTCPSendBuffer* Buffers, size_t NumBuffers, size_t& OutBytesSent);
+	void QueueSend(FClientConnection* Client, const FTCPSendBuffer* Buffers, size_t NumBuffers, size_t BytesAlreadySent);
+	void FlushSendQueue(FClientConnection* Client);
+	void SetWriteNotification(FClientConnection* Client, bool bEnabled);
+	void DisconnectStalledClients();
+
+	int ServerSocket = -1;
+	int EpollHandle = -1;
+
+	/** Connections by client handle. Held by pointer so a connection stays put while its callbacks run. */
+	TSlotMap<std::unique_ptr<FClientConnection>> Clients;
+
+	/** Clients that hit the per-Update receive budget and must be read again even without a new edge */
+	std::vector<FClientConnection*> ClientsWithPendingData;
+
+	/** Clients that reached the high watermark, checked against the stall timeout in Update */
+	std::vector<FClientConnection*> StalledClients;
+
+	/** Scatter/gather list for the message being sent, reused between sends */
+	std::vector<iovec> SendVectors;
+
+#if TCPCLIENT_USE_IO_URING
+	/** What a completion belongs to, stored in the low bits of its user data next to the connection pointer */
+	enum class EIoOperation : uint64_t
+	{
+		Accept = 0,
+		Receive = 1,
+		Send = 2
+	};
+
+	bool OpenIoUring();
+	void CloseIoUring();
+	void UpdateIoUring();
+	void OnIoCompleted(const io_uring_cqe& Completion);
+	void QueueAccept();
+	void QueueReceive(FClientConnection* Client);
+	void QueueSendOperation(FClientConnection* Client);
+	void OnAcceptCompleted(const io_uring_cqe& Completion);
+	void OnReceiveCompleted(FClientConnection* Client, const io_uring_cqe& Completion);
+	void OnSendCompleted(FClientConnection* Client, const io_uring_cqe& Completion);
+
+	FIoUring Ring;
+
+	/** Signalled by the ring on new completions, watched through EpollHandle so GetWaitHandle works for both backends */
+	int RingEventHandle = -1;
+
+	/** Clients with queued data and no send in flight, their sends are submitted together at the end of Update */
+	std::vector<FClientConnection*> ClientsToSend;
+#endif
+#else
+	void GrowSocketSet();
+
+	struct FClientSocket
+	{
+		TCPsocket Socket = nullptr;
+
+		/** Set once the connection is closed, the slot itself is only released at the end of Update */
+		bool bIsClosed = false;
+	};
+
 	TCPsocket ServerSocket = nullptr;
-	std::vector<TCPsocket> ClientsSockets;
+
+	/** Connected sockets by client handle */
+	TSlotMap<FClientSocket> ClientsSockets;
 
 	SDLNet_SocketSet SocketSet;
+	int SocketSetCapacity = 0;
+
+	/** SDL_net has no vectored send, multi-buffer messages are gathered here. Reused between sends. */
+	std::vector<char> SendBuffer;
+#endif
+
+	/** Handles of clients closed since the last Update, released at its end so no pending event can see a reused slot */
+	std::vector<void*> ClosedClients;
 
 	std::vector<char> Buffer;
 
+	FSendQueueSettings SendQueueSettings;
+	FSendQueueStats SendQueueStats;
+
 	FOnBufferReceivedCallback OnBufferReceivedCallback;
 	FOnClientDisconnectedCallback OnClientDisconnectedCallback;
 };
-
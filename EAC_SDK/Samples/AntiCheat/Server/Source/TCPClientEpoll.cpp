@@ -0,0 +1,602 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "TCPClient.h"
+#include "DebugLog.h"
+
+#if TCPCLIENT_USE_EPOLL
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <climits>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+
+namespace
+{
+	/** Maximum number of events fetched by a single epoll_wait call */
+	constexpr int MaxEventsPerWait = 256;
+
+	/** Maximum number of receive calls for one client per Update, so a single busy client cannot starve the others */
+	constexpr int MaxReceivesPerClient = 16;
+
+	/** Maximum number of queue blocks handed to a single sendmsg call when flushing a send queue */
+	constexpr size_t MaxBuffersPerFlush = 64;
+
+	/** Events every client socket is watched for, EPOLLOUT is added only while its send queue is not empty */
+	constexpr uint32_t ClientSocketEvents = EPOLLIN | EPOLLRDHUP | EPOLLET;
+
+	/** Marker stored in the epoll event data for the listening socket, client handles are never null */
+	void* const ServerSocketTag = nullptr;
+}
+
+FTCPClient::FTCPClient(int MaxSockets, size_t MaxBufferSizeBytes, uintptr_t HandleIndexOffset, uintptr_t HandleIndexStride)
+	: Clients(HandleIndexOffset, HandleIndexStride)
+{
+	EpollHandle = epoll_create1(EPOLL_CLOEXEC);
+	if (EpollHandle < 0)
+	{
+		FDebugLog::LogError(L"TCPClient: epoll_create1 failed (errno %d)", errno);
+	}
+
+	Clients.Reserve(MaxSockets);
+	Buffer.resize(MaxBufferSizeBytes);
+}
+
+FTCPClient::~FTCPClient()
+{
+	CloseServerConnection();
+	Clients.ForEach([this](void* ClientHandle, std::unique_ptr<FClientConnection>&) { CloseClientConnection(ClientHandle); });
+#if TCPCLIENT_USE_IO_URING
+	CloseIoUring();
+#endif
+	ReleaseClosedClients();
+
+	if (EpollHandle >= 0)
+	{
+		close(EpollHandle);
+	}
+}
+
+bool FTCPClient::Open(uint16_t Port, bool bShareListenPort, bool bUseIoUring)
+{
+	ServerSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (ServerSocket < 0)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not create server socket (errno %d)", errno);
+		return false;
+	}
+
+	const int ReuseAddress = 1;
+	setsockopt(ServerSocket, SOL_SOCKET, SO_REUSEADDR, &ReuseAddress, sizeof(ReuseAddress));
+
+	if (bShareListenPort)
+	{
+		const int ReusePort = 1;
+		if (setsockopt(ServerSocket, SOL_SOCKET, SO_REUSEPORT, &ReusePort, sizeof(ReusePort)) != 0)
+		{
+			FDebugLog::LogError(L"TCPClient: Could not share port %d (errno %d)", Port, errno);
+			CloseServerConnection();
+			return false;
+		}
+	}
+
+	sockaddr_in Address = {};
+	Address.sin_family = AF_INET;
+	Address.sin_addr.s_addr = htonl(INADDR_ANY);
+	Address.sin_port = htons(Port);
+
+	if (bind(ServerSocket, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0 || listen(ServerSocket, SOMAXCONN) != 0)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not listen on port %d (errno %d)", Port, errno);
+		CloseServerConnection();
+		return false;
+	}
+
+#if TCPCLIENT_USE_IO_URING
+	if (bUseIoUring)
+	{
+		if (OpenIoUring())
+		{
+			FDebugLog::Log(L"TCPClient: Using io_uring");
+			return true;
+		}
+		FDebugLog::LogWarning(L"TCPClient: io_uring is not available, falling back to epoll");
+	}
+#endif
+
+	epoll_event Event = {};
+	Event.events = EPOLLIN | EPOLLET;
+	Event.data.ptr = ServerSocketTag;
+	epoll_ctl(EpollHandle, EPOLL_CTL_ADD, ServerSocket, &Event);
+	return true;
+}
+
+void FTCPClient::Send(void* To, const void* Data, size_t Length)
+{
+	FTCPSendBuffer Buffer;
+	Buffer.Data = Data;
+	Buffer.Length = Length;
+	Send(To, &Buffer, 1);
+}
+
+void FTCPClient::Send(void* To, const FTCPSendBuffer* Buffers, size_t NumBuffers)
+{
+	// The SDK may still send to a client that just disconnected, its handle no longer finds a connection then
+	FClientConnection* Client = FindClient(To);
+	if (!Client)
+	{
+		return;
+	}
+
+	// Queued data goes out first to keep the stream in order. With nothing queued, try to write straight from the
+	// caller's buffers so the common case does not copy at all. With io_uring everything is queued and sent at the end
+	// of Update, the caller's buffers do not live that long.
+	size_t BytesSent = 0;
+	if (Client->SendQueue.IsEmpty() && !IsUsingIoUring())
+	{
+		if (!WriteToSocket(Client, Buffers, NumBuffers, BytesSent))
+		{
+			CloseClientConnection(Client->Handle);
+			return;
+		}
+	}
+
+	QueueSend(Client, Buffers, NumBuffers, BytesSent);
+}
+
+void FTCPClient::SetSendQueueSettings(const FSendQueueSettings& Settings)
+{
+	SendQueueSettings = Settings;
+}
+
+int FTCPClient::GetClientSocket(void* ClientHandle)
+{
+	FClientConnection* Client = FindClient(ClientHandle);
+	return Client ? Client->Socket : -1;
+}
+
+bool FTCPClient::HasQueuedSends(void* ClientHandle)
+{
+	FClientConnection* Client = FindClient(ClientHandle);
+	return Client && !Client->SendQueue.IsEmpty();
+}
+
+bool FTCPClient::WriteToSocket(FClientConnection* Client, const FTCPSendBuffer* Buffers, size_t NumBuffers, size_t& OutBytesSent)
+{
+	return WriteToSocket(Client->Socket, Buffers, NumBuffers, SendVectors, OutBytesSent);
+}
+
+bool FTCPClient::WriteToSocket(int Socket, const FTCPSendBuffer* Buffers, size_t NumBuffers, std::vector<iovec>& VectorStorage, size_t& OutBytesSent)
+{
+	OutBytesSent = 0;
+
+	VectorStorage.resize(NumBuffers);
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		VectorStorage[BufferIndex].iov_base = const_cast<void*>(Buffers[BufferIndex].Data);
+		VectorStorage[BufferIndex].iov_len = Buffers[BufferIndex].Length;
+	}
+
+	iovec* Vectors = VectorStorage.data();
+	size_t NumVectors = VectorStorage.size();
+	while (NumVectors > 0)
+	{
+		// sendmsg rather than writev, so MSG_NOSIGNAL can be passed
+		msghdr Message = {};
+		Message.msg_iov = Vectors;
+		Message.msg_iovlen = std::min<size_t>(NumVectors, IOV_MAX);
+
+		const ssize_t BytesSent = sendmsg(Socket, &Message, MSG_NOSIGNAL);
+		if (BytesSent >= 0)
+		{
+			OutBytesSent += static_cast<size_t>(BytesSent);
+
+			// Skip what was fully sent and trim a partially sent buffer
+			size_t BytesRemaining = static_cast<size_t>(BytesSent);
+			while (NumVectors > 0 && BytesRemaining >= Vectors->iov_len)
+			{
+				BytesRemaining -= Vectors->iov_len;
+				++Vectors;
+				--NumVectors;
+			}
+			if (NumVectors > 0)
+			{
+				Vectors->iov_base = reinterpret_cast<char*>(Vectors->iov_base) + BytesRemaining;
+				Vectors->iov_len -= BytesRemaining;
+			}
+		}
+		else if (errno == EINTR)
+		{
+			continue;
+		}
+		else if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			return true;
+		}
+		else
+		{
+			FDebugLog::LogError(L"TCPClient: Send failed (errno %d), dropping client", errno);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FTCPClient::QueueSend(FClientConnection* Client, const FTCPSendBuffer* Buffers, size_t NumBuffers, size_t BytesAlreadySent)
+{
+	size_t MessageLength = 0;
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		MessageLength += Buffers[BufferIndex].Length;
+	}
+
+	const size_t BytesToQueue = MessageLength - BytesAlreadySent;
+	if (BytesToQueue == 0)
+	{
+		return;
+	}
+
+	FTCPSendQueue& SendQueue = Client->SendQueue;
+	if (SendQueue.GetQueuedBytes() + BytesToQueue > SendQueueSettings.MaxQueuedBytes)
+	{
+		FDebugLog::LogError(L"TCPClient: Send queue of client would exceed %u bytes, dropping client", static_cast<uint32_t>(SendQueueSettings.MaxQueuedBytes));
+		++SendQueueStats.OverflowDisconnects;
+		CloseClientConnection(Client->Handle);
+		return;
+	}
+
+	const bool bWasEmpty = SendQueue.IsEmpty();
+	SendQueue.Append(Buffers, NumBuffers, BytesAlreadySent);
+
+	SendQueueStats.QueuedBytes += BytesToQueue;
+	SendQueueStats.PeakQueuedBytes = std::max(SendQueueStats.PeakQueuedBytes, SendQueueStats.QueuedBytes);
+	SendQueueStats.TotalQueuedBytes += BytesToQueue;
+
+	if (bWasEmpty)
+	{
+		SetWriteNotification(Client, true);
+	}
+
+	if (!Client->bIsStalled && SendQueue.GetQueuedBytes() >= SendQueueSettings.HighWatermarkBytes)
+	{
+		FDebugLog::LogWarning(L"TCPClient: Client stalled with %u bytes queued", static_cast<uint32_t>(SendQueue.GetQueuedBytes()));
+		Client->bIsStalled = true;
+		Client->StallStartTime = std::chrono::steady_clock::now();
+		StalledClients.push_back(Client);
+		++SendQueueStats.Stalls;
+	}
+}
+
+void FTCPClient::FlushSendQueue(FClientConnection* Client)
+{
+	FTCPSendQueue& SendQueue = Client->SendQueue;
+
+	FTCPSendBuffer Buffers[MaxBuffersPerFlush];
+	while (!SendQueue.IsEmpty())
+	{
+		const size_t NumBuffers = SendQueue.GetQueuedBuffers(Buffers, MaxBuffersPerFlush);
+
+		size_t BytesInBuffers = 0;
+		for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+		{
+			BytesInBuffers += Buffers[BufferIndex].Length;
+		}
+
+		size_t BytesSent = 0;
+		if (!WriteToSocket(Client, Buffers, NumBuffers, BytesSent))
+		{
+			CloseClientConnection(Client->Handle);
+			return;
+		}
+
+		SendQueue.Consume(BytesSent);
+		SendQueueStats.QueuedBytes -= BytesSent;
+
+		if (BytesSent < BytesInBuffers)
+		{
+			// The socket is full again, wait for the next writable edge
+			break;
+		}
+	}
+
+	if (Client->bIsStalled && SendQueue.GetQueuedBytes() <= SendQueueSettings.LowWatermarkBytes)
+	{
+		Client->bIsStalled = false;
+	}
+
+	if (SendQueue.IsEmpty())
+	{
+		SetWriteNotification(Client, false);
+	}
+}
+
+void FTCPClient::SetWriteNotification(FClientConnection* Client, bool bEnabled)
+{
+#if TCPCLIENT_USE_IO_URING
+	if (IsUsingIoUring())
+	{
+		if (bEnabled)
+		{
+			ClientsToSend.push_back(Client);
+		}
+		return;
+	}
+#endif
+
+	epoll_event Event = {};
+	Event.events = bEnabled ? (ClientSocketEvents | EPOLLOUT) : ClientSocketEvents;
+	Event.data.ptr = Client->Handle;
+	epoll_ctl(EpollHandle, EPOLL_CTL_MOD, Client->Socket, &Event);
+}
+
+void FTCPClient::DisconnectStalledClients()
+{
+	const ServerTimePoint Now = std::chrono::steady_clock::now();
+
+	// Entries of clients that recovered or disconnected are dropped here as well
+	std::vector<FClientConnection*> ClientsToDisconnect;
+	erase_if(StalledClients, [&](FClientConnection* Client)
+	{
+		if (Client->bIsClosed || !Client->bIsStalled)
+		{
+			return true;
+		}
+		if (Now - Client->StallStartTime >= SendQueueSettings.StallTimeout)
+		{
+			ClientsToDisconnect.push_back(Client);
+			return true;
+		}
+		return false;
+	});
+
+	for (FClientConnection* Client : ClientsToDisconnect)
+	{
+		FDebugLog::LogError(L"TCPClient: Client did not drain its send queue in time, dropping client");
+		++SendQueueStats.StallDisconnects;
+		CloseClientConnection(Client->Handle);
+	}
+}
+
+void FTCPClient::SetOnClientDisconnectedCallback(FOnClientDisconnectedCallback Callback)
+{
+	OnClientDisconnectedCallback = std::move(Callback);
+}
+
+void FTCPClient::SetOnBufferReceivedCallback(FOnBufferReceivedCallback Callback)
+{
+	OnBufferReceivedCallback = std::move(Callback);
+}
+
+void FTCPClient::OpenNewClientConnection()
+{
+	// Edge-triggered: accept until the backlog is empty, otherwise no new event is raised for the remaining connections
+	for (;;)
+	{
+		const int ClientSocket = accept4(ServerSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (ClientSocket < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				FDebugLog::LogError(L"TCPClient: accept failed (errno %d)", errno);
+			}
+			return;
+		}
+
+		FClientConnection* NewClient = AddClientConnection(ClientSocket);
+		if (!NewClient)
+		{
+			continue;
+		}
+
+		epoll_event Event = {};
+		Event.events = ClientSocketEvents;
+		Event.data.ptr = NewClient->Handle;
+		if (epoll_ctl(EpollHandle, EPOLL_CTL_ADD, ClientSocket, &Event) != 0)
+		{
+			FDebugLog::LogError(L"TCPClient: Could not watch client socket (errno %d)", errno);
+			close(ClientSocket);
+			Clients.Remove(NewClient->Handle);
+			continue;
+		}
+	}
+}
+
+FTCPClient::FClientConnection* FTCPClient::AddClientConnection(int ClientSocket)
+{
+	const int NoDelay = 1;
+	setsockopt(ClientSocket, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+
+	std::unique_ptr<FClientConnection> Client = std::make_unique<FClientConnection>();
+	Client->Socket = ClientSocket;
+
+	FClientConnection* NewClient = Client.get();
+	NewClient->Handle = Clients.Add(std::move(Client));
+	if (!NewClient->Handle)
+	{
+		FDebugLog::LogError(L"TCPClient: Out of client handles, dropping new client");
+		close(ClientSocket);
+		return nullptr;
+	}
+	return NewClient;
+}
+
+FTCPClient::FClientConnection* FTCPClient::FindClient(void* ClientHandle)
+{
+	std::unique_ptr<FClientConnection>* Client = Clients.Find(ClientHandle);
+	return (Client && !(*Client)->bIsClosed) ? Client->get() : nullptr;
+}
+
+void FTCPClient::CloseClientConnection(void* ClientHandle)
+{
+	FClientConnection* Client = FindClient(ClientHandle);
+	if (!Client)
+	{
+		return;
+	}
+
+	Client->bIsClosed = true;
+
+	OnClientDisconnectedCallback(ClientHandle);
+
+	if (IsUsingIoUring())
+	{
+		// Requests in flight keep the socket open, shutting it down makes them complete
+		shutdown(Client->Socket, SHUT_RDWR);
+	}
+	else
+	{
+		epoll_ctl(EpollHandle, EPOLL_CTL_DEL, Client->Socket, nullptr);
+	}
+	close(Client->Socket);
+	Client->Socket = -1;
+
+	SendQueueStats.QueuedBytes -= Client->SendQueue.GetQueuedBytes();
+	if (!Client->bIsSending)
+	{
+		// A send in flight still reads from the queue, which is then released with the connection
+		Client->SendQueue.Clear();
+	}
+
+	// The connection may still be referenced further up the stack, e.g. by ReceiveFromClient, so keep it until Update ends
+	ClosedClients.push_back(ClientHandle);
+}
+
+void FTCPClient::ReleaseClosedClients()
+{
+	// Connections that io_uring requests still point to stay until those complete
+	erase_if(ClosedClients, [this](void* ClientHandle)
+	{
+		std::unique_ptr<FClientConnection>* Client = Clients.Find(ClientHandle);
+		if (Client && (*Client)->NumPendingOperations > 0)
+		{
+			return false;
+		}
+		Clients.Remove(ClientHandle);
+		return true;
+	});
+}
+
+void FTCPClient::CloseServerConnection()
+{
+	if (ServerSocket >= 0)
+	{
+		epoll_ctl(EpollHandle, EPOLL_CTL_DEL, ServerSocket, nullptr);
+		close(ServerSocket);
+		ServerSocket = -1;
+	}
+}
+
+void FTCPClient::ReceiveFromClient(FClientConnection* Client)
+{
+	// Edge-triggered: the socket has to be read until it would block. To stay fair to the other clients reading stops
+	// after a fixed number of receives, and the client is read again in the next Update.
+	Client->bHasPendingData = false;
+	for (int ReceiveCount = 0; ReceiveCount < MaxReceivesPerClient; ++ReceiveCount)
+	{
+		const ssize_t ReceivedBufferLength = recv(Client->Socket, &Buffer[0], Buffer.size(), 0);
+		if (ReceivedBufferLength > 0)
+		{
+			OnBufferReceivedCallback(Client->Handle, &Buffer[0], static_cast<int>(ReceivedBufferLength));
+			if (Client->bIsClosed)
+			{
+				return;
+			}
+		}
+		else if (ReceivedBufferLength < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (ReceivedBufferLength < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			return;
+		}
+		else
+		{
+			CloseClientConnection(Client->Handle);
+			return;
+		}
+	}
+
+	Client->bHasPendingData = true;
+	ClientsWithPendingData.push_back(Client);
+}
+
+void FTCPClient::Update()
+{
+#if TCPCLIENT_USE_IO_URING
+	if (IsUsingIoUring())
+	{
+		UpdateIoUring();
+		return;
+	}
+#endif
+
+	// Clients that were cut off by the receive budget in the previous Update will not raise another edge
+	std::vector<FClientConnection*> PendingClients;
+	PendingClients.swap(ClientsWithPendingData);
+	for (FClientConnection* Client : PendingClients)
+	{
+		if (!Client->bIsClosed && Client->bHasPendingData)
+		{
+			ReceiveFromClient(Client);
+		}
+	}
+
+	epoll_event Events[MaxEventsPerWait];
+	int NumEvents;
+	do
+	{
+		NumEvents = epoll_wait(EpollHandle, Events, MaxEventsPerWait, 0);
+		for (int EventIndex = 0; EventIndex < NumEvents; ++EventIndex)
+		{
+			const epoll_event& Event = Events[EventIndex];
+			if (Event.data.ptr == ServerSocketTag)
+			{
+				OpenNewClientConnection();
+				continue;
+			}
+
+			// Events of clients closed earlier in this batch no longer find them
+			FClientConnection* Client = FindClient(Event.data.ptr);
+			if (!Client)
+			{
+				continue;
+			}
+
+			if ((Event.events & EPOLLOUT) && !Client->SendQueue.IsEmpty())
+			{
+				FlushSendQueue(Client);
+				if (Client->bIsClosed)
+				{
+					continue;
+				}
+			}
+
+			// Read first even on hang up, so data sent right before the close is still delivered
+			if ((Event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !Client->bHasPendingData)
+			{
+				ReceiveFromClient(Client);
+			}
+		}
+	// A full batch means more events may be ready
+	} while (NumEvents == MaxEventsPerWait);
+
+	if (!StalledClients.empty())
+	{
+		DisconnectStalledClients();
+	}
+
+	erase_if(ClientsWithPendingData, [](const FClientConnection* Client) { return Client->bIsClosed; });
+	ReleaseClosedClients();
+}
+
+#endif // TCPCLIENT_USE_EPOLL
@@ -0,0 +1,311 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "TCPClient.h"
+#include "DebugLog.h"
+
+#if TCPCLIENT_USE_IO_URING
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+
+// The io_uring backend of FTCPClient. Sockets, connections, send queues and the stall handling are shared with the
+// epoll backend in TCPClientEpoll.cpp, only the I/O itself runs through the ring.
+
+namespace
+{
+	/** Size of the submission queue, every connection has at most one receive and one send in flight */
+	constexpr uint32_t RingEntries = 1024;
+
+	/** Receive buffers the kernel picks from, each MaxBufferSizeBytes large. Recycled as soon as the data was handed on. */
+	constexpr uint16_t NumProvidedBuffers = 512;
+
+	/** Maximum number of queue blocks handed to a single send */
+	constexpr size_t MaxBuffersPerSend = 64;
+
+	/** The user data of a request is its connection pointer with the operation in the low bits */
+	constexpr uint64_t OperationMask = 3;
+
+	/**
+	 * Multishot receives were added in Linux 6.0 and cannot be probed for. IORING_OP_SEND_ZC came with the same
+	 * release, so it stands in for them.
+	 */
+	constexpr uint8_t RequiredOperations[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_SEND_ZC };
+}
+
+bool FTCPClient::OpenIoUring()
+{
+	static_assert(alignof(FClientConnection) > OperationMask, "Connection pointers need free low bits for the operation");
+
+	if (!Ring.Init(RingEntries))
+	{
+		return false;
+	}
+
+	for (uint8_t Operation : RequiredOperations)
+	{
+		if (!Ring.IsSupported(Operation))
+		{
+			FDebugLog::LogWarning(L"TCPClient: io_uring lacks operation %d, Linux 6.0 or later is required", Operation);
+			CloseIoUring();
+			return false;
+		}
+	}
+
+	RingEventHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (RingEventHandle < 0 || !Ring.RegisterEventFd(RingEventHandle) || !Ring.InitProvidedBuffers(NumProvidedBuffers, static_cast<uint32_t>(Buffer.size())))
+	{
+		CloseIoUring();
+		return false;
+	}
+
+	epoll_event Event = {};
+	Event.events = EPOLLIN;
+	if (epoll_ctl(EpollHandle, EPOLL_CTL_ADD, RingEventHandle, &Event) != 0)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not watch the io_uring eventfd (errno %d)", errno);
+		CloseIoUring();
+		return false;
+	}
+
+	// Only queued here: the first Update submits it, so every request is issued by the thread that runs Update
+	QueueAccept();
+	return true;
+}
+
+void FTCPClient::CloseIoUring()
+{
+	// Closing the ring cancels all requests, connections no longer need to wait for their completions
+	Ring.Close();
+	Clients.ForEach([](void*, std::unique_ptr<FClientConnection>& Client)
+	{
+		Client->NumPendingOperations = 0;
+		Client->bIsSending = false;
+	});
+	ClientsToSend.clear();
+
+	if (RingEventHandle >= 0)
+	{
+		epoll_ctl(EpollHandle, EPOLL_CTL_DEL, RingEventHandle, nullptr);
+		close(RingEventHandle);
+		RingEventHandle = -1;
+	}
+}
+
+void FTCPClient::QueueAccept()
+{
+	io_uring_sqe* Sqe = Ring.GetSqe();
+	if (!Sqe)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not queue accept, no new clients will be accepted");
+		return;
+	}
+
+	Sqe->opcode = IORING_OP_ACCEPT;
+	Sqe->fd = ServerSocket;
+	Sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	Sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	Sqe->user_data = static_cast<uint64_t>(EIoOperation::Accept);
+}
+
+void FTCPClient::QueueReceive(FClientConnection* Client)
+{
+	io_uring_sqe* Sqe = Ring.GetSqe();
+	if (!Sqe)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not queue receive, dropping client");
+		CloseClientConnection(Client->Handle);
+		return;
+	}
+
+	// One request keeps receiving into provided buffers until it fails or the peer closes, there is no
+	// receive call per chunk of data and no buffer is tied up while a client is idle
+	Sqe->opcode = IORING_OP_RECV;
+	Sqe->fd = Client->Socket;
+	Sqe->ioprio = IORING_RECV_MULTISHOT;
+	Sqe->flags = IOSQE_BUFFER_SELECT;
+	Sqe->buf_group = FIoUring::ProvidedBufferGroup;
+	Sqe->user_data = reinterpret_cast<uintptr_t>(Client) | static_cast<uint64_t>(EIoOperation::Receive);
+	++Client->NumPendingOperations;
+}
+
+void FTCPClient::QueueSendOperation(FClientConnection* Client)
+{
+	io_uring_sqe* Sqe = Ring.GetSqe();
+	if (!Sqe)
+	{
+		FDebugLog::LogError(L"TCPClient: Could not queue send, dropping client");
+		CloseClientConnection(Client->Handle);
+		return;
+	}
+
+	FTCPSendBuffer Buffers[MaxBuffersPerSend];
+	const size_t NumBuffers = Client->SendQueue.GetQueuedBuffers(Buffers, MaxBuffersPerSend);
+
+	Client->SendVectors.resize(NumBuffers);
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		Client->SendVectors[BufferIndex].iov_base = const_cast<void*>(Buffers[BufferIndex].Data);
+		Client->SendVectors[BufferIndex].iov_len = Buffers[BufferIndex].Length;
+	}
+	Client->SendMessage = {};
+	Client->SendMessage.msg_iov = Client->SendVectors.data();
+	Client->SendMessage.msg_iovlen = NumBuffers;
+
+	Sqe->opcode = IORING_OP_SENDMSG;
+	Sqe->fd = Client->Socket;
+	Sqe->addr = reinterpret_cast<uintptr_t>(&Client->SendMessage);
+	Sqe->len = 1;
+	Sqe->msg_flags = MSG_NOSIGNAL;
+	Sqe->user_data = reinterpret_cast<uintptr_t>(Client) | static_cast<uint64_t>(EIoOperation::Send);
+	++Client->NumPendingOperations;
+	Client->bIsSending = true;
+}
+
+void FTCPClient::OnIoCompleted(const io_uring_cqe& Completion)
+{
+	FClientConnection* Client = reinterpret_cast<FClientConnection*>(static_cast<uintptr_t>(Completion.user_data & ~OperationMask));
+	switch (static_cast<EIoOperation>(Completion.user_data & OperationMask))
+	{
+		case EIoOperation::Accept:
+			OnAcceptCompleted(Completion);
+			break;
+
+		case EIoOperation::Receive:
+			OnReceiveCompleted(Client, Completion);
+			break;
+
+		case EIoOperation::Send:
+			OnSendCompleted(Client, Completion);
+			break;
+	}
+}
+
+void FTCPClient::OnAcceptCompleted(const io_uring_cqe& Completion)
+{
+	// The kernel ends a multishot accept on errors, start a new one while still listening
+	if (!(Completion.flags & IORING_CQE_F_MORE) && ServerSocket >= 0)
+	{
+		QueueAccept();
+	}
+
+	if (Completion.res < 0)
+	{
+		if (Completion.res != -ECONNABORTED && Completion.res != -EINTR)
+		{
+			FDebugLog::LogError(L"TCPClient: accept failed (errno %d)", -Completion.res);
+		}
+		return;
+	}
+
+	FClientConnection* NewClient = AddClientConnection(Completion.res);
+	if (NewClient)
+	{
+		QueueReceive(NewClient);
+	}
+}
+
+void FTCPClient::OnReceiveCompleted(FClientConnection* Client, const io_uring_cqe& Completion)
+{
+	const bool bHasMore = (Completion.flags & IORING_CQE_F_MORE) != 0;
+	if (!bHasMore)
+	{
+		--Client->NumPendingOperations;
+	}
+
+	if (Completion.flags & IORING_CQE_F_BUFFER)
+	{
+		const uint16_t BufferId = static_cast<uint16_t>(Completion.flags >> IORING_CQE_BUFFER_SHIFT);
+		if (Completion.res > 0 && !Client->bIsClosed)
+		{
+			OnBufferReceivedCallback(Client->Handle, Ring.GetProvidedBuffer(BufferId), Completion.res);
+		}
+		Ring.RecycleProvidedBuffer(BufferId);
+	}
+
+	if (bHasMore || Client->bIsClosed)
+	{
+		return;
+	}
+
+	// The kernel also ends a multishot receive when it runs out of provided buffers, those are recycled by the time
+	// the new request is submitted
+	if (Completion.res > 0 || Completion.res == -ENOBUFS)
+	{
+		QueueReceive(Client);
+		return;
+	}
+
+	// 0 is an orderly shutdown by the peer
+	CloseClientConnection(Client->Handle);
+}
+
+void FTCPClient::OnSendCompleted(FClientConnection* Client, const io_uring_cqe& Completion)
+{
+	--Client->NumPendingOperations;
+	Client->bIsSending = false;
+
+	if (Client->bIsClosed)
+	{
+		// Kept while the send was in flight, see CloseClientConnection
+		Client->SendQueue.Clear();
+		return;
+	}
+
+	if (Completion.res < 0)
+	{
+		FDebugLog::LogError(L"TCPClient: Send failed (errno %d), dropping client", -Completion.res);
+		CloseClientConnection(Client->Handle);
+		return;
+	}
+
+	FTCPSendQueue& SendQueue = Client->SendQueue;
+	SendQueue.Consume(static_cast<size_t>(Completion.res));
+	SendQueueStats.QueuedBytes -= static_cast<size_t>(Completion.res);
+
+	if (Client->bIsStalled && SendQueue.GetQueuedBytes() <= SendQueueSettings.LowWatermarkBytes)
+	{
+		Client->bIsStalled = false;
+	}
+
+	// Partially sent, or more was queued while the send was in flight
+	if (!SendQueue.IsEmpty())
+	{
+		ClientsToSend.push_back(Client);
+	}
+}
+
+void FTCPClient::UpdateIoUring()
+{
+	// Reset the eventfd before looking at the completion queue, so completions posted from here on wake the loop again
+	uint64_t EventCount = 0;
+	while (read(RingEventHandle, &EventCount, sizeof(EventCount)) < 0 && errno == EINTR)
+	{
+	}
+
+	Ring.ProcessCompletions([this](const io_uring_cqe& Completion) { OnIoCompleted(Completion); });
+	Ring.CommitProvidedBuffers();
+
+	if (!StalledClients.empty())
+	{
+		DisconnectStalledClients();
+	}
+
+	// Everything sent since the last Update, and every receive and accept to restart, goes out with one system call
+	for (FClientConnection* Client : ClientsToSend)
+	{
+		if (!Client->bIsClosed && !Client->bIsSending && !Client->SendQueue.IsEmpty())
+		{
+			QueueSendOperation(Client);
+		}
+	}
+	ClientsToSend.clear();
+	Ring.Submit();
+
+	ReleaseClosedClients();
+}
+
+#endif // TCPCLIENT_USE_IO_URING
@@ -0,0 +1,87 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "TCPSendQueue.h"
+
+void FTCPSendQueue::Append(const FTCPSendBuffer* Buffers, size_t NumBuffers, size_t BytesToSkip)
+{
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		const char* Data = reinterpret_cast<const char*>(Buffers[BufferIndex].Data);
+		size_t Length = Buffers[BufferIndex].Length;
+
+		if (BytesToSkip >= Length)
+		{
+			BytesToSkip -= Length;
+			continue;
+		}
+		Data += BytesToSkip;
+		Length -= BytesToSkip;
+		BytesToSkip = 0;
+
+		while (Length > 0)
+		{
+			if (Blocks.empty() || Blocks.back().size() == BlockSizeBytes)
+			{
+				Blocks.emplace_back();
+				Blocks.back().swap(SpareBlock);
+				Blocks.back().reserve(BlockSizeBytes);
+			}
+
+			std::vector<char>& Block = Blocks.back();
+			const size_t BytesToCopy = std::min(Length, BlockSizeBytes - Block.size());
+			Block.insert(Block.end(), Data, Data + BytesToCopy);
+
+			Data += BytesToCopy;
+			Length -= BytesToCopy;
+			QueuedBytes += BytesToCopy;
+		}
+	}
+}
+
+size_t FTCPSendQueue::GetQueuedBuffers(FTCPSendBuffer* OutBuffers, size_t MaxBuffers) const
+{
+	size_t NumBuffers = 0;
+	for (auto BlockItr = Blocks.begin(); BlockItr != Blocks.end() && NumBuffers < MaxBuffers; ++BlockItr)
+	{
+		const size_t Offset = (BlockItr == Blocks.begin()) ? FrontOffset : 0;
+		OutBuffers[NumBuffers].Data = BlockItr->data() + Offset;
+		OutBuffers[NumBuffers].Length = BlockItr->size() - Offset;
+		++NumBuffers;
+	}
+	return NumBuffers;
+}
+
+void FTCPSendQueue::Consume(size_t Bytes)
+{
+	assert(Bytes <= QueuedBytes);
+	QueuedBytes -= Bytes;
+
+	while (Bytes > 0)
+	{
+		std::vector<char>& Block = Blocks.front();
+		const size_t BytesInBlock = Block.size() - FrontOffset;
+		if (Bytes < BytesInBlock)
+		{
+			FrontOffset += Bytes;
+			return;
+		}
+
+		Bytes -= BytesInBlock;
+		FrontOffset = 0;
+
+		Block.clear();
+		if (SpareBlock.capacity() == 0)
+		{
+			SpareBlock.swap(Block);
+		}
+		Blocks.pop_front();
+	}
+}
+
+void FTCPSendQueue::Clear()
+{
+	Blocks.clear();
+	FrontOffset = 0;
+	QueuedBytes = 0;
+}
@@ -0,0 +1,68 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+/** A piece of an outgoing message. A message can be sent as several pieces without first copying them into one buffer. */
+struct FTCPSendBuffer
+{
+	const void* Data = nullptr;
+	size_t Length = 0;
+};
+
+/**
+ * Outgoing bytes of a single connection that could not be written to the socket yet.
+ * Data is kept in fixed size blocks, so appending never moves bytes that are already queued.
+ */
+class FTCPSendQueue final
+{
+public:
+	FTCPSendQueue() = default;
+
+	/**
+	 * No copying or copy assignment allowed for this class.
+	 */
+	FTCPSendQueue(FTCPSendQueue const&) = delete;
+	FTCPSendQueue& operator=(FTCPSendQueue const&) = delete;
+
+	bool IsEmpty() const { return QueuedBytes == 0; }
+	size_t GetQueuedBytes() const { return QueuedBytes; }
+
+	/**
+	 * Appends the buffers as one message to the end of the queue
+	 *
+	 * @param Buffers - Pieces of the message
+	 * @param NumBuffers - Number of pieces
+	 * @param BytesToSkip - Number of leading bytes of the message that were already sent and must not be queued
+	 */
+	void Append(const FTCPSendBuffer* Buffers, size_t NumBuffers, size_t BytesToSkip = 0);
+
+	/**
+	 * Describes the queued data from the front of the queue, for use with vectored sends
+	 *
+	 * @return Number of buffers written to OutBuffers
+	 */
+	size_t GetQueuedBuffers(FTCPSendBuffer* OutBuffers, size_t MaxBuffers) const;
+
+	/** Removes the given number of sent bytes from the front of the queue */
+	void Consume(size_t Bytes);
+
+	/** Drops all queued data */
+	void Clear();
+
+private:
+	static constexpr size_t BlockSizeBytes = 16 * 1024;
+
+	/** Queued data, every block holds at most BlockSizeBytes */
+	std::deque<std::vector<char>> Blocks;
+
+	/** Offset of the first unsent byte in the front block */
+	size_t FrontOffset = 0;
+
+	size_t QueuedBytes = 0;
+
+	/** A drained block kept around so a connection that is repeatedly backed up does not reallocate */
+	std::vector<char> SpareBlock;
+};
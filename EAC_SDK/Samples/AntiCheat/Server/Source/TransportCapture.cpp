@@ -0,0 +1,109 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "TransportCapture.h"
+#include "DebugLog.h"
+#include "StringUtils.h"
+
+constexpr uint32_t FTransportCapture::FileMagic;
+constexpr uint32_t FTransportCapture::FileVersion;
+constexpr std::chrono::seconds FTransportCapture::FlushInterval;
+
+FTransportCapture::~FTransportCapture()
+{
+	Close();
+}
+
+bool FTransportCapture::Open(const std::string& InFilePath)
+{
+	Close();
+
+	File.open(InFilePath, std::ios::binary | std::ios::trunc);
+	if (!File.is_open())
+	{
+		FDebugLog::LogError(L"TransportCapture: Could not create %ls", FStringUtils::Widen(InFilePath).c_str());
+		return false;
+	}
+
+	FilePath = InFilePath;
+	StartTime = std::chrono::steady_clock::now();
+	LastFlushTime = StartTime;
+	NumRecords = 0;
+	NumBytes = 0;
+	Buffer.reserve(FlushThresholdBytes + 64 * 1024);
+
+	const FFileHeader Header;
+	File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+
+	FDebugLog::Log(L"TransportCapture: Recording to %ls", FStringUtils::Widen(FilePath).c_str());
+	return true;
+}
+
+void FTransportCapture::Close()
+{
+	if (!File.is_open())
+	{
+		return;
+	}
+
+	Flush();
+	File.close();
+
+	FDebugLog::Log(L"TransportCapture: Recorded %llu records, %llu bytes of messages to %ls",
+		static_cast<unsigned long long>(NumRecords), static_cast<unsigned long long>(NumBytes), FStringUtils::Widen(FilePath).c_str());
+}
+
+void FTransportCapture::Record(ERecordType Type, void* ClientHandle, const FTCPSendBuffer* Buffers, size_t NumBuffers)
+{
+	if (!File.is_open())
+	{
+		return;
+	}
+
+	const ServerTimePoint Now = std::chrono::steady_clock::now();
+
+	FRecordHeader Header;
+	Header.TimeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Now - StartTime).count());
+	Header.ClientHandle = reinterpret_cast<uintptr_t>(ClientHandle);
+	Header.Type = Type;
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		Header.Size += static_cast<uint32_t>(Buffers[BufferIndex].Length);
+	}
+
+	const char* HeaderBytes = reinterpret_cast<const char*>(&Header);
+	Buffer.insert(Buffer.end(), HeaderBytes, HeaderBytes + sizeof(Header));
+	for (size_t BufferIndex = 0; BufferIndex < NumBuffers; ++BufferIndex)
+	{
+		const char* Data = reinterpret_cast<const char*>(Buffers[BufferIndex].Data);
+		Buffer.insert(Buffer.end(), Data, Data + Buffers[BufferIndex].Length);
+	}
+
+	++NumRecords;
+	NumBytes += Header.Size;
+
+	if (Buffer.size() >= FlushThresholdBytes || Now - LastFlushTime >= FlushInterval)
+	{
+		Flush();
+		LastFlushTime = Now;
+	}
+}
+
+void FTransportCapture::Flush()
+{
+	if (Buffer.empty())
+	{
+		return;
+	}
+
+	File.write(Buffer.data(), static_cast<std::streamsize>(Buffer.size()));
+	File.flush();
+	Buffer.clear();
+
+	if (!File.good())
+	{
+		// A full disk should not take the server down, the capture just ends here
+		FDebugLog::LogError(L"TransportCapture: Writing to %ls failed, recording stopped", FStringUtils::Widen(FilePath).c_str());
+		File.close();
+	}
+}
@@ -0,0 +1,93 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "NonCopyable.h"
+#include "TCPSendQueue.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Records the anti-cheat transport traffic of a session into an append-only binary file, to replay it later against
+ * a server with repeatable load (see the load test's -replay option).
+ *
+ * The file starts with an FFileHeader, followed by records of an FRecordHeader and Size bytes of data each. The data
+ * of message records is the whole message as sent on the wire, header included. All values are little endian.
+ * Not thread safe, meant to be used from the thread owning the EOS SDK.
+ */
+class FTransportCapture final : public FNonCopyable
+{
+public:
+	static constexpr uint32_t FileMagic = 0x43544341; // "ACTC"
+	static constexpr uint32_t FileVersion = 1;
+
+	enum class ERecordType : uint8_t
+	{
+		/** A message received from a client, as passed to ProcessMessage */
+		Incoming = 1,
+
+		/** A message sent to a client */
+		Outgoing = 2,
+
+		/** The client disconnected, no data */
+		Disconnected = 3
+	};
+
+	struct FFileHeader
+	{
+		uint32_t Magic = FileMagic;
+		uint32_t Version = FileVersion;
+	};
+
+	struct FRecordHeader
+	{
+		/** Time since the capture was started */
+		uint64_t TimeNs = 0;
+
+		/** Handle the transport knows the client by, only meaningful to tell the clients of a capture apart */
+		uint64_t ClientHandle = 0;
+
+		uint32_t Size = 0;
+		ERecordType Type = ERecordType::Incoming;
+		uint8_t Reserved[3] = {};
+	};
+	static_assert(sizeof(FRecordHeader) == 24, "The record header is part of the file format");
+
+	FTransportCapture() = default;
+	~FTransportCapture();
+
+	/** Creates or truncates the file and starts recording */
+	bool Open(const std::string& FilePath);
+
+	/** Writes what is still buffered and closes the file */
+	void Close();
+
+	bool IsOpen() const { return File.is_open(); }
+
+	/** Records a message made of one or more pieces, or a disconnect if NumBuffers is 0 */
+	void Record(ERecordType Type, void* ClientHandle, const FTCPSendBuffer* Buffers, size_t NumBuffers);
+
+	uint64_t GetNumRecords() const { return NumRecords; }
+	uint64_t GetNumBytes() const { return NumBytes; }
+
+private:
+	void Flush();
+
+	/** Records are gathered here and written in large chunks, so recording does not cost a write call per message */
+	static constexpr size_t FlushThresholdBytes = 256 * 1024;
+
+	/** Longest time records stay buffered, bounds what is lost if the server does not shut down cleanly */
+	static constexpr std::chrono::seconds FlushInterval{ 1 };
+
+	std::ofstream File;
+	std::string FilePath;
+	std::vector<char> Buffer;
+
+	ServerTimePoint StartTime;
+	ServerTimePoint LastFlushTime;
+
+	uint64_t NumRecords = 0;
+	uint64_t NumBytes = 0;
+};
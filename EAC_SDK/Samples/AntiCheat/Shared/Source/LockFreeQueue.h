@@ -0,0 +1,260 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/**
+ * Unbounded multi-producer single-consumer queue.
+ * Push is wait-free and may be called from any number of threads, Pop must only be called from one thread.
+ * A value pushed by another thread may become visible to Pop shortly after Push returns, so producers should
+ * wake the consumer after pushing rather than rely on Pop seeing the value immediately.
+ */
+template<typename T>
+class TMpscQueue final
+{
+public:
+	TMpscQueue()
+	{
+		FNode* Stub = new FNode();
+		Head.store(Stub, std::memory_order_relaxed);
+		Tail = Stub;
+	}
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	TMpscQueue(TMpscQueue const&) = delete;
+	TMpscQueue& operator=(TMpscQueue const&) = delete;
+
+	~TMpscQueue()
+	{
+		T Value;
+		while (Pop(Value))
+		{
+		}
+		delete Tail;
+	}
+
+	void Push(T Value)
+	{
+		FNode* Node = new FNode();
+		Node->Value = std::move(Value);
+
+		// Claim the head first, then link the previous head to the new node
+		FNode* PreviousHead = Head.exchange(Node, std::memory_order_acq_rel);
+		PreviousHead->Next.store(Node, std::memory_order_release);
+	}
+
+	bool Pop(T& OutValue)
+	{
+		FNode* Next = Tail->Next.load(std::memory_order_acquire);
+		if (!Next)
+		{
+			return false;
+		}
+
+		// The popped node becomes the new stub
+		OutValue = std::move(Next->Value);
+		delete Tail;
+		Tail = Next;
+		return true;
+	}
+
+private:
+	struct FNode
+	{
+		std::atomic<FNode*> Next{ nullptr };
+		T Value;
+	};
+
+	/** Most recently pushed node, shared by all producers */
+	std::atomic<FNode*> Head;
+
+	/** Stub node in front of the oldest value, only used by the consumer */
+	FNode* Tail = nullptr;
+};
+
+/**
+ * Unbounded single-producer single-consumer queue.
+ * Push must only be called from one thread and Pop from one other thread. Nodes released by the consumer are
+ * recycled by the producer, so a queue that has reached its working size no longer allocates.
+ */
+template<typename T>
+class TSpscQueue final
+{
+public:
+	TSpscQueue()
+	{
+		FNode* Stub = new FNode();
+		Head = Stub;
+		Tail.store(Stub, std::memory_order_relaxed);
+		FirstFree = Stub;
+		TailCopy = Stub;
+	}
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	TSpscQueue(TSpscQueue const&) = delete;
+	TSpscQueue& operator=(TSpscQueue const&) = delete;
+
+	~TSpscQueue()
+	{
+		// All nodes, recycled or not, are still linked from the oldest free one
+		FNode* Node = FirstFree;
+		while (Node)
+		{
+			FNode* Next = Node->Next.load(std::memory_order_relaxed);
+			delete Node;
+			Node = Next;
+		}
+	}
+
+	void Push(T Value)
+	{
+		FNode* Node = AllocateNode();
+		Node->Value = std::move(Value);
+		Node->Next.store(nullptr, std::memory_order_relaxed);
+
+		Head->Next.store(Node, std::memory_order_release);
+		Head = Node;
+	}
+
+	bool Pop(T& OutValue)
+	{
+		FNode* CurrentTail = Tail.load(std::memory_order_relaxed);
+		FNode* Next = CurrentTail->Next.load(std::memory_order_acquire);
+		if (!Next)
+		{
+			return false;
+		}
+
+		// Releasing the new tail hands the old one back to the producer for reuse
+		OutValue = std::move(Next->Value);
+		Tail.store(Next, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct FNode
+	{
+		std::atomic<FNode*> Next{ nullptr };
+		T Value;
+	};
+
+	FNode* AllocateNode()
+	{
+		// Nodes between FirstFree and the consumer's tail have been popped and can be reused
+		if (FirstFree == TailCopy)
+		{
+			TailCopy = Tail.load(std::memory_order_acquire);
+		}
+		if (FirstFree != TailCopy)
+		{
+			FNode* Node = FirstFree;
+			FirstFree = FirstFree->Next.load(std::memory_order_relaxed);
+			return Node;
+		}
+		return new FNode();
+	}
+
+	/** Most recently pushed node, only used by the producer */
+	FNode* Head = nullptr;
+
+	/** Oldest node that has not been recycled yet and the producer's last view of Tail */
+	FNode* FirstFree = nullptr;
+	FNode* TailCopy = nullptr;
+
+	/** Stub node in front of the oldest value, written by the consumer */
+	std::atomic<FNode*> Tail;
+};
+
+/**
+ * Fixed capacity single-producer single-consumer ring buffer. All slots are allocated up front, values are written and
+ * read in place: the producer fills the slot returned by BeginPush and publishes it with EndPush, the consumer reads
+ * the slot returned by Peek and releases it with Pop.
+ */
+template<typename T>
+class TSpscRingBuffer final
+{
+public:
+	/** Capacity is rounded up to a power of two */
+	explicit TSpscRingBuffer(size_t InCapacity)
+	{
+		Capacity = 1;
+		while (Capacity < InCapacity)
+		{
+			Capacity <<= 1;
+		}
+		Items.reset(new T[Capacity]);
+	}
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	TSpscRingBuffer(TSpscRingBuffer const&) = delete;
+	TSpscRingBuffer& operator=(TSpscRingBuffer const&) = delete;
+
+	size_t GetCapacity() const { return Capacity; }
+
+	/** Returns the next free slot, or nullptr when the buffer is full. Producer only. */
+	T* BeginPush()
+	{
+		const size_t CurrentHead = Head.load(std::memory_order_relaxed);
+		if (CurrentHead - TailCopy == Capacity)
+		{
+			TailCopy = Tail.load(std::memory_order_acquire);
+			if (CurrentHead - TailCopy == Capacity)
+			{
+				return nullptr;
+			}
+		}
+		return &Items[CurrentHead & (Capacity - 1)];
+	}
+
+	/** Makes the slot returned by BeginPush visible to the consumer. Producer only. */
+	void EndPush()
+	{
+		Head.store(Head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	/** Returns the oldest value, or nullptr when the buffer is empty. Consumer only. */
+	T* Peek()
+	{
+		const size_t CurrentTail = Tail.load(std::memory_order_relaxed);
+		if (CurrentTail == HeadCopy)
+		{
+			HeadCopy = Head.load(std::memory_order_acquire);
+			if (CurrentTail == HeadCopy)
+			{
+				return nullptr;
+			}
+		}
+		return &Items[CurrentTail & (Capacity - 1)];
+	}
+
+	/** Hands the slot returned by Peek back to the producer. Consumer only. */
+	void Pop()
+	{
+		Tail.store(Tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	/** Keeps the producer and consumer indices on separate cache lines */
+	static constexpr size_t CacheLineSize = 64;
+
+	size_t Capacity = 0;
+	std::unique_ptr<T[]> Items;
+
+	/** Written by the producer, along with its last view of Tail */
+	std::atomic<size_t> Head{ 0 };
+	size_t TailCopy = 0;
+	char ProducerPadding[CacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+	/** Written by the consumer, along with its last view of Head */
+	std::atomic<size_t> Tail{ 0 };
+	size_t HeadCopy = 0;
+	char ConsumerPadding[CacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
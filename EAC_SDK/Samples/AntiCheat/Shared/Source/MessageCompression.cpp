@@ -0,0 +1,240 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "MessageCompression.h"
+
+#include <cstring>
+
+namespace
+{
+	/**
+	 * A block is a series of sequences: a token byte with the literal length in the high and the match length in the
+	 * low 4 bits, more literal length bytes, the literals, a 2 byte little endian match offset and more match length
+	 * bytes. Lengths of 15 and up continue in the following bytes, each adding up to 255. The last sequence only has
+	 * literals.
+	 */
+	constexpr size_t MinMatch = 4;
+	constexpr size_t MaxOffset = 65535;
+	constexpr uint32_t TokenLengthMask = 15;
+
+	/** The last bytes of a block are always literals, and no match starts in the last MatchSearchEnd bytes */
+	constexpr size_t LastLiterals = 5;
+	constexpr size_t MatchSearchEnd = 12;
+
+	/** 1024 positions, plenty for messages of a few kilobytes and quick to clear for every message */
+	constexpr uint32_t HashBits = 10;
+
+	uint32_t ReadUint32(const uint8_t* Data)
+	{
+		uint32_t Value;
+		memcpy(&Value, Data, sizeof(Value));
+		return Value;
+	}
+
+	uint32_t Hash(uint32_t Sequence)
+	{
+		return (Sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	/** Writes the bytes of a length that did not fit into the token */
+	bool WriteLength(size_t Length, uint8_t*& Output, const uint8_t* OutputEnd)
+	{
+		for (; Length >= 255; Length -= 255)
+		{
+			if (Output == OutputEnd)
+			{
+				return false;
+			}
+			*Output++ = 255;
+		}
+
+		if (Output == OutputEnd)
+		{
+			return false;
+		}
+		*Output++ = static_cast<uint8_t>(Length);
+		return true;
+	}
+
+	bool ReadLength(size_t& Length, const uint8_t*& Input, const uint8_t* InputEnd)
+	{
+		uint8_t Byte;
+		do
+		{
+			if (Input == InputEnd)
+			{
+				return false;
+			}
+			Byte = *Input++;
+			Length += Byte;
+		} while (Byte == 255);
+		return true;
+	}
+
+	/** Writes a sequence of literals followed by a match, or only the literals if MatchLength is 0 */
+	bool WriteSequence(const uint8_t* Literals, size_t LiteralLength, size_t Offset, size_t MatchLength, uint8_t*& Output, const uint8_t* OutputEnd)
+	{
+		if (Output == OutputEnd)
+		{
+			return false;
+		}
+
+		uint8_t& Token = *Output++;
+		Token = static_cast<uint8_t>(std::min<size_t>(LiteralLength, TokenLengthMask) << 4);
+		if (LiteralLength >= TokenLengthMask && !WriteLength(LiteralLength - TokenLengthMask, Output, OutputEnd))
+		{
+			return false;
+		}
+
+		if (static_cast<size_t>(OutputEnd - Output) < LiteralLength)
+		{
+			return false;
+		}
+		if (LiteralLength > 0)
+		{
+			memcpy(Output, Literals, LiteralLength);
+			Output += LiteralLength;
+		}
+
+		if (MatchLength == 0)
+		{
+			return true;
+		}
+
+		if (OutputEnd - Output < 2)
+		{
+			return false;
+		}
+		*Output++ = static_cast<uint8_t>(Offset);
+		*Output++ = static_cast<uint8_t>(Offset >> 8);
+
+		const size_t EncodedMatchLength = MatchLength - MinMatch;
+		Token |= static_cast<uint8_t>(std::min<size_t>(EncodedMatchLength, TokenLengthMask));
+		return EncodedMatchLength < TokenLengthMask || WriteLength(EncodedMatchLength - TokenLengthMask, Output, OutputEnd);
+	}
+}
+
+size_t FMessageCompression::GetMaxCompressedSize(size_t SourceSize)
+{
+	return SourceSize + SourceSize / 255 + 16;
+}
+
+size_t FMessageCompression::Compress(const void* Source, size_t SourceSize, void* Destination, size_t DestinationCapacity)
+{
+	const uint8_t* const Input = static_cast<const uint8_t*>(Source);
+	uint8_t* Output = static_cast<uint8_t*>(Destination);
+	const uint8_t* const OutputEnd = Output + DestinationCapacity;
+
+	size_t Anchor = 0;
+	if (SourceSize > MatchSearchEnd)
+	{
+		// Positions of the last 4 bytes seen with each hash. Stale or colliding entries are caught by comparing the bytes.
+		uint32_t HashTable[1 << HashBits];
+		memset(HashTable, 0, sizeof(HashTable));
+
+		const size_t MatchEnd = SourceSize - LastLiterals;
+		size_t Position = 0;
+		while (Position < SourceSize - MatchSearchEnd)
+		{
+			const uint32_t Sequence = ReadUint32(&Input[Position]);
+			uint32_t& Entry = HashTable[Hash(Sequence)];
+			const size_t Candidate = Entry;
+			Entry = static_cast<uint32_t>(Position);
+
+			if (Candidate >= Position || Position - Candidate > MaxOffset || ReadUint32(&Input[Candidate]) != Sequence)
+			{
+				++Position;
+				continue;
+			}
+
+			size_t MatchLength = MinMatch;
+			while (Position + MatchLength < MatchEnd && Input[Candidate + MatchLength] == Input[Position + MatchLength])
+			{
+				++MatchLength;
+			}
+
+			if (!WriteSequence(&Input[Anchor], Position - Anchor, Position - Candidate, MatchLength, Output, OutputEnd))
+			{
+				return 0;
+			}
+
+			Position += MatchLength;
+			Anchor = Position;
+		}
+	}
+
+	if (!WriteSequence(&Input[Anchor], SourceSize - Anchor, 0, 0, Output, OutputEnd))
+	{
+		return 0;
+	}
+	return Output - static_cast<uint8_t*>(Destination);
+}
+
+bool FMessageCompression::Decompress(const void* Source, size_t SourceSize, void* Destination, size_t DestinationSize)
+{
+	const uint8_t* Input = static_cast<const uint8_t*>(Source);
+	const uint8_t* const InputEnd = Input + SourceSize;
+	uint8_t* const OutputStart = static_cast<uint8_t*>(Destination);
+	uint8_t* Output = OutputStart;
+	const uint8_t* const OutputEnd = Output + DestinationSize;
+
+	while (Input != InputEnd)
+	{
+		const uint8_t Token = *Input++;
+
+		size_t LiteralLength = Token >> 4;
+		if (LiteralLength == TokenLengthMask && !ReadLength(LiteralLength, Input, InputEnd))
+		{
+			return false;
+		}
+		if (static_cast<size_t>(InputEnd - Input) < LiteralLength || static_cast<size_t>(OutputEnd - Output) < LiteralLength)
+		{
+			return false;
+		}
+		if (LiteralLength > 0)
+		{
+			memcpy(Output, Input, LiteralLength);
+			Input += LiteralLength;
+			Output += LiteralLength;
+		}
+
+		// The last sequence has no match
+		if (Input == InputEnd)
+		{
+			return Output == OutputEnd;
+		}
+
+		if (InputEnd - Input < 2)
+		{
+			return false;
+		}
+		const size_t Offset = Input[0] | (Input[1] << 8);
+		Input += 2;
+		if (Offset == 0 || Offset > static_cast<size_t>(Output - OutputStart))
+		{
+			return false;
+		}
+
+		size_t MatchLength = Token & TokenLengthMask;
+		if (MatchLength == TokenLengthMask && !ReadLength(MatchLength, Input, InputEnd))
+		{
+			return false;
+		}
+		MatchLength += MinMatch;
+		if (static_cast<size_t>(OutputEnd - Output) < MatchLength)
+		{
+			return false;
+		}
+
+		// Byte by byte, a match may overlap the bytes it produces
+		const uint8_t* Match = Output - Offset;
+		for (size_t Index = 0; Index < MatchLength; ++Index)
+		{
+			Output[Index] = Match[Index];
+		}
+		Output += MatchLength;
+	}
+
+	// Even an empty block has a token
+	return false;
+}
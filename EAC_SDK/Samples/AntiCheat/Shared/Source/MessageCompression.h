@@ -0,0 +1,35 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Fast block compression for anti-cheat messages, in the LZ4 block format: a greedy single pass compressor with a
+ * small hash table on the stack and a decompressor that checks every length and offset against both buffers, as its
+ * input comes straight off the network.
+ *
+ * Blocks do not store their uncompressed size, the caller sends it along and passes it to Decompress.
+ * The same file is used by the anti-cheat client and server.
+ */
+class FMessageCompression
+{
+public:
+	/** Smallest buffer Compress can always fit the compressed data of SourceSize bytes into */
+	static size_t GetMaxCompressedSize(size_t SourceSize);
+
+	/**
+	 * Compresses Source into Destination
+	 *
+	 * @return Compressed size, or 0 if the compressed data does not fit into DestinationCapacity
+	 */
+	static size_t Compress(const void* Source, size_t SourceSize, void* Destination, size_t DestinationCapacity);
+
+	/**
+	 * Decompresses Source into Destination
+	 *
+	 * @return True if Source is a valid block that decompresses to exactly DestinationSize bytes
+	 */
+	static bool Decompress(const void* Source, size_t SourceSize, void* Destination, size_t DestinationSize);
+};
@@ -0,0 +1,273 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "ProtectedMessageChannel.h"
+#include "DebugLog.h"
+
+FPooledBuffer::FPooledBuffer(FPooledBuffer&& Other) noexcept
+	: Pool(Other.Pool)
+	, Data(Other.Data)
+	, Capacity(Other.Capacity)
+	, Size(Other.Size)
+	, SizeClass(Other.SizeClass)
+{
+	Other.Pool = nullptr;
+	Other.Data = nullptr;
+	Other.Capacity = 0;
+	Other.Size = 0;
+}
+
+FPooledBuffer& FPooledBuffer::operator=(FPooledBuffer&& Other) noexcept
+{
+	if (this != &Other)
+	{
+		Reset();
+		std::swap(Pool, Other.Pool);
+		std::swap(Data, Other.Data);
+		std::swap(Capacity, Other.Capacity);
+		std::swap(Size, Other.Size);
+		std::swap(SizeClass, Other.SizeClass);
+	}
+	return *this;
+}
+
+FPooledBuffer::~FPooledBuffer()
+{
+	Reset();
+}
+
+void FPooledBuffer::Reset()
+{
+	if (Pool)
+	{
+		Pool->Release(*this);
+	}
+	Pool = nullptr;
+	Data = nullptr;
+	Capacity = 0;
+	Size = 0;
+}
+
+FMessageBufferPool::~FMessageBufferPool()
+{
+	for (std::vector<char*>& Buffers : FreeBuffers)
+	{
+		for (char* Buffer : Buffers)
+		{
+			delete[] Buffer;
+		}
+	}
+}
+
+FPooledBuffer FMessageBufferPool::Acquire(uint32_t Capacity)
+{
+	++Stats.Acquired;
+
+	FPooledBuffer Buffer;
+	Buffer.Pool = this;
+
+	uint32_t SizeClass = 0;
+	while (SizeClass < NumSizeClasses && GetSizeClassCapacity(SizeClass) < Capacity)
+	{
+		++SizeClass;
+	}
+
+	if (SizeClass == NumSizeClasses)
+	{
+		++Stats.Oversized;
+		Buffer.SizeClass = OversizedClass;
+		Buffer.Capacity = Capacity;
+		Buffer.Data = new char[Capacity];
+		return Buffer;
+	}
+
+	Buffer.SizeClass = SizeClass;
+	Buffer.Capacity = GetSizeClassCapacity(SizeClass);
+
+	std::vector<char*>& Buffers = FreeBuffers[SizeClass];
+	if (Buffers.empty())
+	{
+		++Stats.Allocated;
+		Buffer.Data = new char[Buffer.Capacity];
+	}
+	else
+	{
+		Buffer.Data = Buffers.back();
+		Buffers.pop_back();
+	}
+	return Buffer;
+}
+
+void FMessageBufferPool::Release(FPooledBuffer& Buffer)
+{
+	if (Buffer.SizeClass == OversizedClass)
+	{
+		delete[] Buffer.Data;
+	}
+	else
+	{
+		FreeBuffers[Buffer.SizeClass].push_back(Buffer.Data);
+	}
+}
+
+FProtectedMessageChannel::FProtectedMessageChannel(FGetOutputLengthFunction InGetOutputLength, FTransformFunction InProtect, FTransformFunction InUnprotect)
+	: GetOutputLength(std::move(InGetOutputLength))
+	, ProtectFunction(std::move(InProtect))
+	, UnprotectFunction(std::move(InUnprotect))
+{
+}
+
+uint32_t FProtectedMessageChannel::GetMaxMessageLength(uint32_t SizeClass)
+{
+	uint32_t& MaxMessageLength = MaxMessageLengths[SizeClass];
+	if (MaxMessageLength == 0)
+	{
+		// The output length only depends on the input length and does not change for an SDK version,
+		// so each size class asks once. Shrink the input by the overhead until its output fits.
+		const uint32_t Capacity = FMessageBufferPool::GetSizeClassCapacity(SizeClass);
+		uint32_t Length = Capacity;
+		uint32_t OutputLength = 0;
+		while (Length > 0 && GetOutputLength(Length, OutputLength))
+		{
+			if (OutputLength <= Capacity)
+			{
+				MaxMessageLength = Length;
+				break;
+			}
+			Length -= std::min(Length, OutputLength - Capacity);
+		}
+	}
+	return MaxMessageLength;
+}
+
+FPooledBuffer FProtectedMessageChannel::AcquireBuffer(uint32_t MaxMessageLength)
+{
+	for (uint32_t SizeClass = 0; SizeClass < FMessageBufferPool::NumSizeClasses; ++SizeClass)
+	{
+		if (GetMaxMessageLength(SizeClass) >= MaxMessageLength)
+		{
+			return Pool.Acquire(FMessageBufferPool::GetSizeClassCapacity(SizeClass));
+		}
+	}
+
+	// Larger than any size class, allocated for this message only
+	uint32_t OutputLength = MaxMessageLength;
+	GetOutputLength(MaxMessageLength, OutputLength);
+	return Pool.Acquire(std::max(MaxMessageLength, OutputLength));
+}
+
+bool FProtectedMessageChannel::Protect(void* ClientHandle, FPooledBuffer& Message)
+{
+	return Transform(true, ClientHandle, Message.GetData(), Message.GetSize(), Message);
+}
+
+bool FProtectedMessageChannel::Unprotect(void* ClientHandle, FPooledBuffer& Message)
+{
+	return Transform(false, ClientHandle, Message.GetData(), Message.GetSize(), Message);
+}
+
+bool FProtectedMessageChannel::Unprotect(void* ClientHandle, const void* Data, uint32_t DataLengthBytes, FPooledBuffer& OutMessage)
+{
+	// Unprotecting never makes a message longer
+	OutMessage = Pool.Acquire(DataLengthBytes);
+	return Transform(false, ClientHandle, Data, DataLengthBytes, OutMessage);
+}
+
+bool FProtectedMessageChannel::Transform(bool bProtect, void* ClientHandle, const void* Data, uint32_t DataLengthBytes, FPooledBuffer& OutMessage)
+{
+	const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+
+	uint32_t BytesWritten = 0;
+	const FTransformFunction& Function = bProtect ? ProtectFunction : UnprotectFunction;
+	if (!Function(ClientHandle, Data, DataLengthBytes, OutMessage.GetData(), OutMessage.GetCapacity(), BytesWritten))
+	{
+		++Stats.Failures;
+		return false;
+	}
+
+	const std::chrono::steady_clock::duration Time = std::chrono::steady_clock::now() - StartTime;
+	if (bProtect)
+	{
+		++Stats.ProtectedMessages;
+		Stats.ProtectedBytesIn += DataLengthBytes;
+		Stats.ProtectedBytesOut += BytesWritten;
+		Stats.ProtectTime += Time;
+	}
+	else
+	{
+		++Stats.UnprotectedMessages;
+		Stats.UnprotectedBytesIn += DataLengthBytes;
+		Stats.UnprotectedBytesOut += BytesWritten;
+		Stats.UnprotectTime += Time;
+	}
+
+	OutMessage.SetSize(BytesWritten);
+	return true;
+}
+
+void FProtectedMessageChannel::QueueMessage(void* ClientHandle, FPooledBuffer Message)
+{
+	FQueuedMessage QueuedMessage;
+	QueuedMessage.ClientHandle = ClientHandle;
+	QueuedMessage.Message = std::move(Message);
+	QueuedMessages.push_back(std::move(QueuedMessage));
+}
+
+size_t FProtectedMessageChannel::ProtectQueuedMessages(const FSendFunction& Send)
+{
+	size_t NumSent = 0;
+	for (FQueuedMessage& QueuedMessage : QueuedMessages)
+	{
+		if (Protect(QueuedMessage.ClientHandle, QueuedMessage.Message))
+		{
+			Send(QueuedMessage.ClientHandle, QueuedMessage.Message.GetData(), QueuedMessage.Message.GetSize());
+			++NumSent;
+		}
+	}
+
+	// Hands the buffers back to the pool but keeps the queue's own storage
+	QueuedMessages.clear();
+
+	if (NumSent > 0)
+	{
+		++Stats.Batches;
+	}
+	return NumSent;
+}
+
+void FProtectedMessageChannel::DiscardQueuedMessages()
+{
+	QueuedMessages.clear();
+}
+
+void FProtectedMessageChannel::LogStats(const wchar_t* Name) const
+{
+	if (Stats.ProtectedMessages == 0 && Stats.UnprotectedMessages == 0 && Stats.Failures == 0)
+	{
+		return;
+	}
+
+	auto MegabytesPerSecond = [](uint64_t Bytes, std::chrono::nanoseconds Time)
+	{
+		return Time.count() > 0 ? (Bytes / (1024.0 * 1024.0)) / std::chrono::duration<double>(Time).count() : 0.0;
+	};
+
+	const FMessageBufferPool::FStats& PoolStats = Pool.GetStats();
+	FDebugLog::Log(L"%ls: protected %llu messages (%llu -> %llu bytes, %.1f MB/s), unprotected %llu messages (%llu -> %llu bytes, %.1f MB/s), %llu failures",
+		Name,
+		static_cast<unsigned long long>(Stats.ProtectedMessages),
+		static_cast<unsigned long long>(Stats.ProtectedBytesIn),
+		static_cast<unsigned long long>(Stats.ProtectedBytesOut),
+		MegabytesPerSecond(Stats.ProtectedBytesIn, Stats.ProtectTime),
+		static_cast<unsigned long long>(Stats.UnprotectedMessages),
+		static_cast<unsigned long long>(Stats.UnprotectedBytesIn),
+		static_cast<unsigned long long>(Stats.UnprotectedBytesOut),
+		MegabytesPerSecond(Stats.UnprotectedBytesIn, Stats.UnprotectTime),
+		static_cast<unsigned long long>(Stats.Failures));
+	FDebugLog::Log(L"%ls: %llu buffers acquired, %llu allocated, %llu oversized, %llu batches",
+		Name,
+		static_cast<unsigned long long>(PoolStats.Acquired),
+		static_cast<unsigned long long>(PoolStats.Allocated),
+		static_cast<unsigned long long>(PoolStats.Oversized),
+		static_cast<unsigned long long>(Stats.Batches));
+}
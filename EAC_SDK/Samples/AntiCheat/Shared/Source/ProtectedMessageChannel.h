@@ -0,0 +1,202 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class FMessageBufferPool;
+
+/** A buffer borrowed from an FMessageBufferPool, handed back to the pool when destroyed */
+class FPooledBuffer
+{
+public:
+	FPooledBuffer() = default;
+	FPooledBuffer(FPooledBuffer&& Other) noexcept;
+	FPooledBuffer& operator=(FPooledBuffer&& Other) noexcept;
+	~FPooledBuffer();
+
+	FPooledBuffer(FPooledBuffer const&) = delete;
+	FPooledBuffer& operator=(FPooledBuffer const&) = delete;
+
+	bool IsValid() const { return Data != nullptr; }
+	char* GetData() const { return Data; }
+	uint32_t GetCapacity() const { return Capacity; }
+
+	/** Number of bytes in use, set by whoever fills the buffer */
+	uint32_t GetSize() const { return Size; }
+	void SetSize(uint32_t InSize) { Size = InSize; }
+
+	/** Hands the buffer back to its pool early */
+	void Reset();
+
+private:
+	friend class FMessageBufferPool;
+
+	FMessageBufferPool* Pool = nullptr;
+	char* Data = nullptr;
+	uint32_t Capacity = 0;
+	uint32_t Size = 0;
+	uint32_t SizeClass = 0;
+};
+
+/**
+ * Reusable message buffers in power of two size classes. Buffers handed back are kept for the next Acquire, so
+ * once the pool has warmed up acquiring a buffer does not allocate. Not thread safe.
+ */
+class FMessageBufferPool
+{
+public:
+	FMessageBufferPool() = default;
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	FMessageBufferPool(FMessageBufferPool const&) = delete;
+	FMessageBufferPool& operator=(FMessageBufferPool const&) = delete;
+
+	/** Size classes are SmallestBufferSize, twice that and so on, larger buffers are allocated and freed every time */
+	static constexpr uint32_t SmallestBufferSize = 256;
+	static constexpr uint32_t NumSizeClasses = 9;
+
+	struct FStats
+	{
+		uint64_t Acquired = 0;
+
+		/** Buffers that had to be allocated because the size class had none to reuse */
+		uint64_t Allocated = 0;
+
+		/** Buffers larger than the largest size class */
+		uint64_t Oversized = 0;
+	};
+
+	/** All buffers acquired from the pool must have been destroyed before the pool */
+	~FMessageBufferPool();
+
+	static uint32_t GetSizeClassCapacity(uint32_t SizeClass) { return SmallestBufferSize << SizeClass; }
+
+	/** Returns a buffer of at least Capacity bytes */
+	FPooledBuffer Acquire(uint32_t Capacity);
+
+	const FStats& GetStats() const { return Stats; }
+
+private:
+	friend class FPooledBuffer;
+
+	static constexpr uint32_t OversizedClass = NumSizeClasses;
+
+	void Release(FPooledBuffer& Buffer);
+
+	std::vector<char*> FreeBuffers[NumSizeClasses];
+	FStats Stats;
+};
+
+/**
+ * Encrypts and decrypts game traffic with the anti-cheat NetProtect functions (ProtectMessage / UnprotectMessage).
+ *
+ * Buffers come from a pool whose size classes are sized with GetProtectMessageOutputLength, so a message written into a
+ * buffer from AcquireBuffer is protected in place and no buffer is allocated per packet. Outgoing messages can also be
+ * queued during a frame and protected together once per tick with ProtectQueuedMessages.
+ * Shared by the client and server samples, which bind it to their anti-cheat interface's NetProtect functions.
+ * Must be used from the thread owning the EOS SDK.
+ */
+class FProtectedMessageChannel
+{
+public:
+	/** GetProtectMessageOutputLength, returns false on failure */
+	using FGetOutputLengthFunction = std::function<bool(uint32_t DataLengthBytes, uint32_t& OutBufferSizeBytes)>;
+
+	/** ProtectMessage or UnprotectMessage, Data and OutBuffer may be the same buffer. Returns false on failure. */
+	using FTransformFunction = std::function<bool(void* ClientHandle, const void* Data, uint32_t DataLengthBytes, void* OutBuffer, uint32_t OutBufferSizeBytes, uint32_t& OutBytesWritten)>;
+
+	/** Receives each message protected by ProtectQueuedMessages. The data is only valid during the call. */
+	using FSendFunction = std::function<void(void* ClientHandle, const void* Data, uint32_t DataLengthBytes)>;
+
+	struct FStats
+	{
+		uint64_t ProtectedMessages = 0;
+		uint64_t ProtectedBytesIn = 0;
+		uint64_t ProtectedBytesOut = 0;
+		std::chrono::nanoseconds ProtectTime{ 0 };
+
+		uint64_t UnprotectedMessages = 0;
+		uint64_t UnprotectedBytesIn = 0;
+		uint64_t UnprotectedBytesOut = 0;
+		std::chrono::nanoseconds UnprotectTime{ 0 };
+
+		/** Messages the SDK could not protect or unprotect */
+		uint64_t Failures = 0;
+
+		/** Calls to ProtectQueuedMessages that protected at least one message */
+		uint64_t Batches = 0;
+	};
+
+	FProtectedMessageChannel(FGetOutputLengthFunction InGetOutputLength, FTransformFunction InProtect, FTransformFunction InUnprotect);
+
+	/**
+	* No copying or copy assignment allowed for this class.
+	*/
+	FProtectedMessageChannel(FProtectedMessageChannel const&) = delete;
+	FProtectedMessageChannel& operator=(FProtectedMessageChannel const&) = delete;
+
+	/** Returns a buffer for a message of up to MaxMessageLength bytes that is large enough to protect it in place */
+	FPooledBuffer AcquireBuffer(uint32_t MaxMessageLength);
+
+	/** Protects the message in place. On success the size of the buffer is the size of the protected message. */
+	bool Protect(void* ClientHandle, FPooledBuffer& Message);
+
+	/** Unprotects the message in place. On success the size of the buffer is the size of the original message. */
+	bool Unprotect(void* ClientHandle, FPooledBuffer& Message);
+
+	/** Unprotects a message that is not in a pooled buffer, e.g. one still in a receive buffer */
+	bool Unprotect(void* ClientHandle, const void* Data, uint32_t DataLengthBytes, FPooledBuffer& OutMessage);
+
+	/** Queues a message for ProtectQueuedMessages */
+	void QueueMessage(void* ClientHandle, FPooledBuffer Message);
+
+	/**
+	 * Protects all queued messages and passes each one to Send, then hands their buffers back to the pool.
+	 * Messages that fail to protect are dropped.
+	 *
+	 * @return Number of messages passed to Send
+	 */
+	size_t ProtectQueuedMessages(const FSendFunction& Send);
+
+	/** Drops all queued messages without protecting them, e.g. when there is nothing to send them with */
+	void DiscardQueuedMessages();
+
+	const FStats& GetStats() const { return Stats; }
+	const FMessageBufferPool::FStats& GetPoolStats() const { return Pool.GetStats(); }
+
+	/** Logs message counts and throughput under the given name, nothing if the channel was not used */
+	void LogStats(const wchar_t* Name) const;
+
+private:
+	struct FQueuedMessage
+	{
+		void* ClientHandle = nullptr;
+		FPooledBuffer Message;
+	};
+
+	/** Longest message a buffer of the size class can protect in place, computed on first use */
+	uint32_t GetMaxMessageLength(uint32_t SizeClass);
+
+	/** Protects or unprotects Data into OutMessage, which may hold Data itself, and updates the counters */
+	bool Transform(bool bProtect, void* ClientHandle, const void* Data, uint32_t DataLengthBytes, FPooledBuffer& OutMessage);
+
+	FGetOutputLengthFunction GetOutputLength;
+	FTransformFunction ProtectFunction;
+	FTransformFunction UnprotectFunction;
+
+	FMessageBufferPool Pool;
+
+	/** Per size class, 0 until computed */
+	uint32_t MaxMessageLengths[FMessageBufferPool::NumSizeClasses] = {};
+
+	/** Queued messages, kept allocated between ticks */
+	std::vector<FQueuedMessage> QueuedMessages;
+
+	FStats Stats;
+};
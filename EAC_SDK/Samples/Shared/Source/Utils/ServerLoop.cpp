@@ -0,0 +1,237 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "pch.h"
+#include "ServerLoop.h"
+#include "DebugLog.h"
+
+#if SERVERLOOP_USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+void FDurationHistogram::Add(std::chrono::steady_clock::duration Duration)
+{
+	const uint64_t Microseconds = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(Duration).count()));
+
+	size_t Bucket = 0;
+	while ((Microseconds >> (Bucket + 1)) != 0 && Bucket + 1 < NumBuckets)
+	{
+		++Bucket;
+	}
+
+	++Buckets[Bucket];
+	++Count;
+	TotalMicroseconds += Microseconds;
+	MaxMicroseconds = std::max(MaxMicroseconds, Microseconds);
+}
+
+std::chrono::microseconds FDurationHistogram::GetPercentile(double Percentile) const
+{
+	if (Count == 0)
+	{
+		return std::chrono::microseconds(0);
+	}
+
+	const uint64_t Rank = std::max<uint64_t>(1, static_cast<uint64_t>(Count * Percentile / 100.0));
+	uint64_t CountSoFar = 0;
+	for (size_t Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		CountSoFar += Buckets[Bucket];
+		if (CountSoFar >= Rank)
+		{
+			return std::chrono::microseconds(std::min(MaxMicroseconds, (uint64_t(2) << Bucket) - 1));
+		}
+	}
+	return std::chrono::microseconds(MaxMicroseconds);
+}
+
+void FDurationHistogram::Log(const wchar_t* Name) const
+{
+	if (Count == 0)
+	{
+		FDebugLog::Log(L"%ls: no samples", Name);
+		return;
+	}
+
+	FDebugLog::Log(L"%ls: %llu samples, avg %llu us, p50 <= %lld us, p99 <= %lld us, max %llu us",
+		Name,
+		static_cast<unsigned long long>(Count),
+		static_cast<unsigned long long>(TotalMicroseconds / Count),
+		static_cast<long long>(GetPercentile(50.0).count()),
+		static_cast<long long>(GetPercentile(99.0).count()),
+		static_cast<unsigned long long>(MaxMicroseconds));
+}
+
+FServerLoop::FServerLoop(std::chrono::milliseconds InTickInterval)
+	: TickInterval(InTickInterval)
+{
+#if SERVERLOOP_USE_EPOLL
+	EpollHandle = epoll_create1(EPOLL_CLOEXEC);
+	WakeEventHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	TickTimerHandle = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (EpollHandle < 0 || WakeEventHandle < 0 || TickTimerHandle < 0)
+	{
+		FDebugLog::LogError(L"ServerLoop: Could not create wait handles (errno %d)", errno);
+	}
+
+	AddReadableHandle(WakeEventHandle);
+	AddReadableHandle(TickTimerHandle);
+	ArmTickDeadline();
+#else
+	NextTickTime = std::chrono::steady_clock::now() + TickInterval;
+#endif
+
+	IterationStartTime = std::chrono::steady_clock::now();
+}
+
+FServerLoop::~FServerLoop()
+{
+#if SERVERLOOP_USE_EPOLL
+	for (int Handle : { TickTimerHandle, WakeEventHandle, EpollHandle })
+	{
+		if (Handle >= 0)
+		{
+			close(Handle);
+		}
+	}
+#endif
+}
+
+bool FServerLoop::AddReadableHandle(int Handle)
+{
+#if SERVERLOOP_USE_EPOLL
+	// Level-triggered, so a handle that still has data left wakes the next Wait again
+	epoll_event Event = {};
+	Event.events = EPOLLIN;
+	Event.data.fd = Handle;
+	if (epoll_ctl(EpollHandle, EPOLL_CTL_ADD, Handle, &Event) != 0)
+	{
+		FDebugLog::LogError(L"ServerLoop: Could not watch handle %d (errno %d)", Handle, errno);
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void FServerLoop::Wake()
+{
+#if SERVERLOOP_USE_EPOLL
+	const uint64_t Increment = 1;
+	const ssize_t Result = write(WakeEventHandle, &Increment, sizeof(Increment));
+	(void)Result;
+#else
+	{
+		FScopedLock Lock(WakeMutex);
+		bWakeRequested = true;
+	}
+	WakeCondition.notify_one();
+#endif
+}
+
+void FServerLoop::Wait()
+{
+	IterationDurations.Add(std::chrono::steady_clock::now() - IterationStartTime);
+
+#if SERVERLOOP_USE_EPOLL
+	constexpr int MaxEvents = 8;
+	epoll_event Events[MaxEvents];
+
+	int NumEvents = 0;
+	do
+	{
+		// No timeout needed, the tick timer guarantees a wake up
+		NumEvents = epoll_wait(EpollHandle, Events, MaxEvents, -1);
+	} while (NumEvents < 0 && errno == EINTR);
+
+	for (int EventIndex = 0; EventIndex < NumEvents; ++EventIndex)
+	{
+		const int Handle = Events[EventIndex].data.fd;
+		if (Handle == WakeEventHandle || Handle == TickTimerHandle)
+		{
+			// Reading resets the event counter and the timer expiration count
+			uint64_t Value = 0;
+			const ssize_t Result = read(Handle, &Value, sizeof(Value));
+			(void)Result;
+
+			if (Handle == WakeEventHandle)
+			{
+				++EventWakeUps;
+			}
+			else
+			{
+				++DeadlineWakeUps;
+			}
+		}
+		else
+		{
+			// Watched handles are drained by their owners after Wait returns
+			++HandleWakeUps;
+		}
+	}
+#else
+	{
+		std::unique_lock<std::mutex> Lock(WakeMutex);
+		if (WakeCondition.wait_until(Lock, NextTickTime, [this]() { return bWakeRequested; }))
+		{
+			++EventWakeUps;
+		}
+		else
+		{
+			++DeadlineWakeUps;
+		}
+		bWakeRequested = false;
+	}
+#endif
+
+	IterationStartTime = std::chrono::steady_clock::now();
+}
+
+void FServerLoop::BeginTick()
+{
+	TickStartTime = std::chrono::steady_clock::now();
+}
+
+void FServerLoop::EndTick()
+{
+	const std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+	TickDurations.Add(Now - TickStartTime);
+
+#if SERVERLOOP_USE_EPOLL
+	ArmTickDeadline();
+#else
+	NextTickTime = Now + TickInterval;
+#endif
+}
+
+#if SERVERLOOP_USE_EPOLL
+void FServerLoop::ArmTickDeadline()
+{
+	// One-shot timer, re-armed after every tick, so it only fires when nothing else caused a tick in time
+	const auto IntervalNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(TickInterval).count();
+
+	itimerspec Deadline = {};
+	Deadline.it_value.tv_sec = static_cast<time_t>(IntervalNanoseconds / 1000000000);
+	Deadline.it_value.tv_nsec = static_cast<long>(IntervalNanoseconds % 1000000000);
+	if (Deadline.it_value.tv_sec == 0 && Deadline.it_value.tv_nsec == 0)
+	{
+		// A zero value would disarm the timer
+		Deadline.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(TickTimerHandle, 0, &Deadline, nullptr);
+}
+#endif
+
+void FServerLoop::LogStats() const
+{
+	FDebugLog::Log(L"Main loop woke up %llu times for watched handles, %llu times for Wake calls, %llu times for the tick deadline",
+		static_cast<unsigned long long>(HandleWakeUps),
+		static_cast<unsigned long long>(EventWakeUps),
+		static_cast<unsigned long long>(DeadlineWakeUps));
+	IterationDurations.Log(L"Main loop iteration");
+	TickDurations.Log(L"SDK tick");
+}
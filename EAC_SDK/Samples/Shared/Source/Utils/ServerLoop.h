@@ -0,0 +1,102 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+/** Linux waits on epoll with an eventfd and a timerfd, other platforms wait on a condition variable */
+#if defined(__linux__)
+#define SERVERLOOP_USE_EPOLL 1
+#else
+#define SERVERLOOP_USE_EPOLL 0
+#endif
+
+#if !SERVERLOOP_USE_EPOLL
+#include <condition_variable>
+#endif
+
+/** Histogram of durations in power of two microsecond buckets */
+class FDurationHistogram
+{
+public:
+	/** Bucket N counts durations of 2^N to 2^(N+1)-1 microseconds, the last bucket also counts all longer durations */
+	static constexpr size_t NumBuckets = 24;
+
+	void Add(std::chrono::steady_clock::duration Duration);
+
+	uint64_t GetCount() const { return Count; }
+
+	/** Upper bound of the bucket that holds the given percentile (0 - 100) */
+	std::chrono::microseconds GetPercentile(double Percentile) const;
+
+	/** Logs count, average, percentiles and maximum under the given name */
+	void Log(const wchar_t* Name) const;
+
+private:
+	uint64_t Buckets[NumBuckets] = {};
+	uint64_t Count = 0;
+	uint64_t TotalMicroseconds = 0;
+	uint64_t MaxMicroseconds = 0;
+};
+
+/**
+ * Blocks the server main loop until there is something to do: a watched handle became readable,
+ * another thread called Wake, or the SDK has not been ticked for a whole tick interval.
+ */
+class FServerLoop
+{
+public:
+	explicit FServerLoop(std::chrono::milliseconds InTickInterval);
+	~FServerLoop();
+
+	FServerLoop(const FServerLoop&) = delete;
+	FServerLoop& operator=(const FServerLoop&) = delete;
+
+	/**
+	 * Wakes Wait whenever the file descriptor is readable. An epoll descriptor can be added as a whole.
+	 * Only supported with SERVERLOOP_USE_EPOLL, elsewhere Wait returns at least once per tick interval.
+	 */
+	bool AddReadableHandle(int Handle);
+
+	/** Makes the current or next Wait return. Safe to call from any thread. */
+	void Wake();
+
+	/** Blocks until a watched handle is readable, Wake was called or the tick deadline has passed */
+	void Wait();
+
+	/** Call around the SDK tick. EndTick pushes the tick deadline one tick interval out. */
+	void BeginTick();
+	void EndTick();
+
+	/** Logs wake up counters and the loop iteration and tick duration histograms */
+	void LogStats() const;
+
+private:
+	std::chrono::milliseconds TickInterval;
+
+	std::chrono::steady_clock::time_point IterationStartTime;
+	std::chrono::steady_clock::time_point TickStartTime;
+
+	/** Time between Wait returning and the next call to Wait */
+	FDurationHistogram IterationDurations;
+	FDurationHistogram TickDurations;
+
+	uint64_t HandleWakeUps = 0;
+	uint64_t EventWakeUps = 0;
+	uint64_t DeadlineWakeUps = 0;
+
+#if SERVERLOOP_USE_EPOLL
+	void ArmTickDeadline();
+
+	int EpollHandle = -1;
+	int WakeEventHandle = -1;
+	int TickTimerHandle = -1;
+#else
+	std::mutex WakeMutex;
+	std::condition_variable WakeCondition;
+	bool bWakeRequested = false;
+	std::chrono::steady_clock::time_point NextTickTime;
+#endif
+};
@@ -3,104 +3,382 @@
 #include "pch.h"
 
 #include "ApiParams.h"
+#include "SampleConstants.h"
 
-#include "rapidjson/document.h"
-#include "rapidjson/stringbuffer.h"
-#include "rapidjson/writer.h"
+#include "rapidjson/reader.h"
 #include "rapidjson/error/en.h"
 
+#include <cstring>
+
+namespace
+{
+	/**
+	 * Reads string, bool and string array members of the top level object straight from the parser's SAX events, without
+	 * building a document. Members that no params asked for and everything nested deeper are skipped.
+	 */
+	class FParamsReader : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, FParamsReader>
+	{
+	public:
+		enum class EState
+		{
+			Missing,
+			Found,
+			WrongType,
+
+			/** A string array had more than MaxStrings elements, parsing stopped right there */
+			TooLong
+		};
+
+		/** Adds a member to read, returns its index for GetState */
+		size_t AddString(const char* Name, std::string& Out) { return AddField(Name, &Out, nullptr, nullptr, 0); }
+		size_t AddBool(const char* Name, bool& Out) { return AddField(Name, nullptr, &Out, nullptr, 0); }
+		size_t AddStringArray(const char* Name, std::vector<std::string>& Out, size_t MaxStrings) { return AddField(Name, nullptr, nullptr, &Out, MaxStrings); }
+
+		EState GetState(size_t Index) const { return Fields[Index].State; }
+
+		FParseResult Parse(const std::string& Body)
+		{
+			// the parser copies strings onto its own stack, give it a small pool on ours so short bodies parse without heap allocations
+			uint64_t PoolBuffer[128];
+			rapidjson::MemoryPoolAllocator<> Pool(PoolBuffer, sizeof(PoolBuffer));
+			rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>> Reader(&Pool, 256);
+
+			rapidjson::StringStream Stream(Body.c_str());
+			if (!Reader.Parse(Stream, *this) && !bStoppedEarly)
+			{
+				return RESULT_FAILED(rapidjson::GetParseError_En(Reader.GetParseErrorCode()));
+			}
+			return RESULT_OK();
+		}
+
+		// SAX events, all other values end up in Default. Returning false stops the parser.
+		bool Default() { return OnValue(nullptr, 0, nullptr); }
+		bool Bool(bool bValue) { return OnValue(nullptr, 0, &bValue); }
+		bool String(const char* Value, rapidjson::SizeType Length, bool) { return OnValue(Value, Length, nullptr); }
+
+		bool Key(const char* Name, rapidjson::SizeType Length, bool)
+		{
+			if (Depth == 1)
+			{
+				CurrentField = FindField(Name, Length);
+			}
+			return true;
+		}
+
+		bool StartObject()
+		{
+			const bool bContinue = OnValue(nullptr, 0, nullptr);
+			++Depth;
+			return bContinue;
+		}
+
+		bool EndObject(rapidjson::SizeType) { --Depth; return true; }
+		bool StartArray()
+		{
+			if (Depth == 1 && CurrentField != nullptr && CurrentField->Strings != nullptr)
+			{
+				// the elements follow one level deeper
+				ArrayField = CurrentField;
+				CurrentField = nullptr;
+				ArrayField->Strings->clear();
+				ArrayField->State = EState::Found;
+			}
+			else if (!OnValue(nullptr, 0, nullptr))
+			{
+				return false;
+			}
+
+			++Depth;
+			return true;
+		}
+
+		bool EndArray(rapidjson::SizeType)
+		{
+			if (--Depth == 1)
+			{
+				ArrayField = nullptr;
+			}
+			return true;
+		}
+
+	private:
+		struct FField
+		{
+			const char* Name;
+			std::string* String;
+			bool* Bool;
+			std::vector<std::string>* Strings;
+			size_t MaxStrings;
+			EState State;
+		};
+
+		size_t AddField(const char* Name, std::string* OutString, bool* OutBool, std::vector<std::string>* OutStrings, size_t MaxStrings)
+		{
+			assert(NumFields < MaxFields);
+			Fields[NumFields] = FField{ Name, OutString, OutBool, OutStrings, MaxStrings, EState::Missing };
+			return NumFields++;
+		}
+
+		FField* FindField(const char* Name, rapidjson::SizeType Length)
+		{
+			for (size_t Index = 0; Index < NumFields; ++Index)
+			{
+				if (strlen(Fields[Index].Name) == Length && memcmp(Fields[Index].Name, Name, Length) == 0)
+				{
+					return &Fields[Index];
+				}
+			}
+			return nullptr;
+		}
+
+		/**
+		 * Stores the value of the current top level member, a value that is neither a string nor a bool is passed as two nullptrs.
+		 * Returns false to stop parsing once a string array is too long, so oversized requests cost no more than a valid one.
+		 */
+		bool OnValue(const char* StringValue, rapidjson::SizeType Length, const bool* bValue)
+		{
+			if (Depth == 2 && ArrayField != nullptr)
+			{
+				if (ArrayField->Strings->size() == ArrayField->MaxStrings)
+				{
+					ArrayField->State = EState::TooLong;
+					bStoppedEarly = true;
+					return false;
+				}
+
+				if (StringValue != nullptr)
+				{
+					ArrayField->Strings->emplace_back(StringValue, Length);
+				}
+				else
+				{
+					ArrayField->State = EState::WrongType;
+				}
+				return true;
+			}
+
+			if (Depth != 1 || CurrentField == nullptr)
+			{
+				return true;
+			}
+
+			FField& Field = *CurrentField;
+			CurrentField = nullptr;
+
+			if (Field.String != nullptr && StringValue != nullptr)
+			{
+				Field.String->assign(StringValue, Length);
+				Field.State = EState::Found;
+			}
+			else if (Field.Bool != nullptr && bValue != nullptr)
+			{
+				*Field.Bool = *bValue;
+				Field.State = EState::Found;
+			}
+			else
+			{
+				Field.State = EState::WrongType;
+			}
+			return true;
+		}
+
+		static constexpr size_t MaxFields = 3;
+		FField Fields[MaxFields];
+		size_t NumFields = 0;
+
+		/** Member whose value comes next, if it was asked for */
+		FField* CurrentField = nullptr;
+
+		/** String array member whose elements are being read */
+		FField* ArrayField = nullptr;
+
+		/** 1 inside the top level object */
+		int Depth = 0;
+
+		/** Set when a handler stopped the parser on purpose, the fields read so far are valid */
+		bool bStoppedEarly = false;
+	};
+
+	/**
+	 * Bulk requests need a non-empty list of up to MaxBulkModerationUsers users. The reader stops at longer lists, so users
+	 * listed twice count twice towards the limit, but are only kept once.
+	 */
+	FParseResult CheckBulkPuids(FParamsReader::EState State, std::vector<std::string>& Puids)
+	{
+		if (State == FParamsReader::EState::TooLong || (State == FParamsReader::EState::Found && Puids.empty()))
+		{
+			return RESULT_FAILED("Invalid puids, expected 1 to " + std::to_string(SampleConstants::MaxBulkModerationUsers) + " users");
+		}
+
+		if (State != FParamsReader::EState::Found)
+		{
+			return RESULT_FAILED("Missing string array parameter: puids");
+		}
+
+		std::sort(Puids.begin(), Puids.end());
+		Puids.erase(std::unique(Puids.begin(), Puids.end()), Puids.end());
+
+		if (std::any_of(Puids.begin(), Puids.end(), [](const std::string& Puid) { return Puid.empty(); }))
+		{
+			return RESULT_FAILED("Invalid puids, expected non-empty strings");
+		}
+
+		return RESULT_OK();
+	}
+}
+
 FParseResult FCreateSessionParams::FromRequestBody(const std::string& Body, FCreateSessionParams& Out)
 {	
-	rapidjson::Document ReqDoc;	
-	ReqDoc.Parse(Body.c_str());
-	if (ReqDoc.HasParseError())
+	FParamsReader Reader;
+	const size_t PuidField = Reader.AddString("puid", Out.Puid);
+	const size_t PasswordField = Reader.AddString("password", Out.Password);
+
+	const FParseResult Result = Reader.Parse(Body);
+	if (!Result.IsOk())
 	{
-		const rapidjson::ParseErrorCode ParseErr = ReqDoc.GetParseError();
-		return RESULT_FAILED(rapidjson::GetParseError_En(ParseErr));
+		return Result;
 	}
 
-	if (!ReqDoc.HasMember("puid") || !ReqDoc["puid"].IsString())
+	if (Reader.GetState(PuidField) != FParamsReader::EState::Found)
 	{
 		return RESULT_FAILED("Missing string parameter: puid");
 	}
 
 	// optional password
-	if (ReqDoc.HasMember("password"))
+	if (Reader.GetState(PasswordField) == FParamsReader::EState::WrongType)
 	{
-		if (!ReqDoc["password"].IsString())
-		{
-			return RESULT_FAILED("Invalid password, expected string");
-		}
-		Out.Password = ReqDoc["password"].GetString();
+		return RESULT_FAILED("Invalid password, expected string");
 	}
-	
-	Out.Puid = ReqDoc["puid"].GetString();
+
 	return RESULT_OK();
 }
 
 FParseResult FKickUserParams::FromRequestBody(const std::string& Body, FKickUserParams& Out)
 {
-	rapidjson::Document ReqDoc;
-	ReqDoc.Parse(Body.c_str());
-	if (ReqDoc.HasParseError())
+	FParamsReader Reader;
+	const size_t LockField = Reader.AddString("lock", Out.Lock);
+
+	const FParseResult Result = Reader.Parse(Body);
+	if (!Result.IsOk())
 	{
-		const rapidjson::ParseErrorCode ParseErr = ReqDoc.GetParseError();
-		return RESULT_FAILED(rapidjson::GetParseError_En(ParseErr));
+		return Result;
 	}
 
-	if (!ReqDoc.HasMember("lock") || !ReqDoc["lock"].IsString())
+	if (Reader.GetState(LockField) != FParamsReader::EState::Found)
 	{
 		return RESULT_FAILED("Missing string parameter: lock");
 	}
-	
-	Out.Lock= ReqDoc["lock"].GetString();
+
 	return RESULT_OK();
 }
 
 
 FParseResult FMuteUserParams::FromRequestBody(const std::string& Body, FMuteUserParams& Out)
 {
-	rapidjson::Document ReqDoc;
-	ReqDoc.Parse(Body.c_str());
-	if (ReqDoc.HasParseError())
+	FParamsReader Reader;
+	const size_t LockField = Reader.AddString("lock", Out.Lock);
+	const size_t MuteField = Reader.AddBool("mute", Out.bMute);
+
+	const FParseResult Result = Reader.Parse(Body);
+	if (!Result.IsOk())
 	{
-		const rapidjson::ParseErrorCode ParseErr = ReqDoc.GetParseError();
-		return RESULT_FAILED(rapidjson::GetParseError_En(ParseErr));
+		return Result;
 	}
 
-	if (!ReqDoc.HasMember("lock") || !ReqDoc["lock"].IsString())
+	if (Reader.GetState(LockField) != FParamsReader::EState::Found)
 	{
 		return RESULT_FAILED("Missing string parameter: lock");
 	}
 
-	if (!ReqDoc.HasMember("mute") || !ReqDoc["mute"].IsBool())
+	if (Reader.GetState(MuteField) != FParamsReader::EState::Found)
 	{
 		return RESULT_FAILED("Missing bool parameter: mute");
 	}
-	
-	Out.Lock = ReqDoc["lock"].GetString();
-	Out.bMute = ReqDoc["mute"].GetBool();
 
 	return RESULT_OK();
 }
 
-FParseResult FHeartbeatParams::FromRequestBody(const std::string& Body, FHeartbeatParams& Out)
+FParseResult FKickUsersParams::FromRequestBody(const std::string& Body, FKickUsersParams& Out)
+{
+	FParamsReader Reader;
+	const size_t LockField = Reader.AddString("lock", Out.Lock);
+	const size_t PuidsField = Reader.AddStringArray("puids", Out.Puids, SampleConstants::MaxBulkModerationUsers);
+
+	const FParseResult Result = Reader.Parse(Body);
+	if (!Result.IsOk())
+	{
+		return Result;
+	}
+
+	if (Reader.GetState(LockField) != FParamsReader::EState::Found)
+	{
+		return RESULT_FAILED("Missing string parameter: lock");
+	}
+
+	return CheckBulkPuids(Reader.GetState(PuidsField), Out.Puids);
+}
+
+FParseResult FMuteUsersParams::FromRequestBody(const std::string& Body, FMuteUsersParams& Out)
 {
-	rapidjson::Document ReqDoc;
-	ReqDoc.Parse(Body.c_str());
+	FParamsReader Reader;
+	const size_t LockField = Reader.AddString("lock", Out.Lock);
+	const size_t MuteField = Reader.AddBool("mute", Out.bMute);
+	const size_t PuidsField = Reader.AddStringArray("puids", Out.Puids, SampleConstants::MaxBulkModerationUsers);
 
-	if (ReqDoc.HasParseError())
+	const FParseResult Result = Reader.Parse(Body);
+	if (!Result.IsOk())
 	{
-		const rapidjson::ParseErrorCode ParseErr = ReqDoc.GetParseError();
-		return RESULT_FAILED(rapidjson::GetParseError_En(ParseErr));
+		return Result;
 	}
 
-	if (!ReqDoc.HasMember("lock") || !ReqDoc["lock"].IsString())
+	if (Reader.GetState(LockField) != FParamsReader::EState::Found)
 	{
 		return RESULT_FAILED("Missing string parameter: lock");
 	}
 
-	Out.Lock = ReqDoc["lock"].GetString();
+	if (Reader.GetState(MuteField) != FParamsReader::EState::Found)
+	{
+		return RESULT_FAILED("Missing bool parameter: mute");
+	}
+
+	return CheckBulkPuids(Reader.GetState(PuidsField), Out.Puids);
+}
+
+FParseResult FInviteUsersParams::FromRequestBody(const std::string& Body, FInviteUsersParams& Out)
+{
+	FParamsReader Reader;
+	const size_t LockField = Reader.AddString("lock", Out.Lock);
+	const size_t PuidsField = Reader.AddStringArray("puids", Out.Puids, SampleConstants::MaxBulkModerationUsers);
+
+	const FParseResult Result = Reader.Parse(Body);
+	if (!Result.IsOk())
+	{
+		return Result;
+	}
+
+	if (Reader.GetState(LockField) != FParamsReader::EState::Found)
+	{
+		return RESULT_FAILED("Missing string parameter: lock");
+	}
+
+	return CheckBulkPuids(Reader.GetState(PuidsField), Out.Puids);
+}
+
+FParseResult FHeartbeatParams::FromRequestBody(const std::string& Body, FHeartbeatParams& Out)
+{
+	FParamsReader Reader;
+	const size_t LockField = Reader.AddString("lock", Out.Lock);
+
+	const FParseResult Result = Reader.Parse(Body);
+	if (!Result.IsOk())
+	{
+		return Result;
+	}
+
+	if (Reader.GetState(LockField) != FParamsReader::EState::Found)
+	{
+		return RESULT_FAILED("Missing string parameter: lock");
+	}
 
 	return RESULT_OK();
 }
\ No newline at end of file
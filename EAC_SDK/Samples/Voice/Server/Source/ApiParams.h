@@ -61,6 +61,53 @@ private:
 	bool bMute = false;
 };
 
+/** Params of the bulk kick endpoint, kicking every listed user */
+class FKickUsersParams final
+{
+public:
+	FKickUsersParams() {}
+	static FParseResult FromRequestBody(const std::string& Body, FKickUsersParams& Out);
+
+	const std::string& GetLock() const { return Lock; }
+	const std::vector<std::string>& GetPuids() const { return Puids; }
+
+private:
+	std::string Lock;
+	std::vector<std::string> Puids;
+};
+
+/** Params of the bulk mute endpoint, muting or unmuting every listed user */
+class FMuteUsersParams final
+{
+public:
+	FMuteUsersParams() {}
+	static FParseResult FromRequestBody(const std::string& Body, FMuteUsersParams& Out);
+
+	const std::string& GetLock() const { return Lock; }
+	bool ShouldMute() const { return bMute; }
+	const std::vector<std::string>& GetPuids() const { return Puids; }
+
+private:
+	std::string Lock;
+	bool bMute = false;
+	std::vector<std::string> Puids;
+};
+
+/** Params of the invite endpoint, issuing join tokens ahead of time for every listed user */
+class FInviteUsersParams final
+{
+public:
+	FInviteUsersParams() {}
+	static FParseResult FromRequestBody(const std::string& Body, FInviteUsersParams& Out);
+
+	const std::string& GetLock() const { return Lock; }
+	const std::vector<std::string>& GetPuids() const { return Puids; }
+
+private:
+	std::string Lock;
+	std::vector<std::string> Puids;
+};
+
 class FHeartbeatParams final
 {
 public:
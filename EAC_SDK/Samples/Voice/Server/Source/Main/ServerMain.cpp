@@ -17,10 +17,12 @@
 #include "CommandLine.h"
 #include "Settings.h"
 #include "SampleConstants.h"
+#include "ServerLoop.h"
 
 using namespace std;
 
 constexpr uint16 SampleConstants::ServerPort;
+constexpr uint32_t SampleConstants::SdkTickIntervalMs;
 
 bool bIsRunning = true;
 
@@ -110,8 +112,15 @@ int MasterMain(int Argc, const char* Args[])
 		return 1;
 	}
 
+	// sleep until a request is queued or the sdk is due for a tick
+	FServerLoop Loop(std::chrono::milliseconds(SampleConstants::SdkTickIntervalMs));
+	EosVoiceSdk->SetOnRequestQueuedCallback([&Loop]() { Loop.Wake(); });
+
 	// start voice host on its own thread
 	FVoiceHostPtr VoiceHost = FVoiceHostPtr(new FVoiceHost());
+	VoiceHost->SetOnSessionExpiredCallback([](const FVoiceSessionPtr& Session) {
+		FDebugLog::Log(L"Session %ls expired", FStringUtils::Widen(Session->GetId()).c_str());
+	});
 	FVoiceApi Api(VoiceHost, EosVoiceSdk);
 	if (Api.Listen(Port) == false)
 	{
@@ -126,8 +135,12 @@ int MasterMain(int Argc, const char* Args[])
 	// main loop
 	while (bIsRunning)
 	{
+		Loop.Wait();
+
 		// update the sdk on the mainthread
+		Loop.BeginTick();
 		EosVoiceSdk->Tick();
+		Loop.EndTick();
 
 		// remove any sessions that haven't received a heartbeat within the given timeout
 		size_t NumRemoved = VoiceHost->RemoveExpiredSessions();
@@ -135,11 +148,14 @@ int MasterMain(int Argc, const char* Args[])
 		{
 			FDebugLog::Log(L"Removed %d expired sessions", NumRemoved);
 		}
-		
-		// simulate other server activity
-		std::this_thread::sleep_for(std::chrono::milliseconds(30));
 	}
 
+	Loop.LogStats();
+	EosVoiceSdk->LogRequestStats();
+
+	// answer requests still waiting for the sdk, their http workers must finish before the api can stop
+	EosVoiceSdk->CancelRequests();
+
 	// stop accepting requests
 	Api.Stop();
 
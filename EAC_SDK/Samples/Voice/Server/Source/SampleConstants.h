@@ -27,4 +27,22 @@ struct SampleConstants
 
 	/** Server Port */
 	static constexpr uint16 ServerPort = 1234;
+
+	/** Longest time the main loop waits between two SDK ticks when no request wakes it up earlier */
+	static constexpr uint32_t SdkTickIntervalMs = 30;
+
+	/** Http worker threads. Every request waiting for the SDK holds one until it is answered, so this also caps the voice requests in flight. */
+	static constexpr uint32_t ApiThreadCount = 64;
+
+	/** Longest time an http request waits for its voice request to be made, after that it is answered with a timeout and the voice request is dropped */
+	static constexpr uint32_t ApiRequestTimeoutMs = 15000;
+
+	/** Longest time an http request waits for a voice request that was made to complete, after that it is answered without knowing the outcome */
+	static constexpr uint32_t ApiRequestInFlightTimeoutMs = 60000;
+
+	/** Most users a single bulk kick or mute request may name */
+	static constexpr uint32_t MaxBulkModerationUsers = 100;
+
+	/** How long join tokens issued ahead of time for invited users are handed out, invited users joining later get a fresh token */
+	static constexpr uint32_t InviteTokenLifetimeSeconds = 120;
 };
@@ -3,10 +3,8 @@
 #include "pch.h"
 
 #define RAPIDJSON_HAS_STDSTRING 1
-#include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
-#include "rapidjson/error/en.h"
 
 #include "ApiParams.h"
 #include "VoiceApi.h"
@@ -14,6 +12,7 @@
 #include "VoiceUser.h"
 #include "VoiceRequestKickUser.h"
 #include "VoiceRequestMuteUser.h"
+#include "SampleConstants.h"
 
 #include "DebugLog.h"
 #include "StringUtils.h"
@@ -21,26 +20,201 @@
 
 #include "eos_common.h"
 
+#include <condition_variable>
+
+constexpr uint32_t SampleConstants::ApiRequestTimeoutMs;
+constexpr uint32_t SampleConstants::ApiRequestInFlightTimeoutMs;
+constexpr uint32_t SampleConstants::InviteTokenLifetimeSeconds;
+
 namespace
 {
-	std::string JsonDocToString(const rapidjson::Document& Document)
+	/**
+	 * Writes json responses straight into a buffer, without building a document first.
+	 * Buffer and writer belong to the calling thread and are reused by all its responses, so once the buffer has grown
+	 * to the largest response, only the returned string allocates.
+	 */
+	class FJsonResponseWriter
 	{
+	public:
+		using FWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+		/** Returns this thread's writer, reset to an empty buffer. Finish the response before beginning another one. */
+		static FJsonResponseWriter& Begin()
+		{
+			thread_local FJsonResponseWriter ThreadWriter;
+			ThreadWriter.Buffer.Clear();
+			ThreadWriter.Writer.Reset(ThreadWriter.Buffer);
+			return ThreadWriter;
+		}
+
+		FWriter& operator*() { return Writer; }
+		FWriter* operator->() { return &Writer; }
+
+		std::string Finish() const
+		{
+			return std::string(Buffer.GetString(), Buffer.GetSize());
+		}
+
+	private:
 		rapidjson::StringBuffer Buffer;
-		Buffer.Clear();
+		FWriter Writer;
+	};
 
-		rapidjson::Writer<rapidjson::StringBuffer> Writer(Buffer);
-		Document.Accept(Writer);
+	std::string FormatBadRequest(const std::string& Message)
+	{
+		FJsonResponseWriter& Json = FJsonResponseWriter::Begin();
+		Json->StartObject();
+		Json->Key("error");
+		Json->String("bad request");
+		Json->Key("description");
+		Json->String(Message);
+		Json->EndObject();
+		return Json.Finish();
+	}
+
+	/** Formats the per user results of a bulk moderation request, by puid */
+	std::string FormatBulkResults(const std::vector<std::string>& Puids, const std::vector<EOS_EResult>& Results)
+	{
+		FJsonResponseWriter& Json = FJsonResponseWriter::Begin();
+		Json->StartObject();
+
+		Json->Key("results");
+		Json->StartObject();
+		for (size_t Index = 0; Index < Puids.size(); ++Index)
+		{
+			Json->Key(Puids[Index].c_str(), static_cast<rapidjson::SizeType>(Puids[Index].size()));
+			Json->String(EOS_EResult_ToString(Results[Index]));
+		}
+		Json->EndObject();
 
-		return std::string(Buffer.GetString());
+		Json->EndObject();
+		return Json.Finish();
 	}
 
-	std::string FormatBadRequest(const std::string& Message)
+	std::vector<EOS_ProductUserId> ToProductUserIds(const std::vector<std::string>& Puids)
+	{
+		std::vector<EOS_ProductUserId> ProductUserIds;
+		ProductUserIds.reserve(Puids.size());
+		for (const std::string& Puid : Puids)
+		{
+			ProductUserIds.push_back(EOS_ProductUserId_FromString(Puid.c_str()));
+		}
+		return ProductUserIds;
+	}
+
+	/**
+	 * Response to an http request that continues on the main thread once its voice request completes.
+	 * cpp-httplib sends the response from the worker thread that received the request as soon as the handler returns,
+	 * so the handler hands the rest of the request to the completion callback and only waits for its response here.
+	 * Queue the voice request with GetTicket, so a request answered with a timeout is never made.
+	 */
+	class FPendingResponse
+	{
+	public:
+		const FVoiceRequestTicketPtr& GetTicket() const { return Ticket; }
+
+		void Complete(int Status, std::string Body = std::string())
+		{
+			{
+				FScopedLock Lock(Mutex);
+				ResponseStatus = Status;
+				ResponseBody = std::move(Body);
+				bIsComplete = true;
+			}
+			CompletedCondition.notify_one();
+		}
+
+		/**
+		 * Copies the completed response into Res. Answers with a timeout instead if the voice request was not made in time,
+		 * it is then dropped without being made. A request that was made is waited for up to ApiRequestInFlightTimeoutMs
+		 * longer, after that the response says the outcome is unknown, so a stuck backend cannot hold every worker.
+		 */
+		void WaitAndSend(Response& Res, std::chrono::milliseconds Timeout)
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			const auto IsComplete = [this]() { return bIsComplete; };
+			if (!CompletedCondition.wait_for(Lock, Timeout, IsComplete))
+			{
+				if (Ticket->TryAbandon())
+				{
+					Res.status = 408;
+					Res.set_content(FVoiceApi::ErrorTimedOut, FVoiceApi::ContentTypeJson);
+					return;
+				}
+
+				// a 408 now would hide the request's effects, SDK requests normally time out on their own long before this
+				if (!CompletedCondition.wait_for(Lock, std::chrono::milliseconds(SampleConstants::ApiRequestInFlightTimeoutMs), IsComplete))
+				{
+					Res.status = 504;
+					Res.set_content(FVoiceApi::ErrorOutcomeUnknown, FVoiceApi::ContentTypeJson);
+					return;
+				}
+			}
+
+			Res.status = ResponseStatus;
+			if (!ResponseBody.empty())
+			{
+				Res.set_content(std::move(ResponseBody), FVoiceApi::ContentTypeJson);
+			}
+		}
+
+	private:
+		std::mutex Mutex;
+		std::condition_variable CompletedCondition;
+		bool bIsComplete = false;
+		int ResponseStatus = 500;
+		std::string ResponseBody;
+		FVoiceRequestTicketPtr Ticket = std::make_shared<FVoiceRequestTicket>();
+	};
+	using FPendingResponsePtr = std::shared_ptr<FPendingResponse>;
+
+	std::string FormatJoinTokens(const std::string& SessionId, const std::string* OwnerLock, const FJoinRoomResult& Result)
 	{
-		rapidjson::Document Doc;
-		Doc.SetObject();
-		Doc.AddMember("error", "bad request", Doc.GetAllocator());
-		Doc.AddMember("description", Message, Doc.GetAllocator());
-		return JsonDocToString(Doc);
+		FJsonResponseWriter& Json = FJsonResponseWriter::Begin();
+		Json->StartObject();
+
+		Json->Key("sessionId");
+		Json->String(SessionId);
+		if (OwnerLock)
+		{
+			Json->Key("ownerLock");
+			Json->String(*OwnerLock);
+		}
+		Json->Key("clientBaseUrl");
+		Json->String(Result.ClientBaseUrl);
+
+		Json->Key("joinTokens");
+		Json->StartObject();
+		for (const auto& TokenPair : Result.Tokens)
+		{
+			Json->Key(TokenPair.ProductUserId.c_str(), static_cast<rapidjson::SizeType>(TokenPair.ProductUserId.size()));
+			Json->String(TokenPair.Token);
+		}
+		Json->EndObject();
+
+		Json->EndObject();
+		return Json.Finish();
+	}
+
+	/** Answers a join with the token issued when the user was invited, false if the user has no valid invite token */
+	bool TryJoinWithInviteToken(FVoiceSession& Session, const std::string& SessionId, const std::string& Puid, const FVoiceUser& NewUser, Response& Res)
+	{
+		FJoinRoomResult Result;
+		std::string Token;
+		if (!Session.TakeInviteToken(Puid, std::chrono::steady_clock::now(), Token, Result.ClientBaseUrl))
+		{
+			return false;
+		}
+
+		Result.Result = EOS_EResult::EOS_Success;
+		Result.RoomName = SessionId;
+		Result.Tokens.push_back(FPuidToken(Puid, Token));
+
+		Session.AddUser(NewUser);
+
+		Res.status = 200;
+		Res.set_content(FormatJoinTokens(SessionId, nullptr, Result), FVoiceApi::ContentTypeJson);
+		return true;
 	}
 }
 
@@ -50,6 +224,7 @@ const std::string FVoiceApi::ErrorUserNotFound = "{\"error\" : \"user not found\
 const std::string FVoiceApi::ErrorForbidden = "{\"error\" : \"invalid lock\" }";
 const std::string FVoiceApi::ErrorUnauthorized = "{\"error\" : \"unauthorized\" }";
 const std::string FVoiceApi::ErrorTimedOut = "{\"error\" : \"timed out\" }";
+const std::string FVoiceApi::ErrorOutcomeUnknown = "{\"error\" : \"still in progress, outcome unknown\" }";
 
 const char* FVoiceApi::ContentTypeJson = "application/json";
 
@@ -60,6 +235,9 @@ FVoiceApi::FVoiceApi(const FVoiceHostPtr& InVoiceHost, const FVoiceSdkPtr& InVoi
 	assert(VoiceHost != nullptr);
 	assert(VoiceSdk != nullptr);
 
+	// every request waiting for the sdk holds a worker until it is answered, which caps the requests in flight, see FPendingResponse
+	Api.new_task_queue = []() { return new ThreadPool(SampleConstants::ApiThreadCount); };
+
 	// setup logging
 	Api.set_logger([](const Request& Req, const Response& Res) {
 		FDebugLog::Log(L"%d | %ls | %ls (%ls)",
@@ -77,60 +255,45 @@ FVoiceApi::FVoiceApi(const FVoiceHostPtr& InVoiceHost, const FVoiceSdkPtr& InVoi
 		{
 			// create a random roomId and request a roomToken
 			const std::string RoomId = FUtils::GenerateRandomId(16);
+			const FVoiceUser Owner(Params.GetPuid(), Req.remote_addr);
+			const std::string Password = Params.GetPassword();
 
 			// This http request callback is called on one of the http threadpool threads.
 			// All EOS SDK calls must originate from the same thread.
-			// To handle this we enqueue a request in the VoiceSdk and wait for its promised result on this thread
-			// The main loop will process all EOS SDK requests on the main thread.
-			FJoinRoomReceiptPtr Receipt = VoiceSdk->CreateJoinRoomTokens(RoomId.c_str(), { FVoiceUser(Params.GetPuid(), Req.remote_addr) });
-
-			// blocks until the request has been completed
-			Receipt->WaitForResult();
-			
-			const FJoinRoomResult TokenResult = Receipt->GetResult();
-			if (TokenResult.Result == EOS_EResult::EOS_Success)
-			{
-				// generate a lock key that is required for owner-level operations, such as kick or mute.
-				const std::string OwnerLock = FUtils::GenerateRandomId(8);
-
-				// add the session and create the json response
-				FVoiceSessionPtr Session = FVoiceSessionPtr(new FVoiceSession(RoomId, OwnerLock, Params.GetPassword(), { FVoiceUser(Params.GetPuid(), Req.remote_addr) }));
-				VoiceHost->AddSession(Session);
+			// To handle this we enqueue a request in the VoiceSdk, which the main loop processes on the main thread.
+			// The rest of this request continues in the completion callback, on the main thread as well.
+			FPendingResponsePtr PendingResponse = std::make_shared<FPendingResponse>();
+			VoiceSdk->CreateJoinRoomTokens(RoomId.c_str(), { Owner }, [this, PendingResponse, RoomId, Owner, Password](const FJoinRoomResult& TokenResult) {
+				if (TokenResult.Result == EOS_EResult::EOS_Success)
+				{
+					// generate a lock key that is required for owner-level operations, such as kick or mute.
+					const std::string OwnerLock = FUtils::GenerateRandomId(8);
 
-				rapidjson::Document Doc;
-				Doc.SetObject();
+					// add the session and create the json response
+					FVoiceSessionPtr Session = FVoiceSessionPtr(new FVoiceSession(RoomId, OwnerLock, Password, { Owner }));
+					VoiceHost->AddSession(Session);
 
-				Doc.AddMember("sessionId", RoomId, Doc.GetAllocator());
-				Doc.AddMember("ownerLock", OwnerLock, Doc.GetAllocator());
-				Doc.AddMember("clientBaseUrl", TokenResult.ClientBaseUrl, Doc.GetAllocator());
+					PendingResponse->Complete(200, FormatJoinTokens(RoomId, &OwnerLock, TokenResult));
 
-				rapidjson::Document TokenObj;
-				TokenObj.SetObject();
-				for (const auto& TokenPair : TokenResult.Tokens)
+					FDebugLog::Log(L"Created session %ls", FStringUtils::Widen(RoomId).c_str());
+				}
+				else if (TokenResult.Result == EOS_EResult::EOS_TimedOut)
 				{
-					TokenObj.AddMember(rapidjson::StringRef(TokenPair.ProductUserId), TokenPair.Token, TokenObj.GetAllocator());
+					PendingResponse->Complete(408, FVoiceApi::ErrorTimedOut);
 				}
-				Doc.AddMember("joinTokens", TokenObj, Doc.GetAllocator());
-
-				Res.status = 200;
-				Res.set_content(JsonDocToString(Doc).c_str(), FVoiceApi::ContentTypeJson);
+				else
+				{
+					PendingResponse->Complete(500);
+				}
+			}, PendingResponse->GetTicket());
 
-				FDebugLog::Log(L"Created session %ls", FStringUtils::Widen(RoomId).c_str());
-			}
-			else if (TokenResult.Result == EOS_EResult::EOS_TimedOut)
-			{
-				Res.status = 408;
-				Res.set_content(FVoiceApi::ErrorTimedOut, FVoiceApi::ContentTypeJson);
-			}
-			else
-			{
-				Res.status = 500;
-			}
+			// blocks until the completion callback has built the response
+			PendingResponse->WaitAndSend(Res, std::chrono::milliseconds(SampleConstants::ApiRequestTimeoutMs));
 		}
 		else
 		{
 			Res.status = 400;
-			Res.set_content(FormatBadRequest(ParseResult.GetError()).c_str(), FVoiceApi::ContentTypeJson);
+			Res.set_content(FormatBadRequest(ParseResult.GetError()), FVoiceApi::ContentTypeJson);
 		}
 	});
 
@@ -151,41 +314,102 @@ FVoiceApi::FVoiceApi(const FVoiceHostPtr& InVoiceHost, const FVoiceSdkPtr& InVoi
 				Res.status = 403;
 				Res.set_content(FVoiceApi::ErrorUnauthorized, FVoiceApi::ContentTypeJson);
 			}
+			else if (TryJoinWithInviteToken(*Session, SessionId, Puid, NewUser, Res))
+			{
+				// answered right away with the token issued when the user was invited
+			}
 			else
 			{
-				// request token to join the session
-				FJoinRoomReceiptPtr Receipt = VoiceSdk->CreateJoinRoomTokens(SessionId.c_str(), { NewUser });
-
-				// blocks until the request has been completed
-				Receipt->WaitForResult();
-				
-				const FJoinRoomResult Result = Receipt->GetResult();
-				if (Result.Result == EOS_EResult::EOS_TimedOut)
+				// request token to join the session, the rest of the request continues on the main thread
+				FPendingResponsePtr PendingResponse = std::make_shared<FPendingResponse>();
+				VoiceSdk->CreateJoinRoomTokens(SessionId.c_str(), { NewUser }, [PendingResponse, Session, SessionId, NewUser](const FJoinRoomResult& Result) {
+					if (Result.Result == EOS_EResult::EOS_TimedOut)
+					{
+						PendingResponse->Complete(408, FVoiceApi::ErrorTimedOut);
+					}
+					else
+					{
+						Session->AddUser(NewUser);
+						PendingResponse->Complete(200, FormatJoinTokens(SessionId, nullptr, Result));
+					}
+				}, PendingResponse->GetTicket());
+
+				// blocks until the completion callback has built the response
+				PendingResponse->WaitAndSend(Res, std::chrono::milliseconds(SampleConstants::ApiRequestTimeoutMs));
+			}
+		}
+		else
+		{
+			Res.status = 404;
+			Res.set_content(FVoiceApi::ErrorSessionNotFound, FVoiceApi::ContentTypeJson);
+		}
+	});
+
+	// inviteUsers, issues join tokens for the listed users ahead of time so they can join without waiting for the sdk
+	Api.Post(R"(/session/([a-zA-Z0-9\-]+)/invite)", [&](const Request& Req, Response& Res) {
+		const std::string RoomId = Req.matches[1];
+
+		FVoiceSessionPtr Session = VoiceHost->FindSession(RoomId);
+		if (Session.get() != nullptr)
+		{
+			FInviteUsersParams Params;
+			FParseResult Result = FInviteUsersParams::FromRequestBody(Req.body, Params);
+			if (Result.IsOk())
+			{
+				// check lock
+				if (Session->GetLock() != Params.GetLock())
 				{
-					Res.status = 408;
-					Res.set_content(FVoiceApi::ErrorTimedOut, FVoiceApi::ContentTypeJson);
+					Res.status = 403;
+					Res.set_content(FVoiceApi::ErrorForbidden, FVoiceApi::ContentTypeJson);
 				}
 				else
 				{
-					Session->AddUser(FVoiceUser{ Puid, Req.remote_addr });
-
-					rapidjson::Document Doc;
-					Doc.SetObject();
-					Doc.AddMember("sessionId", SessionId, Doc.GetAllocator());
-					Doc.AddMember("clientBaseUrl", Result.ClientBaseUrl, Doc.GetAllocator());
-
-					rapidjson::Document TokenObj;
-					TokenObj.SetObject();
-					for (const auto& TokenPair : Result.Tokens)
+					// one token request for all invited users, their address is unknown until they join
+					std::vector<FVoiceUser> InvitedUsers;
+					for (const std::string& Puid : Params.GetPuids())
 					{
-						TokenObj.AddMember(rapidjson::StringRef(TokenPair.ProductUserId), TokenPair.Token, TokenObj.GetAllocator());
+						InvitedUsers.emplace_back(Puid, std::string());
 					}
-					Doc.AddMember("joinTokens", TokenObj, Doc.GetAllocator());
 
-					Res.status = 200;
-					Res.set_content(JsonDocToString(Doc).c_str(), FVoiceApi::ContentTypeJson);
+					FPendingResponsePtr PendingResponse = std::make_shared<FPendingResponse>();
+					const std::vector<std::string>& Puids = Params.GetPuids();
+					VoiceSdk->CreateJoinRoomTokens(RoomId.c_str(), InvitedUsers, [PendingResponse, Session, Puids](const FJoinRoomResult& TokenResult) {
+						if (TokenResult.Result == EOS_EResult::EOS_Success)
+						{
+							const ServerTimePoint TokenExpiration = std::chrono::steady_clock::now() + std::chrono::seconds(SampleConstants::InviteTokenLifetimeSeconds);
+							for (const FPuidToken& Token : TokenResult.Tokens)
+							{
+								Session->AddInviteToken(Token.ProductUserId, Token.Token, TokenResult.ClientBaseUrl, TokenExpiration);
+							}
+
+							// report the users the sdk issued no token for
+							std::vector<EOS_EResult> InviteResults;
+							for (const std::string& Puid : Puids)
+							{
+								const bool bHasToken = std::any_of(TokenResult.Tokens.begin(), TokenResult.Tokens.end(), [&Puid](const FPuidToken& Token) { return Token.ProductUserId == Puid; });
+								InviteResults.push_back(bHasToken ? EOS_EResult::EOS_Success : EOS_EResult::EOS_NotFound);
+							}
+							PendingResponse->Complete(200, FormatBulkResults(Puids, InviteResults));
+						}
+						else if (TokenResult.Result == EOS_EResult::EOS_TimedOut)
+						{
+							PendingResponse->Complete(408, FVoiceApi::ErrorTimedOut);
+						}
+						else
+						{
+							PendingResponse->Complete(500);
+						}
+					}, PendingResponse->GetTicket());
+
+					// blocks until the completion callback has built the response
+					PendingResponse->WaitAndSend(Res, std::chrono::milliseconds(SampleConstants::ApiRequestTimeoutMs));
 				}
 			}
+			else
+			{
+				Res.status = 400;
+				Res.set_content(FormatBadRequest(Result.GetError()), FVoiceApi::ContentTypeJson);
+			}
 		}
 		else
 		{
@@ -214,37 +438,36 @@ FVoiceApi::FVoiceApi(const FVoiceHostPtr& InVoiceHost, const FVoiceSdkPtr& InVoi
 				}
 				else
 				{
-					FVoiceUser User{ UserId, std::string() };
-
-					// kick user
-					FVoiceRequestReceiptPtr Receipt = VoiceSdk->KickUser(RoomId.c_str(), EOS_ProductUserId_FromString(UserId.c_str()));
-
-					// blocks until the request has been completed
-					Receipt->WaitForResult();
-					EOS_EResult KickResult = Receipt->GetResult();
-
-					if (KickResult == EOS_EResult::EOS_Success)
-					{
-						// remove user and ban from rejoining
-						Session->RemoveUser(User);
-						Session->BanUser(User);
-						Res.status = 204;
-					}
-					else if (KickResult == EOS_EResult::EOS_TimedOut)
-					{
-						Res.status = 408;
-						Res.set_content(FVoiceApi::ErrorTimedOut, FVoiceApi::ContentTypeJson);
-					}					
-					else
-					{
-						Res.status = 500;
-					}
+					const FVoiceUser User{ UserId, std::string() };
+
+					// kick user, the rest of the request continues on the main thread
+					FPendingResponsePtr PendingResponse = std::make_shared<FPendingResponse>();
+					VoiceSdk->KickUser(RoomId.c_str(), EOS_ProductUserId_FromString(UserId.c_str()), [PendingResponse, Session, User](EOS_EResult KickResult) {
+						if (KickResult == EOS_EResult::EOS_Success)
+						{
+							// remove user and ban from rejoining
+							Session->RemoveUser(User);
+							Session->BanUser(User);
+							PendingResponse->Complete(204);
+						}
+						else if (KickResult == EOS_EResult::EOS_TimedOut)
+						{
+							PendingResponse->Complete(408, FVoiceApi::ErrorTimedOut);
+						}
+						else
+						{
+							PendingResponse->Complete(500);
+						}
+					}, PendingResponse->GetTicket());
+
+					// blocks until the completion callback has built the response
+					PendingResponse->WaitAndSend(Res, std::chrono::milliseconds(SampleConstants::ApiRequestTimeoutMs));
 				}
 			}
 			else
 			{
 				Res.status = 400;
-				Res.set_content(FormatBadRequest(Result.GetError()).c_str(), FVoiceApi::ContentTypeJson);
+				Res.set_content(FormatBadRequest(Result.GetError()), FVoiceApi::ContentTypeJson);
 			}
 		}
 		else
@@ -274,33 +497,127 @@ FVoiceApi::FVoiceApi(const FVoiceHostPtr& InVoiceHost, const FVoiceSdkPtr& InVoi
 				}
 				else
 				{
-					// hard mute/unmute user
-					FVoiceRequestReceiptPtr Receipt = VoiceSdk->MuteUser(RoomId.c_str(), EOS_ProductUserId_FromString(UserId.c_str()) , Params.ShouldMute());
+					// hard mute/unmute user, the response is completed on the main thread
+					FPendingResponsePtr PendingResponse = std::make_shared<FPendingResponse>();
+					VoiceSdk->MuteUser(RoomId.c_str(), EOS_ProductUserId_FromString(UserId.c_str()), Params.ShouldMute(), [PendingResponse](EOS_EResult MuteResult) {
+						if (MuteResult == EOS_EResult::EOS_Success)
+						{
+							PendingResponse->Complete(204);
+						}
+						else if (MuteResult == EOS_EResult::EOS_TimedOut)
+						{
+							PendingResponse->Complete(408, "Request Timeout");
+						}
+						else
+						{
+							PendingResponse->Complete(500);
+						}
+					}, PendingResponse->GetTicket());
+
+					// blocks until the completion callback has built the response
+					PendingResponse->WaitAndSend(Res, std::chrono::milliseconds(SampleConstants::ApiRequestTimeoutMs));
+				}
+			}
+			else
+			{
+				Res.status = 400;
+				Res.set_content(FormatBadRequest(Result.GetError()), FVoiceApi::ContentTypeJson);
+			}
+		}
+		else
+		{
+			Res.status = 404;
+			Res.set_content(FVoiceApi::ErrorSessionNotFound, FVoiceApi::ContentTypeJson);
+		}
+	});
 
-					// blocks until the request has been completed
-					Receipt->WaitForResult();
-					EOS_EResult MuteResult = Receipt->GetResult();
+	// kickUsers, kicks all listed users with a single lock check and one batch of sdk requests
+	Api.Post(R"(/session/([a-zA-Z0-9\-]+)/kick)", [&](const Request& Req, Response& Res) {
+		const std::string RoomId = Req.matches[1];
 
-					if (MuteResult == EOS_EResult::EOS_Success)
-					{
-						Res.status = 204;
-					}
-					else if (MuteResult == EOS_EResult::EOS_TimedOut)
-					{
-						Res.status = 408;
-						Res.set_content("Request Timeout", FVoiceApi::ContentTypeJson);
-					}
-					else
-					{
-						Res.status = 500;
-					}
-					
+		FVoiceSessionPtr Session = VoiceHost->FindSession(RoomId);
+		if (Session.get() != nullptr)
+		{
+			FKickUsersParams Params;
+			FParseResult Result = FKickUsersParams::FromRequestBody(Req.body, Params);
+			if (Result.IsOk())
+			{
+				// check lock
+				if (Session->GetLock() != Params.GetLock())
+				{
+					Res.status = 403;
+					Res.set_content(FVoiceApi::ErrorForbidden, FVoiceApi::ContentTypeJson);
+				}
+				else
+				{
+					// kick users, the rest of the request continues on the main thread once every kick completed
+					FPendingResponsePtr PendingResponse = std::make_shared<FPendingResponse>();
+					const std::vector<std::string>& Puids = Params.GetPuids();
+					VoiceSdk->KickUsers(RoomId.c_str(), ToProductUserIds(Puids), [PendingResponse, Session, Puids](const std::vector<EOS_EResult>& KickResults) {
+						for (size_t Index = 0; Index < Puids.size(); ++Index)
+						{
+							if (KickResults[Index] == EOS_EResult::EOS_Success)
+							{
+								// remove user and ban from rejoining
+								const FVoiceUser User{ Puids[Index], std::string() };
+								Session->RemoveUser(User);
+								Session->BanUser(User);
+							}
+						}
+						PendingResponse->Complete(200, FormatBulkResults(Puids, KickResults));
+					}, PendingResponse->GetTicket());
+
+					// blocks until the completion callback has built the response
+					PendingResponse->WaitAndSend(Res, std::chrono::milliseconds(SampleConstants::ApiRequestTimeoutMs));
+				}
+			}
+			else
+			{
+				Res.status = 400;
+				Res.set_content(FormatBadRequest(Result.GetError()), FVoiceApi::ContentTypeJson);
+			}
+		}
+		else
+		{
+			Res.status = 404;
+			Res.set_content(FVoiceApi::ErrorSessionNotFound, FVoiceApi::ContentTypeJson);
+		}
+	});
+
+	// muteUsers, mutes or unmutes all listed users with a single lock check and one batch of sdk requests
+	Api.Post(R"(/session/([a-zA-Z0-9\-]+)/mute)", [&](const Request& Req, Response& Res) {
+		const std::string RoomId = Req.matches[1];
+
+		FVoiceSessionPtr Session = VoiceHost->FindSession(RoomId);
+		if (Session.get() != nullptr)
+		{
+			FMuteUsersParams Params;
+			FParseResult Result = FMuteUsersParams::FromRequestBody(Req.body, Params);
+			if (Result.IsOk())
+			{
+				// check lock
+				if (Session->GetLock() != Params.GetLock())
+				{
+					Res.status = 403;
+					Res.set_content(FVoiceApi::ErrorForbidden, FVoiceApi::ContentTypeJson);
+				}
+				else
+				{
+					// hard mute/unmute users, the response is completed on the main thread once every request completed
+					FPendingResponsePtr PendingResponse = std::make_shared<FPendingResponse>();
+					const std::vector<std::string>& Puids = Params.GetPuids();
+					VoiceSdk->MuteUsers(RoomId.c_str(), ToProductUserIds(Puids), Params.ShouldMute(), [PendingResponse, Puids](const std::vector<EOS_EResult>& MuteResults) {
+						PendingResponse->Complete(200, FormatBulkResults(Puids, MuteResults));
+					}, PendingResponse->GetTicket());
+
+					// blocks until the completion callback has built the response
+					PendingResponse->WaitAndSend(Res, std::chrono::milliseconds(SampleConstants::ApiRequestTimeoutMs));
 				}
 			}
 			else
 			{
 				Res.status = 400;
-				Res.set_content(FormatBadRequest(Result.GetError()).c_str(), FVoiceApi::ContentTypeJson);
+				Res.set_content(FormatBadRequest(Result.GetError()), FVoiceApi::ContentTypeJson);
 			}
 		}
 		else
@@ -26,6 +26,7 @@ public:
 	static const std::string ErrorUserNotFound;
 	static const std::string ErrorForbidden;
 	static const std::string ErrorTimedOut;
+	static const std::string ErrorOutcomeUnknown;
 	static const char* ContentTypeJson;
 
 private:
@@ -4,28 +4,41 @@
 
 #include "VoiceHost.h"
 
+using FReadLock = std::shared_lock<std::shared_timed_mutex>;
+using FWriteLock = std::unique_lock<std::shared_timed_mutex>;
+
 bool FVoiceHost::AddSession(const FVoiceSessionPtr& Session)
 {
-	FScopedLock Lock(SessionMutex);
+	{
+		FShard& Shard = GetShard(Session->GetId());
+		FWriteLock Lock(Shard.Mutex);
+		if (!Shard.Sessions.emplace(Session->GetId(), Session).second)
+		{
+			return false;
+		}
+	}
 
-	Sessions.push_back(Session);
+	FScopedLock Lock(ExpiryMutex);
+	ExpiryQueue.push(FExpiryEntry{ Session->GetExpiration(), Session });
 	return true;
 }
 
 bool FVoiceHost::RemoveSession(const std::string& Id)
 {
-	FScopedLock Lock(SessionMutex);
-	return erase_if(Sessions, [&Id](const FVoiceSessionPtr& VoiceSession) { return VoiceSession->GetId() == Id; }) != 0;
+	FShard& Shard = GetShard(Id);
+	FWriteLock Lock(Shard.Mutex);
+	return Shard.Sessions.erase(Id) != 0;
 }
 
-FVoiceSessionPtr FVoiceHost::FindSession(const std::string& Id)
+FVoiceSessionPtr FVoiceHost::FindSession(const std::string& Id) const
 {
-	for (std::vector<FVoiceSessionPtr>::iterator Itr = Sessions.begin(); Itr != Sessions.end(); ++Itr)
+	const FShard& Shard = GetShard(Id);
+	FReadLock Lock(Shard.Mutex);
+
+	const auto Itr = Shard.Sessions.find(Id);
+	if (Itr != Shard.Sessions.end())
 	{
-		if ((*Itr)->GetId() == Id)
-		{
-			return *Itr;
-		}
+		return Itr->second;
 	}
 
 	return FVoiceSessionPtr(nullptr);
@@ -38,6 +51,77 @@ size_t FVoiceHost::RemoveExpiredSessions()
 	// Applications may want to include a notification pushed from the server to all room participants or have the client deal with it accordingly.
 
 	const auto Now = std::chrono::steady_clock::now();
-	FScopedLock Lock(SessionMutex);
-	return erase_if(Sessions, [&Now](const FVoiceSessionPtr& VoiceSession) { return VoiceSession->IsExpired(Now); });
+
+	std::vector<FVoiceSessionPtr> ExpiredSessions;
+	{
+		FScopedLock Lock(ExpiryMutex);
+		while (!ExpiryQueue.empty() && Now > ExpiryQueue.top().Expiration)
+		{
+			std::weak_ptr<FVoiceSession> WeakSession = ExpiryQueue.top().Session;
+			ExpiryQueue.pop();
+
+			// removed and released before it expired
+			FVoiceSessionPtr Session = WeakSession.lock();
+			if (Session == nullptr)
+			{
+				continue;
+			}
+
+			// heartbeated since the entry was pushed, wait for the new expiration
+			const ServerTimePoint Expiration = Session->GetExpiration();
+			if (!(Now > Expiration))
+			{
+				ExpiryQueue.push(FExpiryEntry{ Expiration, std::move(WeakSession) });
+				continue;
+			}
+
+			ExpiredSessions.push_back(std::move(Session));
+		}
+	}
+
+	size_t NumRemoved = 0;
+	for (const FVoiceSessionPtr& Session : ExpiredSessions)
+	{
+		if (RemoveExpiredSession(Session))
+		{
+			++NumRemoved;
+			if (OnSessionExpiredCallback)
+			{
+				OnSessionExpiredCallback(Session);
+			}
+		}
+	}
+	return NumRemoved;
+}
+
+void FVoiceHost::SetOnSessionExpiredCallback(FOnSessionExpiredCallback Callback)
+{
+	OnSessionExpiredCallback = std::move(Callback);
+}
+
+bool FVoiceHost::RemoveExpiredSession(const FVoiceSessionPtr& Session)
+{
+	FShard& Shard = GetShard(Session->GetId());
+	FWriteLock Lock(Shard.Mutex);
+
+	const auto Itr = Shard.Sessions.find(Session->GetId());
+	if (Itr == Shard.Sessions.end() || Itr->second != Session)
+	{
+		return false;
+	}
+
+	Shard.Sessions.erase(Itr);
+	return true;
+}
+
+FVoiceHost::FShard& FVoiceHost::GetShard(const std::string& Id)
+{
+	return const_cast<FShard&>(static_cast<const FVoiceHost*>(this)->GetShard(Id));
+}
+
+const FVoiceHost::FShard& FVoiceHost::GetShard(const std::string& Id) const
+{
+	// skip the low bits, unordered_map implementations with power of two bucket counts pick buckets with them
+	const size_t Hash = std::hash<std::string>()(Id);
+	return Shards[(Hash >> 16) % NumShards];
 }
@@ -2,24 +2,73 @@
 
 #pragma once
 
+#include "NonCopyable.h"
 #include "VoiceSession.h"
 
-/** Container for multiple voice sessions, managing synchronization */
-class FVoiceHost
+#include <array>
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+
+/**
+ * Container for multiple voice sessions, managing synchronization.
+ * Sessions are indexed by id and spread over shards by hash, each with its own reader/writer lock,
+ * so lookups from the http threads only share-lock one shard and rarely wait for a writer.
+ */
+class FVoiceHost : public FNonCopyable
 {
 public:
 	FVoiceHost() {}
 
+	/** Returns false if a session with the same id already exists */
 	bool AddSession(const FVoiceSessionPtr& Session);	
 	bool RemoveSession(const std::string& Id);
 	
-	FVoiceSessionPtr FindSession(const std::string& Id);
+	FVoiceSessionPtr FindSession(const std::string& Id) const;
 
-	/** Compares expiration timestamps of sessions and removes expired ones, clients heartbeat to keep sessions alive. */
+	/**
+	 * Removes sessions whose expiration passed, clients heartbeat to keep sessions alive.
+	 * Only visits sessions that were due to expire, a heartbeat only moves the session's expiration.
+	 */
 	size_t RemoveExpiredSessions();
 
+	/** Called by RemoveExpiredSessions for each removed session, on the thread calling it and without holding any lock */
+	using FOnSessionExpiredCallback = std::function<void(const FVoiceSessionPtr&)>;
+	void SetOnSessionExpiredCallback(FOnSessionExpiredCallback Callback);
 
 private:
-	std::mutex SessionMutex;
-	std::vector<FVoiceSessionPtr> Sessions;
+	/** Enough shards that http threads rarely contend for one */
+	static constexpr size_t NumShards = 64;
+
+	struct FShard
+	{
+		mutable std::shared_timed_mutex Mutex;
+		std::unordered_map<std::string, FVoiceSessionPtr> Sessions;
+	};
+
+	FShard& GetShard(const std::string& Id);
+	const FShard& GetShard(const std::string& Id) const;
+
+	/** Removes the session from its shard unless it was already removed or replaced */
+	bool RemoveExpiredSession(const FVoiceSessionPtr& Session);
+
+	std::array<FShard, NumShards> Shards;
+
+	/** When a session was last known to expire. Sessions removed before they expire leave their entry behind until it is due. */
+	struct FExpiryEntry
+	{
+		ServerTimePoint Expiration;
+		std::weak_ptr<FVoiceSession> Session;
+
+		bool operator>(const FExpiryEntry& Rhs) const { return Expiration > Rhs.Expiration; }
+	};
+
+	/**
+	 * One entry per session, earliest expiration first. Heartbeats don't touch it: once an entry is due,
+	 * a session that was heartbeated in the meantime is pushed again with its new expiration.
+	 */
+	std::mutex ExpiryMutex;
+	std::priority_queue<FExpiryEntry, std::vector<FExpiryEntry>, std::greater<FExpiryEntry>> ExpiryQueue;
+
+	FOnSessionExpiredCallback OnSessionExpiredCallback;
 };
\ No newline at end of file
@@ -3,19 +3,26 @@
 #include "pch.h"
 
 #include "VoiceRequest.h"
-#include "VoiceSdk.h"
 
-#include "Utils.h"
+bool FVoiceRequestTicket::TryStart()
+{
+	EState Expected = EState::Queued;
+	return State.compare_exchange_strong(Expected, EState::Started) || Expected == EState::Started;
+}
 
-FVoiceRequestReceipt::~FVoiceRequestReceipt()
+bool FVoiceRequestTicket::TryAbandon()
 {
-	if (VoiceSdk && VoiceRequestHandle)
-	{
-		VoiceSdk->ReleaseRequest(VoiceRequestHandle);
-	}
+	EState Expected = EState::Queued;
+	return State.compare_exchange_strong(Expected, EState::Abandoned);
 }
 
-void FVoiceRequestReceipt::WaitForResult()
+bool FVoiceRequest::MarkComplete()
 {
-	ResultFuture.wait();
+	if (bIsComplete)
+	{
+		return false;
+	}
+
+	bIsComplete = true;
+	return true;
 }
\ No newline at end of file
@@ -6,34 +6,73 @@
 
 #include <eos_rtc_admin.h>
 
-class FVoiceRequest
+#include <atomic>
+#include <memory>
+
+/**
+ * Lets the thread that queued a request give up on it. Shared by the requester and FVoiceSdk: the requester abandons
+ * the ticket when it stops waiting, FVoiceSdk starts it right before making the request. Only one of them succeeds, so
+ * an abandoned request is never made and a started request always completes.
+ */
+class FVoiceRequestTicket
 {
 public:
-	virtual ~FVoiceRequest() { }
-	virtual EOS_EResult MakeRequest(EOS_HRTCAdmin RTCAdminHandle) = 0;
+	/** Called by FVoiceSdk on the ticking thread, false if the requester abandoned the request. Requests sharing a ticket all start. */
+	bool TryStart();
+
+	/** Called by the requester, false if the request already started and its completion callback is going to run */
+	bool TryAbandon();
+
+private:
+	enum class EState : uint8_t
+	{
+		Queued,
+		Started,
+		Abandoned
+	};
+
+	std::atomic<EState> State{ EState::Queued };
 };
 
-using FVoiceRequestPtr = std::unique_ptr<FVoiceRequest>;
-using FVoiceRequestHandle = FVoiceRequest*;
+using FVoiceRequestTicketPtr = std::shared_ptr<FVoiceRequestTicket>;
 
-class FVoiceRequestReceipt : public FNonCopyable
+/**
+ * A request to the RTC Admin interface. Requests are made and completed on the thread ticking FVoiceSdk: once the SDK
+ * reports the final result, the request calls its completion callback on that thread and is released by FVoiceSdk.
+ */
+class FVoiceRequest
 {
 public:
-	FVoiceRequestReceipt(std::future<EOS_EResult>&& InResultFuture, FVoiceRequestHandle InRequestHandle, FVoiceSdk* InVoiceSdk) :
-		ResultFuture(std::move(InResultFuture)),
-		VoiceRequestHandle(InRequestHandle),
-		VoiceSdk(InVoiceSdk)
-	{
-	}
+	virtual ~FVoiceRequest() { }
+	virtual EOS_EResult MakeRequest(EOS_HRTCAdmin RTCAdminHandle) = 0;
+
+	/** Completes the request with EOS_Canceled unless it already completed, e.g. when the server shuts down */
+	virtual void Cancel() = 0;
+
+	/** Requests with the same merge key that are queued for the same Tick are made as one SDK call, empty if never merged */
+	virtual std::string GetMergeKey() const { return std::string(); }
+
+	/** Takes over the callers of Other, which has the same merge key and is released without being made */
+	virtual void Merge(FVoiceRequest& Other) { }
 
-	virtual ~FVoiceRequestReceipt();
+	bool IsComplete() const { return bIsComplete; }
 
-	void WaitForResult();
-	EOS_EResult GetResult() { return ResultFuture.get(); }
+	/** Set before the request is queued, requests without a ticket are always made */
+	void SetTicket(FVoiceRequestTicketPtr InTicket) { Ticket = std::move(InTicket); }
+
+	/** False if the request was abandoned and must be released without being made or completed */
+	bool TryStart() { return !Ticket || Ticket->TryStart(); }
+
+protected:
+	/** Returns false if the request already completed, the completion callback must only be called once */
+	bool MarkComplete();
 
 private:
-	std::future<EOS_EResult> ResultFuture;
-	FVoiceRequestHandle VoiceRequestHandle = nullptr;
-	FVoiceSdk* VoiceSdk = nullptr;
+	bool bIsComplete = false;
+	FVoiceRequestTicketPtr Ticket;
 };
-using FVoiceRequestReceiptPtr = std::unique_ptr<FVoiceRequestReceipt>;
\ No newline at end of file
+
+using FVoiceRequestPtr = std::unique_ptr<FVoiceRequest>;
+
+/** Called with the final result of a request that has no other result data */
+using FOnVoiceRequestComplete = std::function<void(EOS_EResult)>;
\ No newline at end of file
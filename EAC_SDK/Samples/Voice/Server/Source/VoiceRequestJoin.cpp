@@ -10,29 +10,57 @@
 #include "Utils.h"
 #include "StringUtils.h"
 
-FJoinRoomReceipt::~FJoinRoomReceipt()
+FVoiceRequestJoin::FVoiceRequestJoin(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const std::vector<FVoiceUser>& InVoiceUsers, FOnJoinRoomComplete InOnComplete) :
+	RTCAdminHandle(InRTCAdminHandle),
+	RoomName(InRoomName)
 {
-	if (VoiceSdk && VoiceRequestHandle)
-	{
-		VoiceSdk->ReleaseRequest(VoiceRequestHandle);
-	}
+	Callers.push_back(FCaller{ InVoiceUsers, std::move(InOnComplete) });
 }
 
-void FJoinRoomReceipt::WaitForResult()
+void FVoiceRequestJoin::Cancel()
 {
-	ResultFuture.wait();
+	FJoinRoomResult Result{ };
+	Result.Result = EOS_EResult::EOS_Canceled;
+	Complete(Result);
 }
 
-FVoiceRequestJoin::FVoiceRequestJoin(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const std::vector<FVoiceUser>& InVoiceUsers) :
-	RTCAdminHandle(InRTCAdminHandle),
-	RoomName(InRoomName),
-	VoiceUsers(InVoiceUsers)
+std::string FVoiceRequestJoin::GetMergeKey() const
 {
+	return "QueryJoinRoomToken:" + RoomName;
 }
 
-std::future<FJoinRoomResult> FVoiceRequestJoin::GetFuture()
+void FVoiceRequestJoin::Merge(FVoiceRequest& Other)
 {
-	return ResultPromise.get_future();
+	// only join requests for the same room share the merge key
+	FVoiceRequestJoin& OtherJoin = static_cast<FVoiceRequestJoin&>(Other);
+	assert(OtherJoin.RoomName == RoomName);
+
+	std::move(OtherJoin.Callers.begin(), OtherJoin.Callers.end(), std::back_inserter(Callers));
+	OtherJoin.Callers.clear();
+}
+
+void FVoiceRequestJoin::Complete(const FJoinRoomResult& Result)
+{
+	if (MarkComplete())
+	{
+		for (const FCaller& Caller : Callers)
+		{
+			Caller.OnComplete(Result);
+		}
+	}
+}
+
+void FVoiceRequestJoin::Complete(const std::vector<FJoinRoomResult>& Results)
+{
+	assert(Results.size() == Callers.size());
+
+	if (MarkComplete())
+	{
+		for (size_t Index = 0; Index < Callers.size(); ++Index)
+		{
+			Callers[Index].OnComplete(Results[Index]);
+		}
+	}
 }
 
 EOS_EResult FVoiceRequestJoin::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
@@ -43,12 +71,20 @@ EOS_EResult FVoiceRequestJoin::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 	Options.ApiVersion = EOS_RTCADMIN_QUERYJOINROOMTOKEN_API_LATEST;
 	Options.RoomName = RoomName.c_str();
 
+	// every user once, even if several merged callers requested it
 	std::vector<EOS_ProductUserId> TargetUserIds;
 	std::vector<const char*> TargetUserIpAddresses;
-	for (const FVoiceUser& VoiceUser : VoiceUsers)
+	for (const FCaller& Caller : Callers)
 	{
-		TargetUserIds.emplace_back(VoiceUser.GetPuid());
-		TargetUserIpAddresses.emplace_back(VoiceUser.GetIPAddress().c_str());
+		for (const FVoiceUser& VoiceUser : Caller.VoiceUsers)
+		{
+			if (std::find(TargetUserIds.begin(), TargetUserIds.end(), VoiceUser.GetPuid()) == TargetUserIds.end())
+			{
+				TargetUserIds.emplace_back(VoiceUser.GetPuid());
+				// invited users are not connected yet, their address is unknown
+				TargetUserIpAddresses.emplace_back(VoiceUser.GetIPAddress().empty() ? nullptr : VoiceUser.GetIPAddress().c_str());
+			}
+		}
 	}
 	Options.TargetUserIds = TargetUserIds.data();
 	Options.TargetUserIdsCount = static_cast<uint32_t>(TargetUserIds.size());
@@ -59,8 +95,8 @@ EOS_EResult FVoiceRequestJoin::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 
 		// Wait for completion, SDK may retry
 		// The lifetime of this callback and its request must be guaranteed until EOS_EResult_IsOperationComplete is true.
-		// In this case, we fulfill the ResultPromise which unblocks the wait in VoiceApi. 
-		// As the receipt is destructed it releases the request from ActiveRequests in VoiceSdk.
+		// In this case, we call the completion callback, which continues the request in VoiceApi.
+		// Once completed, VoiceSdk releases the request after the tick.
 		if (EOS_EResult_IsOperationComplete(Data->ResultCode))
 		{
 			if (Data->ResultCode == EOS_EResult::EOS_Success)
@@ -72,6 +108,9 @@ EOS_EResult FVoiceRequestJoin::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 				Result.RoomName = Data->RoomName;
 				Result.ClientBaseUrl = Data->ClientBaseUrl;
 
+				// each caller only receives the tokens of the users it requested
+				std::vector<FJoinRoomResult> Results(Request->Callers.size(), Result);
+
 				EOS_RTCAdmin_CopyUserTokenByIndexOptions CopyOptions = {};
 				CopyOptions.ApiVersion = EOS_RTCADMIN_COPYUSERTOKENBYINDEX_API_LATEST;
 				CopyOptions.QueryId = Data->QueryId;
@@ -91,7 +130,13 @@ EOS_EResult FVoiceRequestJoin::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 
 							if (ToStringResult == EOS_EResult::EOS_Success)
 							{
-								Result.Tokens.push_back(FPuidToken(PuidBuffer, UserToken->Token));
+								for (size_t Index = 0; Index < Results.size(); ++Index)
+								{
+									if (Request->Callers[Index].ContainsPuid(UserToken->ProductUserId))
+									{
+										Results[Index].Tokens.push_back(FPuidToken(PuidBuffer, UserToken->Token));
+									}
+								}
 							}
 							else
 							{
@@ -107,15 +152,14 @@ EOS_EResult FVoiceRequestJoin::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 					}
 				}
 
-				// setting the promise value readies the future in the receipt.
-				Request->ResultPromise.set_value(Result);
+				Request->Complete(Results);
 			}
 			else
 			{
 				FDebugLog::LogError(L"FVoiceRequestJoin (%x) failed: %ls", Request, FStringUtils::Widen(EOS_EResult_ToString(Data->ResultCode)).c_str());
 				FJoinRoomResult Result{ };
 				Result.Result = Data->ResultCode;
-				Request->ResultPromise.set_value(Result);
+				Request->Complete(Result);
 			}
 		}
 		else if (Data->ResultCode == EOS_EResult::EOS_OperationWillRetry)
@@ -127,7 +171,19 @@ EOS_EResult FVoiceRequestJoin::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 	return EOS_EResult::EOS_Success;
 }
 
-bool FVoiceRequestJoin::ContainsPuid(const EOS_ProductUserId& ProductUserId)
+bool FVoiceRequestJoin::ContainsPuid(const EOS_ProductUserId& ProductUserId) const
+{
+	for (const FCaller& Caller : Callers)
+	{
+		if (Caller.ContainsPuid(ProductUserId))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FVoiceRequestJoin::FCaller::ContainsPuid(const EOS_ProductUserId& ProductUserId) const
 {	
 	for (const FVoiceUser& VoiceUser : VoiceUsers)
 	{
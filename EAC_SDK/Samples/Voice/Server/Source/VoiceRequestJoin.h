@@ -21,53 +21,55 @@ public:
 class FJoinRoomResult final
 {
 public:
-	EOS_EResult Result;
+	EOS_EResult Result = EOS_EResult::EOS_UnexpectedError;
 	std::string RoomName;
 	std::string ClientBaseUrl;
 	std::vector<FPuidToken> Tokens;
 };
 
-/** Receipt for FVoiceRequestJoin */
-class FJoinRoomReceipt : public FNonCopyable
-{
-public:
-	FJoinRoomReceipt(std::future<FJoinRoomResult>&& InResultFuture, FVoiceRequestHandle InRequestHandle, FVoiceSdk* InVoiceSdk) :
-		ResultFuture(std::move(InResultFuture)),
-		VoiceRequestHandle(InRequestHandle),
-		VoiceSdk(InVoiceSdk)
-	{
-	}
-
-	~FJoinRoomReceipt();	
-	
-	void WaitForResult();
-	FJoinRoomResult GetResult() { return ResultFuture.get(); }
-
-private:
-	std::future<FJoinRoomResult> ResultFuture;
-	FVoiceRequestHandle VoiceRequestHandle = nullptr;
-	FVoiceSdk* VoiceSdk = nullptr;
-};
-using FJoinRoomReceiptPtr = std::unique_ptr<FJoinRoomReceipt>;
+/** Called with the result of FVoiceRequestJoin */
+using FOnJoinRoomComplete = std::function<void(const FJoinRoomResult&)>;
 
-/** A request for joinRoom tokens for a RoomId and a set of VoiceUsers */
+/**
+ * A request for joinRoom tokens for a RoomId and a set of VoiceUsers.
+ * Requests for the same room are merged into one QueryJoinRoomToken call, every caller receives the tokens of its own users.
+ */
 class FVoiceRequestJoin : public FVoiceRequest, public FNonCopyable
 {
 public:
 	FVoiceRequestJoin() = delete;	
-	FVoiceRequestJoin(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const std::vector<FVoiceUser>& InVoiceUsers);
+	FVoiceRequestJoin(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const std::vector<FVoiceUser>& InVoiceUsers, FOnJoinRoomComplete InOnComplete);
 
 	~FVoiceRequestJoin() {}
 
 	virtual EOS_EResult MakeRequest(EOS_HRTCAdmin RTCAdminHandle) override;
+	virtual void Cancel() override;
+	virtual std::string GetMergeKey() const override;
+	virtual void Merge(FVoiceRequest& Other) override;
 
-	bool ContainsPuid(const EOS_ProductUserId& ProductUserId);
-	std::future<FJoinRoomResult> GetFuture();
+	/** True if any caller requested a token for the ProductUserId */
+	bool ContainsPuid(const EOS_ProductUserId& ProductUserId) const;
 
 private:
+	/** Users and completion callback of one CreateJoinRoomTokens call */
+	struct FCaller
+	{
+		std::vector<FVoiceUser> VoiceUsers;
+		FOnJoinRoomComplete OnComplete;
+
+		bool ContainsPuid(const EOS_ProductUserId& ProductUserId) const;
+	};
+
+	/** Completes every caller with the same result */
+	void Complete(const FJoinRoomResult& Result);
+
+	/** Completes every caller with its own result, Results has one entry per caller */
+	void Complete(const std::vector<FJoinRoomResult>& Results);
+
 	EOS_HRTCAdmin RTCAdminHandle = 0;
 	std::string RoomName;
-	std::vector<FVoiceUser> VoiceUsers;
-	std::promise<FJoinRoomResult> ResultPromise;
+
+	/** One for each request merged into this one, starting with this request's own */
+	std::vector<FCaller> Callers;
 };
 
@@ -8,10 +8,11 @@
 #include "DebugLog.h"
 #include "StringUtils.h"
 
-FVoiceRequestKickUser::FVoiceRequestKickUser(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const EOS_ProductUserId& InProductUserId) :
+FVoiceRequestKickUser::FVoiceRequestKickUser(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const EOS_ProductUserId& InProductUserId, FOnVoiceRequestComplete InOnComplete) :
 	RTCAdminHandle(InRTCAdminHandle),
 	RoomName(InRoomName),
-	ProductUserId(InProductUserId)
+	ProductUserId(InProductUserId),
+	OnComplete(std::move(InOnComplete))
 {
 }
 
@@ -29,8 +30,8 @@ EOS_EResult FVoiceRequestKickUser::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 		
 		// Wait for completion, SDK may retry
 		// The lifetime of this callback and its request must be guaranteed until EOS_EResult_IsOperationComplete is true.
-		// In this case, we fulfill the ResultPromise which unblocks the wait in VoiceApi. 
-		// As the receipt is destructed it releases the request from ActiveRequests in VoiceSdk.
+		// In this case, we call the completion callback, which continues the request in VoiceApi.
+		// Once completed, VoiceSdk releases the request after the tick.
 		if (EOS_EResult_IsOperationComplete(Data->ResultCode))
 		{
 			if (Data->ResultCode == EOS_EResult::EOS_Success)
@@ -42,7 +43,7 @@ EOS_EResult FVoiceRequestKickUser::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 				FDebugLog::LogError(L"FVoiceRequestKickUser (%x) failed: %ls", Request, FStringUtils::Widen(EOS_EResult_ToString(Data->ResultCode)).c_str());
 			}
 
-			Request->ResultPromise.set_value(Data->ResultCode);
+			Request->Complete(Data->ResultCode);
 		}
 		else if (Data->ResultCode == EOS_EResult::EOS_OperationWillRetry)
 		{
@@ -53,7 +54,15 @@ EOS_EResult FVoiceRequestKickUser::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 	return EOS_EResult::EOS_Success;
 }
 
-std::future<EOS_EResult> FVoiceRequestKickUser::GetFuture()
+void FVoiceRequestKickUser::Cancel()
 {
-	return ResultPromise.get_future();
+	Complete(EOS_EResult::EOS_Canceled);
+}
+
+void FVoiceRequestKickUser::Complete(EOS_EResult Result)
+{
+	if (MarkComplete())
+	{
+		OnComplete(Result);
+	}
 }
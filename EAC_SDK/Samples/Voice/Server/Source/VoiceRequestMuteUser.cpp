@@ -7,11 +7,12 @@
 #include "DebugLog.h"
 #include "StringUtils.h"
 
-FVoiceRequestMuteUser::FVoiceRequestMuteUser(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const EOS_ProductUserId& InProductUserId, bool bInMute) :
+FVoiceRequestMuteUser::FVoiceRequestMuteUser(EOS_HRTCAdmin InRTCAdminHandle, const std::string& InRoomName, const EOS_ProductUserId& InProductUserId, bool bInMute, FOnVoiceRequestComplete InOnComplete) :
 	RTCAdminHandle(InRTCAdminHandle),
 	RoomName(InRoomName),
 	ProductUserId(InProductUserId),
-	bMute(bInMute)
+	bMute(bInMute),
+	OnComplete(std::move(InOnComplete))
 {
 }
 
@@ -28,8 +29,8 @@ EOS_EResult FVoiceRequestMuteUser::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 
 		// Wait for completion, SDK may retry
 		// The lifetime of this callback and its request must be guaranteed until EOS_EResult_IsOperationComplete is true.
-		// In this case, we fulfill the ResultPromise which unblocks the wait in VoiceApi. 
-		// As the receipt is destructed it releases the request from ActiveRequests in VoiceSdk.
+		// In this case, we call the completion callback, which continues the request in VoiceApi.
+		// Once completed, VoiceSdk releases the request after the tick.
 		if (EOS_EResult_IsOperationComplete(Data->ResultCode))
 		{
 			if (Data->ResultCode == EOS_EResult::EOS_Success)
@@ -41,7 +42,7 @@ EOS_EResult FVoiceRequestMuteUser::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 				FDebugLog::LogError(L"FVoiceRequestMuteUser (%x) failed: %ls", Request, FStringUtils::Widen(EOS_EResult_ToString(Data->ResultCode)).c_str());
 			}
 
-			Request->ResultPromise.set_value(Data->ResultCode);
+			Request->Complete(Data->ResultCode);
 		}
 		else if (Data->ResultCode == EOS_EResult::EOS_OperationWillRetry)
 		{
@@ -52,7 +53,15 @@ EOS_EResult FVoiceRequestMuteUser::MakeRequest(EOS_HRTCAdmin RTCAdminHandle)
 	return EOS_EResult::EOS_Success;
 }
 
-std::future<EOS_EResult> FVoiceRequestMuteUser::GetFuture()
+void FVoiceRequestMuteUser::Cancel()
 {
-	return ResultPromise.get_future();
+	Complete(EOS_EResult::EOS_Canceled);
+}
+
+void FVoiceRequestMuteUser::Complete(EOS_EResult Result)
+{
+	if (MarkComplete())
+	{
+		OnComplete(Result);
+	}
 }
\ No newline at end of file
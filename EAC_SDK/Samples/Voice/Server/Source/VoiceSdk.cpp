@@ -24,6 +24,35 @@
 
 #include <eos_logging.h>
 
+namespace
+{
+	/** Collects the results of a batch of requests and reports them once the last one completed */
+	class FBatchResults
+	{
+	public:
+		FBatchResults(size_t NumRequests, FVoiceSdk::FOnBatchComplete InOnComplete) :
+			Results(NumRequests, EOS_EResult::EOS_UnexpectedError),
+			NumPending(NumRequests),
+			OnComplete(std::move(InOnComplete))
+		{
+		}
+
+		void SetResult(size_t Index, EOS_EResult Result)
+		{
+			Results[Index] = Result;
+			if (--NumPending == 0)
+			{
+				OnComplete(Results);
+			}
+		}
+
+	private:
+		std::vector<EOS_EResult> Results;
+		size_t NumPending;
+		FVoiceSdk::FOnBatchComplete OnComplete;
+	};
+}
+
 constexpr char SampleConstants::ProductId[];
 constexpr char SampleConstants::SandboxId[];
 constexpr char SampleConstants::DeploymentId[];
@@ -36,14 +65,6 @@ FVoiceSdk::~FVoiceSdk()
 {
 }
 
-void FVoiceSdk::ReleaseRequest(FVoiceRequestHandle VoiceRequestHandle)
-{
-	FScopedLock Lock(RequestsMutex);
-
-	size_t NumErased = erase_if(ActiveRequests, [=](const FVoiceRequestPtr& VoiceRequest) { return VoiceRequest.get() == VoiceRequestHandle; });
-	assert(NumErased == 1);
-}
-
 
 EOS_Bool FVoiceSdk::LoadAndInitSdk()
 {
@@ -231,8 +252,7 @@ EOS_Bool FVoiceSdk::Shutdown()
 	{
 		FScopedLock lock(RequestsMutex);
 
-		std::queue<FVoiceRequestPtr> empty;
-		std::swap(NewRequests, empty);
+		NewRequests.clear();
 		ActiveRequests.clear();
 	}
 
@@ -247,58 +267,221 @@ EOS_Bool FVoiceSdk::Shutdown()
 	return EOS_TRUE;
 }
 
-FJoinRoomReceiptPtr FVoiceSdk::CreateJoinRoomTokens(const char* RoomId, const std::vector<FVoiceUser>& Users)
+void FVoiceSdk::CreateJoinRoomTokens(const char* RoomId, const std::vector<FVoiceUser>& Users, FOnJoinRoomComplete OnComplete, FVoiceRequestTicketPtr Ticket)
 {
-	FVoiceRequestJoin* QueryToken = new FVoiceRequestJoin(RTCAdminHandle, RoomId, Users);
-	FVoiceRequestPtr Request(QueryToken);
+	QueueRequest(FVoiceRequestPtr(new FVoiceRequestJoin(RTCAdminHandle, RoomId, Users, std::move(OnComplete))), std::move(Ticket));
+}
 
-	FScopedLock Lock(RequestsMutex);
-	NewRequests.push(std::move(Request));	
-	
-	return FJoinRoomReceiptPtr(new FJoinRoomReceipt(QueryToken->GetFuture(), QueryToken, this));
+void FVoiceSdk::KickUser(const char* RoomId, const EOS_ProductUserId& ProductUserId, FOnVoiceRequestComplete OnComplete, FVoiceRequestTicketPtr Ticket)
+{
+	QueueRequest(FVoiceRequestPtr(new FVoiceRequestKickUser(RTCAdminHandle, RoomId, ProductUserId, std::move(OnComplete))), std::move(Ticket));
 }
 
-FVoiceRequestReceiptPtr FVoiceSdk::KickUser(const char* RoomId, const EOS_ProductUserId& ProductUserId)
+void FVoiceSdk::MuteUser(const char* RoomId, const EOS_ProductUserId& ProductUserId, bool bMute, FOnVoiceRequestComplete OnComplete, FVoiceRequestTicketPtr Ticket)
 {
-	FVoiceRequestKickUser* Kick = new FVoiceRequestKickUser(RTCAdminHandle, RoomId, ProductUserId);
-	FVoiceRequestPtr Request(Kick);
+	QueueRequest(FVoiceRequestPtr(new FVoiceRequestMuteUser(RTCAdminHandle, RoomId, ProductUserId, bMute, std::move(OnComplete))), std::move(Ticket));
+}
 
-	FScopedLock Lock(RequestsMutex);
-	NewRequests.push(std::move(Request));
+void FVoiceSdk::KickUsers(const char* RoomId, const std::vector<EOS_ProductUserId>& ProductUserIds, FOnBatchComplete OnComplete, FVoiceRequestTicketPtr Ticket)
+{
+	assert(!ProductUserIds.empty());
+
+	// all requests of a batch complete on the same thread, either the ticking thread or the one canceling them
+	std::shared_ptr<FBatchResults> BatchResults = std::make_shared<FBatchResults>(ProductUserIds.size(), std::move(OnComplete));
+
+	std::vector<FVoiceRequestPtr> Requests;
+	Requests.reserve(ProductUserIds.size());
+	for (size_t Index = 0; Index < ProductUserIds.size(); ++Index)
+	{
+		Requests.emplace_back(new FVoiceRequestKickUser(RTCAdminHandle, RoomId, ProductUserIds[Index], [BatchResults, Index](EOS_EResult Result) { BatchResults->SetResult(Index, Result); }));
+	}
+	QueueRequests(std::move(Requests), Ticket);
+}
+
+void FVoiceSdk::MuteUsers(const char* RoomId, const std::vector<EOS_ProductUserId>& ProductUserIds, bool bMute, FOnBatchComplete OnComplete, FVoiceRequestTicketPtr Ticket)
+{
+	assert(!ProductUserIds.empty());
 
-	return FVoiceRequestReceiptPtr(new FVoiceRequestReceipt(Kick->GetFuture(), Kick, this));
+	std::shared_ptr<FBatchResults> BatchResults = std::make_shared<FBatchResults>(ProductUserIds.size(), std::move(OnComplete));
+
+	std::vector<FVoiceRequestPtr> Requests;
+	Requests.reserve(ProductUserIds.size());
+	for (size_t Index = 0; Index < ProductUserIds.size(); ++Index)
+	{
+		Requests.emplace_back(new FVoiceRequestMuteUser(RTCAdminHandle, RoomId, ProductUserIds[Index], bMute, [BatchResults, Index](EOS_EResult Result) { BatchResults->SetResult(Index, Result); }));
+	}
+	QueueRequests(std::move(Requests), Ticket);
 }
 
-FVoiceRequestReceiptPtr FVoiceSdk::MuteUser(const char* RoomId, const EOS_ProductUserId& ProductUserId, bool bMute)
+void FVoiceSdk::QueueRequest(FVoiceRequestPtr Request, FVoiceRequestTicketPtr Ticket)
 {
-	FVoiceRequestMuteUser* Mute = new FVoiceRequestMuteUser(RTCAdminHandle, RoomId, ProductUserId, bMute);
-	FVoiceRequestPtr Request(Mute);
+	Request->SetTicket(std::move(Ticket));
 
-	FScopedLock Lock(RequestsMutex);
-	NewRequests.push(std::move(Request));
+	const ServerTimePoint Now = std::chrono::steady_clock::now();
+	{
+		FScopedLock Lock(RequestsMutex);
+		if (!bRequestsCanceled)
+		{
+			NewRequests.push_back(FQueuedRequest{ std::move(Request), Now });
+		}
+	}
+
+	// still set if it was not queued, after CancelRequests
+	if (Request)
+	{
+		Request->Cancel();
+		return;
+	}
+
+	if (OnRequestQueuedCallback)
+	{
+		OnRequestQueuedCallback();
+	}
+}
+
+void FVoiceSdk::QueueRequests(std::vector<FVoiceRequestPtr> Requests, const FVoiceRequestTicketPtr& Ticket)
+{
+	// one ticket for the whole batch, its requests are made or abandoned together
+	for (FVoiceRequestPtr& Request : Requests)
+	{
+		Request->SetTicket(Ticket);
+	}
+
+	const ServerTimePoint Now = std::chrono::steady_clock::now();
+	{
+		FScopedLock Lock(RequestsMutex);
+		if (!bRequestsCanceled)
+		{
+			for (FVoiceRequestPtr& Request : Requests)
+			{
+				NewRequests.push_back(FQueuedRequest{ std::move(Request), Now });
+			}
+			Requests.clear();
+		}
+	}
 
-	return FVoiceRequestReceiptPtr(new FVoiceRequestReceipt(Mute->GetFuture(), Mute, this));
+	// still set if they were not queued, after CancelRequests
+	if (!Requests.empty())
+	{
+		for (FVoiceRequestPtr& Request : Requests)
+		{
+			Request->Cancel();
+		}
+		return;
+	}
+
+	if (OnRequestQueuedCallback)
+	{
+		OnRequestQueuedCallback();
+	}
 }
 
+void FVoiceSdk::SetOnRequestQueuedCallback(FOnRequestQueuedCallback Callback)
+{
+	OnRequestQueuedCallback = std::move(Callback);
+}
 
 void FVoiceSdk::Tick()
 {
 	/** VoiceReqeusts come in from the http api threadpool, but EOS SDK calls must all originate from the same thread.
 	  * Therefore the VoiceRequests are queued up by FVoiceSdk, which processes them on its main thread, right here as part of Tick.
 	  */
-	if (!NewRequests.empty())
-	{	
+	{
 		FScopedLock Lock(RequestsMutex);
+		std::swap(NewRequests, TickRequests);
+	}
+
+	if (!TickRequests.empty())
+	{
+		const ServerTimePoint Now = std::chrono::steady_clock::now();
+		RequestStats.MaxQueueDepth = std::max(RequestStats.MaxQueueDepth, TickRequests.size());
+
+		// merge first, a merged request must know all of its users before it is made
+		const size_t FirstNewRequest = ActiveRequests.size();
+		for (FQueuedRequest& Queued : TickRequests)
+		{
+			++RequestStats.NumRequests;
+			RequestStats.QueueWaitTimes.Add(Now - Queued.QueuedTime);
+
+			// the requester already answered, making the request now would have effects nobody is told about
+			if (!Queued.Request->TryStart())
+			{
+				++RequestStats.NumAbandonedRequests;
+				continue;
+			}
+
+			const std::string MergeKey = Queued.Request->GetMergeKey();
+			if (!MergeKey.empty())
+			{
+				FVoiceRequest*& MergeTarget = MergeableRequests[MergeKey];
+				if (MergeTarget != nullptr)
+				{
+					MergeTarget->Merge(*Queued.Request);
+					++RequestStats.NumMergedRequests;
+					continue;
+				}
+				MergeTarget = Queued.Request.get();
+			}
 
-		/** Currently just processing 1 request per Tick */
-		FDebugLog::Log(L"Processing voice request (%d more queued)", NewRequests.size() - 1);
+			ActiveRequests.push_back(std::move(Queued.Request));
+		}
 
-		FVoiceRequestPtr Request = std::move(NewRequests.back());
-		NewRequests.pop();
+		const size_t NumMade = ActiveRequests.size() - FirstNewRequest;
+		FDebugLog::Log(L"Processing %llu voice requests (%llu merged or abandoned)",
+			static_cast<unsigned long long>(TickRequests.size()),
+			static_cast<unsigned long long>(TickRequests.size() - NumMade));
+		TickRequests.clear();
+		MergeableRequests.clear();
 
-		Request->MakeRequest(RTCAdminHandle);
-		ActiveRequests.push_back(std::move(Request));
+		for (size_t Index = FirstNewRequest; Index < ActiveRequests.size(); ++Index)
+		{
+			ActiveRequests[Index]->MakeRequest(RTCAdminHandle);
+		}
 	}
 
 	EOS_Platform_Tick(PlatformHandle);
+
+	// completion callbacks ran during the platform tick, the SDK is done with these requests
+	erase_if(ActiveRequests, [](const FVoiceRequestPtr& Request) { return Request->IsComplete(); });
+}
+
+void FVoiceSdk::CancelRequests()
+{
+	std::vector<FQueuedRequest> QueuedRequests;
+	{
+		FScopedLock Lock(RequestsMutex);
+		bRequestsCanceled = true;
+		std::swap(NewRequests, QueuedRequests);
+	}
+
+	// abandoned requests are dropped as in Tick, their requester no longer waits for a result
+	for (FQueuedRequest& Queued : QueuedRequests)
+	{
+		if (Queued.Request->TryStart())
+		{
+			Queued.Request->Cancel();
+		}
+	}
+
+	// in flight requests stay alive until shutdown, the SDK may still call back into them
+	for (const FVoiceRequestPtr& Request : ActiveRequests)
+	{
+		Request->Cancel();
+	}
+}
+
+size_t FVoiceSdk::GetQueueDepth() const
+{
+	FScopedLock Lock(RequestsMutex);
+	return NewRequests.size();
+}
+
+void FVoiceSdk::LogRequestStats() const
+{
+	FDebugLog::Log(L"Voice requests: %llu queued, %llu merged into another request, %llu abandoned, at most %llu queued per tick",
+		static_cast<unsigned long long>(RequestStats.NumRequests),
+		static_cast<unsigned long long>(RequestStats.NumMergedRequests),
+		static_cast<unsigned long long>(RequestStats.NumAbandonedRequests),
+		static_cast<unsigned long long>(RequestStats.MaxQueueDepth));
+	RequestStats.QueueWaitTimes.Log(L"Voice request queue wait");
 }
@@ -3,16 +3,21 @@
 #pragma once
 
 #include "NonCopyable.h"
+#include "ServerLoop.h"
 #include "VoiceRequestJoin.h"
 
 #include <eos_sdk.h>
 
-/** Server VoiceSdk Wrapper to manage multiple requests originating from different threads. */
+#include <unordered_map>
+
+/**
+ * Server VoiceSdk Wrapper to manage multiple requests originating from different threads.
+ * Requests can be queued from any thread, their completion callbacks run on the thread calling Tick.
+ * Every request takes an optional ticket: if it was abandoned before Tick got to the request, the request is released
+ * without being made and its completion callback is never called.
+ */
 class FVoiceSdk : public FNonCopyable
 {
-	friend class FJoinRoomReceipt;
-	friend class FVoiceRequestReceipt;
-
 public:
 	FVoiceSdk() noexcept(false) { }
 	virtual ~FVoiceSdk();
@@ -21,20 +26,80 @@ public:
 	EOS_Bool Shutdown();
 	
 	/** Queues up a request for a joinRoom token for each of the provided users */
-	FJoinRoomReceiptPtr CreateJoinRoomTokens(const char* RoomId, const std::vector<FVoiceUser>& Users);
+	void CreateJoinRoomTokens(const char* RoomId, const std::vector<FVoiceUser>& Users, FOnJoinRoomComplete OnComplete, FVoiceRequestTicketPtr Ticket = nullptr);
 
 	/** Queues up a request to kick a user from the session */
-	FVoiceRequestReceiptPtr KickUser(const char* RoomId, const EOS_ProductUserId& ProductUserId);
+	void KickUser(const char* RoomId, const EOS_ProductUserId& ProductUserId, FOnVoiceRequestComplete OnComplete, FVoiceRequestTicketPtr Ticket = nullptr);
 
 	/** Queues up a request to remote mute a user in the session */
-	FVoiceRequestReceiptPtr MuteUser(const char* RoomId, const EOS_ProductUserId& ProductUserId, bool bMute);
+	void MuteUser(const char* RoomId, const EOS_ProductUserId& ProductUserId, bool bMute, FOnVoiceRequestComplete OnComplete, FVoiceRequestTicketPtr Ticket = nullptr);
+
+	/** Called once all requests of a batch completed, with one result per user in the order the users were passed */
+	using FOnBatchComplete = std::function<void(const std::vector<EOS_EResult>&)>;
 
-	/** Processes queued requests */
+	/** Queues up a request to kick each of the users from the session, all of them are made in the same Tick. ProductUserIds must not be empty. */
+	void KickUsers(const char* RoomId, const std::vector<EOS_ProductUserId>& ProductUserIds, FOnBatchComplete OnComplete, FVoiceRequestTicketPtr Ticket = nullptr);
+
+	/** Queues up a request to remote mute each of the users in the session, all of them are made in the same Tick. ProductUserIds must not be empty. */
+	void MuteUsers(const char* RoomId, const std::vector<EOS_ProductUserId>& ProductUserIds, bool bMute, FOnBatchComplete OnComplete, FVoiceRequestTicketPtr Ticket = nullptr);
+
+	/**
+	 * Makes all queued requests in the order they were queued and releases completed ones.
+	 * Join requests for the same room that were queued since the last Tick are merged into one SDK call.
+	 */
 	void Tick();
 
+	/**
+	 * Completes all queued and in flight requests with EOS_Canceled, call from the ticking thread after the last Tick.
+	 * Requests queued afterwards are canceled right away, on the thread queueing them.
+	 */
+	void CancelRequests();
+
+	/** Called on the requesting thread whenever a request was queued, e.g. to wake up the main loop */
+	using FOnRequestQueuedCallback = std::function<void()>;
+	void SetOnRequestQueuedCallback(FOnRequestQueuedCallback Callback);
+
+	/** Counters of the request queue, updated by Tick */
+	struct FRequestStats
+	{
+		/** Requests taken from the queue */
+		uint64_t NumRequests = 0;
+
+		/** Requests merged into an earlier request of the same Tick instead of making their own SDK call */
+		uint64_t NumMergedRequests = 0;
+
+		/** Requests released without being made because the requester stopped waiting for them */
+		uint64_t NumAbandonedRequests = 0;
+
+		/** Most requests a single Tick found queued */
+		size_t MaxQueueDepth = 0;
+
+		/** Time from queueing a request until Tick made it */
+		FDurationHistogram QueueWaitTimes;
+	};
+
+	/** Only call from the ticking thread */
+	const FRequestStats& GetRequestStats() const { return RequestStats; }
+
+	/** Number of requests waiting for the next Tick, safe to call from any thread */
+	size_t GetQueueDepth() const;
+
+	/** Logs the request counters and queue wait times, only call from the ticking thread */
+	void LogRequestStats() const;
+
 private:
-	/** called by Receipt friend classes */
-	void ReleaseRequest(FVoiceRequestHandle VoiceRequestHandle);
+	/** Adds a request to NewRequests and notifies OnRequestQueuedCallback */
+	void QueueRequest(FVoiceRequestPtr Request, FVoiceRequestTicketPtr Ticket);
+
+	/** Adds all requests to NewRequests at once, so the same Tick makes them, and notifies OnRequestQueuedCallback once */
+	void QueueRequests(std::vector<FVoiceRequestPtr> Requests, const FVoiceRequestTicketPtr& Ticket);
+
+	/** A request waiting for Tick */
+	struct FQueuedRequest
+	{
+		FVoiceRequestPtr Request;
+		ServerTimePoint QueuedTime;
+	};
 
 	/** Handle to EOS SDK Platform */
 	EOS_HPlatform PlatformHandle = 0;
@@ -42,12 +107,25 @@ private:
 	/** Handle to EOS SDK RTC Admin system */
 	EOS_HRTCAdmin RTCAdminHandle = 0;
 
-	/** mutex for accessing NewRequests & ActiveRequests */
-	std::mutex RequestsMutex;
+	/** mutex for accessing NewRequests & bRequestsCanceled */
+	mutable std::mutex RequestsMutex;
 	
-	/** new requests that need to be kicked off */
-	std::queue<FVoiceRequestPtr> NewRequests;
+	/** new requests that need to be kicked off, in the order they were queued */
+	std::vector<FQueuedRequest> NewRequests;
 
-	/** active requests that are in flight */
+	/** Requests Tick took from NewRequests, swapped back empty so both keep their capacity */
+	std::vector<FQueuedRequest> TickRequests;
+
+	/** Requests of the current Tick that later ones can be merged into, by merge key */
+	std::unordered_map<std::string, FVoiceRequest*> MergeableRequests;
+
+	/** Set by CancelRequests */
+	bool bRequestsCanceled = false;
+
+	/** active requests that are in flight, only accessed by the ticking thread */
 	std::vector<FVoiceRequestPtr> ActiveRequests;
+
+	FRequestStats RequestStats;
+
+	FOnRequestQueuedCallback OnRequestQueuedCallback;
 };
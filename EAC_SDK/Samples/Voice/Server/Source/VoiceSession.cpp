@@ -8,7 +8,7 @@
 const uint32_t FVoiceSession::kSessionHeartbeatTimeout = 70;
 
 FVoiceSession::FVoiceSession(const std::string& InSessionId, const std::string& InSessionLock, const std::string& InSessionPassword, const std::initializer_list<FVoiceUser>& InSessionMembers) :
-	Expiration(std::chrono::steady_clock::now()),
+	Expiration(0),
 	SessionId(InSessionId),
 	SessionLock(InSessionLock),
 	SessionPassword(InSessionPassword),
@@ -74,12 +74,57 @@ bool FVoiceSession::IsUserBanned(const FVoiceUser& User) const
 	return PuidBanList.find(User.GetPuid()) != PuidBanList.end();
 }
 
+void FVoiceSession::AddInviteToken(const std::string& Puid, const std::string& Token, const std::string& ClientBaseUrl, const ServerTimePoint& TokenExpiration)
+{
+	ResetHeartbeat();
+
+	FScopedLock Lock(InviteTokenMutex);
+
+	// drop tokens of users that never showed up
+	const auto Now = std::chrono::steady_clock::now();
+	for (auto Itr = InviteTokens.begin(); Itr != InviteTokens.end();)
+	{
+		Itr = Now > Itr->second.Expiration ? InviteTokens.erase(Itr) : std::next(Itr);
+	}
+
+	InviteTokens[Puid] = FInviteToken{ Token, ClientBaseUrl, TokenExpiration };
+}
+
+bool FVoiceSession::TakeInviteToken(const std::string& Puid, const ServerTimePoint& Now, std::string& OutToken, std::string& OutClientBaseUrl)
+{
+	FScopedLock Lock(InviteTokenMutex);
+
+	const auto Itr = InviteTokens.find(Puid);
+	if (Itr == InviteTokens.end())
+	{
+		return false;
+	}
+
+	// tokens are handed out once
+	FInviteToken InviteToken = std::move(Itr->second);
+	InviteTokens.erase(Itr);
+	if (Now > InviteToken.Expiration)
+	{
+		return false;
+	}
+
+	OutToken = std::move(InviteToken.Token);
+	OutClientBaseUrl = std::move(InviteToken.ClientBaseUrl);
+	return true;
+}
+
 void FVoiceSession::ResetHeartbeat()
 {
-	Expiration = std::chrono::steady_clock::now() + std::chrono::seconds(FVoiceSession::kSessionHeartbeatTimeout);
+	const ServerTimePoint NewExpiration = std::chrono::steady_clock::now() + std::chrono::seconds(FVoiceSession::kSessionHeartbeatTimeout);
+	Expiration = NewExpiration.time_since_epoch().count();
 }
 
 bool FVoiceSession::IsExpired(const ServerTimePoint& Now) const
 {
-	return Now > Expiration;
+	return Now > GetExpiration();
+}
+
+ServerTimePoint FVoiceSession::GetExpiration() const
+{
+	return ServerTimePoint(ServerTimePoint::duration(Expiration.load()));
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "eos_common.h"
 
+#include <atomic>
+#include <unordered_map>
+
 /** A session with an optional password, private owner lock and list of members. */
 class FVoiceSession
 {
@@ -19,15 +22,27 @@ public:
 	bool BanUser(const FVoiceUser& InUser);
 	bool IsUserBanned(const FVoiceUser& InUser) const;
 
+	/** Keeps a join token issued ahead of time for an invited user until the user joins or the token expires */
+	void AddInviteToken(const std::string& Puid, const std::string& Token, const std::string& ClientBaseUrl, const ServerTimePoint& TokenExpiration);
+
+	/** Removes and returns the invite token of the user, false if the user has none or it expired */
+	bool TakeInviteToken(const std::string& Puid, const ServerTimePoint& Now, std::string& OutToken, std::string& OutClientBaseUrl);
+
 	void ResetHeartbeat();
 	bool IsExpired(const ServerTimePoint& Now) const;
 
+	/** Time the session expires unless it receives a heartbeat or other activity first */
+	ServerTimePoint GetExpiration() const;
+
 private:
 	/** The unique identifier of the session, generated by the voiceServer. */
 	std::string SessionId;
 
-	/** Expiration time of the session, heartbeat the session to keep it alive. Used to remove unused sessions */	  
-	ServerTimePoint Expiration;
+	/**
+	 * Expiration time of the session in steady clock ticks, heartbeat the session to keep it alive. Used to remove unused sessions.
+	 * Moved by the http threads and read by the main loop, so it is atomic.
+	 */
+	std::atomic<ServerTimePoint::rep> Expiration;
 
 	/** The Lock represents a private key, initially only shared with the creator of the session to perform owner-level operations such as kick or remoteMute. */
 	std::string SessionLock;
@@ -42,6 +57,18 @@ private:
 	std::mutex BanListMutex;
 	std::unordered_set<EOS_ProductUserId> PuidBanList;
 
+	/** A join token issued ahead of time, see AddInviteToken */
+	struct FInviteToken
+	{
+		std::string Token;
+		std::string ClientBaseUrl;
+		ServerTimePoint Expiration;
+	};
+
+	/** Invite tokens by puid, expired ones are dropped whenever tokens are added */
+	std::mutex InviteTokenMutex;
+	std::unordered_map<std::string, FInviteToken> InviteTokens;
+
 	/** Sessions expire after N seconds without any activity or heartbeat */
 	static const uint32_t kSessionHeartbeatTimeout;
 };
\ No newline at end of file